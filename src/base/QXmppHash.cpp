@@ -21,6 +21,9 @@ using namespace QXmpp::Private;
 /// One of the hash algorithms specified by the IANA registry or \xep{0300, Use
 /// of Cryptographic Hash Functions in XMPP}.
 ///
+/// Blake3_256 has been added in QXmpp 1.8. Hashes using it can only be
+/// calculated and verified if QXmpp has been built with the BLAKE3 library.
+///
 /// \since QXmpp 1.5
 ///
 
@@ -55,6 +58,8 @@ static QString algorithmToString(HashAlgorithm algorithm)
         return u"blake2b-256"_s;
     case HashAlgorithm::Blake2b_512:
         return u"blake2b-512"_s;
+    case HashAlgorithm::Blake3_256:
+        return u"blake3-256"_s;
     }
     Q_UNREACHABLE();
 }
@@ -100,6 +105,9 @@ static HashAlgorithm hashAlgorithmFromString(const QString &str)
     if (str == u"blake2b-512") {
         return HashAlgorithm::Blake2b_512;
     }
+    if (str == u"blake3-256") {
+        return HashAlgorithm::Blake3_256;
+    }
     return HashAlgorithm::Unknown;
 }
 
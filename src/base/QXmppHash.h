@@ -29,6 +29,7 @@ enum class HashAlgorithm : uint32_t {
     Sha3_512,
     Blake2b_256,
     Blake2b_512,
+    Blake3_256,
 };
 
 }
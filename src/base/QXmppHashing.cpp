@@ -9,13 +9,20 @@
 #include "Algorithms.h"
 #include "StringLiterals.h"
 
+#include <deque>
+
 #include <QCryptographicHash>
 #include <QFuture>
 #include <QFutureInterface>
 #include <QIODevice>
+#include <QMutex>
 #include <QRunnable>
 #include <QThreadPool>
 
+#ifdef WITH_BLAKE3
+#include <blake3.h>
+#endif
+
 using namespace QXmpp;
 using namespace QXmpp::Private;
 
@@ -25,53 +32,12 @@ class HashGenerator;
 constexpr std::size_t PROCESS_SYNC_MAX_SIZE = 32 * 1024;
 // 512 kB (two buffers are used so 1 MB)
 constexpr std::size_t BUFFER_SIZE = 512 * 1024;
-
-/// \cond
-static HashAlgorithm toHashAlgorithm(QCryptographicHash::Algorithm algorithm)
-{
-    switch (algorithm) {
-    case QCryptographicHash::Md4:
-    case QCryptographicHash::Keccak_224:
-    case QCryptographicHash::Keccak_256:
-    case QCryptographicHash::Keccak_384:
-    case QCryptographicHash::Keccak_512:
-    case QCryptographicHash::Sha3_224:
-    case QCryptographicHash::Sha3_384:
-#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-    case QCryptographicHash::Blake2b_160:
-    case QCryptographicHash::Blake2b_384:
-    case QCryptographicHash::Blake2s_128:
-    case QCryptographicHash::Blake2s_160:
-    case QCryptographicHash::Blake2s_224:
-    case QCryptographicHash::Blake2s_256:
-#endif
-        return HashAlgorithm::Unknown;
-    case QCryptographicHash::Md5:
-        return HashAlgorithm::Md5;
-    case QCryptographicHash::Sha1:
-        return HashAlgorithm::Sha1;
-    case QCryptographicHash::Sha224:
-        return HashAlgorithm::Sha224;
-    case QCryptographicHash::Sha256:
-        return HashAlgorithm::Sha256;
-    case QCryptographicHash::Sha384:
-        return HashAlgorithm::Sha384;
-    case QCryptographicHash::Sha512:
-        return HashAlgorithm::Sha512;
-    case QCryptographicHash::Sha3_256:
-        return HashAlgorithm::Sha3_256;
-    case QCryptographicHash::Sha3_512:
-        return HashAlgorithm::Sha3_512;
-#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-    case QCryptographicHash::Blake2b_256:
-        return HashAlgorithm::Blake2b_256;
-    case QCryptographicHash::Blake2b_512:
-        return HashAlgorithm::Blake2b_512;
+#ifdef HAVE_BLAKE3_TBB
+// 128 kB, below this size splitting the BLAKE3 tree across threads doesn't pay off
+constexpr std::size_t BLAKE3_PARALLEL_MIN_SIZE = 128 * 1024;
 #endif
-    }
-    return HashAlgorithm::Unknown;
-}
 
+/// \cond
 static std::optional<QCryptographicHash::Algorithm> toCryptograhicHashAlgorithm(HashAlgorithm algorithm)
 {
     switch (algorithm) {
@@ -106,10 +72,93 @@ static std::optional<QCryptographicHash::Algorithm> toCryptograhicHashAlgorithm(
     case HashAlgorithm::Blake2b_512:
         return {};
 #endif
+    case HashAlgorithm::Blake3_256:
+        return {};
     }
     return {};
 }
 
+// Incrementally calculates the hash of one algorithm, using QCryptographicHash or the BLAKE3
+// library.
+class Hasher
+{
+public:
+    explicit Hasher(HashAlgorithm algorithm)
+        : m_algorithm(algorithm)
+    {
+        Q_ASSERT_X(isSupported(algorithm), "hasher", "Must only be called with supported algorithms");
+#ifdef WITH_BLAKE3
+        if (algorithm == HashAlgorithm::Blake3_256) {
+            m_blake3 = std::make_unique<blake3_hasher>();
+            blake3_hasher_init(m_blake3.get());
+            return;
+        }
+#endif
+        m_hash = std::make_unique<QCryptographicHash>(*toCryptograhicHashAlgorithm(algorithm));
+    }
+
+    static bool isSupported(HashAlgorithm algorithm)
+    {
+#ifdef WITH_BLAKE3
+        if (algorithm == HashAlgorithm::Blake3_256) {
+            return true;
+        }
+#endif
+        return toCryptograhicHashAlgorithm(algorithm).has_value();
+    }
+
+    HashAlgorithm algorithm() const { return m_algorithm; }
+
+    void addData(const char *data, std::size_t size)
+    {
+#ifdef WITH_BLAKE3
+        if (m_blake3) {
+#ifdef HAVE_BLAKE3_TBB
+            // BLAKE3 is a tree hash: large inputs are split into subtrees hashed on all cores
+            if (size >= BLAKE3_PARALLEL_MIN_SIZE) {
+                blake3_hasher_update_tbb(m_blake3.get(), data, size);
+                return;
+            }
+#endif
+            blake3_hasher_update(m_blake3.get(), data, size);
+            return;
+        }
+#endif
+#if QT_VERSION >= QT_VERSION_CHECK(6, 3, 0)
+        m_hash->addData(QByteArrayView(data, qsizetype(size)));
+#else
+        m_hash->addData(data, int(size));
+#endif
+    }
+
+    QByteArray result() const
+    {
+#ifdef WITH_BLAKE3
+        if (m_blake3) {
+            QByteArray output(BLAKE3_OUT_LEN, Qt::Uninitialized);
+            blake3_hasher_finalize(m_blake3.get(), reinterpret_cast<uint8_t *>(output.data()), BLAKE3_OUT_LEN);
+            return output;
+        }
+#endif
+        return m_hash->result();
+    }
+
+    QXmppHash hash() const
+    {
+        QXmppHash hash;
+        hash.setAlgorithm(m_algorithm);
+        hash.setHash(result());
+        return hash;
+    }
+
+private:
+    HashAlgorithm m_algorithm;
+    std::unique_ptr<QCryptographicHash> m_hash;
+#ifdef WITH_BLAKE3
+    std::unique_ptr<blake3_hasher> m_blake3;
+#endif
+};
+
 bool QXmpp::Private::isHashingAlgorithmSecure(HashAlgorithm algorithm)
 {
     switch (algorithm) {
@@ -128,6 +177,7 @@ bool QXmpp::Private::isHashingAlgorithmSecure(HashAlgorithm algorithm)
     case HashAlgorithm::Sha3_512:
     case HashAlgorithm::Blake2b_256:
     case HashAlgorithm::Blake2b_512:
+    case HashAlgorithm::Blake3_256:
         return true;
     }
     return false;
@@ -158,6 +208,7 @@ uint16_t QXmpp::Private::hashPriority(HashAlgorithm algorithm)
         return 9;
     // prefer BLAKE2 over SHA3 because BLAKE2 is faster
     // prefer 512 bits over 256 bits
+    // prefer BLAKE3 over everything else because it is by far the fastest
     case HashAlgorithm::Sha3_256:
         return 10;
     case HashAlgorithm::Blake2b_256:
@@ -166,6 +217,8 @@ uint16_t QXmpp::Private::hashPriority(HashAlgorithm algorithm)
         return 12;
     case HashAlgorithm::Blake2b_512:
         return 13;
+    case HashAlgorithm::Blake3_256:
+        return 14;
     }
     return 0;
 }
@@ -190,21 +243,21 @@ auto deviceSize(QIODevice &device) -> std::optional<std::size_t>
     return std::nullopt;
 }
 
-HashingResult calculateHashesSync(std::unique_ptr<QIODevice> data, const std::vector<QCryptographicHash::Algorithm> &algorithms)
+HashingResult calculateHashesSync(std::unique_ptr<QIODevice> data, std::size_t size, const std::vector<HashAlgorithm> &algorithms)
 {
+    // read the data only once for all algorithms
+    data->seek(0);
+    const auto content = data->read(qint64(size));
+    if (content.size() != qsizetype(size)) {
+        return { QXmppError::fromIoDevice(*data), std::move(data) };
+    }
+
     std::vector<QXmppHash> results;
     results.reserve(algorithms.size());
     for (auto algorithm : algorithms) {
-        QCryptographicHash hasher(algorithm);
-        data->seek(0);
-        if (!hasher.addData(data.get())) {
-            return { QXmppError::fromIoDevice(*data), std::move(data) };
-        }
-
-        QXmppHash hash;
-        hash.setAlgorithm(toHashAlgorithm(algorithm));
-        hash.setHash(hasher.result());
-        results.push_back(hash);
+        Hasher hasher(algorithm);
+        hasher.addData(content.constData(), std::size_t(content.size()));
+        results.push_back(hasher.hash());
     }
     return { std::move(results), std::move(data) };
 }
@@ -223,17 +276,15 @@ struct BufferReader : public QRunnable {
 };
 
 struct HashProcessor : public QRunnable {
-    HashProcessor(HashGenerator *generator, QCryptographicHash::Algorithm algorithm)
+    HashProcessor(HashGenerator *generator, HashAlgorithm algorithm)
         : generator(generator),
-          hash(std::make_unique<QCryptographicHash>(algorithm)),
-          algorithm(algorithm)
+          hash(std::make_unique<Hasher>(algorithm))
     {
         setAutoDelete(false);
     }
     HashProcessor(HashProcessor &&other) noexcept
         : generator(other.generator),
-          hash(std::move(other.hash)),
-          algorithm(other.algorithm)
+          hash(std::move(other.hash))
     {
     }
     ~HashProcessor() override = default;
@@ -241,8 +292,7 @@ struct HashProcessor : public QRunnable {
     void run() override;
 
     HashGenerator *generator;
-    std::unique_ptr<QCryptographicHash> hash;
-    QCryptographicHash::Algorithm algorithm;
+    std::unique_ptr<Hasher> hash;
 };
 
 class HashGenerator : public QObject
@@ -255,13 +305,6 @@ public:
                                 std::function<void(HashingResult)> reportResult,
                                 std::function<bool()> isCancelled)
     {
-        // convert to QCryptographicHash::Algorithm for hashing
-        auto qtAlgorithms = transform<std::vector<QCryptographicHash::Algorithm>>(algorithms, [](auto algorithm) {
-            auto converted = toCryptograhicHashAlgorithm(algorithm);
-            Q_ASSERT_X(converted.has_value(), "calculate hashes", "Must only be called with algorithms supported by QCryptographicHash");
-            return *converted;
-        });
-
         // check for readability
         if (!data->isOpen() || !data->isReadable()) {
             reportResult({ QXmppError {
@@ -277,18 +320,18 @@ public:
 
         // optimization for small data
         if (auto size = deviceSize(*data)) {
-            if ((algorithms.size() * data->size()) <= PROCESS_SYNC_MAX_SIZE) {
-                reportResult(calculateHashesSync(std::move(data), std::move(qtAlgorithms)));
+            if ((algorithms.size() * *size) <= PROCESS_SYNC_MAX_SIZE) {
+                reportResult(calculateHashesSync(std::move(data), *size, algorithms));
                 return;
             }
         }
 
         // start normal hash calculation with hash generator
-        new HashGenerator(std::move(data), std::move(qtAlgorithms), std::move(reportResult), std::move(isCancelled));
+        new HashGenerator(std::move(data), std::move(algorithms), std::move(reportResult), std::move(isCancelled));
     }
 
     HashGenerator(std::unique_ptr<QIODevice> data,
-                  std::vector<QCryptographicHash::Algorithm> algorithms,
+                  std::vector<HashAlgorithm> algorithms,
                   std::function<void(HashingResult)> reportResult,
                   std::function<bool()> isCancelled)
         : m_data(std::move(data)),
@@ -383,10 +426,7 @@ public:
     void finish()
     {
         auto hashes = transform<std::vector<QXmppHash>>(m_hashProcessors, [](auto &processor) {
-            QXmppHash hash;
-            hash.setAlgorithm(toHashAlgorithm(processor.algorithm));
-            hash.setHash(processor.hash->result());
-            return hash;
+            return processor.hash->hash();
         });
         m_reportResult({ std::move(hashes), std::move(m_data) });
     }
@@ -424,11 +464,7 @@ void BufferReader::run()
 void HashProcessor::run()
 {
     auto &buffer = generator->m_processBuffer;
-#if QT_VERSION >= QT_VERSION_CHECK(6, 3, 0)
-    hash->addData(QByteArrayView(buffer.data(), buffer.size()));
-#else
     hash->addData(buffer.data(), buffer.size());
-#endif
     generator->reportJobFinished();
 }
 
@@ -448,51 +484,242 @@ QFuture<HashingResultPtr> QXmpp::Private::calculateHashes(std::unique_ptr<QIODev
     return interface.future();
 }
 
-QFuture<HashVerificationResultPtr> QXmpp::Private::verifyHashes(std::unique_ptr<QIODevice> data, std::vector<QXmppHash> hashes)
+std::optional<QXmppHash> QXmpp::Private::verificationHash(std::vector<QXmppHash> hashes)
 {
-    // filter out invalid hashes and insecure
+    // filter out invalid, insecure and unsupported hashes
     auto isInvalid = [](const auto &hash) {
-        return hash.hash().isEmpty() || !isHashingAlgorithmSecure(hash.algorithm());
+        return hash.hash().isEmpty() || !isHashingAlgorithmSecure(hash.algorithm()) ||
+            !Hasher::isSupported(hash.algorithm());
     };
     hashes.erase(std::remove_if(hashes.begin(), hashes.end(), isInvalid), hashes.end());
 
     if (hashes.empty()) {
-        return makeReadyResult(HashVerificationResult::NoStrongHashes(), std::move(data));
+        return {};
     }
 
-    std::sort(hashes.begin(), hashes.end(), [](const auto &a, const auto &b) {
+    return *std::max_element(hashes.begin(), hashes.end(), [](const auto &a, const auto &b) {
         return hashPriority(a.algorithm()) < hashPriority(b.algorithm());
     });
+}
 
-    auto expected = hashes.back();
-
-    auto verifyResult = [](auto &result, auto &expected) -> HashVerificationResult::Result {
-        if (auto actualHashes = std::get_if<std::vector<QXmppHash>>(&result)) {
-            Q_ASSERT(!actualHashes->empty());
-            if (actualHashes->front().hash() == expected.hash()) {
-                return HashVerificationResult::Verified();
-            }
-            return HashVerificationResult::NotMatching();
-        } else if (std::holds_alternative<Cancelled>(result)) {
-            return Cancelled();
+HashVerificationResult::Result QXmpp::Private::verifyHashingResult(HashingResult::Result &&result, const QXmppHash &expected)
+{
+    if (auto actualHashes = std::get_if<std::vector<QXmppHash>>(&result)) {
+        Q_ASSERT(!actualHashes->empty());
+        if (actualHashes->front().hash() == expected.hash()) {
+            return HashVerificationResult::Verified();
         }
-        return std::get<QXmppError>(std::move(result));
-    };
+        return HashVerificationResult::NotMatching();
+    } else if (std::holds_alternative<Cancelled>(result)) {
+        return Cancelled();
+    }
+    return std::get<QXmppError>(std::move(result));
+}
+
+QFuture<HashVerificationResultPtr> QXmpp::Private::verifyHashes(std::unique_ptr<QIODevice> data, std::vector<QXmppHash> hashes)
+{
+    auto expected = verificationHash(std::move(hashes));
+    if (!expected) {
+        return makeReadyResult(HashVerificationResult::NoStrongHashes(), std::move(data));
+    }
 
     QFutureInterface<HashVerificationResultPtr> interface;
-    auto finish = [interface, expected, verifyResult](HashingResult &&hashingResult) mutable {
+    auto finish = [interface, expected = *expected](HashingResult &&hashingResult) mutable {
         auto &[result, data] = hashingResult;
 
-        interface.reportResult(std::make_shared<HashVerificationResult>(verifyResult(result, expected), std::move(data)));
+        interface.reportResult(std::make_shared<HashVerificationResult>(verifyHashingResult(std::move(result), expected), std::move(data)));
         interface.reportFinished();
     };
     auto isCancelled = [interface]() {
         return interface.isCanceled();
     };
 
-    HashGenerator::calculateHashes(std::move(data), { expected.algorithm() }, std::move(finish), std::move(isCancelled));
+    HashGenerator::calculateHashes(std::move(data), { expected->algorithm() }, std::move(finish), std::move(isCancelled));
     return interface.future();
 }
+namespace QXmpp::Private {
+
+// hashes the chunks of a HashingDevice in the thread pool, one chunk after another
+struct HashingDeviceState : public std::enable_shared_from_this<HashingDeviceState> {
+    explicit HashingDeviceState(const std::vector<HashAlgorithm> &algorithms)
+    {
+        hashes = transform<std::vector<std::unique_ptr<Hasher>>>(algorithms, [](auto algorithm) {
+            return std::make_unique<Hasher>(algorithm);
+        });
+        interface.reportStarted();
+    }
+
+    void addData(QByteArray &&chunk)
+    {
+        QMutexLocker locker(&mutex);
+        queue.push_back(std::move(chunk));
+        startProcessing();
+    }
+
+    void finish(bool completelyRead)
+    {
+        QMutexLocker locker(&mutex);
+        finished = true;
+        complete = completelyRead;
+        startProcessing();
+    }
+
+    // mutex must be locked
+    void startProcessing()
+    {
+        if (!running) {
+            running = true;
+            QThreadPool::globalInstance()->start([self = shared_from_this()]() {
+                self->process();
+            });
+        }
+    }
+
+    void process()
+    {
+        QMutexLocker locker(&mutex);
+        while (!queue.empty()) {
+            auto chunk = std::move(queue.front());
+            queue.pop_front();
+
+            locker.unlock();
+            if (!interface.isCanceled()) {
+                for (auto &hash : hashes) {
+                    hash->addData(chunk.constData(), std::size_t(chunk.size()));
+                }
+            }
+            locker.relock();
+        }
+        running = false;
+
+        if (finished && !reported) {
+            reported = true;
+            reportResult();
+        }
+    }
+
+    void reportResult()
+    {
+        auto result = [this]() -> HashingResult::Result {
+            if (interface.isCanceled()) {
+                return Cancelled();
+            }
+            if (!complete) {
+                return QXmppError { u"The data has not been read completely."_s, std::any() };
+            }
+            return transform<std::vector<QXmppHash>>(hashes, [](const auto &hash) {
+                return hash->hash();
+            });
+        }();
+        interface.reportResult(std::make_shared<HashingResult>(std::move(result), nullptr));
+        interface.reportFinished();
+    }
+
+    QFutureInterface<HashingResultPtr> interface;
+    std::vector<std::unique_ptr<Hasher>> hashes;
+
+    QMutex mutex;
+    std::deque<QByteArray> queue;
+    bool running = false;
+    bool finished = false;
+    bool complete = false;
+    bool reported = false;
+};
+
+HashingDevice::HashingDevice(std::unique_ptr<QIODevice> device, std::vector<HashAlgorithm> algorithms)
+    : m_device(std::move(device)),
+      m_state(std::make_shared<HashingDeviceState>(algorithms))
+{
+    // unbuffered, so that the position always matches the device's position
+    setOpenMode((m_device->openMode() & QIODevice::ReadWrite) | QIODevice::Unbuffered);
+}
+
+HashingDevice::~HashingDevice()
+{
+    finish();
+}
+
+QFuture<HashingResultPtr> HashingDevice::hashesFuture() const
+{
+    return m_state->interface.future();
+}
+
+void HashingDevice::finish()
+{
+    if (!m_hashingFinished) {
+        m_hashingFinished = true;
+        // when reading, all data up to the end must have been read
+        m_state->finish(!m_incomplete && (isWritable() || m_device->isSequential() || m_hashedBytes == m_device->size()));
+    }
+}
+
+void HashingDevice::close()
+{
+    finish();
+    m_device->close();
+    QIODevice::close();
+}
+
+bool HashingDevice::isSequential() const
+{
+    // written data is hashed in order, so writers must not seek
+    return isWritable() || m_device->isSequential();
+}
+
+qint64 HashingDevice::size() const
+{
+    return m_device->size();
+}
+
+bool HashingDevice::seek(qint64 pos)
+{
+    return QIODevice::seek(pos) && m_device->seek(pos);
+}
+
+qint64 HashingDevice::readData(char *data, qint64 maxlen)
+{
+    const auto start = m_device->isSequential() ? m_hashedBytes : m_device->pos();
+    const auto read = m_device->read(data, maxlen);
+    if (read < 0) {
+        setErrorString(m_device->errorString());
+        return read;
+    }
+
+    hashData(start, data, read);
+    if (!isWritable() && !m_device->isSequential() && m_hashedBytes >= m_device->size()) {
+        finish();
+    }
+    return read;
+}
+
+qint64 HashingDevice::writeData(const char *data, qint64 len)
+{
+    const auto start = m_device->isSequential() ? m_hashedBytes : m_device->pos();
+    const auto written = m_device->write(data, len);
+    if (written < 0) {
+        setErrorString(m_device->errorString());
+        return written;
+    }
+
+    hashData(start, data, written);
+    return written;
+}
+
+void HashingDevice::hashData(qint64 start, const char *data, qint64 length)
+{
+    if (start > m_hashedBytes) {
+        // data has been skipped and can't be hashed anymore
+        m_incomplete = true;
+    } else if (start + length > m_hashedBytes && !m_hashingFinished) {
+        // only hash data that has not been hashed before
+        const auto offset = m_hashedBytes - start;
+        m_state->addData(QByteArray(data + offset, int(length - offset)));
+        m_hashedBytes = start + length;
+    }
+}
+
+}  // namespace QXmpp::Private
+
 /// \endcond
 
 #include "QXmppHashing.moc"
@@ -10,10 +10,12 @@
 #include "QXmppHash.h"
 
 #include <memory>
+#include <optional>
 #include <variant>
 #include <vector>
 
 #include <QCryptographicHash>
+#include <QIODevice>
 
 template<typename T>
 class QFuture;
@@ -57,6 +59,49 @@ uint16_t hashPriority(HashAlgorithm algorithm);
 // QXMPP_EXPORT for unit tests
 QXMPP_EXPORT QFuture<HashingResultPtr> calculateHashes(std::unique_ptr<QIODevice> data, std::vector<HashAlgorithm> hashes);
 QFuture<HashVerificationResultPtr> verifyHashes(std::unique_ptr<QIODevice> data, std::vector<QXmppHash> hashes);
+// strongest hash that can be used for verification, QXMPP_EXPORT for unit tests
+QXMPP_EXPORT std::optional<QXmppHash> verificationHash(std::vector<QXmppHash> hashes);
+QXMPP_EXPORT HashVerificationResult::Result verifyHashingResult(HashingResult::Result &&result, const QXmppHash &expected);
+
+struct HashingDeviceState;
+
+// Device that passes through the data read from or written to another device and calculates
+// hashes of it on the way, so the data doesn't need to be read a second time for hashing.
+//
+// The hashes are calculated in the thread pool in the order of the data. When reading, the result
+// is reported once the device has been read until its end. When writing, the result is reported
+// on finish(), close() or destruction. If data has been skipped, an error is reported.
+// Devices opened for writing are sequential, so writers append the data in order.
+//
+// QXMPP_EXPORT for unit tests
+class QXMPP_EXPORT HashingDevice : public QIODevice
+{
+public:
+    HashingDevice(std::unique_ptr<QIODevice> device, std::vector<HashAlgorithm> algorithms);
+    ~HashingDevice() override;
+
+    QFuture<HashingResultPtr> hashesFuture() const;
+    void finish();
+
+    void close() override;
+    bool isSequential() const override;
+    qint64 size() const override;
+    bool seek(qint64 pos) override;
+
+protected:
+    qint64 readData(char *data, qint64 maxlen) override;
+    qint64 writeData(const char *data, qint64 len) override;
+
+private:
+    void hashData(qint64 start, const char *data, qint64 length);
+
+    std::unique_ptr<QIODevice> m_device;
+    std::shared_ptr<HashingDeviceState> m_state;
+    // number of bytes from the start of the device that have been passed to the hashes
+    qint64 m_hashedBytes = 0;
+    bool m_incomplete = false;
+    bool m_hashingFinished = false;
+};
 
 }  // namespace QXmpp::Private
 
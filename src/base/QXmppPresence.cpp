@@ -52,6 +52,8 @@ public:
     QString mucPassword;
     QList<int> mucStatusCodes;
     bool mucSupported;
+    std::optional<int> mucHistoryMaxStanzas;
+    QDateTime mucHistorySince;
 
     // XEP-0115: Entity Capabilities
     QString capabilityHash;
@@ -348,6 +350,55 @@ void QXmppPresence::setMucSupported(bool supported)
     d->mucSupported = supported;
 }
 
+///
+/// Returns the maximum number of history messages requested when joining a
+/// MUC room.
+///
+/// \since QXmpp 1.8
+///
+std::optional<int> QXmppPresence::mucHistoryMaxStanzas() const
+{
+    return d->mucHistoryMaxStanzas;
+}
+
+///
+/// Sets the maximum number of history messages requested when joining a MUC
+/// room.
+///
+/// 0 requests no history at all. This is only sent if isMucSupported() is
+/// true.
+///
+/// \since QXmpp 1.8
+///
+void QXmppPresence::setMucHistoryMaxStanzas(std::optional<int> maxStanzas)
+{
+    d->mucHistoryMaxStanzas = maxStanzas;
+}
+
+///
+/// Returns the date since when history messages are requested when joining a
+/// MUC room.
+///
+/// \since QXmpp 1.8
+///
+QDateTime QXmppPresence::mucHistorySince() const
+{
+    return d->mucHistorySince;
+}
+
+///
+/// Sets the date since when history messages are requested when joining a MUC
+/// room.
+///
+/// This is only sent if isMucSupported() is true.
+///
+/// \since QXmpp 1.8
+///
+void QXmppPresence::setMucHistorySince(const QDateTime &since)
+{
+    d->mucHistorySince = since;
+}
+
 ///
 /// Returns when the last user interaction with the client took place. See
 /// \xep{0319}: Last User Interaction in Presence for details.
@@ -445,6 +496,14 @@ void QXmppPresence::parseExtension(const QDomElement &element, QXmppElementList
     if (element.tagName() == u"x" && element.namespaceURI() == ns_muc) {
         d->mucSupported = true;
         d->mucPassword = element.firstChildElement(u"password"_s).text();
+
+        if (const auto historyElement = firstChildElement(element, u"history"); !historyElement.isNull()) {
+            bool ok = false;
+            if (const auto maxStanzas = historyElement.attribute(u"maxstanzas"_s).toInt(&ok); ok) {
+                d->mucHistoryMaxStanzas = maxStanzas;
+            }
+            d->mucHistorySince = QXmppUtils::datetimeFromString(historyElement.attribute(u"since"_s));
+        }
     } else if (element.tagName() == u"x" && element.namespaceURI() == ns_muc_user) {
         d->mucItem.parse(firstChildElement(element, u"item"));
 
@@ -522,6 +581,14 @@ void QXmppPresence::toXml(QXmlStreamWriter *xmlWriter) const
         if (!d->mucPassword.isEmpty()) {
             xmlWriter->writeTextElement(QSL65("password"), d->mucPassword);
         }
+        if (d->mucHistoryMaxStanzas || d->mucHistorySince.isValid()) {
+            xmlWriter->writeStartElement(QSL65("history"));
+            if (d->mucHistoryMaxStanzas) {
+                xmlWriter->writeAttribute(QSL65("maxstanzas"), QString::number(*d->mucHistoryMaxStanzas));
+            }
+            writeOptionalXmlAttribute(xmlWriter, u"since", QXmppUtils::datetimeToString(d->mucHistorySince));
+            xmlWriter->writeEndElement();
+        }
         xmlWriter->writeEndElement();
     }
 
@@ -89,6 +89,12 @@ public:
     bool isMucSupported() const;
     void setMucSupported(bool supported);
 
+    std::optional<int> mucHistoryMaxStanzas() const;
+    void setMucHistoryMaxStanzas(std::optional<int> maxStanzas);
+
+    QDateTime mucHistorySince() const;
+    void setMucHistorySince(const QDateTime &since);
+
     // XEP-0153: vCard-Based Avatars
     QByteArray photoHash() const;
     void setPhotoHash(const QByteArray &);
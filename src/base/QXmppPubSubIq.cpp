@@ -97,6 +97,7 @@ public:
     uint32_t maxItems = 0;
     std::optional<QXmppDataForm> dataForm;
     std::optional<QXmppResultSetReply> itemsContinuation;
+    std::optional<QXmppResultSetQuery> itemsQuery;
 };
 
 }  // namespace QXmpp::Private
@@ -312,6 +313,22 @@ void PubSubIqBase::setItemsContinuation(const std::optional<QXmppResultSetReply>
     d->itemsContinuation = itemsContinuation;
 }
 
+///
+/// Returns which items are requested using Result Set Management.
+///
+std::optional<QXmppResultSetQuery> PubSubIqBase::itemsQuery() const
+{
+    return d->itemsQuery;
+}
+
+///
+/// Sets which items are requested using Result Set Management.
+///
+void PubSubIqBase::setItemsQuery(const std::optional<QXmppResultSetQuery> &itemsQuery)
+{
+    d->itemsQuery = itemsQuery;
+}
+
 bool PubSubIqBase::isPubSubIq(const QDomElement &element)
 {
     // no special requirements for the item / it's payload
@@ -630,7 +647,9 @@ void PubSubIqBase::toXmlElementFromChild(QXmlStreamWriter *writer) const
         }
 
         // Result Set Management
-        if (d->queryType == Items && d->itemsContinuation.has_value()) {
+        if (d->queryType == Items && d->itemsQuery.has_value()) {
+            d->itemsQuery->toXml(writer);
+        } else if (d->queryType == Items && d->itemsContinuation.has_value()) {
             d->itemsContinuation->toXml(writer);
         }
     }
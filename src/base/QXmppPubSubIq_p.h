@@ -17,6 +17,7 @@
 class QXmppDataForm;
 class QXmppPubSubSubscription;
 class QXmppPubSubAffiliation;
+class QXmppResultSetQuery;
 class QXmppResultSetReply;
 
 namespace QXmpp::Private {
@@ -83,6 +84,9 @@ public:
     std::optional<QXmppResultSetReply> itemsContinuation() const;
     void setItemsContinuation(const std::optional<QXmppResultSetReply> &itemsContinuation);
 
+    std::optional<QXmppResultSetQuery> itemsQuery() const;
+    void setItemsQuery(const std::optional<QXmppResultSetQuery> &itemsQuery);
+
     /// \cond
     static bool isPubSubIq(const QDomElement &element);
 
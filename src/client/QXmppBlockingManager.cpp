@@ -11,18 +11,57 @@
 
 #include "StringLiterals.h"
 
+#include <algorithm>
+#include <iterator>
+#include <unordered_set>
+
 #include <QDomElement>
 
 using namespace QXmpp;
 using namespace QXmpp::Private;
 using StanzaError = QXmppStanza::Error;
 
-// utility function
-template<typename T>
-static void makeUnique(T &vec)
+// Set of JIDs that can be looked up by QStringView without allocating a QString
+struct JidHash {
+    using is_transparent = void;
+    size_t operator()(QStringView jid) const { return qHash(jid); }
+};
+struct JidEqual {
+    using is_transparent = void;
+    bool operator()(QStringView a, QStringView b) const { return a == b; }
+};
+using JidSet = std::unordered_set<QString, JidHash, JidEqual>;
+
+// Parts of a JID referencing the original string
+struct JidParts {
+    QStringView user;
+    QStringView domain;
+    QStringView resource;
+    // "user@domain"
+    QStringView bareJid;
+    // "domain/resource"
+    QStringView domainResource;
+};
+
+static JidParts splitJid(QStringView jid)
 {
-    std::sort(vec.begin(), vec.end());
-    vec.erase(std::unique(vec.begin(), vec.end()), vec.end());
+    JidParts parts;
+    const auto slash = jid.indexOf(u'/');
+    parts.bareJid = slash < 0 ? jid : jid.left(slash);
+    if (slash >= 0) {
+        parts.resource = jid.mid(slash + 1);
+    }
+
+    const auto at = parts.bareJid.indexOf(u'@');
+    if (at >= 0) {
+        parts.user = parts.bareJid.left(at);
+        parts.domain = parts.bareJid.mid(at + 1);
+        parts.domainResource = jid.mid(at + 1);
+    } else {
+        parts.domain = parts.bareJid;
+        parts.domainResource = jid;
+    }
+    return parts;
 }
 
 // IQ parsing helpers
@@ -125,7 +164,7 @@ public:
 
 // Manager data
 struct QXmppBlockingManagerPrivate {
-    std::optional<QVector<QString>> blocklist;
+    std::optional<QXmppBlocklist> blocklist;
     std::vector<QXmppPromise<QXmppBlockingManager::BlocklistResult>> openFetchBlocklistPromises;
 };
 
@@ -268,7 +307,7 @@ QXmppTask<QXmppBlockingManager::BlocklistResult> QXmppBlockingManager::fetchBloc
 {
     // use cached blocklist if possible
     if (d->blocklist) {
-        return makeReadyTask<BlocklistResult>(QXmppBlocklist(d->blocklist.value()));
+        return makeReadyTask<BlocklistResult>(QXmppBlocklist(*d->blocklist));
     }
 
     // This function is designed so that you can call it multiple times and the actual IQ request
@@ -294,7 +333,7 @@ QXmppTask<QXmppBlockingManager::BlocklistResult> QXmppBlockingManager::fetchBloc
             // store blocklist on success
             if (!d->blocklist) {
                 if (auto *blocklist = std::get_if<QXmppBlocklist>(&blocklistResult)) {
-                    d->blocklist = blocklist->entries();
+                    d->blocklist = *blocklist;
                     Q_EMIT subscribedChanged();
                 }
             }
@@ -405,9 +444,7 @@ bool QXmppBlockingManager::handleStanza(const QDomElement &stanza, const std::op
         }
 
         // store new jids
-        d->blocklist->append(iq.jids);
-        // assure blocklist has no duplicates
-        makeUnique(*d->blocklist);
+        d->blocklist->addEntries(iq.jids);
 
         Q_EMIT blocked(iq.jids);
         return QXmppIq(QXmppIq::Result);
@@ -418,9 +455,7 @@ bool QXmppBlockingManager::handleStanza(const QDomElement &stanza, const std::op
         }
 
         // remove jids
-        for (const auto &jid : iq.jids) {
-            d->blocklist->removeOne(jid);
-        }
+        d->blocklist->removeEntries(iq.jids);
 
         Q_EMIT unblocked(iq.jids);
         return QXmppIq(QXmppIq::Result);
@@ -456,12 +491,72 @@ void QXmppBlockingManager::onConnected()
 /// blocked (NotBlocked).
 ///
 
-QXmppBlocklist::QXmppBlocklist() = default;
+// Set of blocked JIDs of one type, shared between copies of a blocklist until one of them
+// modifies it
+struct SharedJidSet : QSharedData {
+    JidSet jids;
+};
+
+class QXmppBlocklistPrivate : public QSharedData
+{
+public:
+    QSharedDataPointer<SharedJidSet> &indexFor(const JidParts &parts)
+    {
+        if (parts.user.isEmpty()) {
+            return parts.resource.isNull() ? domains : domainResources;
+        }
+        return parts.resource.isNull() ? bareJids : fullJids;
+    }
+    const JidSet &indexFor(const JidParts &parts) const
+    {
+        if (parts.user.isEmpty()) {
+            return (parts.resource.isNull() ? domains : domainResources)->jids;
+        }
+        return (parts.resource.isNull() ? bareJids : fullJids)->jids;
+    }
+
+    // only the set of the entry's type is detached from other copies of the blocklist
+    void addEntry(const QString &entry)
+    {
+        const auto parts = splitJid(entry);
+        if (!contains(std::as_const(*this).indexFor(parts), entry)) {
+            indexFor(parts)->jids.insert(entry);
+        }
+    }
+
+    void removeEntry(const QString &entry)
+    {
+        const auto parts = splitJid(entry);
+        if (contains(std::as_const(*this).indexFor(parts), entry)) {
+            indexFor(parts)->jids.erase(entry);
+        }
+    }
+
+    static bool contains(const JidSet &index, QStringView entry)
+    {
+        return index.find(entry) != index.end();
+    }
+
+    // The entries by the JID types of XEP-0191. Every type of blocked JID can be looked up with
+    // one access.
+    QSharedDataPointer<SharedJidSet> fullJids { new SharedJidSet };
+    QSharedDataPointer<SharedJidSet> bareJids { new SharedJidSet };
+    QSharedDataPointer<SharedJidSet> domains { new SharedJidSet };
+    QSharedDataPointer<SharedJidSet> domainResources { new SharedJidSet };
+};
+
+QXmppBlocklist::QXmppBlocklist()
+    : d(new QXmppBlocklistPrivate)
+{
+}
 
 /// Constructs with given entries.
 QXmppBlocklist::QXmppBlocklist(QVector<QString> entries)
-    : m_blocklist(std::move(entries))
+    : d(new QXmppBlocklistPrivate)
 {
+    for (const auto &entry : std::as_const(entries)) {
+        d->addEntry(entry);
+    }
 }
 
 QXMPP_PRIVATE_DEFINE_RULE_OF_SIX(QXmppBlocklist)
@@ -472,9 +567,17 @@ QXMPP_PRIVATE_DEFINE_RULE_OF_SIX(QXmppBlocklist)
 /// Entries may be full JIDs, bare JIDs, domains or domains with resource, as in
 /// \xep{0191, Blocking Command}.
 ///
+/// The entries are sorted.
+///
 QVector<QString> QXmppBlocklist::entries() const
 {
-    return m_blocklist;
+    QVector<QString> entries;
+    for (const auto *set : { &d->fullJids->jids, &d->bareJids->jids, &d->domains->jids, &d->domainResources->jids }) {
+        entries.reserve(entries.size() + qsizetype(set->size()));
+        std::copy(set->cbegin(), set->cend(), std::back_inserter(entries));
+    }
+    std::sort(entries.begin(), entries.end());
+    return entries;
 }
 
 ///
@@ -486,8 +589,41 @@ QVector<QString> QXmppBlocklist::entries() const
 ///
 bool QXmppBlocklist::containsEntry(QStringView entry) const
 {
-    // Can be replaced with .contains() with Qt 6
-    return std::find(m_blocklist.begin(), m_blocklist.end(), entry) != m_blocklist.end();
+    return QXmppBlocklistPrivate::contains(d->indexFor(splitJid(entry)), entry);
+}
+
+///
+/// Checks whether a JID is blocked completely.
+///
+/// This is the case if any entry matches the JID according to the rules of
+/// \xep{0191, Blocking Command}, e.g. stanzas from `user@domain.tld/resource` are blocked by the
+/// entries `user@domain.tld/resource`, `user@domain.tld`, `domain.tld/resource` and `domain.tld`.
+///
+/// Independent of the size of the blocklist, this only needs a constant number of lookups and
+/// does not allocate memory. It is thus suitable for checking every incoming stanza.
+///
+/// \since QXmpp 1.8
+///
+bool QXmppBlocklist::isBlocked(QStringView jid) const
+{
+    const auto parts = splitJid(jid);
+    const auto contains = &QXmppBlocklistPrivate::contains;
+
+    if (contains(d->domains->jids, parts.domain)) {
+        return true;
+    }
+    if (!parts.user.isEmpty() && contains(d->bareJids->jids, parts.bareJid)) {
+        return true;
+    }
+    if (!parts.resource.isNull()) {
+        if (contains(d->domainResources->jids, parts.domainResource)) {
+            return true;
+        }
+        if (!parts.user.isEmpty() && contains(d->fullJids->jids, jid)) {
+            return true;
+        }
+    }
+    return false;
 }
 
 ///
@@ -500,51 +636,35 @@ bool QXmppBlocklist::containsEntry(QStringView entry) const
 ///
 QXmppBlocklist::BlockingState QXmppBlocklist::blockingState(const QString &jid) const
 {
-    auto user = QXmppUtils::jidToUser(jid);
-    auto domain = QXmppUtils::jidToDomain(jid);
-    auto resource = QXmppUtils::jidToResource(jid);
+    const auto parts = splitJid(jid);
 
     Q_ASSERT(!jid.isEmpty());
-    Q_ASSERT(!domain.isEmpty());
-
-    // determine type of given JID
-    enum { FullJid,
-           BareJid,
-           Domain,
-           DomainResource } jidType = [&] {
-        // domain is always set
-        if (user.isEmpty()) {
-            // no user set
-            if (!resource.isEmpty()) {
-                return DomainResource;
-            }
-            return Domain;
-        }
-        // user is set
-        if (!resource.isEmpty()) {
-            return FullJid;
-        }
-        return BareJid;
-    }();
+    Q_ASSERT(!parts.domain.isEmpty());
 
     // cause the given jid to be blocked (completely)
     QVector<QString> blockingJids;
     // cause parts of the given JID to be blocked
     QVector<QString> partiallyBlockingJids;
 
-    auto checkBlockingJid = [this, &blockingJids](const QString &jid) {
-        if (m_blocklist.contains(jid)) {
-            blockingJids.append(jid);
+    auto checkBlockingJid = [&blockingJids](const JidSet &index, QStringView jid) {
+        if (auto itr = index.find(jid); itr != index.end()) {
+            blockingJids.append(*itr);
         }
     };
-    auto checkPartiallyBlockingJid = [this, &partiallyBlockingJids](const QString &jid) {
-        if (m_blocklist.contains(jid)) {
-            partiallyBlockingJids.append(jid);
+    // adds all entries of the index that match the filter
+    auto findPartiallyBlockingJids = [&partiallyBlockingJids](const JidSet &index, auto filter) {
+        for (const auto &blockedJid : index) {
+            if (filter(splitJid(blockedJid))) {
+                partiallyBlockingJids.append(blockedJid);
+            }
         }
     };
+    auto hasDomain = [&parts](const JidParts &blockedParts) {
+        return blockedParts.domain == parts.domain;
+    };
 
-    switch (jidType) {
-    case FullJid:
+    if (!parts.user.isEmpty() && !parts.resource.isNull()) {
+        // Full JID
         // Blocking:
         //  * full jid
         //  * bare jid
@@ -552,72 +672,51 @@ QXmppBlocklist::BlockingState QXmppBlocklist::blockingState(const QString &jid)
         //  * domain + resource
         // Partially blocked:
         //  not possible
-        checkBlockingJid(jid);
-        checkBlockingJid(user + u'@' + domain);
-        checkBlockingJid(domain);
-        checkBlockingJid(domain + u'/' + resource);
-        break;
-    case BareJid: {
+        checkBlockingJid(d->fullJids->jids, jid);
+        checkBlockingJid(d->bareJids->jids, parts.bareJid);
+        checkBlockingJid(d->domains->jids, parts.domain);
+        checkBlockingJid(d->domainResources->jids, parts.domainResource);
+    } else if (!parts.user.isEmpty()) {
+        // Bare JID
         // Blocking:
         //  * bare jid
         //  * domain
         // Partially blocking:
         //  * full jids
         //  * domain resource
-        checkBlockingJid(jid);
-        checkBlockingJid(domain);
-
-        // look for full jids blocking the bare jid partially
-        QString fullJidStart = jid + u'/';
-        for (const auto &blockedJid : m_blocklist) {
-            if (blockedJid.startsWith(fullJidStart)) {
-                partiallyBlockingJids.append(blockedJid);
-            }
-        }
+        checkBlockingJid(d->bareJids->jids, jid);
+        checkBlockingJid(d->domains->jids, parts.domain);
 
-        checkPartiallyBlockingJid(domain + u'/' + resource);
-        break;
-    }
-    case Domain: {
+        findPartiallyBlockingJids(d->fullJids->jids, [&parts](const JidParts &blockedParts) {
+            return blockedParts.bareJid == parts.bareJid;
+        });
+        findPartiallyBlockingJids(d->domainResources->jids, hasDomain);
+    } else if (parts.resource.isNull()) {
+        // Domain
         // Blocking:
         //  * domain
         // Partially blocking:
         //  * full jids
         //  * bare jids
         //  * domain + resource
-        checkBlockingJid(jid);
-
-        // look for full/bare jids and domain+resource jids
-        QString userJidSubstring = u'@' + domain;
-        QString domainResourceSubstring = domain + u'/';
-
-        for (const auto &blockedJid : m_blocklist) {
-            if (blockedJid.contains(userJidSubstring) || blockedJid.contains(domainResourceSubstring)) {
-                partiallyBlockingJids.append(blockedJid);
-            }
-        }
+        checkBlockingJid(d->domains->jids, jid);
 
-        break;
-    }
-    case DomainResource: {
+        findPartiallyBlockingJids(d->fullJids->jids, hasDomain);
+        findPartiallyBlockingJids(d->bareJids->jids, hasDomain);
+        findPartiallyBlockingJids(d->domainResources->jids, hasDomain);
+    } else {
+        // Domain + resource
         // Blocking:
         //  * domain
         //  * domain + resource
         // Partially blocking:
         //  * full jid
         //  * bare jid
-        checkBlockingJid(jid);
-        checkBlockingJid(domain);
+        checkBlockingJid(d->domainResources->jids, jid);
+        checkBlockingJid(d->domains->jids, parts.domain);
 
-        // look for full/bare jids
-        QString userJidSubstring = u'@' + domain;
-        for (const auto &blockedJid : m_blocklist) {
-            if (blockedJid.contains(userJidSubstring)) {
-                partiallyBlockingJids.append(blockedJid);
-            }
-        }
-        break;
-    }
+        findPartiallyBlockingJids(d->fullJids->jids, hasDomain);
+        findPartiallyBlockingJids(d->bareJids->jids, hasDomain);
     }
 
     if (!blockingJids.isEmpty()) {
@@ -633,3 +732,17 @@ QXmppBlocklist::BlockingState QXmppBlocklist::blockingState(const QString &jid)
     }
     return NotBlocked {};
 }
+
+void QXmppBlocklist::addEntries(const QVector<QString> &entries)
+{
+    for (const auto &entry : entries) {
+        d->addEntry(entry);
+    }
+}
+
+void QXmppBlocklist::removeEntries(const QVector<QString> &entries)
+{
+    for (const auto &entry : entries) {
+        d->removeEntry(entry);
+    }
+}
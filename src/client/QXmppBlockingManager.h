@@ -11,9 +11,11 @@
 
 #include <variant>
 
+#include <QSharedDataPointer>
 #include <QVector>
 
 struct QXmppBlockingManagerPrivate;
+class QXmppBlocklistPrivate;
 
 class QXMPP_EXPORT QXmppBlocklist
 {
@@ -35,10 +37,16 @@ public:
 
     QVector<QString> entries() const;
     bool containsEntry(QStringView) const;
+    bool isBlocked(QStringView jid) const;
     BlockingState blockingState(const QString &jid) const;
 
 private:
-    QVector<QString> m_blocklist;
+    friend class QXmppBlockingManager;
+
+    void addEntries(const QVector<QString> &entries);
+    void removeEntries(const QVector<QString> &entries);
+
+    QSharedDataPointer<QXmppBlocklistPrivate> d;
 };
 
 class QXMPP_EXPORT QXmppBlockingManager : public QXmppClientExtension
@@ -0,0 +1,42 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+///
+/// \class QXmppCapabilitiesStorage
+///
+/// \brief The QXmppCapabilitiesStorage class persistently stores verified
+/// service discovery information of \xep{0115, Entity Capabilities}.
+///
+/// The information is identified by its verification string, so it can be
+/// shared between all entities announcing the same capabilities.
+///
+/// \sa QXmppDiscoveryManager::setCapabilitiesStorage()
+///
+/// \since QXmpp 1.8
+///
+
+///
+/// \fn QXmppCapabilitiesStorage::info(const QByteArray &verificationString)
+///
+/// Returns the stored service discovery information for a verification string.
+///
+/// \param verificationString raw (not base64-encoded) verification string
+///
+/// \return the stored information or std::nullopt if nothing is stored
+///
+
+///
+/// \fn QXmppCapabilitiesStorage::addInfo(const QByteArray &verificationString, const QXmppDiscoveryIq &info)
+///
+/// Stores verified service discovery information.
+///
+/// \param verificationString raw (not base64-encoded) verification string
+/// \param info service discovery information matching the verification string
+///
+
+///
+/// \fn QXmppCapabilitiesStorage::resetAll()
+///
+/// Removes all stored information.
+///
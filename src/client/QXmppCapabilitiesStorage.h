@@ -0,0 +1,26 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPCAPABILITIESSTORAGE_H
+#define QXMPPCAPABILITIESSTORAGE_H
+
+#include "QXmppDiscoveryIq.h"
+
+#include <optional>
+
+template<typename T>
+class QXmppTask;
+
+class QXMPP_EXPORT QXmppCapabilitiesStorage
+{
+public:
+    virtual ~QXmppCapabilitiesStorage() = default;
+
+    virtual QXmppTask<std::optional<QXmppDiscoveryIq>> info(const QByteArray &verificationString) = 0;
+    virtual QXmppTask<void> addInfo(const QByteArray &verificationString, const QXmppDiscoveryIq &info) = 0;
+
+    virtual QXmppTask<void> resetAll() = 0;
+};
+
+#endif  // QXMPPCAPABILITIESSTORAGE_H
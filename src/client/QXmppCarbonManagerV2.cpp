@@ -7,6 +7,7 @@
 #include "QXmppClient.h"
 #include "QXmppConstants_p.h"
 #include "QXmppMessage.h"
+#include "QXmppMessageDeduplicator.h"
 #include "QXmppOutgoingClient.h"
 #include "QXmppUtils_p.h"
 
@@ -114,6 +115,10 @@ bool QXmppCarbonManagerV2::handleStanza(const QDomElement &element, const std::o
         return false;
     }
 
+    if (auto *deduplicator = client()->messageDeduplicator(); deduplicator && !deduplicator->insert(messageElement, from)) {
+        return true;
+    }
+
     QXmppMessage message;
     message.parse(messageElement);
     message.setCarbonForwarded(true);
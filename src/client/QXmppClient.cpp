@@ -185,6 +185,10 @@ bool process(QXmppClient *client, const QList<QXmppClientExtension *> &extension
     if (element.tagName() != u"message") {
         return false;
     }
+    // drop messages that have already been received before parsing them
+    if (auto *deduplicator = client->messageDeduplicator(); deduplicator && !deduplicator->insert(element, client->configuration().jidBare())) {
+        return true;
+    }
     QXmppMessage message;
     if (e2eeExt) {
         message.parse(element, e2eeExt->isEncrypted(element) ? ScePublic : SceSensitive);
@@ -409,6 +413,53 @@ void QXmppClient::setEncryptionExtension(QXmppE2eeExtension *extension)
     d->encryptionExtension = extension;
 }
 
+///
+/// Returns whether received messages are deduplicated.
+///
+/// \since QXmpp 1.8
+///
+bool QXmppClient::isMessageDeduplicationEnabled() const
+{
+    return d->messageDeduplicator != nullptr;
+}
+
+///
+/// Sets whether received messages are deduplicated.
+///
+/// If enabled, messages received live, as carbon copies (QXmppCarbonManagerV2)
+/// or via the catch-up functions of QXmppMamManager are checked against the
+/// messageDeduplicator() before they are processed. Messages that have already
+/// been received are dropped without being passed to the message handlers or
+/// messageReceived().
+///
+/// Disabling the deduplication forgets all remembered IDs.
+///
+/// Deduplication is disabled by default.
+///
+/// \since QXmpp 1.8
+///
+void QXmppClient::setMessageDeduplicationEnabled(bool enabled)
+{
+    if (!enabled) {
+        d->messageDeduplicator.reset();
+    } else if (!d->messageDeduplicator) {
+        d->messageDeduplicator = std::make_unique<QXmppMessageDeduplicator>();
+    }
+}
+
+///
+/// Returns the deduplicator used for received messages, e.g. to change its
+/// capacity or to persist its state.
+///
+/// Returns nullptr if message deduplication is disabled.
+///
+/// \since QXmpp 1.8
+///
+QXmppMessageDeduplicator *QXmppClient::messageDeduplicator() const
+{
+    return d->messageDeduplicator.get();
+}
+
 /// Returns a list containing all the client's extensions.
 QList<QXmppClientExtension *> QXmppClient::extensions() const
 {
@@ -26,6 +26,7 @@ class QXmppE2eeExtension;
 class QXmppClientExtension;
 class QXmppClientPrivate;
 class QXmppMessage;
+class QXmppMessageDeduplicator;
 class QXmppOutgoingClient;
 class QXmppPresence;
 class QXmppIq;
@@ -124,6 +125,9 @@ public:
     bool removeExtension(QXmppClientExtension *extension);
     QXmppE2eeExtension *encryptionExtension() const;
     void setEncryptionExtension(QXmppE2eeExtension *);
+    bool isMessageDeduplicationEnabled() const;
+    void setMessageDeduplicationEnabled(bool enabled);
+    QXmppMessageDeduplicator *messageDeduplicator() const;
 
     QList<QXmppClientExtension *> extensions() const;
 
@@ -335,6 +339,7 @@ private:
     friend class QXmppClientExtension;
     friend class QXmppCarbonManagerV2;
     friend class QXmppRegistrationManager;
+    friend class QXmppRosterManager;
     friend class TestClient;
 };
 
@@ -18,10 +18,12 @@
 #ifndef QXMPPCLIENT_P_H
 #define QXMPPCLIENT_P_H
 
+#include "QXmppMessageDeduplicator.h"
 #include "QXmppOutgoingClient.h"
 #include "QXmppPresence.h"
 
 #include <chrono>
+#include <memory>
 
 class QXmppClient;
 class QXmppClientExtension;
@@ -42,6 +44,8 @@ public:
     QXmppOutgoingClient *stream;
 
     QXmppE2eeExtension *encryptionExtension;
+    // only set while message deduplication is enabled
+    std::unique_ptr<QXmppMessageDeduplicator> messageDeduplicator;
 
     // reconnection
     bool receivedConflict;
@@ -4,20 +4,54 @@
 
 #include "QXmppDiscoveryManager.h"
 
+#include "QXmppCapabilitiesStorage.h"
 #include "QXmppClient.h"
 #include "QXmppClient_p.h"
+#include "QXmppConfiguration.h"
 #include "QXmppConstants_p.h"
 #include "QXmppDataForm.h"
 #include "QXmppDiscoveryIq.h"
 #include "QXmppFutureUtils_p.h"
 #include "QXmppIqHandling.h"
+#include "QXmppPresence.h"
+#include "QXmppUtils.h"
 
 #include "StringLiterals.h"
 
 #include <QCoreApplication>
 #include <QDomElement>
+#include <QHash>
+
+#include <optional>
 
 using namespace QXmpp::Private;
+using namespace std::chrono_literals;
+
+namespace QXmpp::Private {
+
+// (JID, node) of a service discovery query
+using DiscoveryKey = std::pair<QString, QString>;
+
+// result of a service discovery query that can be reused until it expires
+template<typename T>
+struct CachedDiscoveryResult {
+    T result;
+    std::chrono::steady_clock::time_point expiry;
+};
+
+// XEP-0115: Entity Capabilities announced in a presence
+struct EntityCapabilities {
+    QString node;
+    QByteArray verificationString;
+};
+
+// pending lookup of entity capabilities
+struct CapabilitiesRequest {
+    QString jid;
+    QXmppPromise<QXmppDiscoveryManager::InfoResult> promise;
+};
+
+}  // namespace QXmpp::Private
 
 class QXmppDiscoveryManagerPrivate
 {
@@ -27,8 +61,53 @@ public:
     QString clientType;
     QString clientName;
     QXmppDataForm clientInfoForm;
+
+    // XEP-0115: Entity Capabilities
+    // full JIDs mapped to the capabilities of their last presence
+    QHash<QString, EntityCapabilities> jidCapabilities;
+    // verification strings mapped to verified disco info
+    QHash<QByteArray, QXmppDiscoveryIq> capabilitiesCache;
+    // verification strings mapped to lookups waiting for the disco info
+    QHash<QByteArray, QList<CapabilitiesRequest>> capabilitiesRequests;
+    QXmppCapabilitiesStorage *capabilitiesStorage = nullptr;
+
+    // pending queries with all callers waiting for their result
+    QHash<DiscoveryKey, QList<QXmppPromise<QXmppDiscoveryManager::InfoResult>>> infoRequests;
+    QHash<DiscoveryKey, QList<QXmppPromise<QXmppDiscoveryManager::ItemsResult>>> itemsRequests;
+    // results of queries to servers and components
+    QHash<DiscoveryKey, CachedDiscoveryResult<QXmppDiscoveryIq>> infoCache;
+    QHash<DiscoveryKey, CachedDiscoveryResult<QList<QXmppDiscoveryIq::Item>>> itemsCache;
+    std::chrono::seconds cacheDuration = 0s;
+
+    bool isCacheable(const QString &jid) const;
+    void clearCache();
 };
 
+// Only results of servers and components are cached: they don't depend on presences and are
+// queried by many managers at login.
+bool QXmppDiscoveryManagerPrivate::isCacheable(const QString &jid) const
+{
+    return cacheDuration > 0s && QXmppUtils::jidToUser(jid).isEmpty() && QXmppUtils::jidToResource(jid).isEmpty();
+}
+
+void QXmppDiscoveryManagerPrivate::clearCache()
+{
+    infoCache.clear();
+    itemsCache.clear();
+}
+
+template<typename T>
+static std::optional<T> cachedResult(QHash<DiscoveryKey, CachedDiscoveryResult<T>> &cache, const DiscoveryKey &key)
+{
+    if (auto itr = cache.find(key); itr != cache.end()) {
+        if (itr->expiry > std::chrono::steady_clock::now()) {
+            return itr->result;
+        }
+        cache.erase(itr);
+    }
+    return {};
+}
+
 ///
 /// \typedef QXmppDiscoveryManager::InfoResult
 ///
@@ -116,12 +195,31 @@ QString QXmppDiscoveryManager::requestItems(const QString &jid, const QString &n
 /// \param jid  The target entity's JID.
 /// \param node The target node (optional).
 ///
+/// If an identical query is still pending, no new request is sent and the
+/// result of the pending query is reported. Results of servers and components
+/// are cached for cacheDuration().
+///
 /// \warning THIS API IS NOT FINALIZED YET!
 ///
 /// \since QXmpp 1.5
 ///
 QXmppTask<QXmppDiscoveryManager::InfoResult> QXmppDiscoveryManager::requestDiscoInfo(const QString &jid, const QString &node)
 {
+    const auto key = DiscoveryKey { jid, node };
+    if (auto cached = cachedResult(d->infoCache, key)) {
+        return makeReadyTask<InfoResult>(std::move(*cached));
+    }
+
+    QXmppPromise<InfoResult> promise;
+    auto task = promise.task();
+
+    auto &requests = d->infoRequests[key];
+    requests.append(promise);
+    if (requests.size() > 1) {
+        // identical query is already pending
+        return task;
+    }
+
     QXmppDiscoveryIq request;
     request.setType(QXmppIq::Get);
     request.setQueryType(QXmppDiscoveryIq::InfoQuery);
@@ -130,7 +228,17 @@ QXmppTask<QXmppDiscoveryManager::InfoResult> QXmppDiscoveryManager::requestDisco
         request.setQueryNode(node);
     }
 
-    return chainIq<InfoResult>(client()->sendIq(std::move(request)), this);
+    chainIq<InfoResult>(client()->sendIq(std::move(request)), this).then(this, [this, key](InfoResult &&result) {
+        if (auto *info = std::get_if<QXmppDiscoveryIq>(&result); info && d->isCacheable(key.first)) {
+            d->infoCache.insert(key, { *info, std::chrono::steady_clock::now() + d->cacheDuration });
+        }
+
+        const auto requests = d->infoRequests.take(key);
+        for (auto request : requests) {
+            request.finish(InfoResult(result));
+        }
+    });
+    return task;
 }
 
 ///
@@ -139,12 +247,31 @@ QXmppTask<QXmppDiscoveryManager::InfoResult> QXmppDiscoveryManager::requestDisco
 /// \param jid  The target entity's JID.
 /// \param node The target node (optional).
 ///
+/// If an identical query is still pending, no new request is sent and the
+/// result of the pending query is reported. Results of servers and components
+/// are cached for cacheDuration().
+///
 /// \warning THIS API IS NOT FINALIZED YET!
 ///
 /// \since QXmpp 1.5
 ///
 QXmppTask<QXmppDiscoveryManager::ItemsResult> QXmppDiscoveryManager::requestDiscoItems(const QString &jid, const QString &node)
 {
+    const auto key = DiscoveryKey { jid, node };
+    if (auto cached = cachedResult(d->itemsCache, key)) {
+        return makeReadyTask<ItemsResult>(std::move(*cached));
+    }
+
+    QXmppPromise<ItemsResult> promise;
+    auto task = promise.task();
+
+    auto &requests = d->itemsRequests[key];
+    requests.append(promise);
+    if (requests.size() > 1) {
+        // identical query is already pending
+        return task;
+    }
+
     QXmppDiscoveryIq request;
     request.setType(QXmppIq::Get);
     request.setQueryType(QXmppDiscoveryIq::ItemsQuery);
@@ -153,9 +280,159 @@ QXmppTask<QXmppDiscoveryManager::ItemsResult> QXmppDiscoveryManager::requestDisc
         request.setQueryNode(node);
     }
 
-    return chainIq(client()->sendIq(std::move(request)), this, [](QXmppDiscoveryIq &&iq) -> ItemsResult {
+    auto itemsTask = chainIq(client()->sendIq(std::move(request)), this, [](QXmppDiscoveryIq &&iq) -> ItemsResult {
         return iq.items();
     });
+    itemsTask.then(this, [this, key](ItemsResult &&result) {
+        if (auto *items = std::get_if<QList<QXmppDiscoveryIq::Item>>(&result); items && d->isCacheable(key.first)) {
+            d->itemsCache.insert(key, { *items, std::chrono::steady_clock::now() + d->cacheDuration });
+        }
+
+        const auto requests = d->itemsRequests.take(key);
+        for (auto request : requests) {
+            request.finish(ItemsResult(result));
+        }
+    });
+    return task;
+}
+
+///
+/// Returns how long service discovery results of servers and components are
+/// cached.
+///
+/// \since QXmpp 1.8
+///
+std::chrono::seconds QXmppDiscoveryManager::cacheDuration() const
+{
+    return d->cacheDuration;
+}
+
+///
+/// Sets how long service discovery results of servers and components are
+/// cached.
+///
+/// The cache is cleared when a new stream is started, i.e. on every connection
+/// that does not resume the previous stream. A duration of zero disables
+/// caching; identical pending queries are still merged.
+///
+/// The default is 0, i.e. results are not cached.
+///
+/// \since QXmpp 1.8
+///
+void QXmppDiscoveryManager::setCacheDuration(std::chrono::seconds duration)
+{
+    d->cacheDuration = duration;
+    if (duration <= 0s) {
+        d->clearCache();
+    }
+}
+
+///
+/// Removes all cached service discovery results of servers and components.
+///
+/// \since QXmpp 1.8
+///
+void QXmppDiscoveryManager::clearCache()
+{
+    d->clearCache();
+}
+
+///
+/// Returns the service discovery information of an entity using
+/// \xep{0115, Entity Capabilities}.
+///
+/// The capabilities announced in the last presence of \a jid are looked up in
+/// a cache shared by all entities with the same capabilities. Only if they are
+/// unknown, the entity is queried. The result is only cached if its
+/// verification string matches the announced one. Concurrent lookups of the
+/// same capabilities are merged into a single request.
+///
+/// If no (supported) capabilities have been announced, the entity is queried
+/// directly and nothing is cached.
+///
+/// \param jid full JID of the entity
+///
+/// \since QXmpp 1.8
+///
+QXmppTask<QXmppDiscoveryManager::InfoResult> QXmppDiscoveryManager::entityCapabilities(const QString &jid)
+{
+    const auto capsItr = d->jidCapabilities.constFind(jid);
+    if (capsItr == d->jidCapabilities.cend()) {
+        return requestDiscoInfo(jid);
+    }
+    const auto caps = *capsItr;
+
+    if (auto itr = d->capabilitiesCache.constFind(caps.verificationString); itr != d->capabilitiesCache.cend()) {
+        return makeReadyTask<InfoResult>(*itr);
+    }
+
+    QXmppPromise<InfoResult> promise;
+    auto task = promise.task();
+
+    auto &requests = d->capabilitiesRequests[caps.verificationString];
+    requests.append(CapabilitiesRequest { jid, promise });
+    if (requests.size() > 1) {
+        // the same capabilities are already being looked up
+        return task;
+    }
+
+    if (d->capabilitiesStorage) {
+        d->capabilitiesStorage->info(caps.verificationString).then(this, [this, jid, caps](std::optional<QXmppDiscoveryIq> &&info) {
+            if (info) {
+                d->capabilitiesCache.insert(caps.verificationString, *info);
+                finishCapabilitiesRequests(caps.verificationString, *info);
+            } else {
+                fetchCapabilities(jid, caps.node, caps.verificationString);
+            }
+        });
+    } else {
+        fetchCapabilities(jid, caps.node, caps.verificationString);
+    }
+    return task;
+}
+
+///
+/// Returns the features of an entity using \xep{0115, Entity Capabilities}.
+///
+/// If the capabilities announced by \a jid are cached, the task is finished
+/// immediately without any network traffic.
+///
+/// \sa entityCapabilities()
+///
+/// \param jid full JID of the entity
+///
+/// \since QXmpp 1.8
+///
+QXmppTask<QXmppDiscoveryManager::FeaturesResult> QXmppDiscoveryManager::features(const QString &jid)
+{
+    return chainMapSuccess(entityCapabilities(jid), this, [](QXmppDiscoveryIq &&info) {
+        return info.features();
+    });
+}
+
+///
+/// Returns the storage used to persist verified entity capabilities.
+///
+/// \since QXmpp 1.8
+///
+QXmppCapabilitiesStorage *QXmppDiscoveryManager::capabilitiesStorage() const
+{
+    return d->capabilitiesStorage;
+}
+
+///
+/// Sets a storage used to persist verified \xep{0115, Entity Capabilities}
+/// between sessions.
+///
+/// The storage is not owned by the manager and must outlive it.
+///
+/// \param storage storage to use or nullptr to only cache in the memory
+///
+/// \since QXmpp 1.8
+///
+void QXmppDiscoveryManager::setCapabilitiesStorage(QXmppCapabilitiesStorage *storage)
+{
+    d->capabilitiesStorage = storage;
 }
 
 ///
@@ -343,6 +620,25 @@ bool QXmppDiscoveryManager::handleStanza(const QDomElement &element)
     return false;
 }
 
+void QXmppDiscoveryManager::onRegistered(QXmppClient *client)
+{
+    connect(client, &QXmppClient::presenceReceived, this, &QXmppDiscoveryManager::onPresenceReceived);
+    connect(client, &QXmppClient::connected, this, [this, client]() {
+        // presences and services of the last stream may have changed in the meantime
+        if (client->streamManagementState() != QXmppClient::ResumedStream) {
+            d->jidCapabilities.clear();
+            d->clearCache();
+        }
+    });
+}
+
+void QXmppDiscoveryManager::onUnregistered(QXmppClient *client)
+{
+    disconnect(client, &QXmppClient::presenceReceived, this, &QXmppDiscoveryManager::onPresenceReceived);
+    disconnect(client, &QXmppClient::connected, this, nullptr);
+    d->jidCapabilities.clear();
+}
+
 std::variant<QXmppDiscoveryIq, QXmppStanza::Error> QXmppDiscoveryManager::handleIq(QXmppDiscoveryIq &&iq)
 {
     using Error = QXmppStanza::Error;
@@ -367,3 +663,64 @@ std::variant<QXmppDiscoveryIq, QXmppStanza::Error> QXmppDiscoveryManager::handle
     Q_UNREACHABLE();
 }
 /// \endcond
+
+void QXmppDiscoveryManager::onPresenceReceived(const QXmppPresence &presence)
+{
+    switch (presence.type()) {
+    case QXmppPresence::Available:
+        // only SHA-1 is supported by QXmppDiscoveryIq::verificationString()
+        if (presence.capabilityHash() == u"sha-1" && !presence.capabilityVer().isEmpty()) {
+            d->jidCapabilities.insert(presence.from(), { presence.capabilityNode(), presence.capabilityVer() });
+        } else {
+            d->jidCapabilities.remove(presence.from());
+        }
+        break;
+    case QXmppPresence::Unavailable:
+        d->jidCapabilities.remove(presence.from());
+        break;
+    default:
+        break;
+    }
+}
+
+void QXmppDiscoveryManager::fetchCapabilities(const QString &jid, const QString &node, const QByteArray &verificationString)
+{
+    const auto capsNode = node + u'#' + QString::fromLatin1(verificationString.toBase64());
+
+    requestDiscoInfo(jid, capsNode).then(this, [this, jid, capsNode, verificationString](InfoResult &&result) {
+        auto *info = std::get_if<QXmppDiscoveryIq>(&result);
+        if (info && info->verificationString() == verificationString) {
+            d->capabilitiesCache.insert(verificationString, *info);
+            if (d->capabilitiesStorage) {
+                d->capabilitiesStorage->addInfo(verificationString, *info);
+            }
+            finishCapabilitiesRequests(verificationString, *info);
+            return;
+        }
+
+        if (info) {
+            warning(u"Could not verify entity capabilities of %1."_s.arg(jid));
+        }
+
+        // The result can't be used for other entities announcing the same capabilities, so they
+        // are queried directly.
+        const auto requests = d->capabilitiesRequests.take(verificationString);
+        for (auto request : requests) {
+            if (request.jid == jid) {
+                request.promise.finish(InfoResult(result));
+            } else {
+                requestDiscoInfo(request.jid, capsNode).then(this, [promise = request.promise](InfoResult &&result) mutable {
+                    promise.finish(std::move(result));
+                });
+            }
+        }
+    });
+}
+
+void QXmppDiscoveryManager::finishCapabilitiesRequests(const QByteArray &verificationString, const QXmppDiscoveryIq &info)
+{
+    const auto requests = d->capabilitiesRequests.take(verificationString);
+    for (auto request : requests) {
+        request.promise.finish(InfoResult(info));
+    }
+}
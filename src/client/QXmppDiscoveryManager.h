@@ -8,13 +8,16 @@
 
 #include "QXmppClientExtension.h"
 
+#include <chrono>
 #include <variant>
 
 template<typename T>
 class QXmppTask;
+class QXmppCapabilitiesStorage;
 class QXmppDataForm;
 class QXmppDiscoveryIq;
 class QXmppDiscoveryManagerPrivate;
+class QXmppPresence;
 struct QXmppError;
 
 /// \brief The QXmppDiscoveryManager class makes it possible to discover information
@@ -40,6 +43,17 @@ public:
     QXmppTask<InfoResult> requestDiscoInfo(const QString &jid, const QString &node = {});
     QXmppTask<ItemsResult> requestDiscoItems(const QString &jid, const QString &node = {});
 
+    std::chrono::seconds cacheDuration() const;
+    void setCacheDuration(std::chrono::seconds duration);
+    void clearCache();
+
+    using FeaturesResult = std::variant<QStringList, QXmppError>;
+    QXmppTask<InfoResult> entityCapabilities(const QString &jid);
+    QXmppTask<FeaturesResult> features(const QString &jid);
+
+    QXmppCapabilitiesStorage *capabilitiesStorage() const;
+    void setCapabilitiesStorage(QXmppCapabilitiesStorage *storage);
+
     QString clientCapabilitiesNode() const;
     void setClientCapabilitiesNode(const QString &);
 
@@ -69,7 +83,17 @@ Q_SIGNALS:
     /// This signal is emitted when an items response is received.
     void itemsReceived(const QXmppDiscoveryIq &);
 
+protected:
+    /// \cond
+    void onRegistered(QXmppClient *client) override;
+    void onUnregistered(QXmppClient *client) override;
+    /// \endcond
+
 private:
+    void onPresenceReceived(const QXmppPresence &presence);
+    void fetchCapabilities(const QString &jid, const QString &node, const QByteArray &verificationString);
+    void finishCapabilitiesRequests(const QByteArray &verificationString, const QXmppDiscoveryIq &info);
+
     const std::unique_ptr<QXmppDiscoveryManagerPrivate> d;
 };
 
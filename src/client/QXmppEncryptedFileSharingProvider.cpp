@@ -74,7 +74,9 @@ auto QXmppEncryptedFileSharingProvider::downloadFile(const std::any &source,
     std::any httpSource = encryptedSource.httpSources().front();
     if (auto provider = d->manager->providerForSource(httpSource)) {
         auto onFinished = [decryptDevice = output.get(), reportFinished = std::move(reportFinished)](DownloadResult result) {
-            decryptDevice->finish();
+            if (!decryptDevice->finish() && std::holds_alternative<QXmpp::Success>(result)) {
+                result = QXmppError { decryptDevice->errorString(), {} };
+            }
             reportFinished(std::move(result));
         };
 
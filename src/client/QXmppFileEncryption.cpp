@@ -6,19 +6,36 @@
 
 #include "StringLiterals.h"
 
+#include <limits>
+#include <optional>
+
 #include <QByteArray>
 #include <QtCrypto>
 
+#ifdef WITH_OPENSSL
+#include <openssl/evp.h>
+#endif
+
 #undef min
 
 using namespace QCA;
 
 constexpr std::size_t AES128_BLOCK_SIZE = 128 / 8;
 constexpr std::size_t AES256_BLOCK_SIZE = 256 / 8;
+// AES always uses 128 bit blocks, independent of the key size
+constexpr std::size_t CIPHER_BLOCK_SIZE = 128 / 8;
 constexpr int GCM_IV_SIZE = 12;
+// 64 kB, maximum size of the input that is encrypted at once
+constexpr std::size_t INPUT_BUFFER_SIZE = 64 * 1024;
+// output of one update() and final() call
+constexpr std::size_t OUTPUT_BUFFER_SIZE = INPUT_BUFFER_SIZE + 2 * CIPHER_BLOCK_SIZE;
+// maximum input of one backend call, the backends use int sizes for the input and the output
+constexpr std::size_t MAX_CHUNK_SIZE = std::size_t(std::numeric_limits<int>::max()) - CIPHER_BLOCK_SIZE;
 
 namespace QXmpp::Private::Encryption {
 
+#ifndef WITH_OPENSSL
+// only needed for QCA's cipher names
 static QString cipherName(QXmpp::Cipher cipher)
 {
     switch (cipher) {
@@ -30,6 +47,7 @@ static QString cipherName(QXmpp::Cipher cipher)
     }
     Q_UNREACHABLE();
 }
+#endif
 
 static std::size_t blockSize(QXmpp::Cipher cipher)
 {
@@ -84,21 +102,204 @@ static std::size_t roundUpToBlockSize(qint64 size, std::size_t blockSize)
     return (size / blockSize + 1) * blockSize;
 }
 
-bool isSupported(Cipher config)
+// Encrypts or decrypts a stream of data, using OpenSSL directly or QCA's provider plugins.
+//
+// update() writes at most size + CIPHER_BLOCK_SIZE bytes, final() at most CIPHER_BLOCK_SIZE bytes.
+// If processesInPlace(), the output of update() may be the same buffer as the input.
+// Both return an empty optional if the cipher could not be set up or the data could not be
+// processed (e.g. invalid padding).
+class CipherContext
+{
+public:
+    CipherContext(QXmpp::Cipher config, Direction direction, const QByteArray &key, const QByteArray &iv);
+    ~CipherContext();
+
+    static bool isSupported(QXmpp::Cipher config);
+
+    bool processesInPlace() const;
+    std::optional<std::size_t> update(const char *input, std::size_t size, char *output);
+    std::optional<std::size_t> final(char *output);
+
+private:
+    std::optional<std::size_t> updateChunk(const char *input, int size, char *output);
+
+    QXmpp::Cipher m_config;
+    bool m_valid = false;
+#ifdef WITH_OPENSSL
+    EVP_CIPHER_CTX *m_context;
+#else
+    QCA::Cipher m_cipher;
+#endif
+};
+
+bool CipherContext::processesInPlace() const
+{
+    // GCM is a stream cipher, the output has exactly the size of the input
+    return cipherMode(m_config) == QCA::Cipher::GCM;
+}
+
+std::optional<std::size_t> CipherContext::update(const char *input, std::size_t size, char *output)
+{
+    // split up inputs that are too large for the backends
+    std::size_t outputSize = 0;
+    do {
+        auto chunkSize = std::min(size, MAX_CHUNK_SIZE);
+        auto processed = updateChunk(input, int(chunkSize), output + outputSize);
+        if (!processed) {
+            return {};
+        }
+        outputSize += *processed;
+        input += chunkSize;
+        size -= chunkSize;
+    } while (size > 0);
+    return outputSize;
+}
+
+#ifdef WITH_OPENSSL
+static const EVP_CIPHER *evpCipher(QXmpp::Cipher cipher)
+{
+    switch (cipher) {
+    case Aes128GcmNoPad:
+        return EVP_aes_128_gcm();
+    case Aes256GcmNoPad:
+        return EVP_aes_256_gcm();
+    case Aes256CbcPkcs7:
+        return EVP_aes_256_cbc();
+    }
+    Q_UNREACHABLE();
+}
+
+CipherContext::CipherContext(QXmpp::Cipher config, Direction direction, const QByteArray &key, const QByteArray &iv)
+    : m_config(config),
+      m_context(EVP_CIPHER_CTX_new())
+{
+    if (!m_context) {
+        return;
+    }
+
+    const auto *cipher = evpCipher(config);
+    const int encrypt = direction == Encode ? 1 : 0;
+    Q_ASSERT(key.size() == EVP_CIPHER_key_length(cipher));
+
+    // same setup as QCA's OpenSSL plugin, so the output is identical:
+    // GCM uses the full IV instead of only the first 12 bytes
+    if (!EVP_CipherInit_ex(m_context, cipher, nullptr, nullptr, nullptr, encrypt)) {
+        return;
+    }
+    if (cipherMode(config) == QCA::Cipher::GCM &&
+        !EVP_CIPHER_CTX_ctrl(m_context, EVP_CTRL_GCM_SET_IVLEN, int(iv.size()), nullptr)) {
+        return;
+    }
+    if (!EVP_CipherInit_ex(m_context,
+                           nullptr,
+                           nullptr,
+                           reinterpret_cast<const unsigned char *>(key.constData()),
+                           reinterpret_cast<const unsigned char *>(iv.constData()),
+                           encrypt)) {
+        return;
+    }
+    m_valid = EVP_CIPHER_CTX_set_padding(m_context, padding(config) == QCA::Cipher::PKCS7 ? 1 : 0) == 1;
+}
+
+CipherContext::~CipherContext()
+{
+    EVP_CIPHER_CTX_free(m_context);
+}
+
+bool CipherContext::isSupported(QXmpp::Cipher config)
+{
+    return evpCipher(config) != nullptr;
+}
+
+std::optional<std::size_t> CipherContext::updateChunk(const char *input, int size, char *output)
+{
+    int outputSize = 0;
+    if (!m_valid ||
+        !EVP_CipherUpdate(m_context,
+                          reinterpret_cast<unsigned char *>(output),
+                          &outputSize,
+                          reinterpret_cast<const unsigned char *>(input),
+                          size)) {
+        return {};
+    }
+    return std::size_t(outputSize);
+}
+
+std::optional<std::size_t> CipherContext::final(char *output)
+{
+    int outputSize = 0;
+    if (!m_valid || !EVP_CipherFinal_ex(m_context, reinterpret_cast<unsigned char *>(output), &outputSize)) {
+        return {};
+    }
+    return std::size_t(outputSize);
+}
+#else
+CipherContext::CipherContext(QXmpp::Cipher config, Direction direction, const QByteArray &key, const QByteArray &iv)
+    : m_config(config),
+      m_cipher(cipherName(config),
+               cipherMode(config),
+               padding(config),
+               toQcaDirection(direction),
+               SymmetricKey(key),
+               InitializationVector(iv))
+{
+    Q_ASSERT(m_cipher.validKeyLength(int(key.length())));
+    m_valid = m_cipher.ok();
+}
+
+CipherContext::~CipherContext() = default;
+
+bool CipherContext::isSupported(QXmpp::Cipher config)
 {
     auto cipherString = QCA::Cipher::withAlgorithms(cipherName(config), cipherMode(config), padding(config));
     return QCA::isSupported({ cipherString });
 }
 
+std::optional<std::size_t> CipherContext::updateChunk(const char *input, int size, char *output)
+{
+    if (!m_valid) {
+        return {};
+    }
+
+    // QCA copies the input, so this also works in place
+    auto processed = m_cipher.update(MemoryRegion(QByteArray::fromRawData(input, size)));
+    if (!m_cipher.ok()) {
+        return {};
+    }
+    std::copy_n(processed.constData(), processed.size(), output);
+    return std::size_t(processed.size());
+}
+
+std::optional<std::size_t> CipherContext::final(char *output)
+{
+    if (!m_valid) {
+        return {};
+    }
+
+    auto processed = m_cipher.final();
+    if (!m_cipher.ok()) {
+        return {};
+    }
+    std::copy_n(processed.constData(), processed.size(), output);
+    return std::size_t(processed.size());
+}
+#endif
+
+bool isSupported(Cipher config)
+{
+    return CipherContext::isSupported(config);
+}
+
+// Returns a null byte array if the data could not be processed.
 QByteArray process(const QByteArray &data, QXmpp::Cipher cipherConfig, Direction direction, const QByteArray &key, const QByteArray &iv)
 {
-    auto cipher = QCA::Cipher(cipherName(cipherConfig),
-                              cipherMode(cipherConfig),
-                              padding(cipherConfig),
-                              toQcaDirection(direction),
-                              SymmetricKey(key),
-                              InitializationVector(iv));
-    auto output = cipher.update(MemoryRegion(data)).toByteArray();
+    CipherContext cipher(cipherConfig, direction, key, iv);
+
+    QByteArray output(data.size() + int(2 * CIPHER_BLOCK_SIZE), Qt::Uninitialized);
+    auto outputSize = cipher.update(data.constData(), std::size_t(data.size()), output.data());
+    if (!outputSize) {
+        return {};
+    }
 
     switch (cipherConfig) {
     case Aes128GcmNoPad:
@@ -108,10 +309,15 @@ QByteArray process(const QByteArray &data, QXmpp::Cipher cipherConfig, Direction
         // The unit tests verify that the data is still decrypted correctly.
         break;
     case Aes256CbcPkcs7:
-        output += cipher.final().toByteArray();
+        if (auto finalSize = cipher.final(output.data() + *outputSize)) {
+            *outputSize += *finalSize;
+        } else {
+            return {};
+        }
         break;
     }
 
+    output.truncate(qsizetype(*outputSize));
     return output;
 }
 
@@ -137,24 +343,18 @@ EncryptionDevice::EncryptionDevice(std::unique_ptr<QIODevice> input,
                                    const QByteArray &key,
                                    const QByteArray &iv)
     : m_cipherConfig(config),
+      m_outputBuffer(OUTPUT_BUFFER_SIZE),
       m_input(std::move(input)),
-      m_cipher(std::make_unique<QCA::Cipher>(
-          cipherName(config),
-          cipherMode(config),
-          padding(config),
-          QCA::Encode,
-          SymmetricKey(key),
-          InitializationVector(iv)))
+      m_cipher(std::make_unique<CipherContext>(config, Encode, key, iv))
 {
     // output must not be sequential
     Q_ASSERT(!m_input->isSequential());
 
-    Q_ASSERT(m_outputBuffer.empty());
+    if (!m_cipher->processesInPlace()) {
+        m_inputBuffer.resize(INPUT_BUFFER_SIZE);
+    }
 
     setOpenMode(m_input->openMode() & QIODevice::ReadOnly);
-
-    Q_ASSERT(m_cipher->validKeyLength(int(key.length())));
-    Q_ASSERT(m_cipher->ok());
 }
 
 EncryptionDevice::~EncryptionDevice() = default;
@@ -190,54 +390,92 @@ qint64 EncryptionDevice::size() const
 
 qint64 EncryptionDevice::readData(char *data, qint64 len)
 {
-    auto requestedLen = len;
-    qint64 read = 0;
-
-    {
-        // try to read from output buffer
-        qint64 outputBufferRead = std::min(qint64(m_outputBuffer.size()), len);
-        std::copy_n(m_outputBuffer.cbegin(), outputBufferRead, data);
-        m_outputBuffer.erase(m_outputBuffer.begin(), m_outputBuffer.begin() + outputBufferRead);
-        read += outputBufferRead;
-        len -= outputBufferRead;
+    if (m_failed) {
+        return -1;
     }
 
-    if (len > 0) {
-        // read from input and encrypt new data
+    // encrypted data left over from the last read
+    auto read = readFromOutputBuffer(data, len);
 
+    while (read < len && !m_finalized) {
         // output buffer is empty here
-        Q_ASSERT(m_outputBuffer.empty());
+        Q_ASSERT(m_outputBufferPos == m_outputBufferEnd);
+
+        auto *userBuffer = data + read;
+        auto userBufferSize = std::size_t(len - read);
+
+        // Encrypt directly into the user's buffer if the output is guaranteed to fit. Stream
+        // ciphers read the input into the user's buffer and encrypt it in place.
+        std::size_t inputSize = 0;
+        bool direct = true;
+        if (m_cipher->processesInPlace()) {
+            inputSize = std::min(userBufferSize, INPUT_BUFFER_SIZE);
+        } else if (userBufferSize > CIPHER_BLOCK_SIZE) {
+            // the output may be up to one block larger than the input
+            inputSize = std::min(userBufferSize - CIPHER_BLOCK_SIZE, INPUT_BUFFER_SIZE);
+        } else {
+            inputSize = CIPHER_BLOCK_SIZE;
+            direct = false;
+        }
 
-        // read unencrypted data (may read one block more than needed)
-        auto inputBufferSize = roundUpToBlockSize(len, blockSize(m_cipherConfig));
-        Q_ASSERT(inputBufferSize > 0);
-        QByteArray inputBuffer;
-        inputBuffer.resize(inputBufferSize);
-        inputBuffer.resize(m_input->read(inputBuffer.data(), inputBufferSize));
+        auto *input = m_cipher->processesInPlace() ? userBuffer : m_inputBuffer.data();
+        auto inputRead = m_input->read(input, qint64(inputSize));
+        if (inputRead < 0) {
+            setErrorString(m_input->errorString());
+            return read > 0 ? read : -1;
+        }
+
+        m_outputBufferPos = 0;
+        m_outputBufferEnd = 0;
+        auto processed = m_cipher->update(input, std::size_t(inputRead), direct ? userBuffer : m_outputBuffer.data());
+        if (!processed) {
+            return fail();
+        }
+        if (direct) {
+            read += qint64(*processed);
+        } else {
+            m_outputBufferEnd = *processed;
+        }
 
-        // process input buffer
-        auto processed = m_cipher->update(MemoryRegion(inputBuffer));
         if (m_input->atEnd()) {
             m_finalized = true;
-            processed = processed + m_cipher->final();
+            auto finalSize = m_cipher->final(m_outputBuffer.data() + m_outputBufferEnd);
+            if (!finalSize) {
+                return fail();
+            }
+            m_outputBufferEnd += *finalSize;
         }
 
-        // split up into part for user and put rest into output buffer
-        auto processedReadBytes = std::min(qint64(processed.size()), len);
-        std::copy_n(processed.constData(), processedReadBytes, data + read);
-        read += processedReadBytes;
-        len -= processedReadBytes;
+        // pass on what fits, keep the rest for the next read
+        read += readFromOutputBuffer(data + read, len - read);
 
-        Q_ASSERT(processed.size() >= processedReadBytes);
-        auto restBytes = size_t(processed.size() - processedReadBytes);
-        m_outputBuffer.resize(restBytes);
-        std::copy_n(processed.constData() + processedReadBytes, restBytes, m_outputBuffer.data());
+        if (inputRead == 0 && !m_finalized) {
+            // no input available at the moment
+            break;
+        }
     }
 
-    Q_ASSERT((len + read) == requestedLen);
     return read;
 }
 
+qint64 EncryptionDevice::fail()
+{
+    // the output is unusable after an error, also fail all following reads
+    m_failed = true;
+    m_outputBufferPos = m_outputBufferEnd = 0;
+    setErrorString(u"Could not encrypt the data."_s);
+    return -1;
+}
+
+qint64 EncryptionDevice::readFromOutputBuffer(char *data, qint64 maxlen)
+{
+    // consumed bytes are skipped instead of being erased from the front
+    auto count = std::min(qint64(m_outputBufferEnd - m_outputBufferPos), maxlen);
+    std::copy_n(m_outputBuffer.data() + m_outputBufferPos, count, data);
+    m_outputBufferPos += std::size_t(count);
+    return count;
+}
+
 qint64 EncryptionDevice::writeData(const char *, qint64)
 {
     return 0;
@@ -245,7 +483,7 @@ qint64 EncryptionDevice::writeData(const char *, qint64)
 
 bool EncryptionDevice::atEnd() const
 {
-    return m_finalized && m_outputBuffer.empty();
+    return m_finalized && m_outputBufferPos == m_outputBufferEnd;
 }
 
 DecryptionDevice::DecryptionDevice(std::unique_ptr<QIODevice> input,
@@ -253,24 +491,11 @@ DecryptionDevice::DecryptionDevice(std::unique_ptr<QIODevice> input,
                                    const QByteArray &key,
                                    const QByteArray &iv)
     : m_cipherConfig(config),
+      m_outputBuffer(OUTPUT_BUFFER_SIZE),
       m_output(std::move(input)),
-      m_cipher(std::make_unique<QCA::Cipher>(
-          cipherName(config),
-          cipherMode(config),
-          padding(config),
-          QCA::Decode,
-          SymmetricKey(key),
-          InitializationVector(iv)))
+      m_cipher(std::make_unique<CipherContext>(config, Decode, key, iv))
 {
-    // output must not be sequential
-    Q_ASSERT(!m_output->isSequential());
-
-    Q_ASSERT(m_outputBuffer.empty());
-
     setOpenMode(m_output->openMode() & QIODevice::WriteOnly);
-
-    Q_ASSERT(m_cipher->validKeyLength(int(key.length())));
-    Q_ASSERT(m_cipher->ok());
 }
 
 DecryptionDevice::~DecryptionDevice() = default;
@@ -303,26 +528,66 @@ qint64 DecryptionDevice::readData(char *, qint64)
 
 qint64 DecryptionDevice::writeData(const char *data, qint64 len)
 {
-    auto decrypted = m_cipher->update(QByteArray(data, len));
-    m_output->write(decrypted.constData(), decrypted.size());
+    if (m_failed || m_finished) {
+        return -1;
+    }
+
+    // decrypt in parts that fit into the reused output buffer
+    for (qint64 offset = 0; offset < len; offset += qint64(INPUT_BUFFER_SIZE)) {
+        auto size = std::min(std::size_t(len - offset), INPUT_BUFFER_SIZE);
+        auto decryptedSize = m_cipher->update(data + offset, size, m_outputBuffer.data());
+        if (!decryptedSize) {
+            fail(u"Could not decrypt the data."_s);
+            return -1;
+        }
+        if (!writeOutput(*decryptedSize)) {
+            return -1;
+        }
+    }
     return len;
 }
 
-void DecryptionDevice::finish()
+bool DecryptionDevice::finish()
 {
+    // also called by close(), the cipher can only be finalized once
+    if (m_failed || m_finished) {
+        return !m_failed;
+    }
+    m_finished = true;
+
     switch (m_cipherConfig) {
     case Aes128GcmNoPad:
     case Aes256GcmNoPad:
         // For GCM no-padding algorithms QCA / OpenSSL adds a '\0' byte at the end.
         // We don't want that, it breaks our checksums.
         // The unit tests verify that the data is still decrypted correctly.
-        return;
+        return true;
     case Aes256CbcPkcs7: {
-        auto decrypted = m_cipher->final();
-        m_output->write(decrypted.constData(), decrypted.size());
-        break;
+        auto decryptedSize = m_cipher->final(m_outputBuffer.data());
+        if (!decryptedSize) {
+            // usually invalid padding, i.e. a wrong key or truncated data
+            fail(u"Could not decrypt the data."_s);
+            return false;
+        }
+        return writeOutput(*decryptedSize);
+    }
     }
+    Q_UNREACHABLE();
+}
+
+bool DecryptionDevice::writeOutput(std::size_t size)
+{
+    if (m_output->write(m_outputBuffer.data(), qint64(size)) != qint64(size)) {
+        fail(m_output->errorString());
+        return false;
     }
+    return true;
+}
+
+void DecryptionDevice::fail(const QString &errorString)
+{
+    m_failed = true;
+    setErrorString(errorString);
 }
 
 }  // namespace QXmpp::Private::Encryption
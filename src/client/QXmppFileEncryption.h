@@ -11,13 +11,10 @@
 
 #include <QIODevice>
 
-namespace QCA {
-class Cipher;
-class Initializer;
-}  // namespace QCA
-
 namespace QXmpp::Private::Encryption {
 
+class CipherContext;
+
 enum Direction {
     Encode,
     Decode,
@@ -44,11 +41,20 @@ public:
     bool atEnd() const override;
 
 private:
+    qint64 fail();
+    qint64 readFromOutputBuffer(char *data, qint64 maxlen);
+
     Cipher m_cipherConfig;
     bool m_finalized = false;
+    bool m_failed = false;
+    // reused for reading the unencrypted input if it can't be encrypted in place
+    std::vector<char> m_inputBuffer;
+    // encrypted data that has not been read yet is between m_outputBufferPos and m_outputBufferEnd
     std::vector<char> m_outputBuffer;
+    std::size_t m_outputBufferPos = 0;
+    std::size_t m_outputBufferEnd = 0;
     std::unique_ptr<QIODevice> m_input;
-    std::unique_ptr<QCA::Cipher> m_cipher;
+    std::unique_ptr<CipherContext> m_cipher;
 };
 
 class QXMPP_EXPORT DecryptionDevice : public QIODevice
@@ -63,13 +69,19 @@ public:
     qint64 size() const override;
     qint64 readData(char *data, qint64 maxlen) override;
     qint64 writeData(const char *data, qint64 len) override;
-    void finish();
+    bool finish();
 
 private:
+    bool writeOutput(std::size_t size);
+    void fail(const QString &errorString);
+
     Cipher m_cipherConfig;
+    bool m_finished = false;
+    bool m_failed = false;
+    // reused for the decrypted data
     std::vector<char> m_outputBuffer;
     std::unique_ptr<QIODevice> m_output;
-    std::unique_ptr<QCA::Cipher> m_cipher;
+    std::unique_ptr<CipherContext> m_cipher;
 };
 
 }  // namespace QXmpp::Private::Encryption
@@ -28,6 +28,7 @@
 #include <QMimeDatabase>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
+#include <QPointer>
 
 using namespace QXmpp;
 using namespace QXmpp::Private;
@@ -35,10 +36,13 @@ using namespace QXmpp::Private;
 using MetadataGenerator = QXmppFileSharingManager::MetadataGenerator;
 using MetadataGeneratorResult = QXmppFileSharingManager::MetadataGeneratorResult;
 
-// The manager generates a hash with each hash algorithm
+// The manager generates a hash with each hash algorithm. SHA-256 is supported by everyone, the
+// other algorithm is the fastest one available and used by receivers that support it.
 static std::vector<HashAlgorithm> hashAlgorithms()
 {
-#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+#if defined(WITH_BLAKE3)
+    return { HashAlgorithm::Sha256, HashAlgorithm::Blake3_256 };
+#elif QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
     return { HashAlgorithm::Sha256, HashAlgorithm::Blake2b_256 };
 #else
     return { HashAlgorithm::Sha256, HashAlgorithm::Sha3_256 };
@@ -200,7 +204,7 @@ class QXmppFileDownloadPrivate
 {
 public:
     std::shared_ptr<QXmppFileSharingProvider::Download> providerDownload;
-    QFuture<HashVerificationResultPtr> hashesFuture;
+    QFuture<HashingResultPtr> hashesFuture;
     QVector<QXmppHash> hashes;
     QXmppFileDownload::Result result;
     quint64 bytesReceived = 0;
@@ -385,6 +389,11 @@ void QXmppFileSharingManager::setMetadataGenerator(MetadataGenerator &&generator
 
 ///
 /// \brief Upload a file in a way that it can be attached to a message.
+///
+/// The file is read only once for uploading: the hashes of the file are
+/// calculated from the data read by the provider and are added to the
+/// metadata when the upload has finished.
+///
 /// \param provider The provider class decides how the file is uploaded
 /// \param filePath Path to a file that should be uploaded
 /// \param description Optional description of the file
@@ -412,7 +421,6 @@ std::shared_ptr<QXmppFileUpload> QXmppFileSharingManager::uploadFile(std::shared
     };
 
     auto metadataIoDevice = openFile();
-    auto hashesIoDevice = openFile();
     auto uploadIoDevice = openFile();
 
     if (upload->d->finished) {
@@ -421,19 +429,38 @@ std::shared_ptr<QXmppFileUpload> QXmppFileSharingManager::uploadFile(std::shared
     }
 
     upload->d->metadataFuture = d->metadataGenerator(std::move(metadataIoDevice));
-    upload->d->hashesFuture = calculateHashes(std::move(hashesIoDevice), hashAlgorithms());
+
+    // the hashes are calculated while the provider reads the file for uploading
+    auto hashingDevice = std::make_unique<HashingDevice>(std::move(uploadIoDevice), hashAlgorithms());
+    upload->d->hashesFuture = hashingDevice->hashesFuture();
 
     auto onProgress = [upload](quint64 sent, quint64 total) {
         upload->d->bytesSent = sent;
         upload->d->bytesTotal = total;
         Q_EMIT upload->progressChanged();
     };
-    auto onFinished = [this, upload](QXmppFileSharingProvider::UploadResult uploadResult) {
+    auto onHashesCalculated = [upload](HashingResultPtr hashResult) {
+        auto &hashValue = hashResult->result;
+        if (std::holds_alternative<std::vector<QXmppHash>>(hashValue)) {
+            const auto &hashesVector = std::get<std::vector<QXmppHash>>(hashValue);
+            auto hashes = transform<QVector<QXmppHash>>(hashesVector, [](auto &&hash) {
+                return hash;
+            });
+            upload->d->metadata.setHashes(hashes);
+            upload->d->success = true;
+        } else if (std::holds_alternative<Cancelled>(hashValue)) {
+            upload->d->cancelled = true;
+        } else if (std::holds_alternative<QXmppError>(hashValue)) {
+            upload->d->error = std::get<QXmppError>(std::move(hashValue));
+        }
+        upload->reportFinished();
+    };
+    auto onFinished = [this, upload, filePath = fileInfo.absoluteFilePath(), onHashesCalculated](QXmppFileSharingProvider::UploadResult uploadResult) {
         // free memory
         upload->d->providerUpload.reset();
         if (std::holds_alternative<std::any>(uploadResult)) {
             upload->d->source = std::get<std::any>(std::move(uploadResult));
-            await(upload->d->metadataFuture, this, [this, upload](auto &&result) mutable {
+            await(upload->d->metadataFuture, this, [this, upload, filePath, onHashesCalculated](auto &&result) mutable {
                 if (result->dimensions) {
                     upload->d->metadata.setWidth(result->dimensions->width());
                     upload->d->metadata.setHeight(result->dimensions->height());
@@ -463,21 +490,21 @@ std::shared_ptr<QXmppFileUpload> QXmppFileSharingManager::uploadFile(std::shared
                     upload->d->metadata.setThumbnails(thumbnails);
                 }
 
-                await(upload->d->hashesFuture, this, [upload](auto hashResult) mutable {
-                    auto &hashValue = hashResult->result;
-                    if (std::holds_alternative<std::vector<QXmppHash>>(hashValue)) {
-                        const auto &hashesVector = std::get<std::vector<QXmppHash>>(hashValue);
-                        auto hashes = transform<QVector<QXmppHash>>(hashesVector, [](auto &&hash) {
-                            return hash;
-                        });
-                        upload->d->metadata.setHashes(hashes);
-                        upload->d->success = true;
-                    } else if (std::holds_alternative<Cancelled>(hashValue)) {
-                        upload->d->cancelled = true;
-                    } else if (std::holds_alternative<QXmppError>(hashValue)) {
-                        upload->d->error = std::get<QXmppError>(std::move(hashValue));
+                await(upload->d->hashesFuture, this, [this, upload, filePath, onHashesCalculated](HashingResultPtr hashResult) {
+                    if (!std::holds_alternative<QXmppError>(hashResult->result)) {
+                        onHashesCalculated(std::move(hashResult));
+                        return;
+                    }
+
+                    // the provider has not read the whole file through the upload device
+                    auto file = std::make_unique<QFile>(filePath);
+                    if (!file->open(QIODevice::ReadOnly)) {
+                        upload->d->error = QXmppError::fromIoDevice(*file);
+                        upload->reportFinished();
+                        return;
                     }
-                    upload->reportFinished();
+                    upload->d->hashesFuture = calculateHashes(std::move(file), hashAlgorithms());
+                    await(upload->d->hashesFuture, this, onHashesCalculated);
                 });
             });
         } else if (std::holds_alternative<Cancelled>(uploadResult)) {
@@ -489,14 +516,16 @@ std::shared_ptr<QXmppFileUpload> QXmppFileSharingManager::uploadFile(std::shared
         }
     };
 
-    upload->d->providerUpload = provider->uploadFile(std::move(uploadIoDevice), upload->d->metadata, std::move(onProgress), std::move(onFinished));
+    upload->d->providerUpload = provider->uploadFile(std::move(hashingDevice), upload->d->metadata, std::move(onProgress), std::move(onFinished));
     return upload;
 }
 
 ///
 /// \brief Download a file from a QXmppFileShare
 ///
-/// \warning This function currently does not check the hash of the downloaded file.
+/// The hash of the file is calculated while the data is written to the
+/// output, so any QIODevice can be verified without reading it again. The
+/// download is finished with an error if the hash does not match.
 ///
 /// Make sure to register the provider
 /// that handles the sources used in this file share before calling this function.
@@ -513,18 +542,20 @@ std::shared_ptr<QXmppFileDownload> QXmppFileSharingManager::downloadFile(
     std::shared_ptr<QXmppFileDownload> download(new QXmppFileDownload());
     download->d->hashes = fileShare.metadata().hashes();
 
-    // currently hashing does only work with QFiles
-    auto filePath = [&]() -> QString {
-        if (auto *file = dynamic_cast<QFile *>(output.get())) {
-            return file->fileName();
-        }
-        return {};
-    }();
+    // hash the data while it is written to the output
+    auto expectedHash = verificationHash(transform<std::vector<QXmppHash>>(download->d->hashes, [](auto hash) { return hash; }));
+    QPointer<HashingDevice> hashingDevice;
+    if (expectedHash) {
+        auto device = std::make_unique<HashingDevice>(std::move(output), std::vector { expectedHash->algorithm() });
+        download->d->hashesFuture = device->hashesFuture();
+        hashingDevice = device.get();
+        output = std::move(device);
+    }
 
     auto onProgress = [download](quint64 received, quint64 total) {
         download->reportProgress(received, total);
     };
-    auto onFinished = [this, download, filePath](QXmppFileSharingProvider::DownloadResult result) mutable {
+    auto onFinished = [this, download, expectedHash, hashingDevice](QXmppFileSharingProvider::DownloadResult result) mutable {
         // reduce ref count
         download->d->providerDownload.reset();
 
@@ -538,24 +569,17 @@ std::shared_ptr<QXmppFileDownload> QXmppFileSharingManager::downloadFile(
             return;
         }
 
-        // try to do hash verification
-        if (filePath.isEmpty()) {
-            warning(u"Can't verify hashes of other io devices than QFile!"_s);
+        if (!expectedHash) {
             download->reportFinished(QXmppFileDownload::Downloaded { QXmppFileDownload::NoStrongHashes });
             return;
         }
 
-        auto file = std::make_unique<QFile>(filePath);
-        if (!file->open(QIODevice::ReadOnly)) {
-            download->reportFinished(QXmppError::fromFileDevice(*file));
-            return;
+        // all data has been written, in case the provider hasn't closed the output
+        if (hashingDevice) {
+            hashingDevice->finish();
         }
 
-        download->d->hashesFuture = verifyHashes(
-            std::move(file),
-            transform<std::vector<QXmppHash>>(download->d->hashes, [](auto hash) { return hash; }));
-
-        await(download->d->hashesFuture, this, [download](HashVerificationResultPtr hashResult) {
+        await(download->d->hashesFuture, this, [download, expectedHash = *expectedHash](HashingResultPtr hashResult) {
             auto convert = overloaded {
                 [](HashVerificationResult::NoStrongHashes) {
                     return QXmppFileDownload::Downloaded {
@@ -574,7 +598,7 @@ std::shared_ptr<QXmppFileDownload> QXmppFileSharingManager::downloadFile(
                     };
                 }
             };
-            download->reportFinished(visitForward<QXmppFileDownload::Result>(hashResult->result, convert));
+            download->reportFinished(visitForward<QXmppFileDownload::Result>(verifyHashingResult(std::move(hashResult->result), expectedHash), convert));
         });
     };
 
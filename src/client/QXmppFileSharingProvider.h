@@ -65,7 +65,8 @@ public:
     /// \brief Handles the download of files for this provider
     /// \param source A type-erased source object. The provider will only ever have to handle
     ///        its own sources, so this can safely be casted to the defined source type.
-    /// \param target QIODevice into which the received data should be written
+    /// \param target QIODevice into which the received data should be written. The data may
+    ///        only be written out of order if the device is not sequential.
     /// \param reportProgress Can be called to report received bytes and total bytes
     /// \param reportFinished Finalizes the download, no more progress must be reported after this
     ///
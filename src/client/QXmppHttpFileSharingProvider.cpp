@@ -12,17 +12,428 @@
 
 #include "StringLiterals.h"
 
+#include <algorithm>
+#include <deque>
+#include <numeric>
+
+#include <QBuffer>
+#include <QFileDevice>
 #include <QMimeDatabase>
+#include <QNetworkAccessManager>
 #include <QNetworkReply>
+#include <QTimer>
 
 using namespace QXmpp;
 using namespace QXmpp::Private;
+using namespace std::chrono_literals;
+
+constexpr int DEFAULT_MAX_DOWNLOAD_RETRIES = 3;
+// delay before the first retry of a range, doubled with every further retry
+constexpr auto DOWNLOAD_RETRY_DELAY = 250ms;
+// files are only split into ranges of at least this size
+constexpr qint64 PARALLEL_DOWNLOAD_MIN_RANGE_SIZE = 1024 * 1024;
+
+struct ContentRange {
+    qint64 start;
+    // inclusive
+    qint64 end;
+    // -1 if unknown
+    qint64 total;
+};
+
+// parses "bytes <start>-<end>/<total>" as sent in Content-Range headers
+static std::optional<ContentRange> parseContentRange(const QByteArray &header)
+{
+    if (!header.startsWith("bytes ")) {
+        return {};
+    }
+    const auto spec = header.mid(6).trimmed();
+    const auto dash = spec.indexOf('-');
+    const auto slash = spec.indexOf('/');
+    if (dash < 0 || slash < dash) {
+        return {};
+    }
+
+    bool startOk = false, endOk = false, totalOk = true;
+    ContentRange range;
+    range.start = spec.left(dash).toLongLong(&startOk);
+    range.end = spec.mid(dash + 1, slash - dash - 1).toLongLong(&endOk);
+    const auto total = spec.mid(slash + 1);
+    range.total = total == "*" ? -1 : total.toLongLong(&totalOk);
+    if (!startOk || !endOk || !totalOk || range.end < range.start) {
+        return {};
+    }
+    return range;
+}
+
+// discards the data written to the device, false if the device can't be truncated
+static bool truncateDevice(QIODevice &device)
+{
+    if (auto *file = qobject_cast<QFileDevice *>(&device)) {
+        return file->resize(0) && file->seek(0);
+    }
+    if (auto *buffer = qobject_cast<QBuffer *>(&device)) {
+        buffer->buffer().clear();
+        return buffer->seek(0);
+    }
+    return false;
+}
+
+// errors after which requesting the data again may succeed
+static bool isTransientError(QNetworkReply::NetworkError error)
+{
+    switch (error) {
+    case QNetworkReply::RemoteHostClosedError:
+    case QNetworkReply::TimeoutError:
+    case QNetworkReply::TemporaryNetworkFailureError:
+    case QNetworkReply::NetworkSessionFailedError:
+    case QNetworkReply::ProxyConnectionClosedError:
+    case QNetworkReply::ProxyTimeoutError:
+    case QNetworkReply::ServiceUnavailableError:
+    case QNetworkReply::UnknownNetworkError:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Download of a file via one or more HTTP GET requests.
+//
+// Every request fetches a byte range of the file, initially a single range covering the whole
+// file. If a request fails because of a network error and the server supports range requests,
+// the range is requested again starting at the first byte that has not been written yet. Files
+// written to a random-access device can additionally be split into multiple ranges that are
+// downloaded in parallel.
+class HttpDownload : public QXmppFileSharingProvider::Download, public std::enable_shared_from_this<HttpDownload>
+{
+public:
+    struct Range {
+        qint64 start = 0;
+        // exclusive, -1 if the range extends to the end of the file
+        qint64 end = -1;
+        qint64 written = 0;
+        int retries = 0;
+        QNetworkReply *reply = nullptr;
+        bool responseChecked = false;
+        // whether the body of the current response contains data of the file
+        bool bodyAccepted = false;
+        bool done = false;
+    };
+
+    void start();
+    void cancel() override;
+
+    QNetworkAccessManager *netManager = nullptr;
+    QUrl url;
+    std::unique_ptr<QIODevice> output;
+    std::function<void(quint64, quint64)> reportProgress;
+    std::function<void(DownloadResult)> reportFinished;
+    int maxRetries = DEFAULT_MAX_DOWNLOAD_RETRIES;
+    int parallelRanges = 1;
+
+private:
+    void request(Range &range);
+    bool checkResponse(Range &range);
+    void handleData(Range &range);
+    void handleError(Range &range);
+    void handleFinished(Range &range);
+    void retryOrFail(Range &range, QXmppError &&error, bool transient);
+    void split();
+    void finish(DownloadResult &&result);
+
+    // deque, so references to ranges stay valid when adding more
+    std::deque<Range> ranges;
+    // -1 until known
+    qint64 totalSize = -1;
+    bool acceptsRanges = false;
+    // ETag or Last-Modified value of the first response for If-Range
+    QByteArray validator;
+    bool finished = false;
+};
+
+void HttpDownload::start()
+{
+    request(ranges.emplace_back());
+}
+
+void HttpDownload::cancel()
+{
+    if (!finished) {
+        finish(Cancelled());
+    }
+}
+
+void HttpDownload::request(Range &range)
+{
+    QNetworkRequest networkRequest(url);
+    const auto offset = range.start + range.written;
+    if (offset > 0 || range.end >= 0) {
+        auto value = "bytes=" + QByteArray::number(offset) + '-';
+        if (range.end >= 0) {
+            value += QByteArray::number(range.end - 1);
+        }
+        networkRequest.setRawHeader("Range", value);
+        if (!validator.isEmpty()) {
+            // the server sends the whole file if it has changed in the meantime
+            networkRequest.setRawHeader("If-Range", validator);
+        }
+    }
+
+    auto *reply = netManager->get(networkRequest);
+    range.reply = reply;
+    range.responseChecked = false;
+
+    // replies are ignored once they have been replaced or aborted
+    auto self = shared_from_this();
+    QObject::connect(reply, &QNetworkReply::metaDataChanged, [self, &range, reply]() {
+        if (range.reply == reply) {
+            self->checkResponse(range);
+        }
+    });
+    QObject::connect(reply, &QNetworkReply::readyRead, [self, &range, reply]() {
+        if (range.reply == reply) {
+            self->handleData(range);
+        }
+    });
+    QObject::connect(reply, &QNetworkReply::errorOccurred, [self, &range, reply](QNetworkReply::NetworkError) {
+        // Qt doc: the finished() signal will "probably" follow
+        // => we can't be sure that finished() is going to be called
+        if (range.reply == reply) {
+            self->handleError(range);
+        }
+    });
+    QObject::connect(reply, &QNetworkReply::finished, [self, &range, reply]() {
+        if (range.reply == reply) {
+            self->handleFinished(range);
+        }
+    });
+}
+
+bool HttpDownload::checkResponse(Range &range)
+{
+    if (range.responseChecked) {
+        return true;
+    }
+    range.responseChecked = true;
+    range.bodyAccepted = false;
+
+    auto *reply = range.reply;
+    const auto status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    const auto offset = range.start + range.written;
+
+    if (status == 206) {
+        const auto contentRange = parseContentRange(reply->rawHeader("Content-Range"));
+        if (!contentRange || contentRange->start != offset) {
+            finish(QXmppError { u"Server responded with an unexpected byte range."_s, {} });
+            return false;
+        }
+        if (totalSize < 0) {
+            totalSize = contentRange->total;
+        }
+        acceptsRanges = true;
+        range.bodyAccepted = true;
+        return true;
+    }
+
+    if (status != 200) {
+        // the body is e.g. an error page, errors are handled by handleError()
+        return true;
+    }
+
+    if (offset > 0) {
+        // the server ignored the range or the file has changed, the data needs to be written
+        // again from the start and no data of the old response may remain after it
+        if (ranges.size() == 1 && !output->isSequential() && truncateDevice(*output)) {
+            range.written = 0;
+        } else {
+            finish(QXmppError { u"Server does not support resuming the download."_s, {} });
+            return false;
+        }
+    }
+
+    const auto contentLength = reply->header(QNetworkRequest::ContentLengthHeader);
+    totalSize = contentLength.isValid() ? contentLength.toLongLong() : -1;
+    acceptsRanges = reply->rawHeader("Accept-Ranges").trimmed() == "bytes";
+    if (auto eTag = reply->rawHeader("ETag"); !eTag.isEmpty() && !eTag.startsWith("W/")) {
+        // weak entity tags can't be used with If-Range
+        validator = eTag;
+    } else {
+        validator = reply->rawHeader("Last-Modified");
+    }
+
+    range.bodyAccepted = true;
+    if (ranges.size() == 1 && range.written == 0) {
+        split();
+    }
+    return true;
+}
+
+void HttpDownload::handleData(Range &range)
+{
+    Q_ASSERT(output);
+    if (!checkResponse(range)) {
+        return;
+    }
+
+    const auto data = range.reply->readAll();
+    if (!range.bodyAccepted) {
+        // never write the body of other responses into the file
+        return;
+    }
+
+    auto size = qint64(data.size());
+    if (range.end >= 0) {
+        // the first range may be longer, because the file has been split after requesting it
+        size = std::min(size, range.end - range.start - range.written);
+    }
+
+    const auto position = range.start + range.written;
+    if (!output->isSequential() && output->pos() != position && !output->seek(position)) {
+        finish(QXmppError::fromIoDevice(*output));
+        return;
+    }
+    if (output->write(data.constData(), size) != size) {
+        finish(QXmppError::fromIoDevice(*output));
+        return;
+    }
+    range.written += size;
+
+    auto received = std::accumulate(ranges.cbegin(), ranges.cend(), qint64(0), [](qint64 sum, const Range &r) {
+        return sum + r.written;
+    });
+    reportProgress(received, totalSize);
+
+    if (range.end >= 0 && range.start + range.written >= range.end) {
+        // the range is complete, drop the rest of the response
+        auto *reply = std::exchange(range.reply, nullptr);
+        reply->abort();
+        reply->deleteLater();
+
+        range.done = true;
+        if (std::all_of(ranges.cbegin(), ranges.cend(), [](const Range &r) { return r.done; })) {
+            finish(Success());
+        }
+    }
+}
+
+void HttpDownload::handleError(Range &range)
+{
+    // keep the data received before the error, so it doesn't need to be requested again
+    if (range.reply->bytesAvailable() > 0) {
+        handleData(range);
+        if (finished || range.done) {
+            return;
+        }
+    }
+
+    const auto error = range.reply->error();
+    retryOrFail(range, QXmppError::fromNetworkReply(*range.reply), isTransientError(error));
+}
+
+void HttpDownload::handleFinished(Range &range)
+{
+    if (range.reply->error() != QNetworkReply::NoError) {
+        return handleError(range);
+    }
+    if (!checkResponse(range)) {
+        return;
+    }
+    // read data that has not been announced via readyRead() yet
+    if (range.reply->bytesAvailable() > 0) {
+        handleData(range);
+        if (finished || range.done) {
+            return;
+        }
+    }
+
+    if (!range.bodyAccepted) {
+        const auto status = range.reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        finish(QXmppError { u"Server responded with unexpected status code %1."_s.arg(status), {} });
+        return;
+    }
+
+    if (range.end >= 0 && range.start + range.written < range.end) {
+        retryOrFail(range, QXmppError { u"Server closed the connection before the download was complete."_s, {} }, true);
+        return;
+    }
+
+    std::exchange(range.reply, nullptr)->deleteLater();
+    range.done = true;
+    if (std::all_of(ranges.cbegin(), ranges.cend(), [](const Range &r) { return r.done; })) {
+        finish(Success());
+    }
+}
+
+void HttpDownload::retryOrFail(Range &range, QXmppError &&error, bool transient)
+{
+    std::exchange(range.reply, nullptr)->deleteLater();
+
+    // without range requests, a retry is only possible if nothing has been written yet
+    if (!transient || range.retries >= maxRetries || (range.written > 0 && !acceptsRanges)) {
+        finish(std::move(error));
+        return;
+    }
+
+    const auto delay = DOWNLOAD_RETRY_DELAY * (1 << range.retries);
+    range.retries++;
+    QTimer::singleShot(delay, netManager, [self = shared_from_this(), &range]() {
+        if (!self->finished) {
+            self->request(range);
+        }
+    });
+}
+
+void HttpDownload::split()
+{
+    // sequential devices need the data in order
+    if (parallelRanges < 2 || !acceptsRanges || totalSize <= 0 || output->isSequential()) {
+        return;
+    }
+
+    const auto count = std::min(qint64(parallelRanges), totalSize / PARALLEL_DOWNLOAD_MIN_RANGE_SIZE);
+    if (count < 2) {
+        return;
+    }
+
+    // the running request continues as the first range
+    const auto rangeSize = (totalSize + count - 1) / count;
+    ranges.front().end = rangeSize;
+    for (auto start = rangeSize; start < totalSize; start += rangeSize) {
+        auto &range = ranges.emplace_back();
+        range.start = start;
+        range.end = std::min(start + rangeSize, totalSize);
+        request(range);
+    }
+}
+
+void HttpDownload::finish(DownloadResult &&result)
+{
+    if (finished) {
+        return;
+    }
+    finished = true;
+
+    for (auto &range : ranges) {
+        if (auto *reply = std::exchange(range.reply, nullptr)) {
+            reply->abort();
+            reply->deleteLater();
+        }
+    }
+    if (output && output->isOpen()) {
+        output->close();
+    }
+    reportFinished(std::move(result));
+}
 
 ///
 /// \class QXmppHttpFileSharingProvider
 ///
 /// A file sharing provider that uses HTTP File Upload to upload and download files.
 ///
+/// Interrupted downloads are continued from the last received byte if the server supports
+/// range requests, see setMaxDownloadRetries(). Large files can also be downloaded as
+/// multiple byte ranges in parallel, see setParallelDownloadRanges().
+///
 /// \since QXmpp 1.5
 ///
 
@@ -31,6 +442,8 @@ class QXmppHttpFileSharingProviderPrivate
 public:
     QXmppHttpUploadManager *manager;
     QNetworkAccessManager *netManager;
+    int maxDownloadRetries = DEFAULT_MAX_DOWNLOAD_RETRIES;
+    int parallelDownloadRanges = 1;
 };
 
 ///
@@ -47,40 +460,62 @@ QXmppHttpFileSharingProvider::QXmppHttpFileSharingProvider(QXmppHttpUploadManage
 
 QXmppHttpFileSharingProvider::~QXmppHttpFileSharingProvider() = default;
 
+///
+/// Returns how often a download is continued after a network error.
+///
+/// \since QXmpp 1.8
+///
+int QXmppHttpFileSharingProvider::maxDownloadRetries() const
+{
+    return d->maxDownloadRetries;
+}
+
+///
+/// Sets how often a download is continued after a network error.
+///
+/// If the server supports range requests, the download continues from the
+/// last written byte. Otherwise a download can only be retried if no data has
+/// been written yet. The default is 3.
+///
+/// \since QXmpp 1.8
+///
+void QXmppHttpFileSharingProvider::setMaxDownloadRetries(int retries)
+{
+    d->maxDownloadRetries = std::max(retries, 0);
+}
+
+///
+/// Returns the maximum number of byte ranges a file is downloaded in parallel.
+///
+/// \since QXmpp 1.8
+///
+int QXmppHttpFileSharingProvider::parallelDownloadRanges() const
+{
+    return d->parallelDownloadRanges;
+}
+
+///
+/// Sets the maximum number of byte ranges a file is downloaded in parallel.
+///
+/// Files are only split if the server supports range requests, the output
+/// device is not sequential and every range has a size of at least 1 MiB.
+/// Files downloaded via QXmppFileSharingManager with hash verification or
+/// encrypted files are written to sequential devices and are never split. The
+/// default is 1, i.e. no parallel download.
+///
+/// \since QXmpp 1.8
+///
+void QXmppHttpFileSharingProvider::setParallelDownloadRanges(int ranges)
+{
+    d->parallelDownloadRanges = std::max(ranges, 1);
+}
+
 auto QXmppHttpFileSharingProvider::downloadFile(const std::any &source,
                                                 std::unique_ptr<QIODevice> target,
                                                 std::function<void(quint64, quint64)> reportProgress,
                                                 std::function<void(DownloadResult)> reportFinished)
     -> std::shared_ptr<Download>
 {
-    struct State : Download {
-        ~State() override = default;
-
-        std::unique_ptr<QIODevice> output;
-        std::function<void(DownloadResult)> reportFinished;
-        std::optional<QXmppError> error;
-        QNetworkReply *reply = nullptr;
-        bool finished = false;
-        bool cancelled = false;
-
-        void cancel() override
-        {
-            if (!cancelled && !finished) {
-                cancelled = true;
-                reply->abort();
-            }
-        }
-        void finish(DownloadResult &&result)
-        {
-            if (output && output->isOpen()) {
-                output->close();
-            }
-            reportFinished(std::move(result));
-            finished = true;
-            reply->deleteLater();
-        }
-    };
-
     QXmppHttpFileSource httpSource;
     try {
         httpSource = std::any_cast<QXmppHttpFileSource>(source);
@@ -88,46 +523,17 @@ auto QXmppHttpFileSharingProvider::downloadFile(const std::any &source,
         qFatal("QXmppHttpFileSharingProvider::downloadFile can only handle QXmppHttpFileSource.");
     }
 
-    auto state = std::make_shared<State>();
-    state->output = std::move(target);
-    state->reportFinished = std::move(reportFinished);
-    state->reply = d->netManager->get(QNetworkRequest(httpSource.url()));
-
-    QObject::connect(state->reply, &QNetworkReply::finished, [state]() mutable {
-        if (!state->finished) {
-            if (state->error) {
-                state->finish(std::move(*state->error));
-            } else if (state->cancelled) {
-                state->finish(Cancelled());
-            } else {
-                state->finish(Success());
-            }
-        }
-    });
-
-    QObject::connect(state->reply, &QNetworkReply::readyRead, [state]() {
-        Q_ASSERT(state->output);
-
-        auto data = state->reply->readAll();
-        if (state->output->write(data) != data.size()) {
-            state->error = QXmppError::fromIoDevice(*state->output);
-        }
-    });
-
-    QObject::connect(state->reply, &QNetworkReply::downloadProgress, [state, reportProgress = std::move(reportProgress)](qint64 bytesReceived, qint64 bytesTotal) {
-        if (!state->finished) {
-            reportProgress(bytesReceived, bytesTotal);
-        }
-    });
-
-    QObject::connect(state->reply, &QNetworkReply::errorOccurred,
-                     [state](QNetworkReply::NetworkError) {
-                         // Qt doc: the finished() signal will "probably" follow
-                         // => we can't be sure that finished() is going to be called
-                         state->finish(QXmppError::fromNetworkReply(*state->reply));
-                     });
+    auto download = std::make_shared<HttpDownload>();
+    download->netManager = d->netManager;
+    download->url = httpSource.url();
+    download->output = std::move(target);
+    download->reportProgress = std::move(reportProgress);
+    download->reportFinished = std::move(reportFinished);
+    download->maxRetries = d->maxDownloadRetries;
+    download->parallelRanges = d->parallelDownloadRanges;
+    download->start();
 
-    return std::dynamic_pointer_cast<QXmppFileSharingProvider::Download>(state);
+    return std::dynamic_pointer_cast<QXmppFileSharingProvider::Download>(download);
 }
 
 auto QXmppHttpFileSharingProvider::uploadFile(std::unique_ptr<QIODevice> data,
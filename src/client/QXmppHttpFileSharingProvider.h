@@ -24,6 +24,12 @@ public:
     QXmppHttpFileSharingProvider(QXmppHttpUploadManager *manager, QNetworkAccessManager *netManager);
     ~QXmppHttpFileSharingProvider() override;
 
+    int maxDownloadRetries() const;
+    void setMaxDownloadRetries(int retries);
+
+    int parallelDownloadRanges() const;
+    void setParallelDownloadRanges(int ranges);
+
     auto downloadFile(const std::any &source,
                       std::unique_ptr<QIODevice> target,
                       std::function<void(quint64, quint64)> reportProgress,
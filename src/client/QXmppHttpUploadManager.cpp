@@ -12,6 +12,8 @@
 
 #include "StringLiterals.h"
 
+#include <deque>
+
 #include <QFile>
 #include <QFileInfo>
 #include <QMimeDatabase>
@@ -136,9 +138,50 @@ QXmppHttpUpload::~QXmppHttpUpload() = default;
 /// auto *uploadManager = client.addNewExtension<QXmppHttpUploadManager>();
 /// \endcode
 ///
+/// Uploads are queued and started in the order they have been added. Upload slots are requested
+/// ahead of the transfers (see setSlotPrefetchCount()), so a transfer can start as soon as
+/// another one has finished. The number of parallel transfers to one upload host is limited (see
+/// setMaxUploadsPerHost()). If the upload service supports HTTP/2, the transfers to it share one
+/// connection.
+///
+/// The progress of all uploads is available via progress(), bytesSent() and bytesTotal().
+///
 /// \since QXmpp 1.5
 ///
 
+///
+/// \property QXmppHttpUploadManager::progress
+///
+/// The progress of all uploads since the manager was idle the last time, as a floating point
+/// number between 0 and 1.
+///
+/// \since QXmpp 1.8
+///
+
+///
+/// \property QXmppHttpUploadManager::bytesSent
+///
+/// Number of bytes sent of all uploads since the manager was idle the last time
+///
+/// \since QXmpp 1.8
+///
+
+///
+/// \property QXmppHttpUploadManager::bytesTotal
+///
+/// Number of bytes of all uploads since the manager was idle the last time
+///
+/// \since QXmpp 1.8
+///
+
+///
+/// \fn QXmppHttpUploadManager::progressChanged
+///
+/// Emitted when the progress of any upload has changed or an upload has been added or finished.
+///
+/// \since QXmpp 1.8
+///
+
 ///
 /// \typedef QXmppHttpUpload::Result
 ///
@@ -174,11 +217,15 @@ quint64 QXmppHttpUpload::bytesTotal() const
 ///
 /// Cancels the upload.
 ///
+/// Uploads that are still queued or waiting for their upload slot finish immediately.
+///
 void QXmppHttpUpload::cancel()
 {
     d->cancelled = true;
     if (d->reply) {
         d->reply->abort();
+    } else {
+        d->reportFinished();
     }
 }
 
@@ -207,22 +254,204 @@ QXmppHttpUpload::QXmppHttpUpload()
 {
 }
 
+// upload that has not been started yet
+struct PendingUpload {
+    std::shared_ptr<QXmppHttpUpload> upload;
+    std::unique_ptr<QIODevice> data;
+    QString filename;
+    QMimeType mimeType;
+    qint64 fileSize;
+    QString uploadServiceJid;
+    QXmppHttpUploadSlotIq slot;
+};
+
+// upload that is part of the aggregated progress
+struct TrackedUpload {
+    std::shared_ptr<QXmppHttpUpload> upload;
+    quint64 fileSize;
+};
+
 struct QXmppHttpUploadManagerPrivate {
-    explicit QXmppHttpUploadManagerPrivate(QNetworkAccessManager *netManager)
-        : netManager(netManager)
+    QXmppHttpUploadManagerPrivate(QXmppHttpUploadManager *q, QNetworkAccessManager *netManager)
+        : q(q), netManager(netManager)
     {
     }
 
+    void track(const std::shared_ptr<QXmppHttpUpload> &upload, quint64 fileSize);
+    void schedule();
+    void requestSlot(std::shared_ptr<PendingUpload> pending);
+    void startTransfer(std::shared_ptr<PendingUpload> pending);
+
+    QXmppHttpUploadManager *q;
     QNetworkAccessManager *netManager;
+    int maxUploadsPerHost = 4;
+    int slotPrefetchCount = 2;
+
+    // uploads waiting for their slot request, in the order they have been added
+    std::deque<std::shared_ptr<PendingUpload>> queued;
+    int runningSlotRequests = 0;
+    // uploads with a slot waiting for a free transfer to their upload host
+    std::deque<std::shared_ptr<PendingUpload>> waiting;
+    QHash<QString, int> runningTransfers;
+    std::vector<TrackedUpload> tracked;
+
+    bool scheduling = false;
+    bool rescheduleRequested = false;
 };
 
+void QXmppHttpUploadManagerPrivate::track(const std::shared_ptr<QXmppHttpUpload> &upload, quint64 fileSize)
+{
+    // start a new aggregation if the manager was idle
+    if (std::all_of(tracked.cbegin(), tracked.cend(), [](const auto &t) { return t.upload->isFinished(); })) {
+        tracked.clear();
+    }
+    tracked.push_back({ upload, fileSize });
+
+    QObject::connect(upload.get(), &QXmppHttpUpload::progressChanged, q, &QXmppHttpUploadManager::progressChanged);
+    QObject::connect(upload.get(), &QXmppHttpUpload::finished, q, [this]() {
+        // cancelled uploads free their place in the queue, finished transfers are handled when
+        // the network reply has finished
+        schedule();
+        Q_EMIT q->progressChanged();
+    });
+    Q_EMIT q->progressChanged();
+}
+
+void QXmppHttpUploadManagerPrivate::schedule()
+{
+    // slot requests can finish synchronously, they only request another run in that case
+    if (scheduling) {
+        rescheduleRequested = true;
+        return;
+    }
+    scheduling = true;
+
+    do {
+        rescheduleRequested = false;
+
+        // remove cancelled uploads
+        auto isFinished = [](const auto &pending) { return pending->upload->isFinished(); };
+        queued.erase(std::remove_if(queued.begin(), queued.end(), isFinished), queued.end());
+        waiting.erase(std::remove_if(waiting.begin(), waiting.end(), isFinished), waiting.end());
+
+        // start transfers in the order the slots have been received
+        for (auto itr = waiting.begin(); itr != waiting.end();) {
+            if (runningTransfers.value((*itr)->slot.putUrl().host()) < maxUploadsPerHost) {
+                auto pending = std::move(*itr);
+                itr = waiting.erase(itr);
+                startTransfer(std::move(pending));
+            } else {
+                ++itr;
+            }
+        }
+
+        // request slots ahead of the transfers, so transfers can start without waiting for a
+        // round trip
+        while (!queued.empty() && runningSlotRequests + int(waiting.size()) < slotPrefetchCount) {
+            auto pending = std::move(queued.front());
+            queued.pop_front();
+            requestSlot(std::move(pending));
+        }
+    } while (rescheduleRequested);
+
+    scheduling = false;
+}
+
+void QXmppHttpUploadManagerPrivate::requestSlot(std::shared_ptr<PendingUpload> pending)
+{
+    using SlotResult = QXmppUploadRequestManager::SlotResult;
+
+    auto *uploadRequestManager = q->client()->findExtension<QXmppUploadRequestManager>();
+    if (!uploadRequestManager) {
+        pending->upload->d->reportError({ u"QXmppUploadRequestManager has not been added to the client."_s, std::any() });
+        pending->upload->d->reportFinished();
+        return;
+    }
+
+    runningSlotRequests++;
+    uploadRequestManager->requestSlot(pending->filename, pending->fileSize, pending->mimeType, pending->uploadServiceJid)
+        .then(q, [this, pending](SlotResult result) {
+            runningSlotRequests--;
+            const auto &upload = pending->upload;
+
+            // the upload has been cancelled in the meantime
+            if (upload->isFinished()) {
+                schedule();
+                return;
+            }
+
+            if (std::holds_alternative<QXmppError>(result)) {
+                upload->d->reportError(std::get<QXmppError>(std::move(result)));
+                upload->d->reportFinished();
+                return;
+            }
+
+            auto slot = std::get<QXmppHttpUploadSlotIq>(std::move(result));
+            if (slot.getUrl().scheme() != u"https" || slot.putUrl().scheme() != u"https") {
+                auto message = u"The server replied with an insecure non-https url. This is forbidden by XEP-0363."_s;
+                upload->d->reportError(QXmppError { std::move(message), {} });
+                upload->d->reportFinished();
+                return;
+            }
+
+            upload->d->getUrl = slot.getUrl();
+            pending->slot = std::move(slot);
+            waiting.push_back(pending);
+            schedule();
+        });
+}
+
+void QXmppHttpUploadManagerPrivate::startTransfer(std::shared_ptr<PendingUpload> pending)
+{
+    auto upload = pending->upload;
+    auto host = pending->slot.putUrl().host();
+    runningTransfers[host]++;
+
+    QNetworkRequest request(pending->slot.putUrl());
+    const auto headers = pending->slot.putHeaders();
+    for (auto itr = headers.cbegin(); itr != headers.cend(); ++itr) {
+        request.setRawHeader(itr.key().toUtf8(), itr.value().toUtf8());
+    }
+    // if the upload service supports HTTP/2, all uploads to it share one connection
+    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, true);
+
+    auto *reply = netManager->put(request, pending->data.get());
+    pending->data.release()->setParent(reply);
+    upload->d->reply = reply;
+
+    QObject::connect(reply, &QNetworkReply::finished, q, [this, reply, upload, host]() {
+        if (reply->error() == QNetworkReply::NoError) {
+            upload->d->reportFinished();
+        }
+        reply->deleteLater();
+
+        if (--runningTransfers[host] <= 0) {
+            runningTransfers.remove(host);
+        }
+        schedule();
+    });
+
+    QObject::connect(reply, &QNetworkReply::errorOccurred, q,
+                     [upload, reply](QNetworkReply::NetworkError error) {
+                         upload->d->reportError({ reply->errorString(), error });
+                         upload->d->reportFinished();
+                         reply->deleteLater();
+                     });
+
+    QObject::connect(reply, &QNetworkReply::uploadProgress, q, [upload](qint64 sent, qint64 total) {
+        quint64 sentBytes = sent < 0 ? 0 : quint64(sent);
+        quint64 totalBytes = total < 0 ? 0 : quint64(total);
+        upload->d->reportProgress(sentBytes, totalBytes);
+    });
+}
+
 ///
 /// Constructor
 ///
 /// Creates and uses a new network access manager.
 ///
 QXmppHttpUploadManager::QXmppHttpUploadManager()
-    : d(std::make_unique<QXmppHttpUploadManagerPrivate>(new QNetworkAccessManager(this)))
+    : d(std::make_unique<QXmppHttpUploadManagerPrivate>(this, new QNetworkAccessManager(this)))
 {
 }
 
@@ -233,7 +462,7 @@ QXmppHttpUploadManager::QXmppHttpUploadManager()
 /// manager.
 ///
 QXmppHttpUploadManager::QXmppHttpUploadManager(QNetworkAccessManager *netManager)
-    : d(std::make_unique<QXmppHttpUploadManagerPrivate>(netManager))
+    : d(std::make_unique<QXmppHttpUploadManagerPrivate>(this, netManager))
 {
 }
 
@@ -271,8 +500,6 @@ QXmppHttpUploadManager::~QXmppHttpUploadManager() = default;
 ///
 std::shared_ptr<QXmppHttpUpload> QXmppHttpUploadManager::uploadFile(std::unique_ptr<QIODevice> data, const QString &filename, const QMimeType &mimeType, qint64 fileSize, const QString &uploadServiceJid)
 {
-    using SlotResult = QXmppUploadRequestManager::SlotResult;
-
     std::shared_ptr<QXmppHttpUpload> upload(new QXmppHttpUpload);
 
     auto *uploadRequestManager = client()->findExtension<QXmppUploadRequestManager>();
@@ -299,61 +526,19 @@ std::shared_ptr<QXmppHttpUpload> QXmppHttpUploadManager::uploadFile(std::unique_
         }
     }
 
-    auto future = client()->findExtension<QXmppUploadRequestManager>()->requestSlot(filename, fileSize, mimeType, uploadServiceJid);
-    // TODO: rawSourceDevice: could this lead to a memory leak if the "then lambda" is never executed?
-    future.then(this, [this, upload, rawSourceDevice = data.release()](SlotResult result) mutable {
-        // first check whether upload was cancelled in the meantime
-        if (upload->d->cancelled) {
-            upload->d->reportFinished();
-            return;
-        }
-
-        if (std::holds_alternative<QXmppError>(result)) {
-            upload->d->reportError(std::get<QXmppError>(std::move(result)));
-            upload->d->reportFinished();
-        } else {
-            auto slot = std::get<QXmppHttpUploadSlotIq>(std::move(result));
-
-            if (slot.getUrl().scheme() != u"https" || slot.putUrl().scheme() != u"https") {
-                auto message = u"The server replied with an insecure non-https url. This is forbidden by XEP-0363."_s;
-                upload->d->reportError(QXmppError { std::move(message), {} });
-                upload->d->reportFinished();
-                return;
-            }
-
-            upload->d->getUrl = slot.getUrl();
-
-            QNetworkRequest request(slot.putUrl());
-            auto headers = slot.putHeaders();
-            for (auto itr = headers.cbegin(); itr != headers.cend(); ++itr) {
-                request.setRawHeader(itr.key().toUtf8(), itr.value().toUtf8());
-            }
-
-            auto *reply = d->netManager->put(request, rawSourceDevice);
-            rawSourceDevice->setParent(reply);
-            upload->d->reply = reply;
-
-            connect(reply, &QNetworkReply::finished, this, [reply, upload]() {
-                if (reply->error() == QNetworkReply::NoError) {
-                    upload->d->reportFinished();
-                }
-                reply->deleteLater();
-            });
-
-            connect(reply, &QNetworkReply::errorOccurred, this,
-                    [upload, reply](QNetworkReply::NetworkError error) {
-                        upload->d->reportError({ reply->errorString(), error });
-                        upload->d->reportFinished();
-                        reply->deleteLater();
-                    });
-
-            connect(reply, &QNetworkReply::uploadProgress, this, [upload](qint64 sent, qint64 total) {
-                quint64 sentBytes = sent < 0 ? 0 : quint64(sent);
-                quint64 totalBytes = total < 0 ? 0 : quint64(total);
-                upload->d->reportProgress(sentBytes, totalBytes);
-            });
-        }
+    // the upload is queued and started by the scheduler
+    auto pending = std::make_shared<PendingUpload>(PendingUpload {
+        upload,
+        std::move(data),
+        filename,
+        mimeType,
+        fileSize,
+        uploadServiceJid,
+        {},
     });
+    d->track(upload, quint64(fileSize));
+    d->queued.push_back(std::move(pending));
+    d->schedule();
 
     return upload;
 }
@@ -402,3 +587,100 @@ std::shared_ptr<QXmppHttpUpload> QXmppHttpUploadManager::uploadFile(const QFileI
         uploadServiceJid);
     return upload;
 }
+
+///
+/// Returns the maximum number of parallel transfers to one upload host.
+///
+/// \since QXmpp 1.8
+///
+int QXmppHttpUploadManager::maxUploadsPerHost() const
+{
+    return d->maxUploadsPerHost;
+}
+
+///
+/// Sets the maximum number of parallel transfers to one upload host.
+///
+/// The default is 4. Further uploads wait until a transfer has finished.
+///
+/// \since QXmpp 1.8
+///
+void QXmppHttpUploadManager::setMaxUploadsPerHost(int maxUploads)
+{
+    d->maxUploadsPerHost = std::max(1, maxUploads);
+    d->schedule();
+}
+
+///
+/// Returns the number of upload slots that are requested ahead of the transfers.
+///
+/// \since QXmpp 1.8
+///
+int QXmppHttpUploadManager::slotPrefetchCount() const
+{
+    return d->slotPrefetchCount;
+}
+
+///
+/// Sets the number of upload slots that are requested ahead of the transfers.
+///
+/// Slots are only requested while less than \a count uploads are waiting for their slot or for a
+/// free transfer, so not too many slots expire while waiting. The default is 2, at least one slot
+/// is always requested.
+///
+/// \since QXmpp 1.8
+///
+void QXmppHttpUploadManager::setSlotPrefetchCount(int count)
+{
+    d->slotPrefetchCount = std::max(1, count);
+    d->schedule();
+}
+
+///
+/// Returns the progress of all uploads since the manager was idle the last time, as a floating
+/// point number between 0 and 1.
+///
+/// \since QXmpp 1.8
+///
+float QXmppHttpUploadManager::progress() const
+{
+    return calculateProgress(qint64(bytesSent()), qint64(bytesTotal()));
+}
+
+///
+/// Returns the number of bytes sent of all uploads since the manager was idle the last time.
+///
+/// Failed and cancelled uploads are not included.
+///
+/// \since QXmpp 1.8
+///
+quint64 QXmppHttpUploadManager::bytesSent() const
+{
+    quint64 sent = 0;
+    for (const auto &[upload, fileSize] : d->tracked) {
+        if (!upload->isFinished()) {
+            sent += std::min(upload->bytesSent(), fileSize);
+        } else if (std::holds_alternative<QUrl>(*upload->result())) {
+            sent += fileSize;
+        }
+    }
+    return sent;
+}
+
+///
+/// Returns the number of bytes of all uploads since the manager was idle the last time.
+///
+/// Failed and cancelled uploads are not included.
+///
+/// \since QXmpp 1.8
+///
+quint64 QXmppHttpUploadManager::bytesTotal() const
+{
+    quint64 total = 0;
+    for (const auto &[upload, fileSize] : d->tracked) {
+        if (!upload->isFinished() || std::holds_alternative<QUrl>(*upload->result())) {
+            total += fileSize;
+        }
+    }
+    return total;
+}
@@ -42,6 +42,7 @@ public:
 
 private:
     friend class QXmppHttpUploadManager;
+    friend struct QXmppHttpUploadManagerPrivate;
 
     QXmppHttpUpload();
 
@@ -53,6 +54,10 @@ Q_DECLARE_METATYPE(QXmppHttpUpload::Result);
 class QXMPP_EXPORT QXmppHttpUploadManager : public QXmppClientExtension
 {
     Q_OBJECT
+    Q_PROPERTY(float progress READ progress NOTIFY progressChanged)
+    Q_PROPERTY(quint64 bytesSent READ bytesSent NOTIFY progressChanged)
+    Q_PROPERTY(quint64 bytesTotal READ bytesTotal NOTIFY progressChanged)
+
 public:
     QXmppHttpUploadManager();
     explicit QXmppHttpUploadManager(QNetworkAccessManager *netManager);
@@ -61,7 +66,19 @@ public:
     std::shared_ptr<QXmppHttpUpload> uploadFile(std::unique_ptr<QIODevice> data, const QString &filename, const QMimeType &mimeType, qint64 fileSize = -1, const QString &uploadServiceJid = {});
     std::shared_ptr<QXmppHttpUpload> uploadFile(const QFileInfo &fileInfo, const QString &filename = {}, const QString &uploadServiceJid = {});
 
+    int maxUploadsPerHost() const;
+    void setMaxUploadsPerHost(int maxUploads);
+    int slotPrefetchCount() const;
+    void setSlotPrefetchCount(int count);
+
+    float progress() const;
+    quint64 bytesSent() const;
+    quint64 bytesTotal() const;
+    Q_SIGNAL void progressChanged();
+
 private:
+    friend struct QXmppHttpUploadManagerPrivate;
+
     std::unique_ptr<QXmppHttpUploadManagerPrivate> d;
 };
 
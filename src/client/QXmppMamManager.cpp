@@ -11,6 +11,7 @@
 #include "QXmppE2eeExtension.h"
 #include "QXmppMamIq.h"
 #include "QXmppMessage.h"
+#include "QXmppMessageDeduplicator.h"
 #include "QXmppPromise.h"
 #include "QXmppUtils.h"
 #include "QXmppUtils_p.h"
@@ -18,13 +19,24 @@
 #include "Algorithms.h"
 #include "StringLiterals.h"
 
+#include <algorithm>
+#include <deque>
+#include <optional>
 #include <unordered_map>
 
 #include <QDomElement>
+#include <QSet>
 
 using namespace QXmpp;
 using namespace QXmpp::Private;
 
+// Seconds before the end of a sync slice in which messages may be returned by the next slice
+// again. Archives include the boundaries and not all of them compare with sub-second precision.
+constexpr qint64 SYNC_SLICE_OVERLAP = 1;
+// Messages buffered for a sync slice waiting for earlier slices, after which its query is paused
+// until it is committed.
+constexpr size_t SYNC_SLICE_MAX_BUFFERED = 500;
+
 template<typename T>
 auto sum(const T &c)
 {
@@ -34,6 +46,8 @@ auto sum(const T &c)
 struct MamMessage {
     QDomElement element;
     std::optional<QDateTime> delay;
+    // ID of the message in the archive
+    QString id;
 };
 
 enum EncryptedType { Unencrypted,
@@ -76,7 +90,7 @@ std::optional<std::tuple<MamMessage, QString>> parseMamMessageResult(const QDomE
         return {};
     };
 
-    return { { MamMessage { messageElement, parseDelay(forwardedElement) }, queryId } };
+    return { { MamMessage { messageElement, parseDelay(forwardedElement), resultElement.attribute(u"id"_s) }, queryId } };
 }
 
 struct RetrieveRequestState {
@@ -96,13 +110,148 @@ struct RetrieveRequestState {
     }
 };
 
+// parsed message with its archive metadata
+struct ArchivedMessage {
+    QString id;
+    std::optional<QDateTime> delay;
+    // empty while the message is being decrypted
+    std::optional<QXmppMessage> message;
+};
+
+struct MamStreamState {
+    std::function<void(ArchivedMessage &&)> messageHandler;
+    std::function<void(QXmppMamManager::StreamResult &&)> finishHandler;
+    // called before the next page is requested, the stream is paused if it returns false
+    std::function<bool()> continueHandler;
+
+    // query parameters, the result set query is updated for each page
+    QString to;
+    QString node;
+    QString jid;
+    QDateTime start;
+    QDateTime end;
+    QXmppResultSetQuery resultSetQuery;
+
+    // messages of the current page in arrival order
+    std::deque<ArchivedMessage> queue;
+    // number of messages removed from the queue
+    qsizetype delivered = 0;
+    // result IQ of the current page once it has been received
+    std::optional<QXmppMamResultIq> pageResult;
+    // whether the pages are requested from the newest to the oldest
+    bool backwards = false;
+    // ids of the first and last message of all pages
+    QString first;
+    QString last;
+    // whether messages known to the client's deduplicator are skipped
+    bool deduplicate = true;
+    bool paused = false;
+    bool finished = false;
+};
+
+// part of the archive between two points in time that is retrieved by a single stream
+struct MamSyncSlice {
+    QDateTime start;
+    QDateTime end;
+    // ID of the last known message, only set for the first slice
+    QString after;
+    // messages received before all earlier slices have been committed
+    std::vector<ArchivedMessage> messages;
+    // query of the slice while it is running
+    std::weak_ptr<MamStreamState> stream;
+    bool started = false;
+    bool finished = false;
+};
+
+struct MamSyncState {
+    QXmppMamManager::SyncMessageHandler messageHandler;
+    QXmppPromise<QXmppMamManager::SyncResult> promise;
+
+    QString to;
+    QString jid;
+    std::vector<MamSyncSlice> slices;
+    // index of the first slice that has not been committed completely
+    size_t committed = 0;
+    int runningQueries = 0;
+
+    // archive IDs of the messages at the end of the last committed and the current slice to skip
+    // messages at the boundaries that are contained in both
+    QSet<QString> previousIds;
+    QSet<QString> currentIds;
+
+    QXmppMamManager::SyncCheckpoint checkpoint;
+    bool finished = false;
+};
+
 class QXmppMamManagerPrivate
 {
 public:
+    explicit QXmppMamManagerPrivate(QXmppMamManager *q) : q(q) { }
+
+    void startStream(const std::shared_ptr<MamStreamState> &state);
+    void requestPage(const std::shared_ptr<MamStreamState> &state);
+    void handleStreamMessage(const std::shared_ptr<MamStreamState> &state, MamMessage &&message);
+    void deliverMessages(const std::shared_ptr<MamStreamState> &state);
+    bool isDuplicate(const QString &to, const ArchivedMessage &message);
+    void finishPage(const std::shared_ptr<MamStreamState> &state);
+    void resumeStream(const std::shared_ptr<MamStreamState> &state);
+
+    using DecryptResult = QXmppE2eeExtension::MessageDecryptResult;
+    void decryptMessage(QXmppMessage &&message, std::function<void(DecryptResult &&)> &&handler);
+    void startDecryptions();
+
+    void startSyncQueries(const std::shared_ptr<MamSyncState> &state);
+    void cancelSync(const std::shared_ptr<MamSyncState> &state, QXmppError &&error);
+    void commitSyncMessage(const std::shared_ptr<MamSyncState> &state, ArchivedMessage &&message);
+    void advanceSync(const std::shared_ptr<MamSyncState> &state);
+
+    QXmppMamManager *q;
     // std::string because older Qt 5 versions don't add std::hash support for QString
     std::unordered_map<std::string, RetrieveRequestState> ongoingRequests;
+    // streamed queries by the query ID of their current page
+    std::unordered_map<std::string, std::shared_ptr<MamStreamState>> streams;
+
+    // decryption jobs waiting for a free slot
+    std::deque<std::function<void()>> decryptionQueue;
+    int runningDecryptions = 0;
+    int maxParallelDecryptions = 4;
+
+    int maxParallelQueries = 3;
+    std::chrono::seconds syncSliceDuration = std::chrono::hours(24);
 };
 
+// Queues a message for decryption, at most maxParallelDecryptions are decrypted at the same time.
+void QXmppMamManagerPrivate::decryptMessage(QXmppMessage &&message, std::function<void(DecryptResult &&)> &&handler)
+{
+    decryptionQueue.push_back([this, message = std::move(message), handler = std::move(handler)]() mutable {
+        auto *e2eeExt = q->client()->encryptionExtension();
+        if (!e2eeExt) {
+            handler(QXmppError { u"No encryption extension available."_s, {} });
+            return;
+        }
+
+        runningDecryptions++;
+        e2eeExt->decryptMessage(std::move(message)).then(q, [this, handler](DecryptResult &&result) {
+            runningDecryptions--;
+            handler(std::move(result));
+
+            // Continue from the event loop, so that decryptions finishing instantly don't block it
+            // for a whole page.
+            QMetaObject::invokeMethod(q, [this]() { startDecryptions(); }, Qt::QueuedConnection);
+        });
+    });
+    startDecryptions();
+}
+
+void QXmppMamManagerPrivate::startDecryptions()
+{
+    while (runningDecryptions < maxParallelDecryptions && !decryptionQueue.empty()) {
+        auto job = std::move(decryptionQueue.front());
+        decryptionQueue.pop_front();
+        job();
+    }
+}
+
 ///
 /// \struct QXmppMamManager::RetrievedMessages
 ///
@@ -131,13 +280,137 @@ public:
 /// \since QXmpp 1.5
 ///
 
+///
+/// \typedef QXmppMamManager::StreamResult
+///
+/// Contains the result set reply of the last retrieved page or a QXmppError.
+/// QXmppResultSetReply::last() is the ID of the last retrieved message and can
+/// be used to continue streaming later.
+///
+/// \since QXmpp 1.8
+///
+
+///
+/// \struct QXmppMamManager::SyncCheckpoint
+///
+/// \brief Position in the archive up to which messages have been synchronized.
+///
+/// Store the checkpoint reported with each message to resume
+/// synchronizeMessages() after an interruption.
+///
+/// \since QXmpp 1.8
+///
+
+///
+/// \var QXmppMamManager::SyncCheckpoint::stanzaId
+///
+/// ID of the last synchronized message in the archive.
+///
+
+///
+/// \var QXmppMamManager::SyncCheckpoint::stamp
+///
+/// Time the last synchronized message has been archived.
+///
+
+///
+/// \typedef QXmppMamManager::SyncResult
+///
+/// Contains the checkpoint of the last synchronized message or a QXmppError.
+///
+/// \since QXmpp 1.8
+///
+
+///
+/// \typedef QXmppMamManager::SyncMessageHandler
+///
+/// Function called with each synchronized message and the checkpoint after it.
+///
+/// \since QXmpp 1.8
+///
+
 QXmppMamManager::QXmppMamManager()
-    : d(std::make_unique<QXmppMamManagerPrivate>())
+    : d(std::make_unique<QXmppMamManagerPrivate>(this))
 {
 }
 
 QXmppMamManager::~QXmppMamManager() = default;
 
+///
+/// Returns the maximum number of archived messages that are decrypted at the
+/// same time.
+///
+/// \since QXmpp 1.8
+///
+int QXmppMamManager::maxParallelDecryptions() const
+{
+    return d->maxParallelDecryptions;
+}
+
+///
+/// Sets the maximum number of archived messages that are decrypted at the same
+/// time.
+///
+/// Messages are decrypted in the order they have been received. Further
+/// decryptions are started from the event loop, so that long pages don't block
+/// it. Decrypted messages are still reported in archive order.
+///
+/// The default is 4.
+///
+/// \since QXmpp 1.8
+///
+void QXmppMamManager::setMaxParallelDecryptions(int count)
+{
+    d->maxParallelDecryptions = std::max(count, 1);
+    d->startDecryptions();
+}
+
+///
+/// Returns the maximum number of archive queries synchronizeMessages() runs at
+/// the same time.
+///
+/// \since QXmpp 1.8
+///
+int QXmppMamManager::maxParallelQueries() const
+{
+    return d->maxParallelQueries;
+}
+
+///
+/// Sets the maximum number of archive queries synchronizeMessages() runs at the
+/// same time.
+///
+/// Keep this low to not overload the server. The default is 3.
+///
+/// \since QXmpp 1.8
+///
+void QXmppMamManager::setMaxParallelQueries(int count)
+{
+    d->maxParallelQueries = std::max(count, 1);
+}
+
+///
+/// Returns the length of the time slices synchronizeMessages() queries.
+///
+/// \since QXmpp 1.8
+///
+std::chrono::seconds QXmppMamManager::syncSliceDuration() const
+{
+    return d->syncSliceDuration;
+}
+
+///
+/// Sets the length of the time slices synchronizeMessages() queries.
+///
+/// The default is one day.
+///
+/// \since QXmpp 1.8
+///
+void QXmppMamManager::setSyncSliceDuration(std::chrono::seconds duration)
+{
+    d->syncSliceDuration = std::max(duration, std::chrono::seconds(1));
+}
+
 /// \cond
 QStringList QXmppMamManager::discoveryFeatures() const
 {
@@ -155,6 +428,9 @@ bool QXmppMamManager::handleStanza(const QDomElement &element)
             if (itr != d->ongoingRequests.end()) {
                 // future-based API
                 itr->second.messages.append(std::move(message));
+            } else if (auto streamItr = d->streams.find(queryId.toStdString()); streamItr != d->streams.end()) {
+                // streaming API
+                d->handleStreamMessage(streamItr->second, std::move(message));
             } else {
                 // signal-based API
                 Q_EMIT archivedMessageReceived(queryId, parseMamMessage(message, Unencrypted));
@@ -330,7 +606,7 @@ QXmppTask<QXmppMamManager::RetrieveResult> QXmppMamManager::retrieveMessages(con
                     continue;
                 }
 
-                e2eeExt->decryptMessage(parseMamMessage(state.messages.at(i), Encrypted)).then(this, [this, i, queryId](auto result) {
+                d->decryptMessage(parseMamMessage(state.messages.at(i), Encrypted), [this, i, queryId](auto &&result) {
                     auto itr = d->ongoingRequests.find(queryId.toStdString());
                     Q_ASSERT(itr != d->ongoingRequests.end());
 
@@ -369,3 +645,379 @@ QXmppTask<QXmppMamManager::RetrieveResult> QXmppMamManager::retrieveMessages(con
 
     return task;
 }
+
+///
+/// Retrieves archived messages and reports each message as soon as it has been
+/// received.
+///
+/// In contrast to retrieveMessages(), this follows the result set of the
+/// archive across pages until all matching messages have been retrieved. Each
+/// message is parsed (and decrypted if needed) on arrival and passed to
+/// \a messageHandler in archive order, so that only the messages of one page
+/// are held in memory at a time.
+///
+/// The next page is requested only after all messages of the current page have
+/// been handled.
+///
+/// If message deduplication is enabled on the client, messages that have
+/// already been received, e.g. live or in an earlier query, are skipped.
+///
+/// \param messageHandler Function called with each retrieved message.
+/// \param to Optional entity that should be queried. Leave this empty to query
+///           the local archive.
+/// \param node Optional node that should be queried. This is used when querying
+///             a pubsub node.
+/// \param jid Optional JID to filter the results.
+/// \param start Optional start time to filter the results.
+/// \param end Optional end time to filter the results.
+/// \param resultSetQuery Optional Result Set Management query to start from,
+///                       e.g. the ID of the last message of a previous stream as
+///                       \c after. If no maximum is set, pages of 100 messages
+///                       are requested. If \c before is set, the archive is
+///                       paged backwards: pages are reported from the newest
+///                       to the oldest, the messages of a page in archive
+///                       order.
+/// \return Task finished after the last page has been handled.
+///
+/// \since QXmpp 1.8
+///
+QXmppTask<QXmppMamManager::StreamResult> QXmppMamManager::streamMessages(std::function<void(QXmppMessage &&)> &&messageHandler,
+                                                                         const QString &to,
+                                                                         const QString &node,
+                                                                         const QString &jid,
+                                                                         const QDateTime &start,
+                                                                         const QDateTime &end,
+                                                                         const QXmppResultSetQuery &resultSetQuery)
+{
+    QXmppPromise<StreamResult> promise;
+    auto task = promise.task();
+
+    auto state = std::make_shared<MamStreamState>();
+    state->messageHandler = [messageHandler = std::move(messageHandler)](ArchivedMessage &&message) {
+        messageHandler(std::move(*message.message));
+    };
+    state->finishHandler = [promise](StreamResult &&result) mutable {
+        promise.finish(std::move(result));
+    };
+    state->to = to;
+    state->node = node;
+    state->jid = jid;
+    state->start = start;
+    state->end = end;
+    state->resultSetQuery = resultSetQuery;
+
+    d->startStream(state);
+    return task;
+}
+
+void QXmppMamManagerPrivate::startStream(const std::shared_ptr<MamStreamState> &state)
+{
+    if (state->resultSetQuery.max() < 0) {
+        state->resultSetQuery.setMax(100);
+    }
+    state->backwards = !state->resultSetQuery.before().isNull();
+    requestPage(state);
+}
+
+void QXmppMamManagerPrivate::requestPage(const std::shared_ptr<MamStreamState> &state)
+{
+    auto queryIq = buildRequest(state->to, state->node, state->jid, state->start, state->end, state->resultSetQuery);
+    auto queryId = queryIq.queryId().toStdString();
+    streams.insert({ queryId, state });
+
+    q->client()->sendIq(std::move(queryIq)).then(q, [this, state, queryId](QXmppClient::IqResult result) {
+        streams.erase(queryId);
+        if (state->finished) {
+            return;
+        }
+
+        if (auto *error = std::get_if<QXmppError>(&result)) {
+            state->finished = true;
+            state->finishHandler(std::move(*error));
+            return;
+        }
+
+        QXmppMamResultIq iq;
+        iq.parse(std::get<QDomElement>(result));
+        state->pageResult = std::move(iq);
+
+        // finish the page unless messages are still being decrypted
+        deliverMessages(state);
+    });
+}
+
+void QXmppMamManagerPrivate::handleStreamMessage(const std::shared_ptr<MamStreamState> &state, MamMessage &&message)
+{
+    auto *e2eeExt = q->client()->encryptionExtension();
+    if (!e2eeExt || !e2eeExt->isEncrypted(message.element)) {
+        state->queue.push_back({ message.id, message.delay, parseMamMessage(message, Unencrypted) });
+        deliverMessages(state);
+        return;
+    }
+
+    // reserve the position of the message until it is decrypted
+    auto index = state->delivered + qsizetype(state->queue.size());
+    state->queue.push_back({ message.id, message.delay, {} });
+
+    decryptMessage(parseMamMessage(message, Encrypted), [this, state, index, message = std::move(message)](auto &&result) {
+        auto &slot = state->queue.at(index - state->delivered).message;
+        if (std::holds_alternative<QXmppMessage>(result)) {
+            slot = std::get<QXmppMessage>(std::move(result));
+        } else {
+            q->warning(u"Error decrypting message."_s);
+            slot = parseMamMessage(message, Unencrypted);
+        }
+        deliverMessages(state);
+    });
+}
+
+void QXmppMamManagerPrivate::deliverMessages(const std::shared_ptr<MamStreamState> &state)
+{
+    while (!state->queue.empty() && state->queue.front().message.has_value()) {
+        auto message = std::move(state->queue.front());
+        state->queue.pop_front();
+        state->delivered++;
+
+        if (!state->finished && !(state->deduplicate && isDuplicate(state->to, message))) {
+            state->messageHandler(std::move(message));
+        }
+    }
+
+    if (state->queue.empty() && state->pageResult) {
+        finishPage(state);
+    }
+}
+
+bool QXmppMamManagerPrivate::isDuplicate(const QString &to, const ArchivedMessage &message)
+{
+    auto *deduplicator = q->client()->messageDeduplicator();
+    if (!deduplicator) {
+        return false;
+    }
+    const auto archiveJid = to.isEmpty() ? q->client()->configuration().jidBare() : to;
+    return !deduplicator->insertArchived(archiveJid, message.id, *message.message);
+}
+
+void QXmppMamManagerPrivate::finishPage(const std::shared_ptr<MamStreamState> &state)
+{
+    auto reply = state->pageResult->resultSetReply();
+    auto complete = state->pageResult->complete();
+    state->pageResult.reset();
+
+    if (state->finished) {
+        return;
+    }
+
+    const auto cursor = state->backwards ? reply.first() : reply.last();
+    if (!complete && !cursor.isEmpty()) {
+        if (state->backwards) {
+            state->first = cursor;
+            state->resultSetQuery.setBefore(cursor);
+            state->resultSetQuery.setAfter({});
+        } else {
+            state->last = cursor;
+            state->resultSetQuery.setAfter(cursor);
+            state->resultSetQuery.setBefore({});
+        }
+        if (state->continueHandler && !state->continueHandler()) {
+            state->paused = true;
+            return;
+        }
+        requestPage(state);
+        return;
+    }
+
+    if (reply.first().isEmpty()) {
+        reply.setFirst(state->first);
+    }
+    if (reply.last().isEmpty()) {
+        reply.setLast(state->last);
+    }
+    state->finished = true;
+    state->finishHandler(std::move(reply));
+}
+
+void QXmppMamManagerPrivate::resumeStream(const std::shared_ptr<MamStreamState> &state)
+{
+    if (state->paused && !state->finished) {
+        state->paused = false;
+        requestPage(state);
+    }
+}
+
+///
+/// Synchronizes all archived messages since a checkpoint, e.g. after having
+/// been offline for a long time.
+///
+/// The time between the checkpoint and now is split into slices of
+/// syncSliceDuration() which are retrieved by up to maxParallelQueries()
+/// concurrent queries. Messages are passed to \a messageHandler in archive
+/// order together with the checkpoint after them; messages contained in two
+/// adjacent slices are only reported once. Messages of later slices are held
+/// back until all earlier slices have been reported; once a slice holds back
+/// a few hundred messages, its query is paused until then. As with streamMessages(),
+/// messages known to the client's message deduplicator are skipped.
+///
+/// To resume after an interruption, pass the last reported checkpoint.
+///
+/// \param checkpoint Position to start after. If it has no timestamp, the
+///                   archive is retrieved sequentially after its stanza ID.
+///                   If it is empty, the whole archive is retrieved.
+/// \param messageHandler Function called with each synchronized message.
+/// \param to Optional entity that should be queried. Leave this empty to query
+///           the local archive.
+/// \param jid Optional JID to filter the results.
+/// \return Task with the checkpoint of the last message, finished once all
+///         messages have been reported.
+///
+/// \since QXmpp 1.8
+///
+QXmppTask<QXmppMamManager::SyncResult> QXmppMamManager::synchronizeMessages(const SyncCheckpoint &checkpoint,
+                                                                            SyncMessageHandler &&messageHandler,
+                                                                            const QString &to,
+                                                                            const QString &jid)
+{
+    auto state = std::make_shared<MamSyncState>();
+    state->messageHandler = std::move(messageHandler);
+    state->to = to;
+    state->jid = jid;
+    state->checkpoint = checkpoint;
+
+    const auto now = QDateTime::currentDateTimeUtc();
+    const auto sliceSeconds = qint64(d->syncSliceDuration.count());
+    if (checkpoint.stamp.isValid()) {
+        for (auto start = checkpoint.stamp; start < now; start = start.addSecs(sliceSeconds)) {
+            // the last slice is left open, the clock of the server may be ahead of ours
+            const auto end = start.addSecs(sliceSeconds);
+            state->slices.push_back(MamSyncSlice { start, end < now ? end : QDateTime(), {}, {} });
+        }
+    }
+    if (state->slices.empty()) {
+        state->slices.push_back(MamSyncSlice { checkpoint.stamp, {}, {}, {} });
+    }
+    state->slices.front().after = checkpoint.stanzaId;
+    // the checkpoint's message may be contained in the first slice again
+    if (!checkpoint.stanzaId.isEmpty()) {
+        state->previousIds.insert(checkpoint.stanzaId);
+    }
+
+    auto task = state->promise.task();
+    d->startSyncQueries(state);
+    return task;
+}
+
+void QXmppMamManagerPrivate::startSyncQueries(const std::shared_ptr<MamSyncState> &state)
+{
+    for (auto i = state->committed; i < state->slices.size() && state->runningQueries < maxParallelQueries; i++) {
+        auto &slice = state->slices[i];
+        if (slice.started) {
+            continue;
+        }
+        slice.started = true;
+        state->runningQueries++;
+
+        auto stream = std::make_shared<MamStreamState>();
+        stream->messageHandler = [this, state, i](ArchivedMessage &&message) {
+            if (i == state->committed) {
+                commitSyncMessage(state, std::move(message));
+            } else {
+                state->slices[i].messages.push_back(std::move(message));
+            }
+        };
+        // bound the memory used by slices that are held back
+        stream->continueHandler = [state, i]() {
+            return i == state->committed || state->slices[i].messages.size() < SYNC_SLICE_MAX_BUFFERED;
+        };
+        stream->finishHandler = [this, state, i](QXmppMamManager::StreamResult &&result) {
+            state->runningQueries--;
+            if (state->finished) {
+                return;
+            }
+            if (auto *error = std::get_if<QXmppError>(&result)) {
+                cancelSync(state, std::move(*error));
+                return;
+            }
+            state->slices[i].finished = true;
+            advanceSync(state);
+        };
+        // messages are deduplicated when they are committed, buffered messages may be dropped
+        stream->deduplicate = false;
+        stream->to = state->to;
+        stream->jid = state->jid;
+        stream->start = slice.start;
+        stream->end = slice.end;
+        stream->resultSetQuery.setAfter(slice.after);
+        slice.stream = stream;
+
+        startStream(stream);
+    }
+}
+
+// Stops the queries of all slices, their messages can't be reported after an error anymore.
+void QXmppMamManagerPrivate::cancelSync(const std::shared_ptr<MamSyncState> &state, QXmppError &&error)
+{
+    state->finished = true;
+    for (auto &slice : state->slices) {
+        if (auto stream = slice.stream.lock()) {
+            stream->finished = true;
+        }
+        slice.messages.clear();
+    }
+    state->promise.finish(std::move(error));
+}
+
+void QXmppMamManagerPrivate::commitSyncMessage(const std::shared_ptr<MamSyncState> &state, ArchivedMessage &&message)
+{
+    if (state->finished) {
+        return;
+    }
+
+    const auto stamp = message.delay.value_or(message.message->stamp());
+    if (!message.id.isEmpty()) {
+        if (state->previousIds.contains(message.id) || state->currentIds.contains(message.id)) {
+            return;
+        }
+        // only messages at the end of the slice can be contained in the next slice again
+        const auto &sliceEnd = state->slices[state->committed].end;
+        if (sliceEnd.isValid() && stamp.secsTo(sliceEnd) <= SYNC_SLICE_OVERLAP) {
+            state->currentIds.insert(message.id);
+        }
+        state->checkpoint.stanzaId = message.id;
+    }
+    state->checkpoint.stamp = stamp;
+
+    // only remembered once reported, so that a resumed synchronization reports it again
+    if (isDuplicate(state->to, message)) {
+        return;
+    }
+    state->messageHandler(std::move(*message.message), state->checkpoint);
+}
+
+void QXmppMamManagerPrivate::advanceSync(const std::shared_ptr<MamSyncState> &state)
+{
+    while (state->committed < state->slices.size()) {
+        auto &slice = state->slices[state->committed];
+
+        // report messages received while earlier slices were still running
+        auto buffered = std::exchange(slice.messages, {});
+        for (auto &message : buffered) {
+            commitSyncMessage(state, std::move(message));
+        }
+        if (auto stream = slice.stream.lock()) {
+            resumeStream(stream);
+        }
+
+        if (!slice.finished) {
+            break;
+        }
+        state->committed++;
+        state->previousIds = std::exchange(state->currentIds, {});
+    }
+
+    if (state->committed == state->slices.size()) {
+        state->finished = true;
+        state->promise.finish(QXmppMamManager::SyncCheckpoint(state->checkpoint));
+        return;
+    }
+    startSyncQueries(state);
+}
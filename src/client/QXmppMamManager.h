@@ -10,6 +10,8 @@
 #include "QXmppMamIq.h"
 #include "QXmppResultSet.h"
 
+#include <chrono>
+#include <functional>
 #include <variant>
 
 #include <QDateTime>
@@ -46,10 +48,28 @@ public:
     };
 
     using RetrieveResult = std::variant<RetrievedMessages, QXmppError>;
+    using StreamResult = std::variant<QXmppResultSetReply, QXmppError>;
+
+    struct QXMPP_EXPORT SyncCheckpoint {
+        QString stanzaId;
+        QDateTime stamp;
+    };
+
+    using SyncResult = std::variant<SyncCheckpoint, QXmppError>;
+    using SyncMessageHandler = std::function<void(QXmppMessage &&, const SyncCheckpoint &)>;
 
     QXmppMamManager();
     ~QXmppMamManager();
 
+    int maxParallelDecryptions() const;
+    void setMaxParallelDecryptions(int count);
+
+    int maxParallelQueries() const;
+    void setMaxParallelQueries(int count);
+
+    std::chrono::seconds syncSliceDuration() const;
+    void setSyncSliceDuration(std::chrono::seconds duration);
+
     QString retrieveArchivedMessages(const QString &to = QString(),
                                      const QString &node = QString(),
                                      const QString &jid = QString(),
@@ -62,6 +82,17 @@ public:
                                                const QDateTime &start = QDateTime(),
                                                const QDateTime &end = QDateTime(),
                                                const QXmppResultSetQuery &resultSetQuery = QXmppResultSetQuery());
+    QXmppTask<StreamResult> streamMessages(std::function<void(QXmppMessage &&)> &&messageHandler,
+                                           const QString &to = QString(),
+                                           const QString &node = QString(),
+                                           const QString &jid = QString(),
+                                           const QDateTime &start = QDateTime(),
+                                           const QDateTime &end = QDateTime(),
+                                           const QXmppResultSetQuery &resultSetQuery = QXmppResultSetQuery());
+    QXmppTask<SyncResult> synchronizeMessages(const SyncCheckpoint &checkpoint,
+                                              SyncMessageHandler &&messageHandler,
+                                              const QString &to = QString(),
+                                              const QString &jid = QString());
 
     /// \cond
     QStringList discoveryFeatures() const override;
@@ -79,6 +110,8 @@ Q_SIGNALS:
                          bool complete);
 
 private:
+    friend class QXmppMamManagerPrivate;
+
     std::unique_ptr<QXmppMamManagerPrivate> d;
 };
 
@@ -0,0 +1,308 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppMessageDeduplicator.h"
+
+#include "QXmppConstants_p.h"
+#include "QXmppMessage.h"
+#include "QXmppUtils.h"
+#include "QXmppUtils_p.h"
+
+#include "StringLiterals.h"
+
+#include <algorithm>
+#include <list>
+
+#include <QDataStream>
+#include <QDomElement>
+#include <QHash>
+#include <QVarLengthArray>
+
+using namespace QXmpp::Private;
+
+// version of the format written by saveState()
+constexpr quint8 STATE_VERSION = 1;
+
+using Keys = QVarLengthArray<QString, 3>;
+
+static QString stanzaIdKey(const QString &by, const QString &id)
+{
+    return by + u'\x1f' + id;
+}
+
+static QString originIdKey(const QString &from, const QString &originId)
+{
+    return QXmppUtils::jidToBareJid(from) + u'\x1e' + originId;
+}
+
+// Stanza IDs can be added by anyone on the way, only the ones from our own
+// server and from the room or channel a groupchat message comes from are used.
+static bool isTrustedStanzaId(const QString &by, const QString &accountJid, const QString &from, bool groupChat)
+{
+    return by == accountJid || (groupChat && by == QXmppUtils::jidToBareJid(from));
+}
+
+static Keys messageKeys(const QXmppMessage &message, const QString &accountJid)
+{
+    Keys keys;
+    const auto groupChat = message.type() == QXmppMessage::GroupChat;
+    const auto stanzaIds = message.stanzaIds();
+    for (const auto &stanzaId : stanzaIds) {
+        if (!stanzaId.id.isEmpty() && isTrustedStanzaId(stanzaId.by, accountJid, message.from(), groupChat)) {
+            keys.append(stanzaIdKey(stanzaId.by, stanzaId.id));
+        }
+    }
+    if (const auto originId = message.originId(); !originId.isEmpty()) {
+        keys.append(originIdKey(message.from(), originId));
+    }
+    return keys;
+}
+
+static Keys messageKeys(const QDomElement &element, const QString &accountJid)
+{
+    Keys keys;
+    const auto from = element.attribute(u"from"_s);
+    const auto groupChat = element.attribute(u"type"_s) == u"groupchat";
+    for (const auto &child : iterChildElements(element, {}, ns_sid)) {
+        if (child.tagName() == u"stanza-id") {
+            auto id = child.attribute(u"id"_s);
+            auto by = child.attribute(u"by"_s);
+            if (!id.isEmpty() && isTrustedStanzaId(by, accountJid, from, groupChat)) {
+                keys.append(stanzaIdKey(by, id));
+            }
+        } else if (child.tagName() == u"origin-id") {
+            if (auto id = child.attribute(u"id"_s); !id.isEmpty()) {
+                keys.append(originIdKey(from, id));
+            }
+        }
+    }
+    return keys;
+}
+
+class QXmppMessageDeduplicatorPrivate
+{
+public:
+    bool containsAny(const Keys &keys) const;
+    bool insert(const Keys &keys);
+    void insertKey(const QString &key);
+    void evict();
+
+    qsizetype capacity;
+    // keys in the order they have been seen last, least recently seen first
+    std::list<QString> order;
+    QHash<QString, std::list<QString>::iterator> index;
+};
+
+bool QXmppMessageDeduplicatorPrivate::containsAny(const Keys &keys) const
+{
+    return std::any_of(keys.begin(), keys.end(), [this](const auto &key) {
+        return index.contains(key);
+    });
+}
+
+bool QXmppMessageDeduplicatorPrivate::insert(const Keys &keys)
+{
+    const auto duplicate = containsAny(keys);
+    for (const auto &key : keys) {
+        insertKey(key);
+    }
+    evict();
+    return !duplicate;
+}
+
+void QXmppMessageDeduplicatorPrivate::insertKey(const QString &key)
+{
+    if (auto itr = index.constFind(key); itr != index.constEnd()) {
+        // mark as recently seen
+        order.splice(order.end(), order, *itr);
+    } else {
+        index.insert(key, order.insert(order.end(), key));
+    }
+}
+
+void QXmppMessageDeduplicatorPrivate::evict()
+{
+    while (qsizetype(order.size()) > capacity) {
+        index.remove(order.front());
+        order.pop_front();
+    }
+}
+
+///
+/// \class QXmppMessageDeduplicator
+///
+/// \brief The QXmppMessageDeduplicator class detects messages that have
+/// already been received.
+///
+/// Messages can be received multiple times, e.g. live, as carbon copy and via
+/// \xep{0313, Message Archive Management}. The deduplicator remembers the
+/// \xep{0359, Unique and Stable Stanza IDs} of received messages: stanza IDs
+/// together with the JID of the archive that assigned them and, as a
+/// fallback, origin IDs together with the bare JID of the sender. Messages
+/// without any of these IDs are never considered duplicates.
+///
+/// Only stanza IDs assigned by the account's server, i.e. with the account's
+/// bare JID as \c by attribute, or, for groupchat messages, by the MUC room or
+/// MIX channel the message comes from are used. Other stanza IDs could have
+/// been added by the sender to suppress later messages.
+///
+/// The number of remembered IDs is limited by the capacity; the IDs that have
+/// not been seen for the longest time are forgotten first.
+///
+/// The deduplicator of a QXmppClient is enabled via
+/// QXmppClient::setMessageDeduplicationEnabled().
+///
+/// \since QXmpp 1.8
+///
+
+///
+/// Constructs a deduplicator remembering up to \a capacity IDs.
+///
+QXmppMessageDeduplicator::QXmppMessageDeduplicator(qsizetype capacity)
+    : d(std::make_unique<QXmppMessageDeduplicatorPrivate>())
+{
+    d->capacity = capacity;
+}
+
+QXmppMessageDeduplicator::~QXmppMessageDeduplicator() = default;
+
+///
+/// Returns the maximum number of remembered IDs.
+///
+qsizetype QXmppMessageDeduplicator::capacity() const
+{
+    return d->capacity;
+}
+
+///
+/// Sets the maximum number of remembered IDs.
+///
+/// If more IDs are remembered, the least recently seen ones are forgotten.
+///
+void QXmppMessageDeduplicator::setCapacity(qsizetype capacity)
+{
+    d->capacity = capacity;
+    d->evict();
+}
+
+///
+/// Returns the number of remembered IDs.
+///
+qsizetype QXmppMessageDeduplicator::size() const
+{
+    return qsizetype(d->order.size());
+}
+
+///
+/// Returns whether any ID of \a message is known, without remembering it.
+///
+/// \a accountJid is the bare JID of the account that received the message.
+///
+bool QXmppMessageDeduplicator::contains(const QXmppMessage &message, const QString &accountJid) const
+{
+    return d->containsAny(messageKeys(message, accountJid));
+}
+
+///
+/// Remembers the IDs of \a message received by the account with the bare JID
+/// \a accountJid.
+///
+/// \return False if the message is a duplicate, i.e. any of its IDs was
+///         already known.
+///
+bool QXmppMessageDeduplicator::insert(const QXmppMessage &message, const QString &accountJid)
+{
+    return d->insert(messageKeys(message, accountJid));
+}
+
+///
+/// Remembers the IDs of the unparsed message \a messageElement received by the
+/// account with the bare JID \a accountJid.
+///
+/// This only looks at the ID elements of the message and is used before a
+/// received message is parsed.
+///
+/// \return False if the message is a duplicate, i.e. any of its IDs was
+///         already known.
+///
+bool QXmppMessageDeduplicator::insert(const QDomElement &messageElement, const QString &accountJid)
+{
+    return d->insert(messageKeys(messageElement, accountJid));
+}
+
+///
+/// Remembers the IDs of a \a message retrieved from the archive \a archiveJid
+/// with the archive ID \a archiveId.
+///
+/// The archive ID is the stanza ID the archive has assigned to the message,
+/// so a message received live and later from the archive is detected.
+///
+/// \return False if the message is a duplicate, i.e. any of its IDs was
+///         already known.
+///
+bool QXmppMessageDeduplicator::insertArchived(const QString &archiveJid, const QString &archiveId, const QXmppMessage &message)
+{
+    auto keys = messageKeys(message, archiveJid);
+    if (!archiveId.isEmpty()) {
+        keys.append(stanzaIdKey(archiveJid, archiveId));
+    }
+    return d->insert(keys);
+}
+
+///
+/// Forgets all IDs.
+///
+void QXmppMessageDeduplicator::clear()
+{
+    d->index.clear();
+    d->order.clear();
+}
+
+///
+/// Serializes the remembered IDs, e.g. to store them between application
+/// restarts.
+///
+/// \sa restoreState()
+///
+QByteArray QXmppMessageDeduplicator::saveState() const
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << STATE_VERSION << quint32(d->order.size());
+    for (const auto &key : d->order) {
+        stream << key;
+    }
+    return data;
+}
+
+///
+/// Replaces the remembered IDs by the ones serialized with saveState().
+///
+/// \return False if \a state could not be read, the remembered IDs are
+///         cleared in that case.
+///
+bool QXmppMessageDeduplicator::restoreState(const QByteArray &state)
+{
+    clear();
+
+    QDataStream stream(state);
+    quint8 version = 0;
+    quint32 count = 0;
+    stream >> version >> count;
+    if (stream.status() != QDataStream::Ok || version != STATE_VERSION) {
+        return false;
+    }
+
+    for (quint32 i = 0; i < count; i++) {
+        QString key;
+        stream >> key;
+        if (stream.status() != QDataStream::Ok) {
+            clear();
+            return false;
+        }
+        d->insertKey(key);
+    }
+    d->evict();
+    return true;
+}
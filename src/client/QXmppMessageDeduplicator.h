@@ -0,0 +1,41 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPMESSAGEDEDUPLICATOR_H
+#define QXMPPMESSAGEDEDUPLICATOR_H
+
+#include "QXmppGlobal.h"
+
+#include <memory>
+
+#include <QString>
+
+class QDomElement;
+class QXmppMessage;
+class QXmppMessageDeduplicatorPrivate;
+
+class QXMPP_EXPORT QXmppMessageDeduplicator
+{
+public:
+    explicit QXmppMessageDeduplicator(qsizetype capacity = 10000);
+    ~QXmppMessageDeduplicator();
+
+    qsizetype capacity() const;
+    void setCapacity(qsizetype capacity);
+    qsizetype size() const;
+
+    bool contains(const QXmppMessage &message, const QString &accountJid) const;
+    bool insert(const QXmppMessage &message, const QString &accountJid);
+    bool insert(const QDomElement &messageElement, const QString &accountJid);
+    bool insertArchived(const QString &archiveJid, const QString &archiveId, const QXmppMessage &message);
+    void clear();
+
+    QByteArray saveState() const;
+    bool restoreState(const QByteArray &state);
+
+private:
+    const std::unique_ptr<QXmppMessageDeduplicatorPrivate> d;
+};
+
+#endif  // QXMPPMESSAGEDEDUPLICATOR_H
@@ -13,12 +13,216 @@
 #include "QXmppUtils.h"
 
 #include <QDomElement>
+#include <QHash>
+#include <QTimer>
 
+#include <algorithm>
+#include <utility>
+
+using namespace std::chrono_literals;
+
+struct PendingReceipt {
+    QString id;
+    std::optional<QXmppE2eeMetadata> e2eeMetadata;
+};
+
+struct PendingMarker {
+    QString id;
+    QString thread;
+    std::optional<QXmppE2eeMetadata> e2eeMetadata;
+    // sent to a room, the ID is the room's stanza ID then
+    bool groupChat = false;
+};
+
+// receipts and chat markers collected for one peer
+struct PendingPeer {
+    QVector<PendingReceipt> receipts;
+    // latest message that requested a receipt
+    std::optional<PendingMarker> received;
+    std::optional<PendingMarker> displayed;
+    // whether all messages that requested a receipt are markable
+    bool markable = true;
+};
+
+class QXmppMessageReceiptManagerPrivate
+{
+public:
+    PendingPeer &pendingPeer(const QString &jid);
+
+    std::chrono::milliseconds batchInterval = 0ms;
+    QTimer *timer = nullptr;
+    // peers in the order of their first pending receipt or marker
+    QStringList peerOrder;
+    QHash<QString, PendingPeer> peers;
+};
+
+PendingPeer &QXmppMessageReceiptManagerPrivate::pendingPeer(const QString &jid)
+{
+    if (!peers.contains(jid)) {
+        peerOrder.append(jid);
+    }
+    if (!timer->isActive()) {
+        timer->start(batchInterval);
+    }
+    return peers[jid];
+}
+
+static QXmppMessage receiptMessage(const QString &to, const QString &id)
+{
+    QXmppMessage receipt;
+    receipt.setTo(to);
+    receipt.setReceiptId(id);
+
+    // Advise the server to store the receipt even if the message has no body.
+    receipt.addHint(QXmppMessage::Store);
+    return receipt;
+}
+
+static QXmppMessage markerMessage(const QString &to, QXmppMessage::Marker marker, const PendingMarker &marked)
+{
+    QXmppMessage message;
+    message.setTo(to);
+    if (marked.groupChat) {
+        message.setType(QXmppMessage::GroupChat);
+    }
+    message.setMarker(marker);
+    message.setMarkerId(marked.id);
+    message.setMarkedThread(marked.thread);
+    message.addHint(QXmppMessage::Store);
+    return message;
+}
+
+///
 /// Constructs a QXmppMessageReceiptManager to handle incoming and outgoing
 /// message delivery receipts.
+///
 QXmppMessageReceiptManager::QXmppMessageReceiptManager()
-    : QXmppClientExtension()
+    : QXmppClientExtension(),
+      d(std::make_unique<QXmppMessageReceiptManagerPrivate>())
 {
+    d->timer = new QTimer(this);
+    d->timer->setSingleShot(true);
+    connect(d->timer, &QTimer::timeout, this, &QXmppMessageReceiptManager::sendPendingReceipts);
+}
+
+QXmppMessageReceiptManager::~QXmppMessageReceiptManager() = default;
+
+///
+/// Returns the time during which outgoing receipts and chat markers are
+/// collected before they are sent.
+///
+/// \since QXmpp 1.8
+///
+std::chrono::milliseconds QXmppMessageReceiptManager::batchInterval() const
+{
+    return d->batchInterval;
+}
+
+///
+/// Sets the time during which outgoing receipts and chat markers are collected
+/// before they are sent.
+///
+/// With a batch interval, the receipts for all messages received from a peer
+/// within the interval are sent together. If all of these messages are
+/// markable as defined in \xep{0333, Chat Markers}, only a single chat marker
+/// (and receipt) for the latest message is sent, because a marker also
+/// acknowledges all earlier messages. Otherwise all receipts are sent at once.
+/// Groupchat messages never get received markers.
+///
+/// Peers doing the same only send a receipt for their latest message, so
+/// messageDelivered() is only emitted for that message. It implies that all
+/// earlier messages to the peer have been delivered as well.
+///
+/// By default the interval is zero and receipts are sent immediately. Setting
+/// the interval to zero sends all pending receipts.
+///
+/// \since QXmpp 1.8
+///
+void QXmppMessageReceiptManager::setBatchInterval(std::chrono::milliseconds interval)
+{
+    d->batchInterval = interval;
+    if (interval <= 0ms) {
+        sendPendingReceipts();
+    }
+}
+
+///
+/// Sends a \xep{0333, Chat Markers} displayed marker for \a message.
+///
+/// Nothing is sent if the message is not markable. With a batchInterval(),
+/// the marker is collected with the other pending receipts of the peer and
+/// replaces an earlier displayed marker.
+///
+/// For groupchat messages, the marker is sent to the room and references the
+/// stanza ID assigned by the room. Nothing is sent if the message has none.
+///
+/// \since QXmpp 1.8
+///
+void QXmppMessageReceiptManager::sendDisplayedMarker(const QXmppMessage &message)
+{
+    if (!message.isMarkable() || message.from().isEmpty()) {
+        return;
+    }
+
+    auto to = message.from();
+    PendingMarker marker { message.id(), message.thread(), message.e2eeMetadata() };
+    if (message.type() == QXmppMessage::GroupChat) {
+        to = QXmppUtils::jidToBareJid(to);
+        const auto stanzaIds = message.stanzaIds();
+        const auto roomStanzaId = std::find_if(stanzaIds.cbegin(), stanzaIds.cend(), [&](const QXmppStanzaId &stanzaId) {
+            return stanzaId.by == to;
+        });
+        marker.id = roomStanzaId != stanzaIds.cend() ? roomStanzaId->id : QString();
+        marker.groupChat = true;
+    }
+    if (marker.id.isEmpty()) {
+        return;
+    }
+
+    if (d->batchInterval <= 0ms) {
+        client()->reply(markerMessage(to, QXmppMessage::Displayed, marker), marker.e2eeMetadata);
+        return;
+    }
+    d->pendingPeer(to).displayed = std::move(marker);
+}
+
+///
+/// Sends all receipts and chat markers collected during the batchInterval().
+///
+/// \since QXmpp 1.8
+///
+void QXmppMessageReceiptManager::sendPendingReceipts()
+{
+    d->timer->stop();
+    const auto peerOrder = std::exchange(d->peerOrder, {});
+    auto peers = std::exchange(d->peers, {});
+
+    // all stanzas are written at once and leave in as few socket writes as possible
+    for (const auto &jid : peerOrder) {
+        const auto &peer = peers[jid];
+
+        if (peer.markable && peer.received) {
+            // a chat marker also acknowledges all earlier messages
+            const auto &latest = *peer.received;
+            const auto displayedLatest = peer.displayed && peer.displayed->id == latest.id;
+
+            auto marker = markerMessage(jid, displayedLatest ? QXmppMessage::Displayed : QXmppMessage::Received, latest);
+            marker.setReceiptId(latest.id);
+            client()->reply(std::move(marker), latest.e2eeMetadata);
+
+            if (peer.displayed && !displayedLatest) {
+                client()->reply(markerMessage(jid, QXmppMessage::Displayed, *peer.displayed), peer.displayed->e2eeMetadata);
+            }
+            continue;
+        }
+
+        for (const auto &receipt : peer.receipts) {
+            client()->reply(receiptMessage(jid, receipt.id), receipt.e2eeMetadata);
+        }
+        if (peer.displayed) {
+            client()->reply(markerMessage(jid, QXmppMessage::Displayed, *peer.displayed), peer.displayed->e2eeMetadata);
+        }
+    }
 }
 
 /// \cond
@@ -44,14 +248,19 @@ bool QXmppMessageReceiptManager::handleMessage(const QXmppMessage &message)
 
     // If requested, send a receipt.
     if (message.isReceiptRequested() && !message.from().isEmpty() && !message.id().isEmpty()) {
-        QXmppMessage receipt;
-        receipt.setTo(message.from());
-        receipt.setReceiptId(message.id());
-
-        // Advise the server to store the receipt even if the message has no body.
-        receipt.addHint(QXmppMessage::Store);
+        if (d->batchInterval <= 0ms) {
+            client()->reply(receiptMessage(message.from(), message.id()), message.e2eeMetadata());
+            return false;
+        }
 
-        client()->reply(std::move(receipt), message.e2eeMetadata());
+        auto &peer = d->pendingPeer(message.from());
+        peer.receipts.append({ message.id(), message.e2eeMetadata() });
+        // received markers are not used in groupchats
+        if (message.isMarkable() && message.type() != QXmppMessage::GroupChat) {
+            peer.received = PendingMarker { message.id(), message.thread(), message.e2eeMetadata() };
+        } else {
+            peer.markable = false;
+        }
     }
 
     // Continue processing.
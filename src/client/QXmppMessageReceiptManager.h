@@ -9,6 +9,11 @@
 #include "QXmppClientExtension.h"
 #include "QXmppMessageHandler.h"
 
+#include <chrono>
+#include <memory>
+
+class QXmppMessageReceiptManagerPrivate;
+
 ///
 /// \brief The QXmppMessageReceiptManager class makes it possible to
 /// send and receive message delivery receipts as defined in
@@ -21,6 +26,13 @@ class QXMPP_EXPORT QXmppMessageReceiptManager : public QXmppClientExtension, pub
     Q_OBJECT
 public:
     QXmppMessageReceiptManager();
+    ~QXmppMessageReceiptManager() override;
+
+    std::chrono::milliseconds batchInterval() const;
+    void setBatchInterval(std::chrono::milliseconds interval);
+
+    void sendDisplayedMarker(const QXmppMessage &message);
+    void sendPendingReceipts();
 
     /// \cond
     QStringList discoveryFeatures() const override;
@@ -31,7 +43,14 @@ Q_SIGNALS:
     /// This signal is emitted when receipt for the message with the
     /// given id is received. The id could be previously obtained by
     /// calling QXmppMessage::id().
+    ///
+    /// Peers that send \xep{0333, Chat Markers} may only acknowledge their
+    /// latest received message. The signal is only emitted for that id, all
+    /// earlier messages sent to \a jid should be treated as delivered as well.
     void messageDelivered(const QString &jid, const QString &id);
+
+private:
+    const std::unique_ptr<QXmppMessageReceiptManagerPrivate> d;
 };
 
 #endif  // QXMPPMESSAGERECEIPTMANAGER_H
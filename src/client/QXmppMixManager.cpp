@@ -24,14 +24,34 @@
 
 using namespace QXmpp::Private;
 
+namespace QXmpp::Private {
+
+// cached nodes of a channel, unset until they have been requested
+struct MixChannelCache {
+    // participants by their participant IDs
+    std::optional<QHash<QString, QXmppMixParticipantItem>> participants;
+    std::optional<QXmppMixInfoItem> information;
+    std::optional<QXmppMixConfigItem> configuration;
+};
+
+}  // namespace QXmpp::Private
+
 class QXmppMixManagerPrivate
 {
 public:
+    MixChannelCache *channelCache(const QString &channelJid)
+    {
+        auto itr = channelCaches.find(channelJid);
+        return itr == channelCaches.end() ? nullptr : &*itr;
+    }
+
     QXmppPubSubManager *pubSubManager = nullptr;
     QXmppDiscoveryManager *discoveryManager = nullptr;
     QXmppMixManager::Support participantSupport;
     QXmppMixManager::Support messageArchivingSupport;
     QList<QXmppMixManager::Service> services;
+    // channels whose nodes are cached
+    QHash<QString, MixChannelCache> channelCaches;
 };
 
 ///
@@ -486,8 +506,16 @@ QXmppTask<QXmppMixManager::ChannelNodeResult> QXmppMixManager::requestChannelNod
 ///
 QXmppTask<QXmppMixManager::ConfigurationResult> QXmppMixManager::requestChannelConfiguration(const QString &channelJid)
 {
-    return chainMapSuccess(d->pubSubManager->requestItems<QXmppMixConfigItem>(channelJid, ns_mix_node_config.toString()), this, [](QXmppPubSubManager::Items<QXmppMixConfigItem> &&items) {
-        return items.items.takeFirst();
+    if (auto configuration = cachedChannelConfiguration(channelJid)) {
+        return makeReadyTask(ConfigurationResult(std::move(*configuration)));
+    }
+
+    return chainMapSuccess(d->pubSubManager->requestItems<QXmppMixConfigItem>(channelJid, ns_mix_node_config.toString()), this, [this, channelJid](QXmppPubSubManager::Items<QXmppMixConfigItem> &&items) {
+        auto configuration = items.items.takeFirst();
+        if (auto *cache = d->channelCache(channelJid)) {
+            cache->configuration = configuration;
+        }
+        return configuration;
     });
 }
 
@@ -527,8 +555,16 @@ QXmppTask<QXmppClient::EmptyResult> QXmppMixManager::updateChannelConfiguration(
 ///
 QXmppTask<QXmppMixManager::InformationResult> QXmppMixManager::requestChannelInformation(const QString &channelJid)
 {
-    return chainMapSuccess(d->pubSubManager->requestItems<QXmppMixInfoItem>(channelJid, ns_mix_node_info.toString()), this, [](QXmppPubSubManager::Items<QXmppMixInfoItem> &&items) {
-        return items.items.takeFirst();
+    if (auto information = cachedChannelInformation(channelJid)) {
+        return makeReadyTask(InformationResult(std::move(*information)));
+    }
+
+    return chainMapSuccess(d->pubSubManager->requestItems<QXmppMixInfoItem>(channelJid, ns_mix_node_info.toString()), this, [this, channelJid](QXmppPubSubManager::Items<QXmppMixInfoItem> &&items) {
+        auto information = items.items.takeFirst();
+        if (auto *cache = d->channelCache(channelJid)) {
+            cache->information = information;
+        }
+        return information;
     });
 }
 
@@ -888,7 +924,19 @@ QXmppTask<QXmppClient::EmptyResult> QXmppMixManager::unbanAllJids(const QString
 ///
 QXmppTask<QXmppMixManager::ParticipantResult> QXmppMixManager::requestParticipants(const QString &channelJid)
 {
-    return chainMapSuccess(d->pubSubManager->requestItems<QXmppMixParticipantItem>(channelJid, ns_mix_node_participants.toString()), this, [](QXmppPubSubManager::Items<QXmppMixParticipantItem> &&items) {
+    if (auto participants = cachedParticipants(channelJid)) {
+        return makeReadyTask(ParticipantResult(std::move(*participants)));
+    }
+
+    return chainMapSuccess(d->pubSubManager->requestItems<QXmppMixParticipantItem>(channelJid, ns_mix_node_participants.toString()), this, [this, channelJid](QXmppPubSubManager::Items<QXmppMixParticipantItem> &&items) {
+        if (auto *cache = d->channelCache(channelJid)) {
+            QHash<QString, QXmppMixParticipantItem> participants;
+            participants.reserve(items.items.size());
+            for (const auto &item : std::as_const(items.items)) {
+                participants.insert(item.id(), item);
+            }
+            cache->participants = std::move(participants);
+        }
         return items.items;
     });
 }
@@ -926,7 +974,13 @@ QXmppTask<QXmppClient::EmptyResult> QXmppMixManager::leaveChannel(const QString
     iq.setActionType(QXmppMixIq::ClientLeave);
     iq.setChannelJid(channelJid);
 
-    return client()->sendGenericIq(std::move(iq));
+    // Updates are not received anymore after leaving.
+    return chain<QXmppClient::EmptyResult>(client()->sendGenericIq(std::move(iq)), this, [this, channelJid](QXmppClient::EmptyResult &&result) {
+        if (std::holds_alternative<QXmpp::Success>(result)) {
+            d->channelCaches.remove(channelJid);
+        }
+        return std::move(result);
+    });
 }
 
 ///
@@ -955,6 +1009,121 @@ QXmppTask<QXmppClient::EmptyResult> QXmppMixManager::deleteChannel(const QString
 /// \param channelJid JID of the deleted channel
 ///
 
+///
+/// Enables or disables caching the participants, information and configuration of a MIX channel.
+///
+/// The nodes are cached once they have been requested via requestParticipants(),
+/// requestChannelInformation() or requestChannelConfiguration(). Afterwards, those methods return
+/// the cached data without network traffic. The cache is kept up to date by the event
+/// notifications of the nodes the user is subscribed to (see joinChannel() and
+/// updateSubscriptions()). Only enable the cache for nodes the user is subscribed to.
+///
+/// The cache of a channel is removed when the channel is left and its content is reset when the
+/// stream could not be resumed.
+///
+/// \param channelJid JID of the channel
+/// \param enabled whether the channel should be cached
+///
+/// \since QXmpp 1.8
+///
+void QXmppMixManager::setChannelCacheEnabled(const QString &channelJid, bool enabled)
+{
+    if (enabled) {
+        d->channelCaches[channelJid];
+    } else {
+        d->channelCaches.remove(channelJid);
+    }
+}
+
+///
+/// Returns whether a MIX channel is cached.
+///
+/// \param channelJid JID of the channel
+///
+/// \since QXmpp 1.8
+///
+bool QXmppMixManager::isChannelCacheEnabled(const QString &channelJid) const
+{
+    return d->channelCaches.contains(channelJid);
+}
+
+///
+/// Returns the cached participants of a MIX channel.
+///
+/// The participants are sorted by their participant IDs.
+///
+/// \param channelJid JID of the channel
+///
+/// \return the participants or nothing if they are not cached
+///
+/// \since QXmpp 1.8
+///
+std::optional<QVector<QXmppMixParticipantItem>> QXmppMixManager::cachedParticipants(const QString &channelJid) const
+{
+    if (auto *cache = d->channelCache(channelJid); cache && cache->participants) {
+        QVector<QXmppMixParticipantItem> participants(cache->participants->cbegin(), cache->participants->cend());
+        std::sort(participants.begin(), participants.end(), [](const auto &a, const auto &b) {
+            return a.id() < b.id();
+        });
+        return participants;
+    }
+    return {};
+}
+
+///
+/// Returns a cached participant of a MIX channel.
+///
+/// \param channelJid JID of the channel
+/// \param participantId ID of the participant
+///
+/// \return the participant or nothing if it is not cached
+///
+/// \since QXmpp 1.8
+///
+std::optional<QXmppMixParticipantItem> QXmppMixManager::cachedParticipant(const QString &channelJid, const QString &participantId) const
+{
+    if (auto *cache = d->channelCache(channelJid); cache && cache->participants) {
+        if (auto itr = cache->participants->constFind(participantId); itr != cache->participants->cend()) {
+            return *itr;
+        }
+    }
+    return {};
+}
+
+///
+/// Returns the cached information of a MIX channel.
+///
+/// \param channelJid JID of the channel
+///
+/// \return the information or nothing if it is not cached
+///
+/// \since QXmpp 1.8
+///
+std::optional<QXmppMixInfoItem> QXmppMixManager::cachedChannelInformation(const QString &channelJid) const
+{
+    if (auto *cache = d->channelCache(channelJid)) {
+        return cache->information;
+    }
+    return {};
+}
+
+///
+/// Returns the cached configuration of a MIX channel.
+///
+/// \param channelJid JID of the channel
+///
+/// \return the configuration or nothing if it is not cached
+///
+/// \since QXmpp 1.8
+///
+std::optional<QXmppMixConfigItem> QXmppMixManager::cachedChannelConfiguration(const QString &channelJid) const
+{
+    if (auto *cache = d->channelCache(channelJid)) {
+        return cache->configuration;
+    }
+    return {};
+}
+
 /// \cond
 void QXmppMixManager::onRegistered(QXmppClient *client)
 {
@@ -982,6 +1151,11 @@ void QXmppMixManager::onUnregistered(QXmppClient *client)
 
 bool QXmppMixManager::handlePubSubEvent(const QDomElement &element, const QString &pubSubService, const QString &nodeName)
 {
+    // update the cache before the signals are emitted
+    if (d->channelCaches.contains(pubSubService)) {
+        updateChannelCache(element, pubSubService, nodeName);
+    }
+
     if (nodeName == ns_mix_node_allowed && QXmppPubSubEvent<QXmppPubSubBaseItem>::isPubSubEvent(element)) {
         QXmppPubSubEvent<QXmppPubSubBaseItem> event;
         event.parse(element);
@@ -1354,4 +1528,69 @@ void QXmppMixManager::resetCachedData()
     setParticipantSupport(QXmppMixManager::Support::Unknown);
     setMessageArchivingSupport(QXmppMixManager::Support::Unknown);
     removeServices();
+
+    // updates may have been missed
+    for (auto &cache : d->channelCaches) {
+        cache = {};
+    }
+}
+
+///
+/// Updates the cache of a channel by an event notification of one of its nodes.
+///
+/// \param element event notification
+/// \param channelJid JID of the channel
+/// \param nodeName node of the channel
+///
+void QXmppMixManager::updateChannelCache(const QDomElement &element, const QString &channelJid, const QString &nodeName)
+{
+    auto *cache = d->channelCache(channelJid);
+
+    if (nodeName == ns_mix_node_participants && QXmppPubSubEvent<QXmppMixParticipantItem>::isPubSubEvent(element)) {
+        if (!cache->participants) {
+            return;
+        }
+
+        QXmppPubSubEvent<QXmppMixParticipantItem> event;
+        event.parse(element);
+
+        switch (event.eventType()) {
+        case QXmppPubSubEventBase::Items: {
+            const auto items = event.items();
+            for (const auto &item : items) {
+                cache->participants->insert(item.id(), item);
+            }
+            break;
+        }
+        case QXmppPubSubEventBase::Retract: {
+            const auto ids = event.retractIds();
+            for (const auto &id : ids) {
+                cache->participants->remove(id);
+            }
+            break;
+        }
+        // The channel is deleted.
+        case QXmppPubSubEventBase::Purge:
+        case QXmppPubSubEventBase::Delete:
+            *cache = {};
+            break;
+        case QXmppPubSubEventBase::Configuration:
+        case QXmppPubSubEventBase::Subscription:
+            break;
+        }
+    } else if (nodeName == ns_mix_node_info && QXmppPubSubEvent<QXmppMixInfoItem>::isPubSubEvent(element)) {
+        QXmppPubSubEvent<QXmppMixInfoItem> event;
+        event.parse(element);
+
+        if (event.eventType() == QXmppPubSubEventBase::Items && !event.items().isEmpty()) {
+            cache->information = event.items().constFirst();
+        }
+    } else if (nodeName == ns_mix_node_config && QXmppPubSubEvent<QXmppMixConfigItem>::isPubSubEvent(element)) {
+        QXmppPubSubEvent<QXmppMixConfigItem> event;
+        event.parse(element);
+
+        if (event.eventType() == QXmppPubSubEventBase::Items && !event.items().isEmpty()) {
+            cache->configuration = event.items().constFirst();
+        }
+    }
 }
@@ -130,6 +130,13 @@ public:
     QXmppTask<QXmppClient::EmptyResult> deleteChannel(const QString &channelJid);
     Q_SIGNAL void channelDeleted(const QString &channelJid);
 
+    void setChannelCacheEnabled(const QString &channelJid, bool enabled);
+    bool isChannelCacheEnabled(const QString &channelJid) const;
+    std::optional<QVector<QXmppMixParticipantItem>> cachedParticipants(const QString &channelJid) const;
+    std::optional<QXmppMixParticipantItem> cachedParticipant(const QString &channelJid, const QString &participantId) const;
+    std::optional<QXmppMixInfoItem> cachedChannelInformation(const QString &channelJid) const;
+    std::optional<QXmppMixConfigItem> cachedChannelConfiguration(const QString &channelJid) const;
+
 protected:
     /// \cond
     void onRegistered(QXmppClient *client) override;
@@ -151,6 +158,7 @@ private:
     void removeService(const QString &jid);
     void removeServices();
     void resetCachedData();
+    void updateChannelCache(const QDomElement &element, const QString &channelJid, const QString &nodeName);
 
     const std::unique_ptr<QXmppMixManagerPrivate> d;
 
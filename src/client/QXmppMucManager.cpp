@@ -11,13 +11,18 @@
 #include "QXmppMucIq.h"
 #include "QXmppUtils.h"
 
+#include <QDateTime>
 #include <QDomElement>
+#include <QHash>
 #include <QMap>
 
+#include <algorithm>
+
 class QXmppMucManagerPrivate
 {
 public:
-    QMap<QString, QXmppMucRoom *> rooms;
+    // rooms by their bare JID, used to route incoming stanzas
+    QHash<QString, QXmppMucRoom *> rooms;
 };
 
 class QXmppMucRoomPrivate
@@ -29,12 +34,15 @@ public:
     QXmppMucRoom::Actions allowedActions;
     QString jid;
     QString name;
-    QMap<QString, QXmppPresence> participants;
+    QHash<QString, QXmppPresence> participants;
     QString password;
     QMap<QString, QXmppMucItem> permissions;
     QSet<QString> permissionsQueue;
     QString nickName;
     QString subject;
+    QXmppMucRoom::JoinMode joinMode = QXmppMucRoom::NormalJoin;
+    std::optional<int> historyMaxStanzas;
+    QDateTime historySince;
 };
 
 ///
@@ -123,25 +131,56 @@ void QXmppMucManager::onRegistered(QXmppClient *client)
 {
     connect(client, &QXmppClient::messageReceived,
             this, &QXmppMucManager::_q_messageReceived);
+    connect(client, &QXmppClient::presenceReceived,
+            this, &QXmppMucManager::_q_presenceReceived);
 }
 
 void QXmppMucManager::onUnregistered(QXmppClient *client)
 {
     disconnect(client, &QXmppClient::messageReceived,
                this, &QXmppMucManager::_q_messageReceived);
+    disconnect(client, &QXmppClient::presenceReceived,
+               this, &QXmppMucManager::_q_presenceReceived);
 }
 /// \endcond
 
 void QXmppMucManager::_q_messageReceived(const QXmppMessage &msg)
 {
+    // route messages from rooms
+    if (auto *room = d->rooms.value(QXmppUtils::jidToBareJid(msg.from()))) {
+        room->_q_messageReceived(msg);
+    }
+
     if (msg.type() != QXmppMessage::Normal) {
         return;
     }
 
     // process room invitations
     const QString roomJid = msg.mucInvitationJid();
-    if (!roomJid.isEmpty() && (!d->rooms.contains(roomJid) || !d->rooms.value(roomJid)->isJoined())) {
-        Q_EMIT invitationReceived(roomJid, msg.from(), msg.mucInvitationReason());
+    if (!roomJid.isEmpty()) {
+        auto *room = d->rooms.value(roomJid);
+        if (!room || !room->isJoined()) {
+            Q_EMIT invitationReceived(roomJid, msg.from(), msg.mucInvitationReason());
+        }
+    }
+}
+
+void QXmppMucManager::_q_presenceReceived(const QXmppPresence &presence)
+{
+    // if our own presence changes, reflect it in the joined chat rooms
+    if (presence.from() == client()->configuration().jid()) {
+        for (auto *room : std::as_const(d->rooms)) {
+            if (room->isJoined()) {
+                QXmppPresence packet = client()->clientPresence();
+                packet.setTo(room->d->ownJid());
+                client()->sendPacket(packet);
+            }
+        }
+    }
+
+    // route presences from room occupants
+    if (auto *room = d->rooms.value(QXmppUtils::jidToBareJid(presence.from()))) {
+        room->_q_presenceReceived(presence);
     }
 }
 
@@ -167,11 +206,7 @@ QXmppMucRoom::QXmppMucRoom(QXmppClient *client, const QString &jid, QObject *par
     connect(d->client, &QXmppClient::disconnected,
             this, &QXmppMucRoom::_q_disconnected);
 
-    connect(d->client, &QXmppClient::messageReceived,
-            this, &QXmppMucRoom::_q_messageReceived);
-
-    connect(d->client, &QXmppClient::presenceReceived,
-            this, &QXmppMucRoom::_q_presenceReceived);
+    // messages and presences are routed to the room by the QXmppMucManager
 
     if (d->discoManager) {
         connect(d->discoManager, &QXmppDiscoveryManager::infoReceived,
@@ -245,6 +280,8 @@ bool QXmppMucRoom::join()
     packet.setType(QXmppPresence::Available);
     packet.setMucPassword(d->password);
     packet.setMucSupported(true);
+    packet.setMucHistoryMaxStanzas(d->historyMaxStanzas);
+    packet.setMucHistorySince(d->historySince);
     return d->client->sendPacket(packet);
 }
 
@@ -357,6 +394,73 @@ void QXmppMucRoom::setNickName(const QString &nickName)
     }
 }
 
+///
+/// Returns how the participants of the room are tracked.
+///
+/// \since QXmpp 1.8
+///
+QXmppMucRoom::JoinMode QXmppMucRoom::joinMode() const
+{
+    return d->joinMode;
+}
+
+///
+/// Sets how the participants of the room are tracked.
+///
+/// You need to set the mode before calling join().
+///
+/// \since QXmpp 1.8
+///
+void QXmppMucRoom::setJoinMode(JoinMode mode)
+{
+    d->joinMode = mode;
+}
+
+///
+/// Returns the maximum number of history messages requested when joining.
+///
+/// \since QXmpp 1.8
+///
+std::optional<int> QXmppMucRoom::historyMaxStanzas() const
+{
+    return d->historyMaxStanzas;
+}
+
+///
+/// Sets the maximum number of history messages requested when joining.
+///
+/// 0 requests no history at all. By default, the room decides how much history
+/// is sent.
+///
+/// \since QXmpp 1.8
+///
+void QXmppMucRoom::setHistoryMaxStanzas(std::optional<int> maxStanzas)
+{
+    d->historyMaxStanzas = maxStanzas;
+}
+
+///
+/// Returns the date since when history messages are requested when joining.
+///
+/// \since QXmpp 1.8
+///
+QDateTime QXmppMucRoom::historySince() const
+{
+    return d->historySince;
+}
+
+///
+/// Sets the date since when history messages are requested when joining.
+///
+/// This can be used to only receive the messages sent since the room was left.
+///
+/// \since QXmpp 1.8
+///
+void QXmppMucRoom::setHistorySince(const QDateTime &since)
+{
+    d->historySince = since;
+}
+
 ///
 /// Returns the "Full JID" of the given participant.
 ///
@@ -364,11 +468,10 @@ void QXmppMucRoom::setNickName(const QString &nickName)
 ///
 QString QXmppMucRoom::participantFullJid(const QString &jid) const
 {
-    if (d->participants.contains(jid)) {
-        return d->participants.value(jid).mucItem().jid();
-    } else {
-        return QString();
+    if (const auto itr = d->participants.constFind(jid); itr != d->participants.cend()) {
+        return itr->mucItem().jid();
     }
+    return QString();
 }
 
 ///
@@ -378,8 +481,8 @@ QString QXmppMucRoom::participantFullJid(const QString &jid) const
 ///
 QXmppPresence QXmppMucRoom::participantPresence(const QString &jid) const
 {
-    if (d->participants.contains(jid)) {
-        return d->participants.value(jid);
+    if (const auto itr = d->participants.constFind(jid); itr != d->participants.cend()) {
+        return *itr;
     }
 
     QXmppPresence presence;
@@ -390,7 +493,9 @@ QXmppPresence QXmppMucRoom::participantPresence(const QString &jid) const
 
 QStringList QXmppMucRoom::participants() const
 {
-    return d->participants.keys();
+    auto jids = d->participants.keys();
+    std::sort(jids.begin(), jids.end());
+    return jids;
 }
 
 QString QXmppMucRoom::password() const
@@ -576,10 +681,6 @@ void QXmppMucRoom::_q_discoveryInfoReceived(const QXmppDiscoveryIq &iq)
 
 void QXmppMucRoom::_q_messageReceived(const QXmppMessage &message)
 {
-    if (QXmppUtils::jidToBareJid(message.from()) != d->jid) {
-        return;
-    }
-
     // handle message subject
     const QString subject = message.subject();
     if (!subject.isEmpty()) {
@@ -594,23 +695,25 @@ void QXmppMucRoom::_q_presenceReceived(const QXmppPresence &presence)
 {
     const QString jid = presence.from();
 
-    // if our own presence changes, reflect it in the chat room
-    if (isJoined() && jid == d->client->configuration().jid()) {
-        QXmppPresence packet = d->client->clientPresence();
-        packet.setTo(d->ownJid());
-        d->client->sendPacket(packet);
-    }
+    if (presence.type() == QXmppPresence::Available) {
+        // the service may have assigned another nickname than requested
+        if (!isJoined() && jid != d->ownJid() && presence.mucStatusCodes().contains(110)) {
+            d->nickName = QXmppUtils::jidToResource(jid);
+            Q_EMIT nickNameChanged(d->nickName);
+        }
 
-    if (QXmppUtils::jidToBareJid(jid) != d->jid) {
-        return;
-    }
+        const bool isOwnPresence = jid == d->ownJid();
+        if (!isOwnPresence && d->joinMode == LurkerJoin) {
+            return;
+        }
 
-    if (presence.type() == QXmppPresence::Available) {
+        // the occupants present when joining are reported with our own presence
+        const bool batched = d->joinMode == BatchedJoin && !isJoined();
         const bool added = !d->participants.contains(jid);
         d->participants.insert(jid, presence);
 
         // refresh allowed actions
-        if (jid == d->ownJid()) {
+        if (isOwnPresence) {
 
             QXmppMucItem mucItem = presence.mucItem();
             Actions newActions = NoAction;
@@ -633,22 +736,34 @@ void QXmppMucRoom::_q_presenceReceived(const QXmppPresence &presence)
             }
         }
 
-        if (added) {
+        if (batched) {
+            if (!isOwnPresence) {
+                return;
+            }
+            Q_EMIT participantsReset();
+            Q_EMIT participantsChanged();
+        } else if (added) {
             Q_EMIT participantAdded(jid);
             Q_EMIT participantsChanged();
-            if (jid == d->ownJid()) {
-                // request room information
-                if (d->discoManager) {
-                    d->discoManager->requestInfo(d->jid);
-                }
-
-                Q_EMIT joined();
-            }
         } else {
             Q_EMIT participantChanged(jid);
         }
+
+        if (added && isOwnPresence) {
+            // request room information
+            if (d->discoManager) {
+                d->discoManager->requestInfo(d->jid);
+            }
+
+            Q_EMIT joined();
+        }
     } else if (presence.type() == QXmppPresence::Unavailable) {
         if (d->participants.contains(jid)) {
+            if (d->joinMode == BatchedJoin && !isJoined()) {
+                d->participants.remove(jid);
+                return;
+            }
+
             d->participants.insert(jid, presence);
 
             Q_EMIT participantRemoved(jid);
@@ -74,6 +74,7 @@ protected:
 
 private Q_SLOTS:
     void _q_messageReceived(const QXmppMessage &message);
+    void _q_presenceReceived(const QXmppPresence &presence);
     void _q_roomDestroyed(QObject *object);
 
 private:
@@ -118,6 +119,24 @@ public:
     };
     Q_DECLARE_FLAGS(Actions, Action)
 
+    ///
+    /// This enum describes how the participants of the room are tracked.
+    ///
+    /// \since QXmpp 1.8
+    ///
+    enum JoinMode {
+        /// Every participant is reported via participantAdded().
+        NormalJoin,
+        /// The participants present when joining are collected until your own
+        /// presence has been received and are then reported at once via
+        /// participantsReset(). Later changes are reported individually.
+        BatchedJoin,
+        /// Only your own presence is tracked. This is useful for bots in large
+        /// rooms that are not interested in the other participants.
+        LurkerJoin,
+    };
+    Q_ENUM(JoinMode)
+
     ~QXmppMucRoom() override;
 
     // documentation needs to be here, see https://stackoverflow.com/questions/49192523/
@@ -145,6 +164,14 @@ public:
     QString nickName() const;
     void setNickName(const QString &nickName);
 
+    JoinMode joinMode() const;
+    void setJoinMode(JoinMode mode);
+
+    std::optional<int> historyMaxStanzas() const;
+    void setHistoryMaxStanzas(std::optional<int> maxStanzas);
+    QDateTime historySince() const;
+    void setHistorySince(const QDateTime &since);
+
     Q_INVOKABLE QString participantFullJid(const QString &jid) const;
     QXmppPresence participantPresence(const QString &jid) const;
 
@@ -211,6 +238,16 @@ Q_SIGNALS:
     void participantsChanged();
     /// \endcond
 
+    ///
+    /// This signal is emitted when the participants present when joining have
+    /// been received in BatchedJoin mode.
+    ///
+    /// participants() returns the complete list afterwards.
+    ///
+    /// \since QXmpp 1.8
+    ///
+    void participantsReset();
+
     /// This signal is emitted when the room's permissions are received.
     void permissionsReceived(const QList<QXmppMucItem> &permissions);
 
@@ -73,6 +73,9 @@ void QXmppOutgoingClientPrivate::connectToHost(const QString &host, quint16 port
 {
     q->info(u"Connecting to %1:%2"_s.arg(host, QString::number(port)));
 
+    // stream features of the previous connection don't apply anymore
+    rosterVersioningSupported = false;
+
     // override CA certificates if requested
     if (!config.caCertificates().isEmpty()) {
         QSslConfiguration newSslConfig;
@@ -242,6 +245,15 @@ bool QXmppOutgoingClient::isConnected() const
     return d->socket.isConnected() && d->sessionStarted;
 }
 
+///
+/// Returns whether the server advertised support for \xep{0237, Roster Versioning} in
+/// the last received stream features.
+///
+bool QXmppOutgoingClient::isRosterVersioningSupported() const
+{
+    return d->rosterVersioningSupported;
+}
+
 ///
 /// Sends an IQ and reports the response asynchronously.
 ///
@@ -629,6 +641,10 @@ HandleElementResult QXmppOutgoingClient::handleElement(const QDomElement &nodeRe
 
 void QXmppOutgoingClient::handleStreamFeatures(const QXmppStreamFeatures &features)
 {
+    // XEP-0237: Roster Versioning (may be advertised before or after authentication, so later
+    // stream features without it don't reset it)
+    d->rosterVersioningSupported |= features.rosterVersioningSupported();
+
     // STARTTLS
     if (handleStarttls(features)) {
         return;
@@ -91,6 +91,7 @@ public:
     void disconnectFromHost();
     bool isAuthenticated() const;
     bool isConnected() const;
+    bool isRosterVersioningSupported() const;
     QXmppTask<IqResult> sendIq(QXmppIq &&);
 
     /// Returns the used socket
@@ -190,6 +190,7 @@ public:
     // Authentication & Session
     bool isAuthenticated = false;
     bool bindModeAvailable = false;
+    bool rosterVersioningSupported = false;
     bool sessionStarted = false;
     AuthenticationMethod authenticationMethod = AuthenticationMethod::Sasl;
     std::optional<Bind2Bound> bind2Bound;
@@ -11,8 +11,10 @@
 #include "QXmppPubSubAffiliation.h"
 #include "QXmppPubSubBaseItem.h"
 #include "QXmppPubSubEventHandler.h"
+#include "QXmppPromise.h"
 #include "QXmppPubSubSubscribeOptions.h"
 #include "QXmppPubSubSubscription.h"
+#include "QXmppResultSet.h"
 #include "QXmppStanza.h"
 #include "QXmppUtils.h"
 #include "QXmppUtils_p.h"
@@ -21,9 +23,31 @@
 #include "StringLiterals.h"
 
 #include <QDomElement>
+#include <QSet>
 
 using namespace QXmpp::Private;
 
+namespace QXmpp::Private {
+
+// cached items of a node
+struct PubSubNodeCache {
+    // IDs of all items of the node in the order of the service
+    QStringList itemIds;
+    // <item/> elements of the items whose payload is known
+    QHash<QString, QDomElement> items;
+};
+
+}  // namespace QXmpp::Private
+
+class QXmppPubSubManagerPrivate
+{
+public:
+    // (service JID, node name) mapped to the cached items of the node
+    QHash<std::pair<QString, QString>, PubSubNodeCache> itemCaches;
+    // maximum size of a publish request in bytes, 0 for no limit
+    qsizetype maxPublishSize = 0;
+};
+
 ///
 /// \class QXmppPubSubEventHandler
 ///
@@ -189,6 +213,7 @@ using namespace QXmpp::Private;
 /// Default constructor.
 ///
 QXmppPubSubManager::QXmppPubSubManager()
+    : d(std::make_unique<QXmppPubSubManagerPrivate>())
 {
 }
 
@@ -987,6 +1012,9 @@ bool QXmppPubSubManager::handleStanza(const QDomElement &element)
         const auto service = element.attribute(u"from"_s);
         const auto node = event.firstChildElement().attribute(u"node"_s);
 
+        // event handlers can read the updated cache
+        updateItemCache(service, event);
+
         const auto extensions = client()->extensions();
         for (auto *extension : extensions) {
             if (auto *eventHandler = dynamic_cast<QXmppPubSubEventHandler *>(extension)) {
@@ -999,6 +1027,16 @@ bool QXmppPubSubManager::handleStanza(const QDomElement &element)
     return false;
 }
 
+void QXmppPubSubManager::onRegistered(QXmppClient *client)
+{
+    connect(client, &QXmppClient::connected, this, &QXmppPubSubManager::onConnected);
+}
+
+void QXmppPubSubManager::onUnregistered(QXmppClient *client)
+{
+    disconnect(client, &QXmppClient::connected, this, &QXmppPubSubManager::onConnected);
+}
+
 PubSubIq<> QXmppPubSubManager::requestItemsIq(const QString &jid, const QString &nodeName, const QStringList &itemIds)
 {
     PubSubIq request;
@@ -1046,4 +1084,314 @@ auto QXmppPubSubManager::publishItems(PubSubIqBase &&request) -> QXmppTask<Publi
                        });
                    });
 }
+
+auto QXmppPubSubManager::joinPublishResults(std::vector<QXmppTask<PublishItemsResult>> &&tasks, QVector<qsizetype> &&chunkSizes) -> QXmppTask<PublishItemsResult>
+{
+    struct State {
+        QXmppPromise<PublishItemsResult> promise;
+        std::vector<std::optional<PublishItemsResult>> results;
+        QVector<qsizetype> chunkSizes;
+        size_t pending = 0;
+    };
+
+    auto state = std::make_shared<State>();
+    state->results.resize(tasks.size());
+    state->chunkSizes = std::move(chunkSizes);
+    state->pending = tasks.size();
+    auto task = state->promise.task();
+
+    for (size_t i = 0; i < tasks.size(); i++) {
+        tasks[i].then(this, [state, i](PublishItemsResult &&result) {
+            state->results[i] = std::move(result);
+            if (--state->pending > 0) {
+                return;
+            }
+
+            // report the IDs in the order of the items or which chunks have been published
+            QVector<QString> ids;
+            const QXmppError *firstError = nullptr;
+            qsizetype failedChunks = 0;
+            for (const auto &chunkResult : state->results) {
+                if (const auto *error = std::get_if<QXmppError>(&*chunkResult)) {
+                    firstError = firstError ? firstError : error;
+                    failedChunks++;
+                } else {
+                    ids.append(std::get<QVector<QString>>(*chunkResult));
+                }
+            }
+            if (!firstError) {
+                state->promise.finish(std::move(ids));
+                return;
+            }
+
+            // before the results are moved
+            auto description = u"%1 of %2 publish requests failed: %3"_s
+                                   .arg(QString::number(failedChunks), QString::number(state->results.size()), firstError->description);
+
+            ChunkedPublishError chunkedError;
+            chunkedError.chunkSizes = state->chunkSizes;
+            for (auto &chunkResult : state->results) {
+                chunkedError.chunkResults.append(std::move(*chunkResult));
+            }
+            state->promise.finish(QXmppError { std::move(description), std::move(chunkedError) });
+        });
+    }
+    return task;
+}
+
+QXmppTask<QXmppPubSubManager::Result> QXmppPubSubManager::streamItemElements(const QString &jid, const QString &nodeName, int pageSize, std::function<void(const QDomElement &)> &&itemHandler)
+{
+    struct State {
+        QXmppPromise<Result> promise;
+        std::function<void(const QDomElement &)> itemHandler;
+        std::function<void(const QString &)> requestPage;
+        int received = 0;
+    };
+
+    auto state = std::make_shared<State>();
+    state->itemHandler = std::move(itemHandler);
+    auto task = state->promise.task();
+
+    // the state only holds a weak reference to itself to avoid a reference cycle
+    state->requestPage = [this, jid, nodeName, pageSize, weakState = std::weak_ptr<State>(state)](const QString &after) {
+        auto state = weakState.lock();
+
+        QXmppResultSetQuery query;
+        query.setMax(pageSize);
+        if (!after.isEmpty()) {
+            query.setAfter(after);
+        }
+
+        auto request = requestItemsIq(jid, nodeName, {});
+        request.setItemsQuery(query);
+
+        client()->sendIq(std::move(request)).then(this, [state, after](QXmppClient::IqResult &&result) {
+            if (auto *error = std::get_if<QXmppError>(&result)) {
+                state->promise.finish(std::move(*error));
+                return;
+            }
+
+            const auto pubSubElement = firstChildElement(std::get<QDomElement>(result), u"pubsub", ns_pubsub);
+            int pageItems = 0;
+            for (const auto &itemElement : iterChildElements(firstChildElement(pubSubElement, u"items"), u"item")) {
+                state->itemHandler(itemElement);
+                pageItems++;
+            }
+            state->received += pageItems;
+
+            QXmppResultSetReply reply;
+            reply.parse(firstChildElement(pubSubElement, u"set", ns_rsm));
+
+            // Services may return fewer items than requested in the middle of the result set, so
+            // only an empty page, a missing <last/> or the total count end it. Services without RSM
+            // support return all items in one page without <last/>.
+            const bool hasMore = pageItems > 0 &&
+                !reply.last().isEmpty() &&
+                reply.last() != after &&
+                (reply.count() < 0 || state->received < reply.count());
+            if (hasMore) {
+                state->requestPage(reply.last());
+            } else {
+                state->promise.finish(Success());
+            }
+        });
+    };
+    state->requestPage({});
+    return task;
+}
 /// \endcond
+
+///
+/// Returns the maximum size of a publish request in bytes.
+///
+/// \sa setMaxPublishSize()
+///
+/// \since QXmpp 1.8
+///
+qsizetype QXmppPubSubManager::maxPublishSize() const
+{
+    return d->maxPublishSize;
+}
+
+///
+/// Sets the maximum size of a publish request in bytes.
+///
+/// When publishing multiple items would exceed this size, the items are split
+/// into multiple requests which are sent at once. Their results are reported
+/// together, the IDs in the order of the published items. If any of the
+/// requests fails, the QXmppError contains a ChunkedPublishError telling which
+/// requests have been published. An item exceeding the limit on its own is
+/// still published in a separate request.
+///
+/// Services often limit the size of stanzas, which can be respected with this
+/// option. The default is 0, which means that all items are published in a
+/// single request.
+///
+/// \since QXmpp 1.8
+///
+void QXmppPubSubManager::setMaxPublishSize(qsizetype bytes)
+{
+    d->maxPublishSize = bytes;
+}
+
+///
+/// Enables or disables caching the items of a node.
+///
+/// Cached nodes are updated from event notifications and by
+/// synchronizeItems(). Disabling the cache removes all cached items of the
+/// node. When a new stream is started, i.e. the stream could not be resumed,
+/// the cached items are removed, because notifications may have been missed.
+///
+/// \param jid Jabber ID of the entity hosting the pubsub service
+/// \param nodeName the name of the node
+/// \param enabled whether the items of the node should be cached
+///
+/// \since QXmpp 1.8
+///
+void QXmppPubSubManager::setItemCacheEnabled(const QString &jid, const QString &nodeName, bool enabled)
+{
+    const auto key = std::pair { jid, nodeName };
+    if (enabled) {
+        d->itemCaches[key];
+    } else {
+        d->itemCaches.remove(key);
+    }
+}
+
+///
+/// Returns whether the items of a node are cached.
+///
+/// \param jid Jabber ID of the entity hosting the pubsub service
+/// \param nodeName the name of the node
+///
+/// \since QXmpp 1.8
+///
+bool QXmppPubSubManager::isItemCacheEnabled(const QString &jid, const QString &nodeName) const
+{
+    return d->itemCaches.contains(std::pair { jid, nodeName });
+}
+
+void QXmppPubSubManager::onConnected()
+{
+    // notifications may have been missed, the nodes stay cached but need to be synchronized again
+    if (client()->streamManagementState() != QXmppClient::ResumedStream) {
+        for (auto &cache : d->itemCaches) {
+            cache = {};
+        }
+    }
+}
+
+std::optional<QVector<QDomElement>> QXmppPubSubManager::cachedItemElements(const QString &jid, const QString &nodeName) const
+{
+    const auto itr = d->itemCaches.constFind(std::pair { jid, nodeName });
+    if (itr == d->itemCaches.cend()) {
+        return {};
+    }
+
+    QVector<QDomElement> elements;
+    elements.reserve(itr->itemIds.size());
+    for (const auto &id : std::as_const(itr->itemIds)) {
+        if (auto itemItr = itr->items.constFind(id); itemItr != itr->items.cend()) {
+            elements.append(*itemItr);
+        }
+    }
+    return elements;
+}
+
+QXmppTask<QXmppPubSubManager::ItemElementsResult> QXmppPubSubManager::synchronizeItemElements(const QString &jid, const QString &nodeName)
+{
+    setItemCacheEnabled(jid, nodeName, true);
+
+    QXmppPromise<ItemElementsResult> promise;
+    auto task = promise.task();
+
+    requestItemIds(jid, nodeName).then(this, [this, promise, jid, nodeName](ItemIdsResult &&result) mutable {
+        auto cacheItr = d->itemCaches.find(std::pair { jid, nodeName });
+        if (auto *error = std::get_if<QXmppError>(&result)) {
+            promise.finish(std::move(*error));
+            return;
+        }
+        if (cacheItr == d->itemCaches.end()) {
+            promise.finish(QXmppError { u"Item cache of the node has been disabled."_s, {} });
+            return;
+        }
+        auto &cache = *cacheItr;
+        const auto &itemIds = std::get<QVector<QString>>(result);
+
+        // drop removed items
+        const auto currentIds = QSet<QString>(itemIds.cbegin(), itemIds.cend());
+        for (auto itr = cache.items.begin(); itr != cache.items.end();) {
+            if (currentIds.contains(itr.key())) {
+                ++itr;
+            } else {
+                itr = cache.items.erase(itr);
+            }
+        }
+        cache.itemIds = QStringList(itemIds.cbegin(), itemIds.cend());
+
+        QStringList missingIds;
+        for (const auto &id : itemIds) {
+            if (!cache.items.contains(id)) {
+                missingIds.append(id);
+            }
+        }
+        if (missingIds.isEmpty()) {
+            promise.finish(*cachedItemElements(jid, nodeName));
+            return;
+        }
+
+        // only request new items
+        client()->sendIq(requestItemsIq(jid, nodeName, missingIds)).then(this, [this, promise, jid, nodeName](QXmppClient::IqResult &&result) mutable {
+            if (auto *error = std::get_if<QXmppError>(&result)) {
+                promise.finish(std::move(*error));
+                return;
+            }
+
+            auto cacheItr = d->itemCaches.find(std::pair { jid, nodeName });
+            if (cacheItr == d->itemCaches.end()) {
+                promise.finish(QXmppError { u"Item cache of the node has been disabled."_s, {} });
+                return;
+            }
+
+            const auto itemsElement = firstChildElement(firstChildElement(std::get<QDomElement>(result), u"pubsub", ns_pubsub), u"items");
+            for (const auto &itemElement : iterChildElements(itemsElement, u"item")) {
+                cacheItr->items.insert(itemElement.attribute(u"id"_s), itemElement);
+            }
+            promise.finish(*cachedItemElements(jid, nodeName));
+        });
+    });
+    return task;
+}
+
+void QXmppPubSubManager::updateItemCache(const QString &jid, const QDomElement &eventElement)
+{
+    const auto child = eventElement.firstChildElement();
+    const auto cacheItr = d->itemCaches.find(std::pair { jid, child.attribute(u"node"_s) });
+    if (cacheItr == d->itemCaches.end()) {
+        return;
+    }
+    auto &cache = *cacheItr;
+
+    if (child.tagName() == u"items") {
+        for (const auto &itemElement : iterChildElements(child, u"item")) {
+            const auto id = itemElement.attribute(u"id"_s);
+            if (!cache.itemIds.contains(id)) {
+                cache.itemIds.append(id);
+            }
+            // notifications without payload are fetched by the next synchronization
+            if (itemElement.firstChildElement().isNull()) {
+                cache.items.remove(id);
+            } else {
+                cache.items.insert(id, itemElement);
+            }
+        }
+        for (const auto &retractElement : iterChildElements(child, u"retract")) {
+            const auto id = retractElement.attribute(u"id"_s);
+            cache.itemIds.removeOne(id);
+            cache.items.remove(id);
+        }
+    } else if (child.tagName() == u"purge" || child.tagName() == u"delete") {
+        cache.itemIds.clear();
+        cache.items.clear();
+    }
+}
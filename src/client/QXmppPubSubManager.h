@@ -14,6 +14,12 @@
 #include "QXmppPubSubPublishOptions.h"
 #include "QXmppResultSet.h"
 
+#include <functional>
+
+#include <QDomElement>
+#include <QXmlStreamWriter>
+
+class QXmppPubSubManagerPrivate;
 class QXmppPubSubPublishOptions;
 class QXmppPubSubSubscribeOptions;
 
@@ -65,6 +71,20 @@ public:
     using OptionsResult = std::variant<QXmppPubSubSubscribeOptions, QXmppError>;
     using NodeConfigResult = std::variant<QXmppPubSubNodeConfig, QXmppError>;
 
+    ///
+    /// Error of publishing items that have been split into multiple requests
+    /// of which at least one failed, see setMaxPublishSize().
+    ///
+    /// \since QXmpp 1.8
+    ///
+    struct ChunkedPublishError {
+        /// Result of each request in the order of the items: the IDs of the
+        /// published items or the error
+        QVector<PublishItemsResult> chunkResults;
+        /// Number of items of each request
+        QVector<qsizetype> chunkSizes;
+    };
+
     QXmppPubSubManager();
     ~QXmppPubSubManager();
 
@@ -84,6 +104,8 @@ public:
     QXmppTask<ItemsResult<T>> requestItems(const QString &jid, const QString &nodeName);
     template<typename T = QXmppPubSubBaseItem>
     QXmppTask<ItemsResult<T>> requestItems(const QString &jid, const QString &nodeName, const QStringList &itemIds);
+    template<typename T = QXmppPubSubBaseItem>
+    QXmppTask<Result> streamItems(const QString &jid, const QString &nodeName, std::function<void(T &&)> &&itemHandler, int pageSize = 50);
     template<typename T>
     QXmppTask<PublishItemResult> publishItem(const QString &jid, const QString &nodeName, const T &item);
     template<typename T>
@@ -137,6 +159,17 @@ public:
     QXmppTask<Result> configureOwnPepNode(const QString &nodeName, const QXmppPubSubNodeConfig &config) { return configureNode(client()->configuration().jidBare(), nodeName, config); }
     QXmppTask<Result> cancelOwnPepNodeConfiguration(const QString &nodeName) { return cancelNodeConfiguration(client()->configuration().jidBare(), nodeName); }
 
+    qsizetype maxPublishSize() const;
+    void setMaxPublishSize(qsizetype bytes);
+
+    // Item cache
+    void setItemCacheEnabled(const QString &jid, const QString &nodeName, bool enabled);
+    bool isItemCacheEnabled(const QString &jid, const QString &nodeName) const;
+    template<typename T = QXmppPubSubBaseItem>
+    std::optional<QVector<T>> cachedItems(const QString &jid, const QString &nodeName) const;
+    template<typename T = QXmppPubSubBaseItem>
+    QXmppTask<ItemsResult<T>> synchronizeItems(const QString &jid, const QString &nodeName);
+
     static QString standardItemIdToString(StandardItemId itemId);
 
     /// \cond
@@ -144,7 +177,15 @@ public:
     bool handleStanza(const QDomElement &element) override;
     /// \endcond
 
+protected:
+    /// \cond
+    void onRegistered(QXmppClient *client) override;
+    void onUnregistered(QXmppClient *client) override;
+    /// \endcond
+
 private:
+    void onConnected();
+
     // for private requestFeatures() API
     friend class tst_QXmppPubSubManager;
     friend class QXmppOmemoManagerPrivate;
@@ -154,7 +195,22 @@ private:
 
     QXmppTask<PublishItemResult> publishItem(QXmpp::Private::PubSubIqBase &&iq);
     QXmppTask<PublishItemsResult> publishItems(QXmpp::Private::PubSubIqBase &&iq);
+    template<typename T>
+    QXmppTask<PublishItemsResult> publishItemsInChunks(QXmpp::Private::PubSubIq<T> &&iq);
+    QXmppTask<PublishItemsResult> joinPublishResults(std::vector<QXmppTask<PublishItemsResult>> &&tasks, QVector<qsizetype> &&chunkSizes);
+    QXmppTask<Result> streamItemElements(const QString &jid, const QString &nodeName, int pageSize, std::function<void(const QDomElement &)> &&itemHandler);
+    template<typename T>
+    static qsizetype serializedSize(const T &packet);
     static QXmpp::Private::PubSubIq<> requestItemsIq(const QString &jid, const QString &nodeName, const QStringList &itemIds);
+
+    using ItemElementsResult = std::variant<QVector<QDomElement>, QXmppError>;
+    std::optional<QVector<QDomElement>> cachedItemElements(const QString &jid, const QString &nodeName) const;
+    QXmppTask<ItemElementsResult> synchronizeItemElements(const QString &jid, const QString &nodeName);
+    void updateItemCache(const QString &jid, const QDomElement &eventElement);
+    template<typename T>
+    static QVector<T> parseItems(const QVector<QDomElement> &elements);
+
+    const std::unique_ptr<QXmppPubSubManagerPrivate> d;
 };
 
 ///
@@ -238,6 +294,151 @@ QXmppTask<QXmppPubSubManager::ItemsResult<T>> QXmppPubSubManager::requestItems(c
                    });
 }
 
+///
+/// Requests all items of a node page by page and reports each item as soon as
+/// its page has been received.
+///
+/// The pages are requested using \xep{0059, Result Set Management}, so that
+/// large nodes don't need to be transferred in a single stanza. If the service
+/// doesn't support it, it returns all items at once.
+///
+/// \param jid Jabber ID of the entity hosting the pubsub service
+/// \param nodeName the name of the node to query
+/// \param itemHandler function called with each item
+/// \param pageSize maximum number of items requested at once
+/// \return task finished after all items have been reported
+///
+/// \since QXmpp 1.8
+///
+template<typename T>
+QXmppTask<QXmppPubSubManager::Result> QXmppPubSubManager::streamItems(const QString &jid,
+                                                                     const QString &nodeName,
+                                                                     std::function<void(T &&)> &&itemHandler,
+                                                                     int pageSize)
+{
+    return streamItemElements(jid, nodeName, pageSize, [itemHandler = std::move(itemHandler)](const QDomElement &element) {
+        T item;
+        item.parse(element);
+        itemHandler(std::move(item));
+    });
+}
+
+///
+/// Returns the cached items of a node.
+///
+/// This can be used in a QXmppPubSubEventHandler as the cache is updated
+/// before the event handlers are called.
+///
+/// \param jid Jabber ID of the entity hosting the pubsub service
+/// \param nodeName the name of the node
+/// \return the cached items or std::nullopt if the node is not cached
+///
+/// \since QXmpp 1.8
+///
+template<typename T>
+std::optional<QVector<T>> QXmppPubSubManager::cachedItems(const QString &jid, const QString &nodeName) const
+{
+    if (auto elements = cachedItemElements(jid, nodeName)) {
+        return parseItems<T>(*elements);
+    }
+    return {};
+}
+
+///
+/// Synchronizes the item cache of a node and returns all of its items.
+///
+/// This enables the item cache of the node. Only the IDs of the items are
+/// requested; items that are not cached yet are requested afterwards, items
+/// that have been removed are dropped from the cache. Items changed without
+/// changing their IDs are only noticed via event notifications, so the account
+/// should be subscribed to the node.
+///
+/// \param jid Jabber ID of the entity hosting the pubsub service
+/// \param nodeName the name of the node
+///
+/// \since QXmpp 1.8
+///
+template<typename T>
+QXmppTask<QXmppPubSubManager::ItemsResult<T>> QXmppPubSubManager::synchronizeItems(const QString &jid, const QString &nodeName)
+{
+    return QXmpp::Private::chainMapSuccess(synchronizeItemElements(jid, nodeName), this, [](QVector<QDomElement> &&elements) {
+        return Items<T> { parseItems<T>(elements), {} };
+    });
+}
+
+// Splits the items into multiple requests if the IQ would exceed maxPublishSize(). The requests are
+// sent at once and reported together.
+template<typename T>
+QXmppTask<QXmppPubSubManager::PublishItemsResult> QXmppPubSubManager::publishItemsInChunks(QXmpp::Private::PubSubIq<T> &&request)
+{
+    const auto maxSize = maxPublishSize();
+    const auto items = request.items();
+    if (maxSize <= 0 || items.size() < 2) {
+        return publishItems(std::move(request));
+    }
+
+    // every chunk needs its own IQ to get a new stanza ID
+    auto createRequest = [&](const QVector<T> &chunkItems) {
+        QXmpp::Private::PubSubIq<T> chunkRequest;
+        chunkRequest.setTo(request.to());
+        chunkRequest.setQueryType(QXmpp::Private::PubSubIqBase::Publish);
+        chunkRequest.setQueryNode(request.queryNode());
+        chunkRequest.setDataForm(request.dataForm());
+        chunkRequest.setItems(chunkItems);
+        return chunkRequest;
+    };
+    const auto baseSize = serializedSize(createRequest({}));
+
+    std::vector<QXmppTask<PublishItemsResult>> tasks;
+    QVector<qsizetype> chunkSizes;
+    QVector<T> chunk;
+    qsizetype chunkSize = baseSize;
+    auto publishChunk = [&]() {
+        auto chunkRequest = createRequest(chunk);
+        tasks.push_back(publishItems(std::move(chunkRequest)));
+        chunkSizes.append(chunk.size());
+        chunk.clear();
+        chunkSize = baseSize;
+    };
+
+    for (const auto &item : items) {
+        const auto itemSize = serializedSize(item);
+        if (!chunk.isEmpty() && chunkSize + itemSize > maxSize) {
+            publishChunk();
+        }
+        chunk.append(item);
+        chunkSize += itemSize;
+    }
+    publishChunk();
+
+    if (tasks.size() == 1) {
+        return std::move(tasks.front());
+    }
+    return joinPublishResults(std::move(tasks), std::move(chunkSizes));
+}
+
+template<typename T>
+qsizetype QXmppPubSubManager::serializedSize(const T &packet)
+{
+    QByteArray data;
+    QXmlStreamWriter writer(&data);
+    packet.toXml(&writer);
+    return data.size();
+}
+
+template<typename T>
+QVector<T> QXmppPubSubManager::parseItems(const QVector<QDomElement> &elements)
+{
+    QVector<T> items;
+    items.reserve(elements.size());
+    for (const auto &element : elements) {
+        T item;
+        item.parse(element);
+        items.append(std::move(item));
+    }
+    return items;
+}
+
 ///
 /// Publishs one item to a pubsub node.
 ///
@@ -304,7 +505,7 @@ QXmppTask<QXmppPubSubManager::PublishItemsResult> QXmppPubSubManager::publishIte
     request.setTo(jid);
     request.setItems(items);
     request.setQueryNode(nodeName);
-    return publishItems(std::move(request));
+    return publishItemsInChunks(std::move(request));
 }
 
 ///
@@ -327,7 +528,7 @@ QXmppTask<QXmppPubSubManager::PublishItemsResult> QXmppPubSubManager::publishIte
     request.setItems(items);
     request.setQueryNode(nodeName);
     request.setDataForm(publishOptions.toDataForm());
-    return publishItems(std::move(request));
+    return publishItemsInChunks(std::move(request));
 }
 
 ///
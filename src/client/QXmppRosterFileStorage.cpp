@@ -0,0 +1,164 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppRosterFileStorage.h"
+
+#include "QXmppConstants_p.h"
+#include "QXmppFutureUtils_p.h"
+#include "QXmppUtils_p.h"
+
+#include "StringLiterals.h"
+
+#include <QDomDocument>
+#include <QFile>
+#include <QSaveFile>
+#include <QTimer>
+#include <QXmlStreamWriter>
+
+using namespace QXmpp::Private;
+
+///
+/// \class QXmppRosterFileStorage
+///
+/// \brief The QXmppRosterFileStorage class stores the roster in an XML file.
+///
+/// The file is read on first access. Changes are kept in the memory and
+/// written back to the file once control returns to the event loop, so that a
+/// burst of roster pushes only causes a single write.
+///
+/// \since QXmpp 1.8
+///
+
+class QXmppRosterFileStoragePrivate
+{
+public:
+    QString fileName;
+    bool loaded = false;
+    // used to merge multiple changes into one write
+    QTimer saveTimer;
+};
+
+///
+/// Constructs a roster file storage.
+///
+/// \param fileName path of the file the roster is read from and written to
+///
+QXmppRosterFileStorage::QXmppRosterFileStorage(const QString &fileName)
+    : d(std::make_unique<QXmppRosterFileStoragePrivate>())
+{
+    d->fileName = fileName;
+    d->saveTimer.setSingleShot(true);
+    d->saveTimer.setInterval(0);
+    QObject::connect(&d->saveTimer, &QTimer::timeout, &d->saveTimer, [this]() {
+        save();
+    });
+}
+
+QXmppRosterFileStorage::~QXmppRosterFileStorage()
+{
+    // write pending changes
+    if (d->saveTimer.isActive()) {
+        save();
+    }
+}
+
+///
+/// Returns the path of the file the roster is stored in.
+///
+QString QXmppRosterFileStorage::fileName() const
+{
+    return d->fileName;
+}
+
+/// \cond
+QXmppTask<QXmppRosterStorage::Roster> QXmppRosterFileStorage::roster()
+{
+    load();
+    return QXmppRosterMemoryStorage::roster();
+}
+
+QXmppTask<void> QXmppRosterFileStorage::replaceRoster(const Roster &roster)
+{
+    // the file does not need to be read, everything is replaced
+    d->loaded = true;
+    QXmppRosterMemoryStorage::replaceRoster(roster);
+    d->saveTimer.start();
+    return makeReadyTask();
+}
+
+QXmppTask<void> QXmppRosterFileStorage::updateItems(const QString &version, const QList<QXmppRosterIq::Item> &items)
+{
+    load();
+    QXmppRosterMemoryStorage::updateItems(version, items);
+    d->saveTimer.start();
+    return makeReadyTask();
+}
+
+QXmppTask<void> QXmppRosterFileStorage::resetAll()
+{
+    d->loaded = true;
+    d->saveTimer.stop();
+    QXmppRosterMemoryStorage::resetAll();
+    QFile::remove(d->fileName);
+    return makeReadyTask();
+}
+/// \endcond
+
+void QXmppRosterFileStorage::load()
+{
+    if (d->loaded) {
+        return;
+    }
+    d->loaded = true;
+
+    QFile file(d->fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    QDomDocument document;
+    if (!document.setContent(file.readAll(), true)) {
+        return;
+    }
+
+    const auto rosterEl = document.documentElement();
+    if (rosterEl.tagName() != u"roster" || rosterEl.namespaceURI() != ns_roster) {
+        return;
+    }
+
+    Roster roster;
+    roster.version = rosterEl.attribute(u"ver"_s);
+    for (const auto &itemEl : iterChildElements(rosterEl, u"item", ns_roster)) {
+        QXmppRosterIq::Item item;
+        item.parse(itemEl);
+        roster.items.push_back(std::move(item));
+    }
+
+    QXmppRosterMemoryStorage::replaceRoster(roster);
+}
+
+void QXmppRosterFileStorage::save()
+{
+    d->saveTimer.stop();
+
+    const auto roster = QXmppRosterMemoryStorage::roster().takeResult();
+
+    QSaveFile file(d->fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+
+    QXmlStreamWriter writer(&file);
+    writer.writeStartDocument();
+    writer.writeStartElement(QSL65("roster"));
+    writer.writeDefaultNamespace(toString65(ns_roster));
+    writeOptionalXmlAttribute(&writer, u"ver", roster.version);
+    for (const auto &item : roster.items) {
+        item.toXml(&writer);
+    }
+    writer.writeEndElement();
+    writer.writeEndDocument();
+
+    file.commit();
+}
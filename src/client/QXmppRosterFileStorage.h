@@ -0,0 +1,35 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPROSTERFILESTORAGE_H
+#define QXMPPROSTERFILESTORAGE_H
+
+#include "QXmppRosterMemoryStorage.h"
+
+class QXmppRosterFileStoragePrivate;
+
+class QXMPP_EXPORT QXmppRosterFileStorage : public QXmppRosterMemoryStorage
+{
+public:
+    explicit QXmppRosterFileStorage(const QString &fileName);
+    ~QXmppRosterFileStorage() override;
+
+    QString fileName() const;
+
+    /// \cond
+    QXmppTask<Roster> roster() override;
+    QXmppTask<void> replaceRoster(const Roster &roster) override;
+    QXmppTask<void> updateItems(const QString &version, const QList<QXmppRosterIq::Item> &items) override;
+
+    QXmppTask<void> resetAll() override;
+    /// \endcond
+
+private:
+    void load();
+    void save();
+
+    const std::unique_ptr<QXmppRosterFileStoragePrivate> d;
+};
+
+#endif  // QXMPPROSTERFILESTORAGE_H
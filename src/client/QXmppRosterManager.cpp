@@ -10,14 +10,21 @@
 #include "QXmppClient.h"
 #include "QXmppConstants_p.h"
 #include "QXmppFutureUtils_p.h"
+#include "QXmppOutgoingClient.h"
 #include "QXmppPresence.h"
 #include "QXmppRosterIq.h"
+#include "QXmppRosterStorage.h"
 #include "QXmppUtils.h"
 #include "QXmppUtils_p.h"
 
 #include "StringLiterals.h"
 
+#include <algorithm>
+#include <optional>
+#include <vector>
+
 #include <QDomElement>
+#include <QHash>
 
 using namespace QXmpp;
 using namespace QXmpp::Private;
@@ -59,6 +66,18 @@ static void serializeRosterData(const RosterData &d, QXmlStreamWriter &writer)
     d.toXml(writer);
 }
 
+static bool isSameItem(const QXmppRosterIq::Item &a, const QXmppRosterIq::Item &b)
+{
+    return a.bareJid() == b.bareJid() &&
+        a.name() == b.name() &&
+        a.subscriptionType() == b.subscriptionType() &&
+        a.subscriptionStatus() == b.subscriptionStatus() &&
+        a.isApproved() == b.isApproved() &&
+        a.groups() == b.groups() &&
+        a.isMixChannel() == b.isMixChannel() &&
+        a.mixParticipantId() == b.mixParticipantId();
+}
+
 }  // namespace QXmpp::Private
 
 ///
@@ -78,21 +97,56 @@ static void serializeRosterData(const RosterData &d, QXmlStreamWriter &writer)
 /// \since QXmpp 1.5
 ///
 
+namespace QXmpp::Private {
+
+// presence of a single resource
+struct ResourcePresence {
+    QString resource;
+    QXmppPresence presence;
+};
+
+// roster entry and presences of a bare JID
+struct RosterContact {
+    std::optional<QXmppRosterIq::Item> item;
+    // most contacts only have very few resources, so a vector is cheaper than a map
+    std::vector<ResourcePresence> presences;
+
+    auto findPresence(const QString &resource)
+    {
+        return std::find_if(presences.begin(), presences.end(), [&](const auto &p) {
+            return p.resource == resource;
+        });
+    }
+    auto findPresence(const QString &resource) const
+    {
+        return std::find_if(presences.cbegin(), presences.cend(), [&](const auto &p) {
+            return p.resource == resource;
+        });
+    }
+};
+
+}  // namespace QXmpp::Private
+
 class QXmppRosterManagerPrivate
 {
 public:
     QXmppRosterManagerPrivate();
 
     void clear();
+    void setEntries(const QList<QXmppRosterIq::Item> &items);
+    bool removeEntry(const QString &bareJid);
+    const QXmppRosterIq::Item *entry(const QString &bareJid) const;
 
-    // map of bareJid and its rosterEntry
-    QMap<QString, QXmppRosterIq::Item> entries;
-
-    // map of resources of the jid and map of resources and presences
-    QMap<QString, QMap<QString, QXmppPresence>> presences;
+    // bare JIDs mapped to roster entries and presences, the bare JID is only stored once
+    QHash<QString, RosterContact> contacts;
+    // number of contacts with a roster entry
+    qsizetype entryCount = 0;
 
     // flag to store that the roster has been populated
     bool isRosterReceived;
+
+    // optional cache for XEP-0237: Roster Versioning
+    QXmppRosterStorage *storage = nullptr;
 };
 
 QXmppRosterManagerPrivate::QXmppRosterManagerPrivate()
@@ -102,11 +156,59 @@ QXmppRosterManagerPrivate::QXmppRosterManagerPrivate()
 
 void QXmppRosterManagerPrivate::clear()
 {
-    entries.clear();
-    presences.clear();
+    contacts.clear();
+    entryCount = 0;
     isRosterReceived = false;
 }
 
+void QXmppRosterManagerPrivate::setEntries(const QList<QXmppRosterIq::Item> &items)
+{
+    // drop old entries, but keep the presences
+    for (auto itr = contacts.begin(); itr != contacts.end();) {
+        if (itr->presences.empty()) {
+            itr = contacts.erase(itr);
+        } else {
+            itr->item.reset();
+            ++itr;
+        }
+    }
+    entryCount = 0;
+
+    contacts.reserve(items.size());
+    for (const auto &item : items) {
+        auto &contact = contacts[item.bareJid()];
+        if (!contact.item) {
+            entryCount++;
+        }
+        contact.item = item;
+    }
+}
+
+bool QXmppRosterManagerPrivate::removeEntry(const QString &bareJid)
+{
+    auto itr = contacts.find(bareJid);
+    if (itr == contacts.end() || !itr->item) {
+        return false;
+    }
+
+    if (itr->presences.empty()) {
+        contacts.erase(itr);
+    } else {
+        itr->item.reset();
+    }
+    entryCount--;
+    return true;
+}
+
+const QXmppRosterIq::Item *QXmppRosterManagerPrivate::entry(const QString &bareJid) const
+{
+    auto itr = contacts.constFind(bareJid);
+    if (itr == contacts.cend() || !itr->item) {
+        return nullptr;
+    }
+    return &*itr->item;
+}
+
 ///
 /// Constructs a roster manager.
 ///
@@ -127,6 +229,35 @@ QXmppRosterManager::QXmppRosterManager(QXmppClient *client)
 
 QXmppRosterManager::~QXmppRosterManager() = default;
 
+///
+/// Returns the storage used to cache the roster between sessions.
+///
+/// \since QXmpp 1.8
+///
+QXmppRosterStorage *QXmppRosterManager::storage() const
+{
+    return d->storage;
+}
+
+///
+/// Sets a storage used to cache the roster between sessions.
+///
+/// If the server supports \xep{0237, Roster Versioning}, the version of the
+/// stored roster is sent on login and the server only transmits the changes
+/// since then. The stored roster is kept up to date with the roster pushes.
+///
+/// The storage is not owned by the manager and must outlive it. It should be
+/// set before connecting.
+///
+/// \param storage storage to use or nullptr to disable caching
+///
+/// \since QXmpp 1.8
+///
+void QXmppRosterManager::setStorage(QXmppRosterStorage *storage)
+{
+    d->storage = storage;
+}
+
 ///
 /// Accepts an existing subscription request or pre-approves future subscription
 /// requests.
@@ -160,20 +291,17 @@ void QXmppRosterManager::_q_connected()
     }
 
     if (!d->isRosterReceived && client()->isAuthenticated()) {
-        requestRoster().then(this, [this](auto &&result) {
-            if (auto *rosterIq = std::get_if<QXmppRosterIq>(&result)) {
-                // reset entries
-                d->entries.clear();
-                const auto items = rosterIq->items();
-                for (const auto &item : items) {
-                    d->entries.insert(item.bareJid(), item);
+        if (d->storage && client()->stream()->isRosterVersioningSupported()) {
+            d->storage->roster().then(this, [this](QXmppRosterStorage::Roster &&cached) {
+                // the stream may have been closed while loading the stored roster
+                if (client()->isAuthenticated()) {
+                    receiveRoster(cached.version, std::move(cached.items));
                 }
+            });
+            return;
+        }
 
-                // notify
-                d->isRosterReceived = true;
-                Q_EMIT rosterReceived();
-            }
-        });
+        receiveRoster({}, {});
     }
 }
 
@@ -211,20 +339,26 @@ bool QXmppRosterManager::handleStanza(const QDomElement &element)
 
         // store updated entries and notify changes
         const auto items = rosterIq.items();
+        if (d->storage) {
+            d->storage->updateItems(rosterIq.version(), items);
+        }
+
         for (const auto &item : items) {
             const QString bareJid = item.bareJid();
             if (item.subscriptionType() == QXmppRosterIq::Item::Remove) {
-                if (d->entries.remove(bareJid)) {
+                if (d->removeEntry(bareJid)) {
                     // notify the user that the item was removed
                     Q_EMIT itemRemoved(bareJid);
                 }
             } else {
-                const bool added = !d->entries.contains(bareJid);
-                d->entries.insert(bareJid, item);
-                if (added) {
+                auto &contact = d->contacts[bareJid];
+                if (!contact.item) {
+                    contact.item = item;
+                    d->entryCount++;
                     // notify the user that the item was added
                     Q_EMIT itemAdded(bareJid);
-                } else {
+                } else if (!isSameItem(*contact.item, item)) {
+                    contact.item = item;
                     // notify the user that the item changed
                     Q_EMIT itemChanged(bareJid);
                 }
@@ -251,12 +385,26 @@ void QXmppRosterManager::_q_presenceReceived(const QXmppPresence &presence)
     }
 
     switch (presence.type()) {
-    case QXmppPresence::Available:
-        d->presences[bareJid][resource] = presence;
+    case QXmppPresence::Available: {
+        auto &contact = d->contacts[bareJid];
+        if (auto itr = contact.findPresence(resource); itr != contact.presences.end()) {
+            itr->presence = presence;
+        } else {
+            contact.presences.push_back({ resource, presence });
+        }
         Q_EMIT presenceChanged(bareJid, resource);
         break;
+    }
     case QXmppPresence::Unavailable:
-        d->presences[bareJid].remove(resource);
+        if (auto contactItr = d->contacts.find(bareJid); contactItr != d->contacts.end()) {
+            auto &contact = *contactItr;
+            if (auto itr = contact.findPresence(resource); itr != contact.presences.end()) {
+                contact.presences.erase(itr);
+            }
+            if (!contact.item && contact.presences.empty()) {
+                d->contacts.erase(contactItr);
+            }
+        }
         Q_EMIT presenceChanged(bareJid, resource);
         break;
     case QXmppPresence::Subscribe:
@@ -276,16 +424,75 @@ void QXmppRosterManager::_q_presenceReceived(const QXmppPresence &presence)
     }
 }
 
-QXmppTask<QXmppRosterManager::RosterResult> QXmppRosterManager::requestRoster()
+//
+// Requests the roster.
+//
+// If a version is passed (XEP-0237: Roster Versioning), the server replies with an empty result
+// if the roster of that version is up to date and delivers the changes since then as roster
+// pushes. The result is an empty optional in that case.
+//
+QXmppTask<QXmppRosterManager::RosterResult> QXmppRosterManager::requestRoster(const std::optional<QString> &version)
 {
     QXmppRosterIq iq;
     iq.setType(QXmppIq::Get);
     iq.setFrom(client()->configuration().jid());
+    if (version) {
+        iq.setVersion(*version);
+    }
 
     // TODO: Request MIX annotations only when the server supports MIX-PAM.
     iq.setMixAnnotate(true);
 
-    return chainIq<RosterResult>(client()->sendIq(std::move(iq)), this);
+    return chain<RosterResult>(client()->sendIq(std::move(iq)), this, [](QXmppClient::IqResult &&result) -> RosterResult {
+        if (auto *element = std::get_if<QDomElement>(&result)) {
+            if (!QXmppRosterIq::isRosterIq(*element)) {
+                return std::optional<QXmppRosterIq>();
+            }
+
+            QXmppRosterIq rosterIq;
+            rosterIq.parse(*element);
+            return rosterIq;
+        }
+        return std::get<QXmppError>(std::move(result));
+    });
+}
+
+//
+// Requests the roster and replaces the entries by it. The cached roster is used if the server
+// reports that its version is up to date.
+//
+void QXmppRosterManager::receiveRoster(const std::optional<QString> &cachedVersion, QList<QXmppRosterIq::Item> &&cachedItems)
+{
+    requestRoster(cachedVersion).then(this, [this, cached = cachedVersion.has_value(), cachedItems = std::move(cachedItems)](RosterResult &&result) {
+        if (auto *error = std::get_if<QXmppError>(&result)) {
+            warning(u"Could not request the roster: "_s + error->description);
+            return;
+        }
+
+        if (auto &rosterIq = std::get<std::optional<QXmppRosterIq>>(result)) {
+            setRoster(rosterIq->version(), rosterIq->items());
+        } else if (cached) {
+            // the stored roster is up to date
+            d->setEntries(cachedItems);
+
+            d->isRosterReceived = true;
+            Q_EMIT rosterReceived();
+        }
+    });
+}
+
+void QXmppRosterManager::setRoster(const QString &version, const QList<QXmppRosterIq::Item> &items)
+{
+    // reset entries
+    d->setEntries(items);
+
+    if (d->storage) {
+        d->storage->replaceRoster({ version, items });
+    }
+
+    // notify
+    d->isRosterReceived = true;
+    Q_EMIT rosterReceived();
 }
 
 ///
@@ -349,12 +556,13 @@ QXmppTask<QXmppRosterManager::Result> QXmppRosterManager::removeRosterItem(const
 ///
 QXmppTask<QXmppRosterManager::Result> QXmppRosterManager::renameRosterItem(const QString &bareJid, const QString &name)
 {
-    if (!d->entries.contains(bareJid)) {
+    const auto *entry = d->entry(bareJid);
+    if (!entry) {
         return makeReadyTask<Result>(
             QXmppError { u"The roster doesn't contain this user."_s, {} });
     }
 
-    auto item = d->entries.value(bareJid);
+    auto item = *entry;
     item.setName(name);
 
     // If there is a pending subscription, do not include the corresponding attribute in the stanza.
@@ -471,11 +679,12 @@ bool QXmppRosterManager::removeItem(const QString &bareJid)
 ///
 bool QXmppRosterManager::renameItem(const QString &bareJid, const QString &name)
 {
-    if (!d->entries.contains(bareJid)) {
+    const auto *entry = d->entry(bareJid);
+    if (!entry) {
         return false;
     }
 
-    auto item = d->entries.value(bareJid);
+    auto item = *entry;
     item.setName(name);
 
     // If there is a pending subscription, do not include the corresponding attribute in the stanza.
@@ -556,8 +765,8 @@ void QXmppRosterManager::onRegistered(QXmppClient *client)
         };
 
         auto exportData = [this]() {
-            return chainMapSuccess(requestRoster(), this, [](QXmppRosterIq &&iq) -> RosterData {
-                return { iq.items() };
+            return chainMapSuccess(requestRoster(), this, [](std::optional<QXmppRosterIq> &&iq) -> RosterData {
+                return { iq ? iq->items() : QList<QXmppRosterIq::Item>() };
             });
         };
 
@@ -575,11 +784,37 @@ void QXmppRosterManager::onUnregistered(QXmppClient *client)
 ///
 /// Function to get all the bareJids present in the roster.
 ///
-/// \return QStringList list of all the bareJids
+/// \return QStringList list of all the bareJids, sorted
 ///
 QStringList QXmppRosterManager::getRosterBareJids() const
 {
-    return d->entries.keys();
+    QStringList bareJids;
+    bareJids.reserve(d->entryCount);
+    for (auto itr = d->contacts.cbegin(); itr != d->contacts.cend(); ++itr) {
+        if (itr->item) {
+            bareJids.push_back(itr.key());
+        }
+    }
+    // the contacts are hashed, keep the sorted order of earlier versions
+    std::sort(bareJids.begin(), bareJids.end());
+    return bareJids;
+}
+
+///
+/// Calls \a visitor for each entry of the roster without copying the roster.
+///
+/// The entries are visited in no particular order. The visitor can return true to
+/// stop the iteration. The roster must not be modified from within the visitor.
+///
+/// \since QXmpp 1.8
+///
+void QXmppRosterManager::visitRosterEntries(std::function<bool(const QXmppRosterIq::Item &)> &&visitor) const
+{
+    for (const auto &contact : std::as_const(d->contacts)) {
+        if (contact.item && visitor(*contact.item)) {
+            return;
+        }
+    }
 }
 
 ///
@@ -592,8 +827,8 @@ QXmppRosterIq::Item QXmppRosterManager::getRosterEntry(
     const QString &bareJid) const
 {
     // will return blank entry if bareJid doesn't exist
-    if (d->entries.contains(bareJid)) {
-        return d->entries.value(bareJid);
+    if (const auto *entry = d->entry(bareJid)) {
+        return *entry;
     }
     return {};
 }
@@ -602,14 +837,20 @@ QXmppRosterIq::Item QXmppRosterManager::getRosterEntry(
 /// Get all the associated resources with the given bareJid.
 ///
 /// \param bareJid as a QString
-/// \return list of associated resources as a QStringList
+/// \return list of associated resources as a QStringList, sorted
 ///
 QStringList QXmppRosterManager::getResources(const QString &bareJid) const
 {
-    if (d->presences.contains(bareJid)) {
-        return d->presences[bareJid].keys();
+    QStringList resources;
+    if (auto itr = d->contacts.constFind(bareJid); itr != d->contacts.cend()) {
+        resources.reserve(itr->presences.size());
+        for (const auto &resourcePresence : itr->presences) {
+            resources.push_back(resourcePresence.resource);
+        }
     }
-    return {};
+    // the presences are kept in arrival order, keep the sorted order of earlier versions
+    std::sort(resources.begin(), resources.end());
+    return resources;
 }
 
 ///
@@ -623,10 +864,34 @@ QStringList QXmppRosterManager::getResources(const QString &bareJid) const
 QMap<QString, QXmppPresence> QXmppRosterManager::getAllPresencesForBareJid(
     const QString &bareJid) const
 {
-    if (d->presences.contains(bareJid)) {
-        return d->presences.value(bareJid);
+    QMap<QString, QXmppPresence> presences;
+    if (auto itr = d->contacts.constFind(bareJid); itr != d->contacts.cend()) {
+        for (const auto &resourcePresence : itr->presences) {
+            presences.insert(resourcePresence.resource, resourcePresence.presence);
+        }
+    }
+    return presences;
+}
+
+///
+/// Calls \a visitor with the resource and presence of each available resource of
+/// \a bareJid without copying any container. The resources are visited in the
+/// order in which they became available.
+///
+/// The visitor can return true to stop the iteration. Presences must not be
+/// modified from within the visitor.
+///
+/// \since QXmpp 1.8
+///
+void QXmppRosterManager::visitPresences(const QString &bareJid, std::function<bool(const QString &, const QXmppPresence &)> &&visitor) const
+{
+    if (auto itr = d->contacts.constFind(bareJid); itr != d->contacts.cend()) {
+        for (const auto &resourcePresence : itr->presences) {
+            if (visitor(resourcePresence.resource, resourcePresence.presence)) {
+                return;
+            }
+        }
     }
-    return {};
 }
 
 ///
@@ -639,8 +904,10 @@ QMap<QString, QXmppPresence> QXmppRosterManager::getAllPresencesForBareJid(
 QXmppPresence QXmppRosterManager::getPresence(const QString &bareJid,
                                               const QString &resource) const
 {
-    if (d->presences.contains(bareJid) && d->presences[bareJid].contains(resource)) {
-        return d->presences[bareJid][resource];
+    if (auto contactItr = d->contacts.constFind(bareJid); contactItr != d->contacts.cend()) {
+        if (auto itr = contactItr->findPresence(resource); itr != contactItr->presences.cend()) {
+            return itr->presence;
+        }
     }
 
     QXmppPresence presence;
@@ -12,6 +12,8 @@
 #include "QXmppRosterIq.h"
 #include "QXmppSendResult.h"
 
+#include <functional>
+#include <optional>
 #include <variant>
 
 #include <QMap>
@@ -21,6 +23,7 @@
 template<typename T>
 class QXmppTask;
 class QXmppRosterManagerPrivate;
+class QXmppRosterStorage;
 
 ///
 /// \brief The QXmppRosterManager class provides access to a connected client's
@@ -50,6 +53,10 @@ class QXmppRosterManagerPrivate;
 /// The \c presenceChanged() signal is emitted whenever the presence for a
 /// roster item changes.
 ///
+/// If a QXmppRosterStorage is set using \c setStorage() and the server supports
+/// \xep{0237, Roster Versioning}, the roster is cached and on login only the
+/// changes since the last session are requested.
+///
 /// \ingroup Managers
 ///
 class QXMPP_EXPORT QXmppRosterManager : public QXmppClientExtension
@@ -63,15 +70,20 @@ public:
     explicit QXmppRosterManager(QXmppClient *stream);
     ~QXmppRosterManager() override;
 
+    QXmppRosterStorage *storage() const;
+    void setStorage(QXmppRosterStorage *storage);
+
     bool isRosterReceived() const;
     QStringList getRosterBareJids() const;
     QXmppRosterIq::Item getRosterEntry(const QString &bareJid) const;
+    void visitRosterEntries(std::function<bool(const QXmppRosterIq::Item &)> &&visitor) const;
 
     QStringList getResources(const QString &bareJid) const;
     QMap<QString, QXmppPresence> getAllPresencesForBareJid(
         const QString &bareJid) const;
     QXmppPresence getPresence(const QString &bareJid,
                               const QString &resource) const;
+    void visitPresences(const QString &bareJid, std::function<bool(const QString &, const QXmppPresence &)> &&visitor) const;
 
     QXmppTask<Result> addRosterItem(const QString &bareJid, const QString &name = {}, const QSet<QString> &groups = {});
     QXmppTask<Result> removeRosterItem(const QString &bareJid);
@@ -139,8 +151,10 @@ private Q_SLOTS:
     void _q_presenceReceived(const QXmppPresence &);
 
 private:
-    using RosterResult = std::variant<QXmppRosterIq, QXmppError>;
-    QXmppTask<RosterResult> requestRoster();
+    using RosterResult = std::variant<std::optional<QXmppRosterIq>, QXmppError>;
+    QXmppTask<RosterResult> requestRoster(const std::optional<QString> &version = {});
+    void receiveRoster(const std::optional<QString> &cachedVersion, QList<QXmppRosterIq::Item> &&cachedItems);
+    void setRoster(const QString &version, const QList<QXmppRosterIq::Item> &items);
 
     const std::unique_ptr<QXmppRosterManagerPrivate> d;
 };
@@ -0,0 +1,83 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppRosterMemoryStorage.h"
+
+#include "QXmppFutureUtils_p.h"
+
+#include <QHash>
+
+using namespace QXmpp::Private;
+
+///
+/// \class QXmppRosterMemoryStorage
+///
+/// \brief The QXmppRosterMemoryStorage class stores the roster in the memory.
+///
+/// This keeps the roster over reconnects of the same QXmppClient, so that only
+/// the changes need to be requested if the server supports
+/// \xep{0237, Roster Versioning}. Use QXmppRosterFileStorage to keep the roster
+/// between application restarts.
+///
+/// \since QXmpp 1.8
+///
+
+class QXmppRosterMemoryStoragePrivate
+{
+public:
+    QString version;
+
+    // bare JIDs mapped to roster items
+    QHash<QString, QXmppRosterIq::Item> items;
+};
+
+///
+/// Constructs a roster memory storage.
+///
+QXmppRosterMemoryStorage::QXmppRosterMemoryStorage()
+    : d(std::make_unique<QXmppRosterMemoryStoragePrivate>())
+{
+}
+
+QXmppRosterMemoryStorage::~QXmppRosterMemoryStorage() = default;
+
+/// \cond
+QXmppTask<QXmppRosterStorage::Roster> QXmppRosterMemoryStorage::roster()
+{
+    return makeReadyTask(Roster { d->version, d->items.values() });
+}
+
+QXmppTask<void> QXmppRosterMemoryStorage::replaceRoster(const Roster &roster)
+{
+    d->version = roster.version;
+    d->items.clear();
+    d->items.reserve(roster.items.size());
+    for (const auto &item : roster.items) {
+        d->items.insert(item.bareJid(), item);
+    }
+    return makeReadyTask();
+}
+
+QXmppTask<void> QXmppRosterMemoryStorage::updateItems(const QString &version, const QList<QXmppRosterIq::Item> &items)
+{
+    if (!version.isEmpty()) {
+        d->version = version;
+    }
+    for (const auto &item : items) {
+        if (item.subscriptionType() == QXmppRosterIq::Item::Remove) {
+            d->items.remove(item.bareJid());
+        } else {
+            d->items.insert(item.bareJid(), item);
+        }
+    }
+    return makeReadyTask();
+}
+
+QXmppTask<void> QXmppRosterMemoryStorage::resetAll()
+{
+    d->version.clear();
+    d->items.clear();
+    return makeReadyTask();
+}
+/// \endcond
@@ -0,0 +1,32 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPROSTERMEMORYSTORAGE_H
+#define QXMPPROSTERMEMORYSTORAGE_H
+
+#include "QXmppRosterStorage.h"
+
+#include <memory>
+
+class QXmppRosterMemoryStoragePrivate;
+
+class QXMPP_EXPORT QXmppRosterMemoryStorage : public QXmppRosterStorage
+{
+public:
+    QXmppRosterMemoryStorage();
+    ~QXmppRosterMemoryStorage() override;
+
+    /// \cond
+    QXmppTask<Roster> roster() override;
+    QXmppTask<void> replaceRoster(const Roster &roster) override;
+    QXmppTask<void> updateItems(const QString &version, const QList<QXmppRosterIq::Item> &items) override;
+
+    QXmppTask<void> resetAll() override;
+    /// \endcond
+
+private:
+    const std::unique_ptr<QXmppRosterMemoryStoragePrivate> d;
+};
+
+#endif  // QXMPPROSTERMEMORYSTORAGE_H
@@ -0,0 +1,51 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+///
+/// \class QXmppRosterStorage
+///
+/// \brief The QXmppRosterStorage class stores the roster and its
+/// \xep{0237, Roster Versioning} version between sessions.
+///
+/// If a storage is set on the QXmppRosterManager and the server supports roster
+/// versioning, the manager only requests the changes since the stored version.
+///
+/// \sa QXmppRosterManager::setStorage()
+///
+/// \since QXmpp 1.8
+///
+
+///
+/// \fn QXmppRosterStorage::roster()
+///
+/// Returns the stored roster.
+///
+/// \return the stored version and items, empty if nothing has been stored yet
+///
+
+///
+/// \fn QXmppRosterStorage::replaceRoster(const Roster &roster)
+///
+/// Replaces the stored roster by a complete roster received from the server.
+///
+/// \param roster new version and items
+///
+
+///
+/// \fn QXmppRosterStorage::updateItems(const QString &version, const QList<QXmppRosterIq::Item> &items)
+///
+/// Applies a roster push to the stored roster.
+///
+/// Items with the subscription type QXmppRosterIq::Item::Remove are removed,
+/// all other items are added or replace the stored item with the same bare JID.
+///
+/// \param version new roster version, the stored version is kept if this is empty
+/// \param items changed items
+///
+
+///
+/// \fn QXmppRosterStorage::resetAll()
+///
+/// Removes the stored roster including its version.
+///
@@ -0,0 +1,40 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPROSTERSTORAGE_H
+#define QXMPPROSTERSTORAGE_H
+
+#include "QXmppRosterIq.h"
+
+template<typename T>
+class QXmppTask;
+
+class QXMPP_EXPORT QXmppRosterStorage
+{
+public:
+    ///
+    /// Contains a cached roster.
+    ///
+    struct Roster {
+        ///
+        /// Roster version as announced by the server (may be empty)
+        ///
+        QString version;
+
+        ///
+        /// All items of the roster
+        ///
+        QList<QXmppRosterIq::Item> items;
+    };
+
+    virtual ~QXmppRosterStorage() = default;
+
+    virtual QXmppTask<Roster> roster() = 0;
+    virtual QXmppTask<void> replaceRoster(const Roster &roster) = 0;
+    virtual QXmppTask<void> updateItems(const QString &version, const QList<QXmppRosterIq::Item> &items) = 0;
+
+    virtual QXmppTask<void> resetAll() = 0;
+};
+
+#endif  // QXMPPROSTERSTORAGE_H
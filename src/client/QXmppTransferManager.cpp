@@ -17,6 +17,8 @@
 
 #include "StringLiterals.h"
 
+#include <algorithm>
+
 #include <QCryptographicHash>
 #include <QDomElement>
 #include <QElapsedTimer>
@@ -30,11 +32,28 @@
 #include <QTimer>
 #include <QUrl>
 
+#ifdef Q_OS_LINUX
+#include <cerrno>
+
+#include <sys/sendfile.h>
+#endif
+
 using namespace QXmpp::Private;
 
 // time to try to connect to a SOCKS host (7 seconds)
 const int socksTimeout = 7000;
 
+// SOCKS5 bytestreams use blocks of the size of the socket buffers within these limits
+constexpr int SOCKS_MIN_BLOCK_SIZE = 16 * 1024;
+constexpr int SOCKS_MAX_BLOCK_SIZE = 1024 * 1024;
+// maximum number of bytes sent before returning to the event loop
+constexpr qint64 SOCKS_MAX_SEND_BATCH = 8 * SOCKS_MAX_BLOCK_SIZE;
+
+static int socksBlockSize(QAbstractSocket *socket, QAbstractSocket::SocketOption bufferSizeOption)
+{
+    return std::clamp(socket->socketOption(bufferSizeOption).toInt(), SOCKS_MIN_BLOCK_SIZE, SOCKS_MAX_BLOCK_SIZE);
+}
+
 static QString streamHash(const QString &sid, const QString &initiatorJid, const QString &targetJid)
 {
     QCryptographicHash hash(QCryptographicHash::Sha1);
@@ -226,6 +245,7 @@ public:
     QXmppTransferJob::State state;
     QElapsedTimer transferStart;
     bool deviceIsOwn;
+    bool hashingEnabled;
 
     // file meta-data
     QXmppTransferFileInfo fileInfo;
@@ -236,6 +256,10 @@ public:
     // for socks5 bytestreams
     QTcpSocket *socksSocket;
     QXmppByteStreamIq::StreamHost socksProxy;
+    // reused for all blocks passed through the socket
+    QByteArray socksBuffer;
+    // set after sendfile() failed for the file or the socket
+    bool sendFileUnsupported;
 };
 
 QXmppTransferJobPrivate::QXmppTransferJobPrivate()
@@ -249,8 +273,10 @@ QXmppTransferJobPrivate::QXmppTransferJobPrivate()
       method(QXmppTransferJob::NoMethod),
       state(QXmppTransferJob::OfferState),
       deviceIsOwn(false),
+      hashingEnabled(true),
       ibbSequence(0),
-      socksSocket(nullptr)
+      socksSocket(nullptr),
+      sendFileUnsupported(false)
 {
 }
 
@@ -466,7 +492,7 @@ QXmppTransferIncomingJob::QXmppTransferIncomingJob(const QString &jid, QXmppClie
 void QXmppTransferIncomingJob::checkData()
 {
     if ((d->fileInfo.size() && d->done != d->fileInfo.size()) ||
-        (!d->fileInfo.hash().isEmpty() && d->hash.result() != d->fileInfo.hash())) {
+        (d->hashingEnabled && !d->fileInfo.hash().isEmpty() && d->hash.result() != d->fileInfo.hash())) {
         terminate(QXmppTransferJob::FileCorruptError);
     } else {
         terminate(QXmppTransferJob::NoError);
@@ -530,7 +556,7 @@ bool QXmppTransferIncomingJob::writeData(const QByteArray &data)
         return false;
     }
     d->done += written;
-    if (!d->fileInfo.hash().isEmpty()) {
+    if (d->hashingEnabled && !d->fileInfo.hash().isEmpty()) {
         d->hash.addData(data);
     }
     Q_EMIT progress(d->done, d->fileInfo.size());
@@ -551,6 +577,7 @@ void QXmppTransferIncomingJob::_q_candidateReady()
     m_candidateTimer->deleteLater();
     m_candidateTimer = nullptr;
 
+    d->blockSize = socksBlockSize(d->socksSocket, QAbstractSocket::ReceiveBufferSizeSocketOption);
     connect(d->socksSocket, &QIODevice::readyRead, this, &QXmppTransferIncomingJob::_q_receiveData);
     connect(d->socksSocket, &QAbstractSocket::disconnected, this, &QXmppTransferIncomingJob::_q_disconnected);
 
@@ -595,9 +622,16 @@ void QXmppTransferIncomingJob::_q_receiveData()
         return;
     }
 
-    // receive data block
+    // receive data blocks into a reused buffer
     if (d->direction == QXmppTransferJob::IncomingDirection) {
-        writeData(d->socksSocket->readAll());
+        d->socksBuffer.resize(d->blockSize);
+        while (d->socksSocket->bytesAvailable() > 0) {
+            const auto length = d->socksSocket->read(d->socksBuffer.data(), d->socksBuffer.size());
+            if (length <= 0) {
+                break;
+            }
+            writeData(QByteArray::fromRawData(d->socksBuffer.constData(), int(length)));
+        }
 
         // if we have received all the data, stop here
         if (fileSize() && d->done >= fileSize()) {
@@ -632,6 +666,7 @@ void QXmppTransferOutgoingJob::startSending()
 {
     setState(QXmppTransferJob::TransferState);
 
+    d->blockSize = socksBlockSize(d->socksSocket, QAbstractSocket::SendBufferSizeSocketOption);
     connect(d->socksSocket, &QIODevice::bytesWritten, this, &QXmppTransferOutgoingJob::_q_sendData);
     connect(d->iodevice, &QIODevice::readyRead, this, &QXmppTransferOutgoingJob::_q_sendData);
 
@@ -683,19 +718,92 @@ void QXmppTransferOutgoingJob::_q_sendData()
         return;
     }
 
-    char *buffer = new char[d->blockSize];
-    qint64 length = d->iodevice->read(buffer, d->blockSize);
+#ifdef Q_OS_LINUX
+    // the next block is queued on the socket below, so its bytesWritten() signal continues the
+    // transfer once the socket can take more data
+    if (sendFileData()) {
+        return;
+    }
+#endif
+
+    d->socksBuffer.resize(d->blockSize);
+    qint64 length = d->iodevice->read(d->socksBuffer.data(), d->blockSize);
     if (length < 0) {
-        delete[] buffer;
         terminate(QXmppTransferJob::FileAccessError);
         return;
     } else {
-        d->socksSocket->write(buffer, length);
-        delete[] buffer;
+        d->socksSocket->write(d->socksBuffer.constData(), length);
         d->done += length;
         Q_EMIT progress(d->done, fileSize());
     }
 }
+
+#ifdef Q_OS_LINUX
+// Sends data of files directly from the page cache to the socket using sendfile() until the
+// socket buffer is full.
+//
+// This is only possible if the socket's own write buffer is empty. Returns true if the job has
+// been terminated, otherwise the caller continues with the socket.
+bool QXmppTransferOutgoingJob::sendFileData()
+{
+    auto *file = qobject_cast<QFile *>(d->iodevice);
+    const auto socketDescriptor = d->socksSocket->socketDescriptor();
+    if (d->sendFileUnsupported || !file || file->handle() < 0 || socketDescriptor < 0 || d->socksSocket->bytesToWrite() > 0) {
+        return false;
+    }
+
+    off_t offset = file->pos();
+    qint64 sent = 0;
+    bool atEnd = false;
+    while (sent < SOCKS_MAX_SEND_BATCH) {
+        // don't send more than announced
+        const auto length = fileSize() ? std::min(qint64(d->blockSize), fileSize() - d->done - sent) : qint64(d->blockSize);
+        const auto result = length > 0 ? ::sendfile(int(socketDescriptor), file->handle(), &offset, size_t(length)) : 0;
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN) {
+                // socket buffer is full
+                break;
+            }
+            if (errno == EINVAL || errno == ENOSYS) {
+                // e.g. files on file systems that don't support sendfile(), only use the socket
+                // from now on
+                d->sendFileUnsupported = true;
+                break;
+            }
+            terminate(QXmppTransferJob::FileAccessError);
+            return true;
+        }
+        if (result == 0) {
+            atEnd = true;
+            break;
+        }
+        sent += result;
+    }
+
+    if (sent > 0) {
+        if (!file->seek(offset)) {
+            terminate(QXmppTransferJob::FileAccessError);
+            return true;
+        }
+        d->done += sent;
+        Q_EMIT progress(d->done, fileSize());
+    }
+
+    // there is nothing left to queue on the socket
+    if (fileSize() && d->done >= fileSize()) {
+        atEnd = true;
+    }
+
+    if (atEnd) {
+        terminate(fileSize() && d->done != fileSize() ? QXmppTransferJob::FileAccessError : QXmppTransferJob::NoError);
+        return true;
+    }
+    return false;
+}
+#endif
 /// \endcond
 
 class QXmppTransferManagerPrivate
@@ -713,6 +821,7 @@ public:
     bool proxyOnly;
     QXmppSocksServer *socksServer;
     QXmppTransferJob::Methods supportedMethods;
+    bool hashingEnabled;
 
 private:
     QXmppTransferJob *getJobByRequestId(QXmppTransferJob::Direction direction, const QString &jid, const QString &id);
@@ -722,7 +831,8 @@ QXmppTransferManagerPrivate::QXmppTransferManagerPrivate()
     : ibbBlockSize(4096),
       proxyOnly(false),
       socksServer(nullptr),
-      supportedMethods(QXmppTransferJob::AnyMethod)
+      supportedMethods(QXmppTransferJob::AnyMethod),
+      hashingEnabled(true)
 {
 }
 
@@ -1278,7 +1388,7 @@ QXmppTransferJob *QXmppTransferManager::sendFile(const QString &jid, const QStri
     }
 
     // hash file
-    if (device && !device->isSequential()) {
+    if (device && !device->isSequential() && d->hashingEnabled) {
         QCryptographicHash hash(QCryptographicHash::Md5);
         QByteArray buffer;
         while (device->bytesAvailable()) {
@@ -1318,6 +1428,7 @@ QXmppTransferJob *QXmppTransferManager::sendFile(const QString &jid, QIODevice *
     job->d->sid = sid.isEmpty() ? QXmppUtils::generateStanzaHash() : sid;
     job->d->fileInfo = fileInfo;
     job->d->iodevice = device;
+    job->d->hashingEnabled = d->hashingEnabled;
 
     // check file is open
     if (!device || !device->isReadable()) {
@@ -1522,6 +1633,7 @@ void QXmppTransferManager::streamInitiationSetReceived(const QXmppStreamInitiati
     job->d->sid = iq.siId();
     job->d->mimeType = iq.mimeType();
     job->d->fileInfo = iq.fileInfo();
+    job->d->hashingEnabled = d->hashingEnabled;
 
     const auto &form = iq.featureForm();
     const auto &fields = form.fields();
@@ -1621,3 +1733,23 @@ void QXmppTransferManager::setSupportedMethods(QXmppTransferJob::Methods methods
 {
     d->supportedMethods = methods;
 }
+
+bool QXmppTransferManager::hashingEnabled() const
+{
+    return d->hashingEnabled;
+}
+
+///
+/// Set whether transferred files are hashed to verify their integrity.
+///
+/// If enabled, files sent using sendFile() with a file path are hashed before
+/// the transfer is offered and the hashes of received files are compared with
+/// the hash announced by the sender. Disabling this avoids reading sent files
+/// twice and hashing the data of fast transfers. The default is true.
+///
+/// \since QXmpp 1.8
+///
+void QXmppTransferManager::setHashingEnabled(bool enabled)
+{
+    d->hashingEnabled = enabled;
+}
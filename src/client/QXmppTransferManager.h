@@ -199,6 +199,8 @@ class QXMPP_EXPORT QXmppTransferManager : public QXmppClientExtension
     Q_PROPERTY(bool proxyOnly READ proxyOnly WRITE setProxyOnly)
     /// The supported stream methods
     Q_PROPERTY(QXmppTransferJob::Methods supportedMethods READ supportedMethods WRITE setSupportedMethods)
+    /// Whether transferred files are hashed to verify their integrity
+    Q_PROPERTY(bool hashingEnabled READ hashingEnabled WRITE setHashingEnabled)
 
 public:
     QXmppTransferManager();
@@ -222,6 +224,13 @@ public:
     QXmppTransferJob::Methods supportedMethods() const;
     void setSupportedMethods(QXmppTransferJob::Methods methods);
 
+    // documentation needs to be here, see https://stackoverflow.com/questions/49192523/
+    /// Return whether transferred files are hashed to verify their integrity.
+    ///
+    /// \since QXmpp 1.8
+    bool hashingEnabled() const;
+    void setHashingEnabled(bool enabled);
+
     /// \cond
     QStringList discoveryFeatures() const override;
     bool handleStanza(const QDomElement &element) override;
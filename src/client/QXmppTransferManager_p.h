@@ -64,6 +64,11 @@ public Q_SLOTS:
 private Q_SLOTS:
     void _q_proxyReady();
     void _q_sendData();
+
+private:
+#ifdef Q_OS_LINUX
+    bool sendFileData();
+#endif
 };
 
 #endif
@@ -9,13 +9,21 @@
 #include "QXmppConstants_p.h"
 #include "QXmppError.h"
 #include "QXmppFutureUtils_p.h"
+#include "QXmppMucIq.h"
+#include "QXmppPresence.h"
 #include "QXmppTask.h"
 #include "QXmppUtils.h"
 #include "QXmppUtils_p.h"
 #include "QXmppVCardIq.h"
+#include "QXmppVCardStorage.h"
 
 #include "StringLiterals.h"
 
+#include <QCache>
+#include <QCryptographicHash>
+#include <QSet>
+
+using namespace std::chrono_literals;
 using namespace QXmpp::Private;
 
 namespace QXmpp::Private {
@@ -54,16 +62,76 @@ void serializeVCardData(const VCardData &data, QXmlStreamWriter &writer)
 
 }  // namespace QXmpp::Private
 
+// Rough cost of a vCard in the cache: the photo dominates, the other fields are estimated.
+static qsizetype vCardCost(const QXmppVCardIq &vCard)
+{
+    return vCard.photo().size() + 1024;
+}
+
+// XEP-0153: SHA-1 of the binary photo data, empty if there is no photo
+static QByteArray photoHash(const QXmppVCardIq &vCard)
+{
+    if (vCard.photo().isEmpty()) {
+        return {};
+    }
+    return QCryptographicHash::hash(vCard.photo(), QCryptographicHash::Sha1);
+}
+
+struct CachedVCard {
+    QXmppVCardIq vCard;
+    std::chrono::steady_clock::time_point expires;
+};
+
 class QXmppVCardManagerPrivate
 {
 public:
     QXmppVCardIq clientVCard;
     bool isClientVCardReceived = false;
+
+    // least recently used vCards of other entities, the cost is the approximate size in bytes
+    QCache<QString, CachedVCard> cache;
+    std::chrono::seconds cacheDuration = 1h;
+    // photo hashes announced via XEP-0153, empty if the entity has no photo
+    QHash<QString, QByteArray> photoHashes;
+    // pending fetches with all callers waiting for the vCard
+    QHash<QString, QList<QXmppPromise<QXmppVCardManager::VCardIqResult>>> fetches;
+    // pending fetches that must not be answered from the storage
+    QSet<QString> refreshes;
+    QXmppVCardStorage *storage = nullptr;
+
+    bool isCurrent(const QString &bareJid, const QXmppVCardIq &vCard, std::optional<std::chrono::steady_clock::time_point> expires) const;
+    const QXmppVCardIq *cachedVCard(const QString &bareJid) const;
+    void cacheVCard(const QString &bareJid, const QXmppVCardIq &vCard);
 };
 
+// A vCard is outdated if its photo does not match the hash announced by the entity. Without an
+// announced hash, it is only used until it expires.
+bool QXmppVCardManagerPrivate::isCurrent(const QString &bareJid, const QXmppVCardIq &vCard, std::optional<std::chrono::steady_clock::time_point> expires) const
+{
+    if (const auto itr = photoHashes.constFind(bareJid); itr != photoHashes.cend()) {
+        return *itr == photoHash(vCard);
+    }
+    return expires && *expires > std::chrono::steady_clock::now();
+}
+
+const QXmppVCardIq *QXmppVCardManagerPrivate::cachedVCard(const QString &bareJid) const
+{
+    if (auto *cached = cache.object(bareJid); cached && isCurrent(bareJid, cached->vCard, cached->expires)) {
+        return &cached->vCard;
+    }
+    return nullptr;
+}
+
+void QXmppVCardManagerPrivate::cacheVCard(const QString &bareJid, const QXmppVCardIq &vCard)
+{
+    cache.insert(bareJid, new CachedVCard { vCard, std::chrono::steady_clock::now() + cacheDuration }, vCardCost(vCard));
+}
+
 QXmppVCardManager::QXmppVCardManager()
     : d(std::make_unique<QXmppVCardManagerPrivate>())
 {
+    // caching is opt-in
+    d->cache.setMaxCost(0);
     QXmppExportData::registerExtension<VCardData, VCardData::fromDom, serializeVCardData>(u"vcard", ns_qxmpp_export);
 }
 
@@ -72,11 +140,162 @@ QXmppVCardManager::~QXmppVCardManager() = default;
 ///
 /// Fetches the VCard of a bare JID.
 ///
+/// If enabled using setCacheSize() or setStorage(), vCards are cached in the
+/// memory or in the storage. A cached vCard is returned without any network
+/// traffic as long as its photo matches the hash the entity announces in its
+/// presence using \xep{0153, vCard-Based Avatars}. If the entity hasn't
+/// announced a hash, a vCard cached in the memory is used for cacheDuration()
+/// and a vCard from the storage is requested again. Concurrent fetches of the
+/// same JID are merged into a single request.
+///
+/// \sa refreshVCard()
+///
 /// \since QXmpp 1.8
 ///
 QXmppTask<QXmppVCardManager::VCardIqResult> QXmppVCardManager::fetchVCard(const QString &bareJid)
 {
-    return chainIq<VCardIqResult>(client()->sendIq(QXmppVCardIq(bareJid)), this);
+    if (auto *vCard = d->cachedVCard(bareJid)) {
+        return makeReadyTask<VCardIqResult>(QXmppVCardIq(*vCard));
+    }
+    d->cache.remove(bareJid);
+
+    QXmppPromise<VCardIqResult> promise;
+    auto task = promise.task();
+
+    auto &fetches = d->fetches[bareJid];
+    fetches.append(promise);
+    if (fetches.size() > 1) {
+        // the vCard is already being fetched
+        return task;
+    }
+
+    if (d->storage) {
+        d->storage->vCard(bareJid).then(this, [this, bareJid](std::optional<QXmppVCardIq> &&vCard) {
+            if (vCard && !d->refreshes.contains(bareJid) && d->isCurrent(bareJid, *vCard, {})) {
+                d->cacheVCard(bareJid, *vCard);
+                finishVCardFetches(bareJid, std::move(*vCard));
+            } else {
+                requestVCardFromServer(bareJid);
+            }
+        });
+    } else {
+        requestVCardFromServer(bareJid);
+    }
+    return task;
+}
+
+///
+/// Requests the vCard of a bare JID from the server, even if it is cached.
+///
+/// The cache and the storage() are updated with the received vCard.
+///
+/// \since QXmpp 1.8
+///
+QXmppTask<QXmppVCardManager::VCardIqResult> QXmppVCardManager::refreshVCard(const QString &bareJid)
+{
+    d->cache.remove(bareJid);
+
+    QXmppPromise<VCardIqResult> promise;
+    auto task = promise.task();
+
+    auto &fetches = d->fetches[bareJid];
+    fetches.append(promise);
+    if (fetches.size() > 1) {
+        // a pending fetch must not use the storage anymore
+        d->refreshes.insert(bareJid);
+        return task;
+    }
+
+    requestVCardFromServer(bareJid);
+    return task;
+}
+
+///
+/// Returns the cached vCard of a bare JID without fetching it.
+///
+/// Only vCards cached in the memory are returned, the storage() is not used.
+///
+/// \since QXmpp 1.8
+///
+std::optional<QXmppVCardIq> QXmppVCardManager::cachedVCard(const QString &bareJid) const
+{
+    if (auto *vCard = d->cachedVCard(bareJid)) {
+        return *vCard;
+    }
+    return {};
+}
+
+///
+/// Returns the maximum size of the vCard cache in bytes.
+///
+/// \since QXmpp 1.8
+///
+qsizetype QXmppVCardManager::cacheSize() const
+{
+    return d->cache.maxCost();
+}
+
+///
+/// Sets the maximum size of the vCard cache in bytes.
+///
+/// The size of a vCard is estimated, it is dominated by its photo. The least
+/// recently used vCards are removed first. The default is 0, i.e. vCards are
+/// not cached in the memory.
+///
+/// \since QXmpp 1.8
+///
+void QXmppVCardManager::setCacheSize(qsizetype bytes)
+{
+    d->cache.setMaxCost(bytes);
+}
+
+///
+/// Returns how long cached vCards are used if the entity hasn't announced the
+/// hash of its photo.
+///
+/// \since QXmpp 1.8
+///
+std::chrono::seconds QXmppVCardManager::cacheDuration() const
+{
+    return d->cacheDuration;
+}
+
+///
+/// Sets how long cached vCards are used if the entity hasn't announced the
+/// hash of its photo using \xep{0153, vCard-Based Avatars}.
+///
+/// The duration only applies to vCards cached afterwards. The default is one
+/// hour.
+///
+/// \since QXmpp 1.8
+///
+void QXmppVCardManager::setCacheDuration(std::chrono::seconds duration)
+{
+    d->cacheDuration = duration;
+}
+
+///
+/// Returns the storage used to persist vCards between sessions.
+///
+/// \since QXmpp 1.8
+///
+QXmppVCardStorage *QXmppVCardManager::storage() const
+{
+    return d->storage;
+}
+
+///
+/// Sets a storage used to persist vCards between sessions.
+///
+/// The storage is not owned by the manager and must outlive it.
+///
+/// \param storage storage to use or nullptr to only cache in the memory
+///
+/// \since QXmpp 1.8
+///
+void QXmppVCardManager::setStorage(QXmppVCardStorage *storage)
+{
+    d->storage = storage;
 }
 
 ///
@@ -90,7 +309,17 @@ QXmppTask<QXmppVCardManager::Result> QXmppVCardManager::setVCard(const QXmppVCar
     vCardIq.setTo(client()->configuration().jidBare());
     vCardIq.setFrom({});
     vCardIq.setType(QXmppIq::Set);
-    return client()->sendGenericIq(std::move(vCardIq));
+
+    auto bareJid = vCardIq.to();
+    return chain<Result>(client()->sendGenericIq(QXmppVCardIq(vCardIq)), this, [this, bareJid, vCardIq](Result &&result) {
+        if (std::holds_alternative<QXmpp::Success>(result)) {
+            d->cacheVCard(bareJid, vCardIq);
+            if (d->storage) {
+                d->storage->storeVCard(bareJid, vCardIq);
+            }
+        }
+        return std::move(result);
+    });
 }
 
 ///
@@ -172,6 +401,9 @@ bool QXmppVCardManager::handleStanza(const QDomElement &element)
 
 void QXmppVCardManager::onRegistered(QXmppClient *client)
 {
+    connect(client, &QXmppClient::connected, this, &QXmppVCardManager::onConnected);
+    connect(client, &QXmppClient::presenceReceived, this, &QXmppVCardManager::onPresenceReceived);
+
     if (auto manager = client->findExtension<QXmppAccountMigrationManager>()) {
         using DataResult = std::variant<VCardData, QXmppError>;
 
@@ -191,8 +423,70 @@ void QXmppVCardManager::onRegistered(QXmppClient *client)
 
 void QXmppVCardManager::onUnregistered(QXmppClient *client)
 {
+    disconnect(client, &QXmppClient::connected, this, &QXmppVCardManager::onConnected);
+    disconnect(client, &QXmppClient::presenceReceived, this, &QXmppVCardManager::onPresenceReceived);
+
     if (auto manager = client->findExtension<QXmppAccountMigrationManager>()) {
         manager->unregisterExportData<QXmppVCardIq>();
     }
 }
 /// \endcond
+
+void QXmppVCardManager::onConnected()
+{
+    // vCards may have changed while we were offline, the photo hashes are announced again
+    if (client()->streamManagementState() != QXmppClient::ResumedStream) {
+        d->photoHashes.clear();
+        d->cache.clear();
+    }
+}
+
+void QXmppVCardManager::onPresenceReceived(const QXmppPresence &presence)
+{
+    // occupants of group chats announce their own avatars, not the one of the room
+    if (!presence.mucItem().isNull()) {
+        return;
+    }
+
+    const auto bareJid = QXmppUtils::jidToBareJid(presence.from());
+    switch (presence.vCardUpdateType()) {
+    case QXmppPresence::VCardUpdateValidPhoto:
+        d->photoHashes.insert(bareJid, presence.photoHash());
+        break;
+    case QXmppPresence::VCardUpdateNoPhoto:
+        d->photoHashes.insert(bareJid, {});
+        break;
+    case QXmppPresence::VCardUpdateNone:
+    case QXmppPresence::VCardUpdateNotReady:
+        return;
+    }
+
+    if (auto *cached = d->cache.object(bareJid); cached && !d->isCurrent(bareJid, cached->vCard, cached->expires)) {
+        d->cache.remove(bareJid);
+        if (d->storage) {
+            d->storage->removeVCard(bareJid);
+        }
+    }
+}
+
+void QXmppVCardManager::requestVCardFromServer(const QString &bareJid)
+{
+    chainIq<VCardIqResult>(client()->sendIq(QXmppVCardIq(bareJid)), this).then(this, [this, bareJid](VCardIqResult &&result) {
+        if (auto *vCard = std::get_if<QXmppVCardIq>(&result)) {
+            d->cacheVCard(bareJid, *vCard);
+            if (d->storage) {
+                d->storage->storeVCard(bareJid, *vCard);
+            }
+        }
+        finishVCardFetches(bareJid, std::move(result));
+    });
+}
+
+void QXmppVCardManager::finishVCardFetches(const QString &bareJid, VCardIqResult &&result)
+{
+    d->refreshes.remove(bareJid);
+    const auto fetches = d->fetches.take(bareJid);
+    for (auto fetch : fetches) {
+        fetch.finish(VCardIqResult(result));
+    }
+}
@@ -7,12 +7,16 @@
 
 #include "QXmppClientExtension.h"
 
+#include <chrono>
+#include <optional>
 #include <variant>
 
 template<typename T>
 class QXmppTask;
+class QXmppPresence;
 class QXmppVCardIq;
 class QXmppVCardManagerPrivate;
+class QXmppVCardStorage;
 struct QXmppError;
 
 ///
@@ -53,8 +57,19 @@ public:
     ~QXmppVCardManager() override;
 
     QXmppTask<VCardIqResult> fetchVCard(const QString &bareJid);
+    QXmppTask<VCardIqResult> refreshVCard(const QString &bareJid);
     QXmppTask<Result> setVCard(const QXmppVCardIq &);
 
+    std::optional<QXmppVCardIq> cachedVCard(const QString &bareJid) const;
+
+    qsizetype cacheSize() const;
+    void setCacheSize(qsizetype bytes);
+    std::chrono::seconds cacheDuration() const;
+    void setCacheDuration(std::chrono::seconds duration);
+
+    QXmppVCardStorage *storage() const;
+    void setStorage(QXmppVCardStorage *storage);
+
     QString requestVCard(const QString &bareJid = QString());
 
     const QXmppVCardIq &clientVCard() const;
@@ -82,6 +97,11 @@ protected:
     void onUnregistered(QXmppClient *client) override;
 
 private:
+    void onConnected();
+    void onPresenceReceived(const QXmppPresence &presence);
+    void requestVCardFromServer(const QString &bareJid);
+    void finishVCardFetches(const QString &bareJid, VCardIqResult &&result);
+
     const std::unique_ptr<QXmppVCardManagerPrivate> d;
 };
 
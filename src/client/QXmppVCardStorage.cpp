@@ -0,0 +1,50 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+///
+/// \class QXmppVCardStorage
+///
+/// \brief The QXmppVCardStorage class persistently stores vCards of other
+/// entities, so they don't need to be fetched again in every session.
+///
+/// Stored vCards are validated against the photo hashes announced via
+/// \xep{0153, vCard-Based Avatars} before they are used.
+///
+/// \sa QXmppVCardManager::setStorage()
+///
+/// \since QXmpp 1.8
+///
+
+///
+/// \fn QXmppVCardStorage::vCard(const QString &bareJid)
+///
+/// Returns the stored vCard of an entity.
+///
+/// \param bareJid bare JID of the entity
+///
+/// \return the stored vCard or std::nullopt if nothing is stored
+///
+
+///
+/// \fn QXmppVCardStorage::storeVCard(const QString &bareJid, const QXmppVCardIq &vCard)
+///
+/// Stores the vCard of an entity, replacing a previously stored one.
+///
+/// \param bareJid bare JID of the entity
+/// \param vCard vCard to store
+///
+
+///
+/// \fn QXmppVCardStorage::removeVCard(const QString &bareJid)
+///
+/// Removes the stored vCard of an entity.
+///
+/// \param bareJid bare JID of the entity
+///
+
+///
+/// \fn QXmppVCardStorage::resetAll()
+///
+/// Removes all stored vCards.
+///
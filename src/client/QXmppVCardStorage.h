@@ -0,0 +1,27 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPVCARDSTORAGE_H
+#define QXMPPVCARDSTORAGE_H
+
+#include "QXmppVCardIq.h"
+
+#include <optional>
+
+template<typename T>
+class QXmppTask;
+
+class QXMPP_EXPORT QXmppVCardStorage
+{
+public:
+    virtual ~QXmppVCardStorage() = default;
+
+    virtual QXmppTask<std::optional<QXmppVCardIq>> vCard(const QString &bareJid) = 0;
+    virtual QXmppTask<void> storeVCard(const QString &bareJid, const QXmppVCardIq &vCard) = 0;
+    virtual QXmppTask<void> removeVCard(const QString &bareJid) = 0;
+
+    virtual QXmppTask<void> resetAll() = 0;
+};
+
+#endif  // QXMPPVCARDSTORAGE_H
@@ -18,7 +18,9 @@ private:
     Q_SLOT void block();
     Q_SLOT void unblock();
     Q_SLOT void pushBlocked();
+    Q_SLOT void entriesSorted();
     Q_SLOT void blockedState();
+    Q_SLOT void isBlocked();
 };
 
 void tst_QXmppBlockingManager::basic()
@@ -48,7 +50,7 @@ void tst_QXmppBlockingManager::fetch()
     QVERIFY(m->isSubscribed());
 
     // check all three results
-    QVector<QString> expected { "romeo@montague.net", "iago@shakespeare.lit" };
+    QVector<QString> expected { "iago@shakespeare.lit", "romeo@montague.net" };
     for (auto t : { task, task2, task3 }) {
         auto blocklist = expectFutureVariant<QXmppBlocklist>(t);
         QCOMPARE(blocklist.entries(), expected);
@@ -121,6 +123,54 @@ void tst_QXmppBlockingManager::pushBlocked()
     blocklist = std::get<QXmppBlocklist>(m->fetchBlocklist().result()).entries();
     auto expected = QVector<QString> { "iago@shakespeare.lit", "romeo@montague.net" };
     QCOMPARE(blocklist, expected);
+    QVERIFY(std::get<QXmppBlocklist>(m->fetchBlocklist().result()).isBlocked(u"romeo@montague.net/orchard"));
+}
+
+void tst_QXmppBlockingManager::entriesSorted()
+{
+    TestClient t;
+    t.configuration().setJid("juliet@capulet.com/balcony");
+    auto *m = t.addNewExtension<QXmppBlockingManager>();
+
+    m->fetchBlocklist();
+    t.expect("<iq id='qxmpp1' type='get'><blocklist xmlns='urn:xmpp:blocking'/></iq>");
+    t.inject("<iq type='result' id='qxmpp1'><blocklist xmlns='urn:xmpp:blocking'>"
+             "<item jid='romeo@montague.net'/><item jid='iago@shakespeare.lit'/><item jid='montague.net'/><item jid='tybalt@capulet.com/street'/>"
+             "</blocklist></iq>");
+
+    auto push = [&](const char *type, const QString &items) {
+        QVERIFY(m->handleStanza(xmlToDom(u"<iq to='juliet@capulet.com/balcony' type='set' id='push'><%1 xmlns='urn:xmpp:blocking'>%2</%1></iq>"_s.arg(QString::fromUtf8(type), items)), {}));
+    };
+    auto entries = [&] {
+        return std::get<QXmppBlocklist>(m->fetchBlocklist().result()).entries();
+    };
+
+    QCOMPARE(entries(), (QVector<QString> { "iago@shakespeare.lit", "montague.net", "romeo@montague.net", "tybalt@capulet.com/street" }));
+
+    // copies are not modified by later pushes
+    const auto copy = std::get<QXmppBlocklist>(m->fetchBlocklist().result());
+
+    push("unblock", "<item jid='iago@shakespeare.lit'/>");
+    QCOMPARE(entries(), (QVector<QString> { "montague.net", "romeo@montague.net", "tybalt@capulet.com/street" }));
+
+    push("block", "<item jid='capulet.com/balcony'/>");
+    QCOMPARE(entries(), (QVector<QString> { "capulet.com/balcony", "montague.net", "romeo@montague.net", "tybalt@capulet.com/street" }));
+
+    push("unblock", "<item jid='romeo@montague.net'/><item jid='tybalt@capulet.com/street'/><item jid='capulet.com/balcony'/>");
+    QCOMPARE(entries(), QVector<QString> { "montague.net" });
+
+    push("block", "<item jid='iago@shakespeare.lit'/>");
+    QCOMPARE(entries(), (QVector<QString> { "iago@shakespeare.lit", "montague.net" }));
+
+    auto blocklist = std::get<QXmppBlocklist>(m->fetchBlocklist().result());
+    QVERIFY(blocklist.isBlocked(u"iago@shakespeare.lit/castle"));
+    QVERIFY(blocklist.isBlocked(u"romeo@montague.net"));
+    QVERIFY(!blocklist.isBlocked(u"tybalt@capulet.com/street"));
+    QVERIFY(!blocklist.containsEntry(u"capulet.com/balcony"));
+
+    QCOMPARE(copy.entries(), (QVector<QString> { "iago@shakespeare.lit", "montague.net", "romeo@montague.net", "tybalt@capulet.com/street" }));
+    QVERIFY(copy.isBlocked(u"tybalt@capulet.com/street"));
+    QVERIFY(!copy.containsEntry(u"capulet.com/balcony"));
 }
 
 void tst_QXmppBlockingManager::blockedState()
@@ -153,5 +203,51 @@ void tst_QXmppBlockingManager::blockedState()
     expectVariant<L::NotBlocked>(state);
 }
 
+void tst_QXmppBlockingManager::isBlocked()
+{
+    QXmppBlocklist l({
+        "iago@shakespeare.lit",
+        "romeo@montague.net/orchard",
+        "capulet.com/balcony",
+        "spam.im",
+    });
+
+    // bare JID
+    QVERIFY(l.isBlocked(u"iago@shakespeare.lit"));
+    QVERIFY(l.isBlocked(u"iago@shakespeare.lit/res"));
+    QVERIFY(!l.isBlocked(u"shakespeare.lit"));
+    QVERIFY(!l.isBlocked(u"othello@shakespeare.lit"));
+
+    // full JID
+    QVERIFY(l.isBlocked(u"romeo@montague.net/orchard"));
+    QVERIFY(!l.isBlocked(u"romeo@montague.net"));
+    QVERIFY(!l.isBlocked(u"romeo@montague.net/garden"));
+
+    // domain + resource
+    QVERIFY(l.isBlocked(u"capulet.com/balcony"));
+    QVERIFY(l.isBlocked(u"juliet@capulet.com/balcony"));
+    QVERIFY(!l.isBlocked(u"juliet@capulet.com"));
+    QVERIFY(!l.isBlocked(u"capulet.com"));
+
+    // domain
+    QVERIFY(l.isBlocked(u"spam.im"));
+    QVERIFY(l.isBlocked(u"spam.im/bot"));
+    QVERIFY(l.isBlocked(u"baduser@spam.im"));
+    QVERIFY(l.isBlocked(u"baduser@spam.im/bot"));
+    QVERIFY(!l.isBlocked(u"baduser@spam.im.example.org"));
+
+    QVERIFY(l.containsEntry(u"capulet.com/balcony"));
+    QVERIFY(!l.containsEntry(u"capulet.com"));
+
+    // partially blocking entries are only reported for matching domains
+    auto state = l.blockingState("capulet.com");
+    auto partially = expectVariant<QXmppBlocklist::PartiallyBlocked>(state);
+    QCOMPARE(partially.partiallyBlockingEntries, QVector<QString> { "capulet.com/balcony" });
+    state = l.blockingState("juliet@capulet.com");
+    partially = expectVariant<QXmppBlocklist::PartiallyBlocked>(state);
+    QCOMPARE(partially.partiallyBlockingEntries, QVector<QString> { "capulet.com/balcony" });
+    expectVariant<QXmppBlocklist::NotBlocked>(l.blockingState("montague.net.example.org"));
+}
+
 QTEST_MAIN(tst_QXmppBlockingManager)
 #include "tst_qxmppblockingmanager.moc"
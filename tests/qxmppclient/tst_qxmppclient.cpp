@@ -3,12 +3,15 @@
 //
 // SPDX-License-Identifier: LGPL-2.1-or-later
 
+#include "QXmppCarbonManagerV2.h"
 #include "QXmppClient.h"
 #include "QXmppCredentials.h"
 #include "QXmppE2eeExtension.h"
 #include "QXmppFutureUtils_p.h"
 #include "QXmppLogger.h"
+#include "QXmppMamManager.h"
 #include "QXmppMessage.h"
+#include "QXmppMessageDeduplicator.h"
 #include "QXmppOutgoingClient.h"
 #include "QXmppOutgoingClient_p.h"
 #include "QXmppPromise.h"
@@ -22,6 +25,7 @@
 #include "util.h"
 
 #include <QObject>
+#include <QSignalSpy>
 
 using namespace QXmpp::Private;
 
@@ -35,6 +39,10 @@ private:
     Q_SLOT void testE2eeExtension();
     Q_SLOT void testTaskDirect();
     Q_SLOT void testTaskStore();
+    Q_SLOT void testMessageDeduplicator();
+    Q_SLOT void testMessageDeduplication();
+    Q_SLOT void testCarbonDeduplication();
+    Q_SLOT void testMamDeduplication();
 
     // outgoing client
 #if BUILD_INTERNAL_TESTS
@@ -230,6 +238,192 @@ void tst_QXmppClient::testTaskStore()
     QVERIFY(!p.task().hasResult());
 }
 
+void tst_QXmppClient::testMessageDeduplicator()
+{
+    const auto account = u"romeo@montague.lit"_s;
+    auto message = [](const QString &stanzaId, const QString &originId, const QString &by = u"romeo@montague.lit"_s) {
+        QXmppMessage message(u"juliet@capulet.lit/balcony"_s, u"romeo@montague.lit"_s);
+        if (!stanzaId.isEmpty()) {
+            message.setStanzaIds({ QXmppStanzaId { stanzaId, by } });
+        }
+        message.setOriginId(originId);
+        return message;
+    };
+
+    QXmppMessageDeduplicator deduplicator(3);
+    QVERIFY(deduplicator.insert(message(u"s1"_s, u"o1"_s), account));
+    QVERIFY(!deduplicator.insert(message(u"s1"_s, {}), account));
+    // origin ID fallback
+    QVERIFY(!deduplicator.insert(message({}, u"o1"_s), account));
+    QCOMPARE(deduplicator.size(), 2);
+
+    // messages without IDs are never duplicates
+    QVERIFY(deduplicator.insert(message({}, {}), account));
+    QVERIFY(deduplicator.insert(message({}, {}), account));
+    QCOMPARE(deduplicator.size(), 2);
+
+    // stanza IDs not assigned by our server are ignored
+    QVERIFY(deduplicator.insert(message(u"s1"_s, {}, u"juliet@capulet.lit"_s), account));
+    QVERIFY(!deduplicator.contains(message(u"s1"_s, {}), u"juliet@capulet.lit"_s));
+    QCOMPARE(deduplicator.size(), 2);
+
+    // unless the message comes from the room or channel that assigned them
+    auto groupChatMessage = message(u"g1"_s, {}, u"coven@chat.shakespeare.lit"_s);
+    groupChatMessage.setFrom(u"coven@chat.shakespeare.lit/thirdwitch"_s);
+    QVERIFY(deduplicator.insert(groupChatMessage, account));
+    QCOMPARE(deduplicator.size(), 2);
+    groupChatMessage.setType(QXmppMessage::GroupChat);
+    QVERIFY(deduplicator.insert(groupChatMessage, account));
+    QVERIFY(!deduplicator.insert(groupChatMessage, account));
+    QCOMPARE(deduplicator.size(), 3);
+    deduplicator.clear();
+    QVERIFY(deduplicator.insert(message(u"s1"_s, u"o1"_s), account));
+
+    // the archive ID is the stanza ID assigned by the archive
+    QVERIFY(!deduplicator.insertArchived(account, u"s1"_s, QXmppMessage()));
+    QVERIFY(deduplicator.insertArchived(account, u"s2"_s, QXmppMessage()));
+    QVERIFY(deduplicator.contains(message(u"s2"_s, {}), account));
+
+    // least recently seen IDs are evicted
+    QVERIFY(deduplicator.insert(message(u"s3"_s, {}), account));
+    QCOMPARE(deduplicator.size(), 3);
+    QVERIFY(!deduplicator.contains(message({}, u"o1"_s), account));
+    QVERIFY(deduplicator.contains(message(u"s1"_s, {}), account));
+
+    auto state = deduplicator.saveState();
+    QXmppMessageDeduplicator restored;
+    QVERIFY(restored.restoreState(state));
+    QCOMPARE(restored.size(), 3);
+    QVERIFY(restored.contains(message(u"s1"_s, {}), account));
+    QVERIFY(restored.contains(message(u"s3"_s, {}), account));
+    QVERIFY(!restored.restoreState(QByteArray("invalid")));
+    QCOMPARE(restored.size(), 0);
+
+    deduplicator.setCapacity(1);
+    QCOMPARE(deduplicator.size(), 1);
+    QVERIFY(deduplicator.contains(message(u"s3"_s, {}), account));
+    deduplicator.clear();
+    QCOMPARE(deduplicator.size(), 0);
+}
+
+void tst_QXmppClient::testMessageDeduplication()
+{
+    TestClient client;
+    client.configuration().setJid(u"romeo@montague.lit/orchard"_s);
+    QVERIFY(!client.isMessageDeduplicationEnabled());
+    QVERIFY(!client.messageDeduplicator());
+
+    // returns whether the message has been handled, i.e. dropped as duplicate
+    auto receive = [&](const QString &xml) {
+        bool handled = false;
+        Q_EMIT client.stream()->elementReceived(xmlToDom(xml), handled);
+        return handled;
+    };
+    const auto xml = u"<message xmlns='jabber:client' from='juliet@capulet.lit/balcony' to='romeo@montague.lit' type='chat'>"
+                     "<body>Hi</body>"
+                     "<stanza-id xmlns='urn:xmpp:sid:0' id='5f3dbc5e' by='romeo@montague.lit'/>"
+                     "</message>"_s;
+
+    QVERIFY(!receive(xml));
+    QVERIFY(!receive(xml));
+
+    client.setMessageDeduplicationEnabled(true);
+    QVERIFY(client.isMessageDeduplicationEnabled());
+    QVERIFY(client.messageDeduplicator());
+    QVERIFY(!receive(xml));
+    QVERIFY(receive(xml));
+    QCOMPARE(client.messageDeduplicator()->size(), 1);
+
+    client.setMessageDeduplicationEnabled(false);
+    QVERIFY(!client.messageDeduplicator());
+    QVERIFY(!receive(xml));
+}
+
+void tst_QXmppClient::testCarbonDeduplication()
+{
+    TestClient client;
+    client.configuration().setJid(u"romeo@montague.lit/orchard"_s);
+    client.setMessageDeduplicationEnabled(true);
+    auto *carbonManager = client.addNewExtension<QXmppCarbonManagerV2>();
+    QSignalSpy received(&client, &QXmppClient::messageReceived);
+
+    auto carbon = [](const QString &stanzaIdBy) {
+        return xmlToDom(u"<message xmlns='jabber:client' from='romeo@montague.lit' to='romeo@montague.lit/orchard' type='chat'>"
+                        "<received xmlns='urn:xmpp:carbons:2'><forwarded xmlns='urn:xmpp:forward:0'>"
+                        "<message xmlns='jabber:client' from='juliet@capulet.lit/balcony' to='romeo@montague.lit/garden' type='chat'>"
+                        "<body>Hi</body>"
+                        "<stanza-id xmlns='urn:xmpp:sid:0' id='5f3dbc5e' by='%1'/>"
+                        "</message>"
+                        "</forwarded></received>"
+                        "</message>"_s.arg(stanzaIdBy));
+    };
+
+    QVERIFY(carbonManager->handleStanza(carbon(u"romeo@montague.lit"_s), {}));
+    QCOMPARE(received.size(), 1);
+    // the copy is handled, but not injected again
+    QVERIFY(carbonManager->handleStanza(carbon(u"romeo@montague.lit"_s), {}));
+    QCOMPARE(received.size(), 1);
+
+    // stanza IDs set by the sender are not trusted
+    QVERIFY(carbonManager->handleStanza(carbon(u"juliet@capulet.lit"_s), {}));
+    QVERIFY(carbonManager->handleStanza(carbon(u"juliet@capulet.lit"_s), {}));
+    QCOMPARE(received.size(), 3);
+
+    // live copy of a message received as carbon copy before
+    bool handled = false;
+    Q_EMIT client.stream()->elementReceived(carbon(u"romeo@montague.lit"_s).firstChildElement().firstChildElement().firstChildElement(), handled);
+    QVERIFY(handled);
+    QCOMPARE(received.size(), 3);
+}
+
+void tst_QXmppClient::testMamDeduplication()
+{
+    TestClient client;
+    client.configuration().setJid(u"romeo@montague.lit/orchard"_s);
+    client.setMessageDeduplicationEnabled(true);
+    auto *mamManager = client.addNewExtension<QXmppMamManager>();
+
+    // received live before it is retrieved from the archive
+    bool handled = false;
+    Q_EMIT client.stream()->elementReceived(xmlToDom(u"<message xmlns='jabber:client' from='juliet@capulet.lit/balcony' to='romeo@montague.lit/orchard' type='chat'>"
+                                                     "<body>live</body>"
+                                                     "<stanza-id xmlns='urn:xmpp:sid:0' id='a' by='romeo@montague.lit'/>"
+                                                     "</message>"_s),
+                                            handled);
+    QVERIFY(!handled);
+
+    auto archivedMessage = [](const QString &queryId, const QString &id) {
+        return xmlToDom(u"<message to='romeo@montague.lit/orchard'>"
+                        "<result xmlns='urn:xmpp:mam:2' queryid='%1' id='%2'>"
+                        "<forwarded xmlns='urn:xmpp:forward:0'>"
+                        "<message xmlns='jabber:client' from='juliet@capulet.lit/balcony' type='chat'><body>%2</body></message>"
+                        "</forwarded>"
+                        "</result>"
+                        "</message>"_s.arg(queryId, id));
+    };
+    auto stream = [&](const QStringList &ids) {
+        QStringList bodies;
+        auto task = mamManager->streamMessages([&](QXmppMessage &&message) {
+            bodies << message.body();
+        });
+        const auto queryId = xmlToDom(client.takePacket()).attribute(u"id"_s);
+        for (const auto &id : ids) {
+            VERIFY2(mamManager->handleStanza(archivedMessage(queryId, id)), "Archived message not handled");
+        }
+        client.inject(u"<iq id='%1' type='result'>"
+                      "<fin xmlns='urn:xmpp:mam:2' complete='true'><set xmlns='http://jabber.org/protocol/rsm'><first>%2</first><last>%3</last></set></fin>"
+                      "</iq>"_s.arg(queryId, ids.constFirst(), ids.constLast()));
+        expectFutureVariant<QXmppResultSetReply>(task);
+        return bodies;
+    };
+
+    // the live message is skipped
+    QCOMPARE(stream({ u"a"_s, u"b"_s }), QStringList { u"b"_s });
+    // messages are only reported by the first query
+    QCOMPARE(stream({ u"b"_s, u"c"_s }), QStringList { u"c"_s });
+    client.expectNoPacket();
+}
+
 #if BUILD_INTERNAL_TESTS
 void tst_QXmppClient::csiManager()
 {
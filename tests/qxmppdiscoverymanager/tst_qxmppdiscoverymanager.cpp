@@ -2,10 +2,14 @@
 //
 // SPDX-License-Identifier: LGPL-2.1-or-later
 
+#include "QXmppDiscoveryIq.h"
 #include "QXmppDiscoveryManager.h"
+#include "QXmppPresence.h"
 
 #include "TestClient.h"
 
+using namespace std::chrono_literals;
+
 class tst_QXmppDiscoveryManager : public QObject
 {
     Q_OBJECT
@@ -13,6 +17,8 @@ private:
     Q_SLOT void testInfo();
     Q_SLOT void testItems();
     Q_SLOT void testRequests();
+    Q_SLOT void testEntityCapabilities();
+    Q_SLOT void testCoalescing();
 };
 
 void tst_QXmppDiscoveryManager::testInfo()
@@ -80,6 +86,139 @@ void tst_QXmppDiscoveryManager::testRequests()
     test.expect("<iq id='info1' to='romeo@montague.net/orchard' type='result'><query xmlns='http://jabber.org/protocol/disco#info'><identity category='client' name='tst_qxmppdiscoverymanager ' type='pc'/><feature var='jabber:x:data'/><feature var='http://jabber.org/protocol/rsm'/><feature var='jabber:x:oob'/><feature var='http://jabber.org/protocol/xhtml-im'/><feature var='http://jabber.org/protocol/chatstates'/><feature var='http://jabber.org/protocol/caps'/><feature var='jabber:x:conference'/><feature var='urn:xmpp:message-correct:0'/><feature var='urn:xmpp:chat-markers:0'/><feature var='urn:xmpp:hints'/><feature var='urn:xmpp:sid:0'/><feature var='urn:xmpp:message-attaching:1'/><feature var='urn:xmpp:eme:0'/><feature var='urn:xmpp:spoiler:0'/><feature var='urn:xmpp:fallback:0'/><feature var='urn:xmpp:reactions:0'/><feature var='http://jabber.org/protocol/disco#info'/></query></iq>");
 }
 
+void tst_QXmppDiscoveryManager::testEntityCapabilities()
+{
+    TestClient test;
+    auto *discoManager = test.addNewExtension<QXmppDiscoveryManager>();
+
+    QXmppDiscoveryIq::Identity identity;
+    identity.setCategory(u"client"_s);
+    identity.setType(u"pc"_s);
+    identity.setName(u"Exodus 0.9.1"_s);
+
+    QXmppDiscoveryIq info;
+    info.setType(QXmppIq::Result);
+    info.setQueryType(QXmppDiscoveryIq::InfoQuery);
+    info.setIdentities({ identity });
+    info.setFeatures({ u"http://jabber.org/protocol/caps"_s,
+                       u"http://jabber.org/protocol/disco#info"_s,
+                       u"http://jabber.org/protocol/disco#items"_s,
+                       u"http://jabber.org/protocol/muc"_s });
+    const auto ver = info.verificationString();
+    const auto node = u"http://code.google.com/p/exodus#"_s + QString::fromLatin1(ver.toBase64());
+
+    auto sendPresence = [&](const QString &from) {
+        QXmppPresence presence;
+        presence.setFrom(from);
+        presence.setCapabilityHash(u"sha-1"_s);
+        presence.setCapabilityNode(u"http://code.google.com/p/exodus"_s);
+        presence.setCapabilityVer(ver);
+        Q_EMIT test.presenceReceived(presence);
+    };
+    sendPresence(u"romeo@montague.lit/orchard"_s);
+    sendPresence(u"benvolio@montague.lit/home"_s);
+
+    // both lookups are answered by a single request
+    auto romeoTask = discoManager->features(u"romeo@montague.lit/orchard"_s);
+    auto benvolioTask = discoManager->features(u"benvolio@montague.lit/home"_s);
+    test.expect(u"<iq id='qxmpp1' to='romeo@montague.lit/orchard' type='get'>"
+                "<query xmlns='http://jabber.org/protocol/disco#info' node='%1'/></iq>"_s.arg(node));
+    test.expectNoPacket();
+
+    info.setId(u"qxmpp1"_s);
+    info.setFrom(u"romeo@montague.lit/orchard"_s);
+    info.setQueryNode(node);
+    test.inject(packetToXml(info));
+
+    QCOMPARE(expectFutureVariant<QStringList>(romeoTask).size(), 4);
+    QCOMPARE(expectFutureVariant<QStringList>(benvolioTask).size(), 4);
+
+    // cache hit: no network traffic
+    auto cachedTask = discoManager->features(u"benvolio@montague.lit/home"_s);
+    test.expectNoPacket();
+    QCOMPARE(expectFutureVariant<QStringList>(cachedTask), info.features());
+
+    // after going offline the entity is queried directly
+    QXmppPresence unavailable(QXmppPresence::Unavailable);
+    unavailable.setFrom(u"benvolio@montague.lit/home"_s);
+    Q_EMIT test.presenceReceived(unavailable);
+
+    discoManager->features(u"benvolio@montague.lit/home"_s);
+    test.expect(u"<iq id='qxmpp1' to='benvolio@montague.lit/home' type='get'>"
+                "<query xmlns='http://jabber.org/protocol/disco#info'/></iq>"_s);
+}
+
+void tst_QXmppDiscoveryManager::testCoalescing()
+{
+    TestClient test;
+    auto *discoManager = test.addNewExtension<QXmppDiscoveryManager>();
+    QCOMPARE(discoManager->cacheDuration(), 0s);
+    discoManager->setCacheDuration(10min);
+
+    // identical queries are merged
+    auto task1 = discoManager->requestDiscoInfo(u"example.org"_s);
+    auto task2 = discoManager->requestDiscoInfo(u"example.org"_s);
+    auto otherNodeTask = discoManager->requestDiscoInfo(u"example.org"_s, u"node"_s);
+    test.expect(u"<iq id='qxmpp1' to='example.org' type='get'><query xmlns='http://jabber.org/protocol/disco#info'/></iq>"_s);
+    test.expect(u"<iq id='qxmpp2' to='example.org' type='get'><query xmlns='http://jabber.org/protocol/disco#info' node='node'/></iq>"_s);
+    test.expectNoPacket();
+
+    test.inject(u"<iq id='qxmpp1' from='example.org' type='result'>"
+                "<query xmlns='http://jabber.org/protocol/disco#info'><feature var='urn:xmpp:mam:2'/></query>"
+                "</iq>"_s);
+    QCOMPARE(expectFutureVariant<QXmppDiscoveryIq>(task1).features(), QStringList { u"urn:xmpp:mam:2"_s });
+    QCOMPARE(expectFutureVariant<QXmppDiscoveryIq>(task2).features(), QStringList { u"urn:xmpp:mam:2"_s });
+    QVERIFY(!otherNodeTask.isFinished());
+
+    // results of servers are cached
+    auto cachedTask = discoManager->requestDiscoInfo(u"example.org"_s);
+    test.expectNoPacket();
+    QCOMPARE(expectFutureVariant<QXmppDiscoveryIq>(cachedTask).features(), QStringList { u"urn:xmpp:mam:2"_s });
+
+    // results of users are not cached
+    auto userTask1 = discoManager->requestDiscoItems(u"user@example.org"_s);
+    auto userTask2 = discoManager->requestDiscoItems(u"user@example.org"_s);
+    test.expect(u"<iq id='qxmpp1' to='user@example.org' type='get'><query xmlns='http://jabber.org/protocol/disco#items'/></iq>"_s);
+    test.expectNoPacket();
+    test.inject(u"<iq id='qxmpp1' from='user@example.org' type='result'>"
+                "<query xmlns='http://jabber.org/protocol/disco#items'><item jid='user@example.org' node='urn:xmpp:microblog:0'/></query>"
+                "</iq>"_s);
+    QCOMPARE(expectFutureVariant<QList<QXmppDiscoveryIq::Item>>(userTask1).size(), 1);
+    QCOMPARE(expectFutureVariant<QList<QXmppDiscoveryIq::Item>>(userTask2).size(), 1);
+
+    discoManager->requestDiscoItems(u"user@example.org"_s);
+    test.expect(u"<iq id='qxmpp1' to='user@example.org' type='get'><query xmlns='http://jabber.org/protocol/disco#items'/></iq>"_s);
+
+    // clearing the cache
+    discoManager->clearCache();
+    auto infoTask = discoManager->requestDiscoInfo(u"example.org"_s);
+    test.expect(u"<iq id='qxmpp1' to='example.org' type='get'><query xmlns='http://jabber.org/protocol/disco#info'/></iq>"_s);
+    test.inject(u"<iq id='qxmpp1' from='example.org' type='result'>"
+                "<query xmlns='http://jabber.org/protocol/disco#info'><feature var='urn:xmpp:mam:2'/></query>"
+                "</iq>"_s);
+    expectFutureVariant<QXmppDiscoveryIq>(infoTask);
+
+    // the cache is kept when the stream is resumed
+    test.setStreamManagementState(QXmppClient::ResumedStream);
+    Q_EMIT test.connected();
+    discoManager->requestDiscoInfo(u"example.org"_s);
+    test.expectNoPacket();
+
+    // the cache is cleared on a new stream
+    test.setStreamManagementState(QXmppClient::NewStream);
+    Q_EMIT test.connected();
+    discoManager->requestDiscoInfo(u"example.org"_s);
+    test.expect(u"<iq id='qxmpp1' to='example.org' type='get'><query xmlns='http://jabber.org/protocol/disco#info'/></iq>"_s);
+
+    // without a cache duration nothing is cached
+    discoManager->setCacheDuration(0s);
+    test.inject(u"<iq id='qxmpp1' from='example.org' type='result'>"
+                "<query xmlns='http://jabber.org/protocol/disco#info'/>"
+                "</iq>"_s);
+    discoManager->requestDiscoInfo(u"example.org"_s);
+    test.expect(u"<iq id='qxmpp1' to='example.org' type='get'><query xmlns='http://jabber.org/protocol/disco#info'/></iq>"_s);
+}
+
 QTEST_MAIN(tst_QXmppDiscoveryManager)
 
 #include "tst_qxmppdiscoverymanager.moc"
@@ -5,6 +5,7 @@
 #include "QXmppFileEncryption.h"
 
 #include "QcaInitializer_p.h"
+#include "util.h"
 
 #include <QtTest>
 
@@ -20,9 +21,18 @@ private:
     Q_SLOT void basic();
     Q_SLOT void qcaFeatures();
     Q_SLOT void deviceEncrypt();
+    Q_SLOT void knownAnswer_data();
+    Q_SLOT void knownAnswer();
+    Q_SLOT void deviceReadSizes_data();
+    Q_SLOT void deviceReadSizes();
     Q_SLOT void deviceDecrypt_data();
     Q_SLOT void deviceDecrypt();
     Q_SLOT void paddingSize();
+    Q_SLOT void decryptInvalid();
+#ifdef BUILD_BENCHMARKS
+    Q_SLOT void benchmarkEncryptionDevice_data();
+    Q_SLOT void benchmarkEncryptionDevice();
+#endif
 };
 
 void tst_QXmppFileEncryption::basic()
@@ -68,6 +78,100 @@ void tst_QXmppFileEncryption::deviceEncrypt()
     QCOMPARE(decrypted, data);
 }
 
+void tst_QXmppFileEncryption::knownAnswer_data()
+{
+    QTest::addColumn<int>("cipherId");
+    QTest::addColumn<QByteArray>("key");
+    QTest::addColumn<QByteArray>("encrypted");
+
+    // output of QCA's OpenSSL plugin, every backend must produce exactly the same
+    QTest::newRow("aes128-gcm")
+        << int(Aes128GcmNoPad)
+        << QByteArray("1234567890123456")
+        << QByteArray::fromHex("fb37a7e6eb38ee2b4eb9eb4c02e2a479defb6de648e2573c4821dbb36b9e024b374c4f72dcb27ee4dff00cdaa79f4ade44427e7a73597622d36f7214580bbe10176abaea94");
+    QTest::newRow("aes256-gcm")
+        << int(Aes256GcmNoPad)
+        << QByteArray("12345678901234567890123456789012")
+        << QByteArray::fromHex("760d1cc88bfc2fcc866c7d2fe004544a6f6034da41b3bcc6ea6759d48807f0a489fe7e1957a6723d90f8c04bc05d621d12b3ed1b1370cc701194afe55c2917a63b22dfa3d4");
+    QTest::newRow("aes256-cbc-pkcs7")
+        << int(Aes256CbcPkcs7)
+        << QByteArray("12345678901234567890123456789012")
+        << QByteArray::fromHex("7da078b8a510470b2859927f50febdf88843f4bc304f3573f3f5332bc0881e95c98550970d2716a4ad8e7588d95d8bb454013dba4d72b8e630e135ad76928938cf78895bff5a6b57c988a628011c8672");
+}
+
+void tst_QXmppFileEncryption::knownAnswer()
+{
+    QFETCH(int, cipherId);
+    QFETCH(QByteArray, key);
+    QFETCH(QByteArray, encrypted);
+    auto cipher = Cipher(cipherId);
+
+    QcaInitializer encInit;
+
+    QByteArray data =
+        "v2qtI8tx5DxM6axUAZ+xsEwrtb0VYafAPlMWqpVMG+5PBE5wbZ7MZhDUEIdFkxchOIJqt";
+    QByteArray iv = "12345678901234567890123456789012";
+
+    QCOMPARE(process(data, cipher, Encode, key, iv), encrypted);
+    QCOMPARE(process(encrypted, cipher, Decode, key, iv), data);
+
+    auto buffer = std::make_unique<QBuffer>(&data);
+    buffer->open(QIODevice::ReadOnly);
+    EncryptionDevice encDevice(std::move(buffer), cipher, key, iv);
+    QCOMPARE(encDevice.readAll(), encrypted);
+}
+
+void tst_QXmppFileEncryption::deviceReadSizes_data()
+{
+    deviceDecrypt_data();
+}
+
+void tst_QXmppFileEncryption::deviceReadSizes()
+{
+    QFETCH(int, cipherId);
+    QFETCH(QByteArray, key);
+    auto cipher = Cipher(cipherId);
+
+    QcaInitializer encInit;
+
+    QByteArray data(200 * 1024, Qt::Uninitialized);
+    for (qsizetype i = 0; i < data.size(); i++) {
+        data[i] = char(i % 251);
+    }
+    QByteArray iv = "12345678901234567890123456789012";
+    const auto expected = process(data, cipher, Encode, key, iv);
+
+    // reads smaller than a block, not aligned to blocks and larger than the internal buffers
+    auto buffer = std::make_unique<QBuffer>(&data);
+    buffer->open(QIODevice::ReadOnly);
+    EncryptionDevice encDevice(std::move(buffer), cipher, key, iv);
+
+    QByteArray encrypted;
+    const QList<int> readSizes = { 1, 7, 16, 17, 1000, 100 * 1024 };
+    for (int i = 0;; i++) {
+        QByteArray chunk(readSizes[i % readSizes.size()], Qt::Uninitialized);
+        auto read = encDevice.read(chunk.data(), chunk.size());
+        QVERIFY(read >= 0);
+        if (read == 0) {
+            break;
+        }
+        encrypted += chunk.left(read);
+    }
+    QCOMPARE(encrypted, expected);
+
+    // decrypt in odd parts, too
+    QByteArray decrypted;
+    buffer = std::make_unique<QBuffer>(&decrypted);
+    buffer->open(QIODevice::WriteOnly);
+    DecryptionDevice decDevice(std::move(buffer), cipher, key, iv);
+    for (qsizetype i = 0; i < encrypted.size(); i += 70 * 1024 + 3) {
+        auto part = encrypted.mid(i, 70 * 1024 + 3);
+        QCOMPARE(decDevice.write(part), qint64(part.size()));
+    }
+    decDevice.close();
+    QCOMPARE(decrypted, data);
+}
+
 void tst_QXmppFileEncryption::deviceDecrypt_data()
 {
     QTest::addColumn<int>("cipherId");
@@ -149,5 +253,86 @@ void tst_QXmppFileEncryption::paddingSize()
     }
 }
 
+void tst_QXmppFileEncryption::decryptInvalid()
+{
+    QcaInitializer encInit;
+
+    QByteArray data = "This is an example text message";
+    QByteArray key = "12345678901234567890123456789012";
+    QByteArray iv = "12345678901234567890123456789012";
+
+    // the last block is incomplete
+    auto truncated = process(data, Aes256CbcPkcs7, Encode, key, iv).chopped(1);
+    QVERIFY(process(truncated, Aes256CbcPkcs7, Decode, key, iv).isNull());
+
+    QByteArray decrypted;
+    auto buffer = std::make_unique<QBuffer>(&decrypted);
+    buffer->open(QIODevice::WriteOnly);
+
+    DecryptionDevice decDev(std::move(buffer), Aes256CbcPkcs7, key, iv);
+    QCOMPARE(decDev.write(truncated), qint64(truncated.size()));
+    QVERIFY(!decDev.finish());
+    QVERIFY(!decDev.errorString().isEmpty());
+    // finishing again reports the same result
+    QVERIFY(!decDev.finish());
+    QCOMPARE(decDev.write(truncated), qint64(-1));
+}
+
+#ifdef BUILD_BENCHMARKS
+void tst_QXmppFileEncryption::benchmarkEncryptionDevice_data()
+{
+    QTest::addColumn<bool>("encrypted");
+    QTest::addColumn<int>("cipherId");
+    QTest::addColumn<QByteArray>("key");
+
+    QTest::newRow("plain")
+        << false
+        << int(Aes256GcmNoPad)
+        << QByteArray();
+    QTest::newRow("aes128-gcm")
+        << true
+        << int(Aes128GcmNoPad)
+        << QByteArray("1234567890123456");
+    QTest::newRow("aes256-gcm")
+        << true
+        << int(Aes256GcmNoPad)
+        << QByteArray("12345678901234567890123456789012");
+    QTest::newRow("aes256-cbc-pkcs7")
+        << true
+        << int(Aes256CbcPkcs7)
+        << QByteArray("12345678901234567890123456789012");
+}
+
+void tst_QXmppFileEncryption::benchmarkEncryptionDevice()
+{
+    QFETCH(bool, encrypted);
+    QFETCH(int, cipherId);
+    QFETCH(QByteArray, key);
+    constexpr qint64 fileSize = 64 * 1024 * 1024;
+
+    QcaInitializer encInit;
+
+    auto file = createBenchmarkFile(fileSize);
+    auto input = std::make_unique<QFile>(file->fileName());
+    QVERIFY(input->open(QIODevice::ReadOnly));
+    std::unique_ptr<QIODevice> device = std::move(input);
+    if (encrypted) {
+        device = std::make_unique<EncryptionDevice>(std::move(device), Cipher(cipherId), key, QByteArray("12345678901234567890123456789012"));
+    }
+
+    // read like the HTTP upload does
+    QByteArray buffer(64 * 1024, Qt::Uninitialized);
+    qint64 total = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+    for (qint64 read = 0; (read = device->read(buffer.data(), buffer.size())) > 0;) {
+        total += read;
+    }
+    setThroughputResult(fileSize, timer.nsecsElapsed());
+    QVERIFY(total >= fileSize);
+}
+#endif
+
 QTEST_MAIN(tst_QXmppFileEncryption)
 #include "tst_qxmppfileencryption.moc"
@@ -0,0 +1,457 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppHash.h"
+#include "QXmppHashing_p.h"
+#include "QXmppHttpFileSharingProvider.h"
+#include "QXmppHttpFileSource.h"
+
+#ifdef WITH_QCA
+#include "QXmppEncryptedFileSharingProvider.h"
+#include "QXmppEncryptedFileSource.h"
+#include "QXmppFileEncryption.h"
+#include "QXmppFileMetadata.h"
+#include "QXmppFileShare.h"
+#include "QXmppFileSharingManager.h"
+
+#include "QcaInitializer_p.h"
+#endif
+
+#include "util.h"
+
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryFile>
+
+using namespace QXmpp;
+using namespace QXmpp::Private;
+using DownloadResult = QXmppFileSharingProvider::DownloadResult;
+
+// Minimal HTTP/1.1 server serving a single file, optionally with range requests and with a
+// connection that is dropped after some bytes of the body.
+class HttpServer : public QObject
+{
+public:
+    HttpServer(QByteArray body)
+        : body(std::move(body))
+    {
+        connect(&server, &QTcpServer::newConnection, this, [this]() {
+            while (auto *socket = server.nextPendingConnection()) {
+                connect(socket, &QAbstractSocket::disconnected, socket, &QObject::deleteLater);
+                connect(socket, &QIODevice::readyRead, this, [this, socket]() {
+                    socket->setProperty("request", socket->property("request").toByteArray() + socket->readAll());
+                    const auto request = socket->property("request").toByteArray();
+                    if (request.contains("\r\n\r\n")) {
+                        respond(socket, request);
+                    }
+                });
+            }
+        });
+        server.listen(QHostAddress::LocalHost);
+    }
+
+    QUrl url() const
+    {
+        return QUrl(u"http://127.0.0.1:"_s + QString::number(server.serverPort()) + u"/file");
+    }
+
+    QByteArray body;
+    bool acceptRanges = true;
+    // number of body bytes sent before the first response is interrupted, -1 to never interrupt
+    qint64 dropAfter = -1;
+    // if set, all requests after the first one are answered with the whole changed file
+    QByteArray changedBody;
+    // whether the first request of a range is answered with an error page
+    bool rejectFirstRangeRequest = false;
+    // Range header of every request, empty for requests of the whole file
+    QList<QByteArray> requestedRanges;
+    QList<QByteArray> ifRangeHeaders;
+
+private:
+    void respond(QTcpSocket *socket, const QByteArray &request)
+    {
+        QByteArray range;
+        QByteArray ifRange;
+        const auto lines = request.split('\n');
+        for (const auto &line : lines) {
+            const auto colon = line.indexOf(':');
+            const auto name = line.left(colon).trimmed().toLower();
+            if (name == "range") {
+                range = line.mid(colon + 1).trimmed();
+            } else if (name == "if-range") {
+                ifRange = line.mid(colon + 1).trimmed();
+            }
+        }
+        requestedRanges << range;
+        ifRangeHeaders << ifRange;
+
+        if (rejectFirstRangeRequest && !range.isEmpty()) {
+            rejectFirstRangeRequest = false;
+            const QByteArray page = "<html><body>Service Unavailable</body></html>";
+            socket->write("HTTP/1.1 503 Service Unavailable\r\n"
+                          "Content-Type: text/html\r\n"
+                          "Content-Length: " +
+                          QByteArray::number(page.size()) +
+                          "\r\n"
+                          "Connection: close\r\n\r\n" +
+                          page);
+            socket->disconnectFromHost();
+            return;
+        }
+
+        const bool changed = !changedBody.isEmpty() && requestedRanges.size() > 1;
+        const auto &file = changed ? changedBody : body;
+        qint64 start = 0;
+        qint64 end = file.size() - 1;
+        const bool partial = acceptRanges && !changed && range.startsWith("bytes=");
+        if (partial) {
+            const auto spec = range.mid(6);
+            const auto dash = spec.indexOf('-');
+            start = spec.left(dash).toLongLong();
+            if (dash + 1 < spec.size()) {
+                end = spec.mid(dash + 1).toLongLong();
+            }
+        }
+        const auto content = file.mid(start, end - start + 1);
+
+        QByteArray header = partial ? "HTTP/1.1 206 Partial Content\r\n" : "HTTP/1.1 200 OK\r\n";
+        header += "Content-Length: " + QByteArray::number(content.size()) + "\r\n";
+        if (acceptRanges) {
+            header += "Accept-Ranges: bytes\r\n";
+            header += "ETag: \"file-v1\"\r\n";
+        }
+        if (partial) {
+            header += "Content-Range: bytes " + QByteArray::number(start) + '-' + QByteArray::number(end) + '/' + QByteArray::number(file.size()) + "\r\n";
+        }
+        header += "Connection: close\r\n\r\n";
+
+        socket->write(header);
+        if (dropAfter >= 0) {
+            socket->write(content.left(dropAfter));
+            dropAfter = -1;
+        } else {
+            socket->write(content);
+        }
+        socket->disconnectFromHost();
+    }
+
+    QTcpServer server;
+};
+
+static QByteArray testData(qsizetype size)
+{
+    QByteArray data;
+    data.reserve(size);
+    for (qsizetype i = 0; i < size; i++) {
+        data.append(char((i * 7 + i / 251) % 256));
+    }
+    return data;
+}
+
+class tst_QXmppHttpFileSharingProvider : public QObject
+{
+    Q_OBJECT
+
+private:
+    Q_SLOT void testDownload();
+    Q_SLOT void testResume();
+    Q_SLOT void testResumeAfterErrorResponse();
+    Q_SLOT void testResumeUnsupported();
+    Q_SLOT void testResumeChangedFile_data();
+    Q_SLOT void testResumeChangedFile();
+    Q_SLOT void testParallelRanges();
+    Q_SLOT void testParallelRangesSequential();
+    Q_SLOT void testCancel();
+#ifdef WITH_QCA
+    Q_SLOT void testResumeEncrypted_data();
+    Q_SLOT void testResumeEncrypted();
+    Q_SLOT void testEncryptedDownloadWithHashes();
+#endif
+
+    DownloadResult download(const QUrl &url, std::unique_ptr<QIODevice> output, int parallelRanges = 1);
+
+    QNetworkAccessManager netManager;
+};
+
+DownloadResult tst_QXmppHttpFileSharingProvider::download(const QUrl &url, std::unique_ptr<QIODevice> output, int parallelRanges)
+{
+    QXmppHttpFileSharingProvider provider(nullptr, &netManager);
+    provider.setParallelDownloadRanges(parallelRanges);
+
+    std::optional<DownloadResult> result;
+    auto download = provider.downloadFile(
+        QXmppHttpFileSource(url), std::move(output), [](quint64, quint64) {}, [&](DownloadResult r) { result = std::move(r); });
+
+    [&]() { QTRY_VERIFY_WITH_TIMEOUT(result.has_value(), 10000); }();
+    if (!result) {
+        return QXmppError { u"Download did not finish"_s, {} };
+    }
+    return std::move(*result);
+}
+
+void tst_QXmppHttpFileSharingProvider::testDownload()
+{
+    HttpServer server(testData(100 * 1024));
+
+    QByteArray received;
+    auto buffer = std::make_unique<QBuffer>(&received);
+    buffer->open(QIODevice::WriteOnly);
+
+    expectVariant<Success>(download(server.url(), std::move(buffer)));
+    QCOMPARE(received, server.body);
+    QCOMPARE(server.requestedRanges, QList<QByteArray> { QByteArray() });
+}
+
+void tst_QXmppHttpFileSharingProvider::testResume()
+{
+    HttpServer server(testData(100 * 1024));
+    server.dropAfter = 1000;
+
+    QByteArray received;
+    auto buffer = std::make_unique<QBuffer>(&received);
+    buffer->open(QIODevice::WriteOnly);
+
+    expectVariant<Success>(download(server.url(), std::move(buffer)));
+    QCOMPARE(received, server.body);
+    QCOMPARE(server.requestedRanges, (QList<QByteArray> { QByteArray(), QByteArray("bytes=1000-") }));
+    QCOMPARE(server.ifRangeHeaders.last(), QByteArray("\"file-v1\""));
+}
+
+void tst_QXmppHttpFileSharingProvider::testResumeAfterErrorResponse()
+{
+    HttpServer server(testData(100 * 1024));
+    server.dropAfter = 1000;
+    server.rejectFirstRangeRequest = true;
+
+    QByteArray received;
+    auto buffer = std::make_unique<QBuffer>(&received);
+    buffer->open(QIODevice::WriteOnly);
+
+    // the error page must not end up in the file
+    expectVariant<Success>(download(server.url(), std::move(buffer)));
+    QCOMPARE(received, server.body);
+    QCOMPARE(server.requestedRanges, (QList<QByteArray> { QByteArray(), QByteArray("bytes=1000-"), QByteArray("bytes=1000-") }));
+}
+
+void tst_QXmppHttpFileSharingProvider::testResumeUnsupported()
+{
+    HttpServer server(testData(100 * 1024));
+    server.acceptRanges = false;
+    server.dropAfter = 1000;
+
+    QByteArray received;
+    auto buffer = std::make_unique<QBuffer>(&received);
+    buffer->open(QIODevice::WriteOnly);
+
+    auto error = expectVariant<QXmppError>(download(server.url(), std::move(buffer)));
+    QVERIFY(error.value<QNetworkReply::NetworkError>() == QNetworkReply::RemoteHostClosedError);
+    QCOMPARE(server.requestedRanges.size(), 1);
+}
+
+void tst_QXmppHttpFileSharingProvider::testResumeChangedFile_data()
+{
+    QTest::addColumn<bool>("useFile");
+
+    QTest::newRow("buffer") << false;
+    QTest::newRow("file") << true;
+}
+
+void tst_QXmppHttpFileSharingProvider::testResumeChangedFile()
+{
+    QFETCH(bool, useFile);
+
+    // the server answers the resumed request with a shorter file
+    HttpServer server(testData(100 * 1024));
+    server.dropAfter = 50 * 1024;
+    server.changedBody = testData(10 * 1024);
+
+    QByteArray received;
+    QTemporaryFile file;
+    std::unique_ptr<QIODevice> output;
+    if (useFile) {
+        QVERIFY(file.open());
+        auto fileDevice = std::make_unique<QFile>(file.fileName());
+        QVERIFY(fileDevice->open(QIODevice::WriteOnly));
+        output = std::move(fileDevice);
+    } else {
+        output = std::make_unique<QBuffer>(&received);
+        output->open(QIODevice::WriteOnly);
+    }
+
+    expectVariant<Success>(download(server.url(), std::move(output)));
+    if (useFile) {
+        received = file.readAll();
+    }
+    // no data of the first response remains after the new file
+    QCOMPARE(received.size(), server.changedBody.size());
+    QVERIFY(received == server.changedBody);
+    QCOMPARE(server.requestedRanges, (QList<QByteArray> { QByteArray(), QByteArray("bytes=51200-") }));
+}
+
+void tst_QXmppHttpFileSharingProvider::testParallelRanges()
+{
+    constexpr qint64 rangeSize = 1024 * 1024;
+    HttpServer server(testData(4 * rangeSize));
+
+    QByteArray received;
+    auto buffer = std::make_unique<QBuffer>(&received);
+    buffer->open(QIODevice::WriteOnly);
+
+    expectVariant<Success>(download(server.url(), std::move(buffer), 4));
+    QCOMPARE(received.size(), server.body.size());
+    QVERIFY(received == server.body);
+
+    auto ranges = server.requestedRanges;
+    std::sort(ranges.begin(), ranges.end());
+    QCOMPARE(ranges,
+             (QList<QByteArray> {
+                 QByteArray(),
+                 "bytes=1048576-2097151",
+                 "bytes=2097152-3145727",
+                 "bytes=3145728-4194303",
+             }));
+}
+
+void tst_QXmppHttpFileSharingProvider::testParallelRangesSequential()
+{
+    constexpr qint64 rangeSize = 1024 * 1024;
+    HttpServer server(testData(4 * rangeSize));
+
+    QByteArray received;
+    auto buffer = std::make_unique<QBuffer>(&received);
+    buffer->open(QIODevice::WriteOnly);
+    auto hashingDevice = std::make_unique<HashingDevice>(std::move(buffer), std::vector { HashAlgorithm::Sha256 });
+    auto future = hashingDevice->hashesFuture();
+    QVERIFY(hashingDevice->isSequential());
+
+    // the hashes need the data in order, so the file is not split
+    expectVariant<Success>(download(server.url(), std::move(hashingDevice), 4));
+    QVERIFY(received == server.body);
+    QCOMPARE(server.requestedRanges, QList<QByteArray> { QByteArray() });
+
+    auto hashes = expectVariant<std::vector<QXmppHash>>(std::move(wait(future)->result));
+    QCOMPARE(hashes.front().hash(), QCryptographicHash::hash(server.body, QCryptographicHash::Sha256));
+}
+
+void tst_QXmppHttpFileSharingProvider::testCancel()
+{
+    HttpServer server(testData(100 * 1024));
+
+    QXmppHttpFileSharingProvider provider(nullptr, &netManager);
+    auto buffer = std::make_unique<QBuffer>();
+    buffer->open(QIODevice::WriteOnly);
+
+    std::optional<DownloadResult> result;
+    auto download = provider.downloadFile(
+        QXmppHttpFileSource(server.url()), std::move(buffer), [](quint64, quint64) {}, [&](DownloadResult r) { result = std::move(r); });
+    download->cancel();
+
+    QVERIFY(result.has_value());
+    expectVariant<Cancelled>(std::move(*result));
+}
+
+#ifdef WITH_QCA
+void tst_QXmppHttpFileSharingProvider::testResumeEncrypted_data()
+{
+    QTest::addColumn<int>("cipherId");
+    QTest::addColumn<qint64>("dropAfter");
+
+    // interrupted in the middle of a cipher block
+    QTest::newRow("aes128-gcm") << int(Aes128GcmNoPad) << qint64(1000);
+    QTest::newRow("aes256-gcm") << int(Aes256GcmNoPad) << qint64(1000);
+    QTest::newRow("aes256-cbc") << int(Aes256CbcPkcs7) << qint64(1000);
+    // interrupted at a block boundary
+    QTest::newRow("aes256-cbc-boundary") << int(Aes256CbcPkcs7) << qint64(1024);
+}
+
+void tst_QXmppHttpFileSharingProvider::testResumeEncrypted()
+{
+    QFETCH(int, cipherId);
+    QFETCH(qint64, dropAfter);
+    const auto cipher = Cipher(cipherId);
+
+    QcaInitializer qcaInit;
+    const auto key = Encryption::generateKey(cipher);
+    const auto iv = Encryption::generateInitializationVector(cipher);
+    const auto plaintext = testData(100 * 1024);
+
+    HttpServer server(Encryption::process(plaintext, cipher, Encryption::Encode, key, iv));
+    server.dropAfter = dropAfter;
+
+    QByteArray received;
+    auto buffer = std::make_unique<QBuffer>(&received);
+    buffer->open(QIODevice::WriteOnly);
+    auto decryptionDevice = std::make_unique<Encryption::DecryptionDevice>(std::move(buffer), cipher, key, iv);
+    auto *decryptionDevicePtr = decryptionDevice.get();
+
+    // the decryption state continues with the resumed data
+    QXmppHttpFileSharingProvider provider(nullptr, &netManager);
+
+    std::optional<DownloadResult> result;
+    auto download = provider.downloadFile(
+        QXmppHttpFileSource(server.url()), std::move(decryptionDevice), [](quint64, quint64) {}, [&](DownloadResult r) {
+            decryptionDevicePtr->finish();
+            result = std::move(r);
+        });
+    QTRY_VERIFY_WITH_TIMEOUT(result.has_value(), 10000);
+
+    expectVariant<Success>(std::move(*result));
+    QCOMPARE(received, plaintext);
+    QCOMPARE(server.requestedRanges, (QList<QByteArray> { QByteArray(), "bytes=" + QByteArray::number(dropAfter) + '-' }));
+}
+
+void tst_QXmppHttpFileSharingProvider::testEncryptedDownloadWithHashes()
+{
+    QcaInitializer qcaInit;
+    const auto cipher = Aes256GcmNoPad;
+    const auto key = Encryption::generateKey(cipher);
+    const auto iv = Encryption::generateInitializationVector(cipher);
+    const auto plaintext = testData(100 * 1024);
+
+    HttpServer server(Encryption::process(plaintext, cipher, Encryption::Encode, key, iv));
+    server.dropAfter = 1000;
+
+    QXmppFileSharingManager manager;
+    auto httpProvider = std::make_shared<QXmppHttpFileSharingProvider>(nullptr, &netManager);
+    httpProvider->setParallelDownloadRanges(4);
+    manager.registerProvider(httpProvider);
+    manager.registerProvider(std::make_shared<QXmppEncryptedFileSharingProvider>(&manager, httpProvider));
+
+    QXmppHash hash;
+    hash.setAlgorithm(HashAlgorithm::Sha256);
+    hash.setHash(QCryptographicHash::hash(plaintext, QCryptographicHash::Sha256));
+    QXmppFileMetadata metadata;
+    metadata.setHashes({ hash });
+    metadata.setSize(quint64(plaintext.size()));
+
+    QXmppEncryptedFileSource source;
+    source.setCipher(cipher);
+    source.setKey(key);
+    source.setIv(iv);
+    source.setHttpSources({ QXmppHttpFileSource(server.url()) });
+
+    QXmppFileShare fileShare;
+    fileShare.setMetadata(metadata);
+    fileShare.setEncryptedSourecs({ source });
+
+    // the output is wrapped into a hashing and a decryption device
+    QByteArray received;
+    auto buffer = std::make_unique<QBuffer>(&received);
+    buffer->open(QIODevice::WriteOnly);
+
+    auto download = manager.downloadFile(fileShare, std::move(buffer));
+    QTRY_VERIFY_WITH_TIMEOUT(download->isFinished(), 10000);
+
+    auto result = expectVariant<QXmppFileDownload::Downloaded>(download->result());
+    QCOMPARE(result.hashVerificationResult, QXmppFileDownload::HashVerified);
+    QCOMPARE(received, plaintext);
+}
+#endif
+
+QTEST_MAIN(tst_QXmppHttpFileSharingProvider)
+#include "tst_qxmpphttpfilesharingprovider.moc"
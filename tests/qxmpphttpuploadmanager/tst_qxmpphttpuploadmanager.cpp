@@ -14,7 +14,10 @@
 #include "TestClient.h"
 #include "util.h"
 
+#include <QBuffer>
 #include <QMimeDatabase>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
 
 using namespace QXmpp::Private;
 
@@ -49,6 +52,57 @@ static void addUploadService(QXmppClient &client)
     QVERIFY(discovery->handleStanza(xmlToDom(xml)));
 }
 
+// Network reply that only finishes when told so by the test.
+class PendingReply : public QNetworkReply
+{
+public:
+    PendingReply(QNetworkAccessManager::Operation operation, const QNetworkRequest &request, QObject *parent)
+        : QNetworkReply(parent)
+    {
+        setOperation(operation);
+        setRequest(request);
+        setUrl(request.url());
+        open(QIODevice::ReadOnly);
+    }
+
+    void finish()
+    {
+        setFinished(true);
+        Q_EMIT finished();
+    }
+    void abort() override { }
+
+protected:
+    qint64 readData(char *, qint64) override { return -1; }
+};
+
+// Records the requests instead of sending them.
+class StubNetworkAccessManager : public QNetworkAccessManager
+{
+public:
+    QList<QUrl> putUrls;
+    QList<PendingReply *> running;
+
+    int maxRunning = 0;
+
+    void finishReply(qsizetype index)
+    {
+        running.takeAt(index)->finish();
+    }
+
+protected:
+    QNetworkReply *createRequest(Operation operation, const QNetworkRequest &request, QIODevice *) override
+    {
+        auto *reply = new PendingReply(operation, request, this);
+        if (operation == PutOperation) {
+            putUrls.append(request.url());
+            running.append(reply);
+            maxRunning = std::max(maxRunning, int(running.size()));
+        }
+        return reply;
+    }
+};
+
 class tst_QXmppHttpUploadManager : public QObject
 {
     Q_OBJECT
@@ -65,6 +119,8 @@ private:
     Q_SLOT void testUploadService();
 
     // HttpUploadManager
+    Q_SLOT void testUploadQueue();
+    Q_SLOT void testUploadsPerHost();
     Q_SLOT void testUpload();
 };
 
@@ -360,6 +416,115 @@ void tst_QXmppHttpUploadManager::testUploadService()
     QCOMPARE(service.jid(), u"upload.shakespeare.lit"_s);
 }
 
+void tst_QXmppHttpUploadManager::testUploadQueue()
+{
+    TestClient test;
+    test.addNewExtension<QXmppDiscoveryManager>();
+    test.addNewExtension<QXmppUploadRequestManager>();
+    auto *uploadManager = test.addNewExtension<QXmppHttpUploadManager>();
+    addUploadService(test);
+    uploadManager->setSlotPrefetchCount(2);
+
+    auto startUpload = [&](const QString &filename) {
+        auto buffer = std::make_unique<QBuffer>();
+        buffer->setData(QByteArray(100, 'x'));
+        buffer->open(QIODevice::ReadOnly);
+        return uploadManager->uploadFile(std::move(buffer), filename, QMimeDatabase().mimeTypeForName(u"text/plain"_s));
+    };
+    auto takeRequest = [&]() {
+        QXmppHttpUploadRequestIq iq;
+        parsePacket(iq, test.takePacket().toUtf8());
+        return iq;
+    };
+
+    auto upload1 = startUpload(u"1.txt"_s);
+    auto upload2 = startUpload(u"2.txt"_s);
+    auto upload3 = startUpload(u"3.txt"_s);
+    QCOMPARE(uploadManager->bytesTotal(), 300ULL);
+    QCOMPARE(uploadManager->bytesSent(), 0ULL);
+
+    // only two slots are requested ahead, in order
+    auto request1 = takeRequest();
+    QCOMPARE(request1.fileName(), u"1.txt"_s);
+    QCOMPARE(takeRequest().fileName(), u"2.txt"_s);
+    test.expectNoPacket();
+
+    // queued uploads can be cancelled
+    upload3->cancel();
+    QVERIFY(upload3->isFinished());
+    expectVariant<QXmpp::Cancelled>(upload3->result().value());
+    QCOMPARE(uploadManager->bytesTotal(), 200ULL);
+    test.expectNoPacket();
+
+    auto upload4 = startUpload(u"4.txt"_s);
+    test.expectNoPacket();
+
+    // a finished slot request makes room for the next one
+    test.inject(u"<iq from='" + UPLOAD_SERVICE_NAME + u"' id='" + request1.id() + u"' to='" + request1.from() + u"' type='error'>"
+                u"<error type='modify'>"
+                u"<not-acceptable xmlns='urn:ietf:params:xml:ns:xmpp-stanzas'/>"
+                u"</error>"
+                u"</iq>");
+    QVERIFY(upload1->isFinished());
+    expectVariant<QXmppError>(upload1->result().value());
+    QCOMPARE(takeRequest().fileName(), u"4.txt"_s);
+    test.expectNoPacket();
+    QCOMPARE(uploadManager->bytesTotal(), 200ULL);
+}
+
+void tst_QXmppHttpUploadManager::testUploadsPerHost()
+{
+    StubNetworkAccessManager netManager;
+    TestClient test;
+    test.addNewExtension<QXmppDiscoveryManager>();
+    test.addNewExtension<QXmppUploadRequestManager>();
+    auto *uploadManager = test.addNewExtension<QXmppHttpUploadManager>(&netManager);
+    addUploadService(test);
+    uploadManager->setSlotPrefetchCount(5);
+    uploadManager->setMaxUploadsPerHost(2);
+
+    std::vector<std::shared_ptr<QXmppHttpUpload>> uploads;
+    for (int i = 1; i <= 5; i++) {
+        auto buffer = std::make_unique<QBuffer>();
+        buffer->setData(QByteArray(100, 'x'));
+        buffer->open(QIODevice::ReadOnly);
+        uploads.push_back(uploadManager->uploadFile(std::move(buffer), u"%1.txt"_s.arg(i), QMimeDatabase().mimeTypeForName(u"text/plain"_s)));
+    }
+
+    // all slots are received before any transfer has finished
+    for (int i = 1; i <= 5; i++) {
+        QXmppHttpUploadRequestIq request;
+        parsePacket(request, test.takePacket().toUtf8());
+        QCOMPARE(request.fileName(), u"%1.txt"_s.arg(i));
+        test.inject(u"<iq from='%1' id='%2' to='%3' type='result'>"
+                    "<slot xmlns='urn:xmpp:http:upload:0'>"
+                    "<put url='https://upload.montague.tld/%4.txt'/>"
+                    "<get url='https://download.montague.tld/%4.txt'/>"
+                    "</slot>"
+                    "</iq>"_s.arg(UPLOAD_SERVICE_NAME, request.id(), request.from(), QString::number(i)));
+    }
+    test.expectNoPacket();
+
+    // only two PUTs run at once, the others start in order when one finishes
+    QCOMPARE(netManager.running.size(), 2);
+    netManager.finishReply(0);
+    QCOMPARE(netManager.running.size(), 2);
+    netManager.finishReply(1);
+    netManager.finishReply(0);
+    QCOMPARE(netManager.running.size(), 2);
+    while (!netManager.running.isEmpty()) {
+        netManager.finishReply(0);
+    }
+
+    QCOMPARE(netManager.maxRunning, 2);
+    QCOMPARE(netManager.putUrls.size(), 5);
+    for (int i = 0; i < 5; i++) {
+        QCOMPARE(netManager.putUrls.at(i), QUrl(u"https://upload.montague.tld/%1.txt"_s.arg(i + 1)));
+        QVERIFY(uploads.at(i)->isFinished());
+        QCOMPARE(expectVariant<QUrl>(uploads.at(i)->result().value()), QUrl(u"https://download.montague.tld/%1.txt"_s.arg(i + 1)));
+    }
+}
+
 void tst_QXmppHttpUploadManager::testUpload()
 {
     using DiscoInfoResult = QXmppDiscoveryManager::InfoResult;
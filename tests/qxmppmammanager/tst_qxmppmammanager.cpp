@@ -2,13 +2,20 @@
 //
 // SPDX-License-Identifier: LGPL-2.1-or-later
 
+#include "QXmppE2eeExtension.h"
+#include "QXmppFutureUtils_p.h"
 #include "QXmppMamManager.h"
 #include "QXmppMessage.h"
+#include "QXmppPromise.h"
+#include "QXmppUtils.h"
 
+#include "TestClient.h"
 #include "util.h"
 
 #include <QObject>
 
+using namespace QXmpp::Private;
+
 class QXmppMamTestHelper : public QObject
 {
     Q_OBJECT
@@ -40,6 +47,14 @@ private:
     Q_SLOT void testHandleResultIq_data();
     Q_SLOT void testHandleResultIq();
 
+    Q_SLOT void testStreamMessages();
+    Q_SLOT void testStreamMessagesBackwards();
+    Q_SLOT void testParallelDecryption();
+    Q_SLOT void testSynchronizeMessages();
+    Q_SLOT void testSynchronizeMessagesError();
+    Q_SLOT void testSynchronizeMessagesResume();
+    Q_SLOT void testSynchronizeMessagesBuffer();
+
     QXmppMamTestHelper m_helper;
     QXmppMamManager m_manager;
 };
@@ -206,6 +221,362 @@ void tst_QXmppMamManager::testHandleResultIq()
     QCOMPARE(m_helper.m_signalTriggered, accept);
 }
 
+static QString mamMessage(const QString &queryId, const QString &id, const QString &body, bool encrypted = false, const QDateTime &stamp = {})
+{
+    return u"<message to='juliet@capulet.lit/chamber'>"
+           "<result xmlns='urn:xmpp:mam:2' queryid='%1' id='%2'>"
+           "<forwarded xmlns='urn:xmpp:forward:0'>%5"
+           "<message xmlns='jabber:client' id='%2' from='romeo@montague.lit/orchard' type='chat'><body>%3</body>%4</message>"
+           "</forwarded>"
+           "</result>"
+           "</message>"_s.arg(queryId,
+                              id,
+                              body,
+                              encrypted ? u"<encrypted xmlns='urn:qxmpp:test'/>"_s : QString(),
+                              stamp.isValid() ? u"<delay xmlns='urn:xmpp:delay' stamp='%1'/>"_s.arg(QXmppUtils::datetimeToString(stamp)) : QString());
+}
+
+// value of a field of the data form of a MAM query
+static QString queryField(const QDomElement &iq, const QString &name)
+{
+    auto form = iq.firstChildElement(u"query"_s).firstChildElement(u"x"_s);
+    for (auto field = form.firstChildElement(u"field"_s); !field.isNull(); field = field.nextSiblingElement(u"field"_s)) {
+        if (field.attribute(u"var"_s) == name) {
+            return field.firstChildElement(u"value"_s).text();
+        }
+    }
+    return {};
+}
+
+// Decrypts messages only when told so by the test.
+class PendingEncryption : public QXmppE2eeExtension
+{
+public:
+    QList<std::pair<QString, QXmppPromise<MessageDecryptResult>>> decryptions;
+
+    QXmppTask<MessageEncryptResult> encryptMessage(QXmppMessage &&, const std::optional<QXmppSendStanzaParams> &) override
+    {
+        return makeReadyTask<MessageEncryptResult>(QXmppError { u"Not supported"_s, {} });
+    }
+    QXmppTask<MessageDecryptResult> decryptMessage(QXmppMessage &&message) override
+    {
+        QXmppPromise<MessageDecryptResult> promise;
+        auto task = promise.task();
+        decryptions.append({ message.id(), std::move(promise) });
+        return task;
+    }
+    QXmppTask<IqEncryptResult> encryptIq(QXmppIq &&, const std::optional<QXmppSendStanzaParams> &) override
+    {
+        return makeReadyTask<IqEncryptResult>(QXmppError { u"Not supported"_s, {} });
+    }
+    QXmppTask<IqDecryptResult> decryptIq(const QDomElement &) override
+    {
+        return makeReadyTask<IqDecryptResult>(NotEncrypted());
+    }
+    bool isEncrypted(const QDomElement &element) override
+    {
+        return !element.firstChildElement(u"encrypted"_s).isNull();
+    }
+    bool isEncrypted(const QXmppMessage &) override
+    {
+        return false;
+    }
+
+    void finishDecryption(qsizetype index)
+    {
+        auto [id, promise] = decryptions.takeAt(index);
+        QXmppMessage message;
+        message.setId(id);
+        message.setBody(u"decrypted "_s + id);
+        promise.finish(std::move(message));
+    }
+};
+
+void tst_QXmppMamManager::testStreamMessages()
+{
+    TestClient test;
+    auto *manager = test.addNewExtension<QXmppMamManager>();
+
+    QXmppResultSetQuery resultSetQuery;
+    resultSetQuery.setMax(2);
+
+    QStringList bodies;
+    auto handleMessage = [&](QXmppMessage &&message) {
+        bodies << message.body();
+    };
+    auto task = manager->streamMessages(handleMessage, {}, {}, {}, {}, {}, resultSetQuery);
+
+    // first page
+    auto query = xmlToDom(test.takePacket());
+    auto set = query.firstChildElement(u"query"_s).firstChildElement(u"set"_s);
+    QCOMPARE(set.firstChildElement(u"max"_s).text(), u"2"_s);
+    QVERIFY(set.firstChildElement(u"after"_s).isNull());
+    auto queryId = query.attribute(u"id"_s);
+
+    QVERIFY(manager->handleStanza(xmlToDom(mamMessage(queryId, u"a"_s, u"Hello"_s))));
+    // messages are reported on arrival
+    QCOMPARE(bodies, QStringList { u"Hello"_s });
+    QVERIFY(manager->handleStanza(xmlToDom(mamMessage(queryId, u"b"_s, u"World"_s))));
+    test.inject(u"<iq id='%1' type='result'>"
+                "<fin xmlns='urn:xmpp:mam:2'><set xmlns='http://jabber.org/protocol/rsm'><first>a</first><last>b</last></set></fin>"
+                "</iq>"_s.arg(queryId));
+    QVERIFY(!task.isFinished());
+
+    // second page continues after the last message
+    query = xmlToDom(test.takePacket());
+    set = query.firstChildElement(u"query"_s).firstChildElement(u"set"_s);
+    QCOMPARE(set.firstChildElement(u"after"_s).text(), u"b"_s);
+    queryId = query.attribute(u"id"_s);
+
+    QVERIFY(manager->handleStanza(xmlToDom(mamMessage(queryId, u"c"_s, u"!"_s))));
+    test.inject(u"<iq id='%1' type='result'>"
+                "<fin xmlns='urn:xmpp:mam:2' complete='true'><set xmlns='http://jabber.org/protocol/rsm'><first>c</first><last>c</last></set></fin>"
+                "</iq>"_s.arg(queryId));
+
+    QCOMPARE(expectFutureVariant<QXmppResultSetReply>(task).last(), u"c"_s);
+    QCOMPARE(bodies, (QStringList { u"Hello"_s, u"World"_s, u"!"_s }));
+    test.expectNoPacket();
+}
+
+void tst_QXmppMamManager::testStreamMessagesBackwards()
+{
+    TestClient test;
+    auto *manager = test.addNewExtension<QXmppMamManager>();
+
+    QXmppResultSetQuery resultSetQuery;
+    resultSetQuery.setMax(2);
+    resultSetQuery.setBefore(u"e"_s);
+
+    QStringList bodies;
+    auto task = manager->streamMessages([&](QXmppMessage &&message) { bodies << message.body(); }, {}, {}, {}, {}, {}, resultSetQuery);
+
+    auto query = xmlToDom(test.takePacket());
+    auto queryId = query.attribute(u"id"_s);
+    QCOMPARE(query.firstChildElement(u"query"_s).firstChildElement(u"set"_s).firstChildElement(u"before"_s).text(), u"e"_s);
+    manager->handleStanza(xmlToDom(mamMessage(queryId, u"c"_s, u"3"_s)));
+    manager->handleStanza(xmlToDom(mamMessage(queryId, u"d"_s, u"4"_s)));
+    test.inject(u"<iq id='%1' type='result'>"
+                "<fin xmlns='urn:xmpp:mam:2'><set xmlns='http://jabber.org/protocol/rsm'><first>c</first><last>d</last></set></fin>"
+                "</iq>"_s.arg(queryId));
+
+    // the next page is the one before the first message
+    query = xmlToDom(test.takePacket());
+    queryId = query.attribute(u"id"_s);
+    auto set = query.firstChildElement(u"query"_s).firstChildElement(u"set"_s);
+    QCOMPARE(set.firstChildElement(u"before"_s).text(), u"c"_s);
+    QVERIFY(set.firstChildElement(u"after"_s).isNull());
+    manager->handleStanza(xmlToDom(mamMessage(queryId, u"a"_s, u"1"_s)));
+    manager->handleStanza(xmlToDom(mamMessage(queryId, u"b"_s, u"2"_s)));
+    test.inject(u"<iq id='%1' type='result'>"
+                "<fin xmlns='urn:xmpp:mam:2' complete='true'><set xmlns='http://jabber.org/protocol/rsm'><first>a</first><last>b</last></set></fin>"
+                "</iq>"_s.arg(queryId));
+
+    QCOMPARE(expectFutureVariant<QXmppResultSetReply>(task).first(), u"a"_s);
+    QCOMPARE(bodies, (QStringList { u"3"_s, u"4"_s, u"1"_s, u"2"_s }));
+    test.expectNoPacket();
+}
+
+void tst_QXmppMamManager::testParallelDecryption()
+{
+    TestClient test;
+    PendingEncryption encryption;
+    test.setEncryptionExtension(&encryption);
+    auto *manager = test.addNewExtension<QXmppMamManager>();
+    manager->setMaxParallelDecryptions(2);
+
+    QStringList bodies;
+    auto handleMessage = [&](QXmppMessage &&message) {
+        bodies << message.body();
+    };
+    auto task = manager->streamMessages(handleMessage);
+    auto queryId = xmlToDom(test.takePacket()).attribute(u"id"_s);
+
+    manager->handleStanza(xmlToDom(mamMessage(queryId, u"a"_s, {}, true)));
+    manager->handleStanza(xmlToDom(mamMessage(queryId, u"b"_s, {}, true)));
+    manager->handleStanza(xmlToDom(mamMessage(queryId, u"c"_s, {}, true)));
+    manager->handleStanza(xmlToDom(mamMessage(queryId, u"d"_s, u"plain"_s)));
+    test.inject(u"<iq id='%1' type='result'><fin xmlns='urn:xmpp:mam:2' complete='true'/></iq>"_s.arg(queryId));
+
+    // only two messages are decrypted at the same time
+    QCOMPARE(encryption.decryptions.size(), 2);
+
+    // later messages wait for earlier ones
+    encryption.finishDecryption(1);
+    QVERIFY(bodies.isEmpty());
+    QCoreApplication::processEvents();
+    QCOMPARE(encryption.decryptions.size(), 2);
+
+    encryption.finishDecryption(0);
+    QCOMPARE(bodies, (QStringList { u"decrypted a"_s, u"decrypted b"_s }));
+    QVERIFY(!task.isFinished());
+
+    QCoreApplication::processEvents();
+    encryption.finishDecryption(0);
+    QCOMPARE(bodies, (QStringList { u"decrypted a"_s, u"decrypted b"_s, u"decrypted c"_s, u"plain"_s }));
+    expectFutureVariant<QXmppResultSetReply>(task);
+}
+
+void tst_QXmppMamManager::testSynchronizeMessages()
+{
+    TestClient test;
+    auto *manager = test.addNewExtension<QXmppMamManager>();
+    manager->setMaxParallelQueries(2);
+
+    QStringList bodies;
+    QString lastStanzaId;
+    auto handleMessage = [&](QXmppMessage &&message, const QXmppMamManager::SyncCheckpoint &checkpoint) {
+        bodies << message.body();
+        lastStanzaId = checkpoint.stanzaId;
+    };
+
+    // 36 hours are split into two slices that are queried in parallel
+    QXmppMamManager::SyncCheckpoint checkpoint { u"0"_s, QDateTime::currentDateTimeUtc().addSecs(-36 * 60 * 60) };
+    auto task = manager->synchronizeMessages(checkpoint, handleMessage);
+
+    auto query1 = xmlToDom(test.takePacket());
+    auto query2 = xmlToDom(test.takePacket());
+    test.expectNoPacket();
+    auto queryId1 = query1.attribute(u"id"_s);
+    auto queryId2 = query2.attribute(u"id"_s);
+    QCOMPARE(query1.firstChildElement(u"query"_s).firstChildElement(u"set"_s).firstChildElement(u"after"_s).text(), u"0"_s);
+    const auto boundary = QXmppUtils::datetimeFromString(queryField(query1, u"end"_s));
+    QVERIFY(boundary.isValid());
+    QCOMPARE(QXmppUtils::datetimeFromString(queryField(query2, u"start"_s)), boundary);
+    // the last slice has no end
+    QVERIFY(queryField(query2, u"end"_s).isEmpty());
+
+    // the later slice is held back
+    manager->handleStanza(xmlToDom(mamMessage(queryId2, u"b"_s, u"2"_s, false, boundary)));
+    manager->handleStanza(xmlToDom(mamMessage(queryId2, u"c"_s, u"3"_s, false, boundary.addSecs(60))));
+    test.inject(u"<iq id='%1' type='result'><fin xmlns='urn:xmpp:mam:2' complete='true'/></iq>"_s.arg(queryId2));
+    QVERIFY(bodies.isEmpty());
+
+    // the first slice is reported directly, the message at the boundary only once
+    manager->handleStanza(xmlToDom(mamMessage(queryId1, u"a"_s, u"1"_s, false, boundary.addSecs(-60 * 60))));
+    QCOMPARE(bodies, QStringList { u"1"_s });
+    QCOMPARE(lastStanzaId, u"a"_s);
+    manager->handleStanza(xmlToDom(mamMessage(queryId1, u"b"_s, u"2"_s, false, boundary)));
+    test.inject(u"<iq id='%1' type='result'><fin xmlns='urn:xmpp:mam:2' complete='true'/></iq>"_s.arg(queryId1));
+
+    QCOMPARE(bodies, (QStringList { u"1"_s, u"2"_s, u"3"_s }));
+    QCOMPARE(expectFutureVariant<QXmppMamManager::SyncCheckpoint>(task).stanzaId, u"c"_s);
+    test.expectNoPacket();
+}
+
+void tst_QXmppMamManager::testSynchronizeMessagesError()
+{
+    TestClient test;
+    auto *manager = test.addNewExtension<QXmppMamManager>();
+    manager->setMaxParallelQueries(2);
+
+    QStringList bodies;
+    auto handleMessage = [&](QXmppMessage &&message, const QXmppMamManager::SyncCheckpoint &) {
+        bodies << message.body();
+    };
+
+    QXmppMamManager::SyncCheckpoint checkpoint { u"0"_s, QDateTime::currentDateTimeUtc().addSecs(-36 * 60 * 60) };
+    auto task = manager->synchronizeMessages(checkpoint, handleMessage);
+
+    auto queryId1 = xmlToDom(test.takePacket()).attribute(u"id"_s);
+    auto queryId2 = xmlToDom(test.takePacket()).attribute(u"id"_s);
+
+    manager->handleStanza(xmlToDom(mamMessage(queryId2, u"c"_s, u"3"_s)));
+    test.inject(u"<iq id='%1' type='error'><error type='cancel'><item-not-found xmlns='urn:ietf:params:xml:ns:xmpp-stanzas'/></error></iq>"_s.arg(queryId2));
+    expectFutureVariant<QXmppError>(task);
+
+    // the other slice is cancelled: no messages are reported and no further pages are requested
+    manager->handleStanza(xmlToDom(mamMessage(queryId1, u"a"_s, u"1"_s)));
+    test.inject(u"<iq id='%1' type='result'>"
+                "<fin xmlns='urn:xmpp:mam:2'><set xmlns='http://jabber.org/protocol/rsm'><first>a</first><last>a</last></set></fin>"
+                "</iq>"_s.arg(queryId1));
+    QVERIFY(bodies.isEmpty());
+    test.expectNoPacket();
+}
+
+void tst_QXmppMamManager::testSynchronizeMessagesResume()
+{
+    TestClient test;
+    test.configuration().setJid(u"juliet@capulet.lit/chamber"_s);
+    test.setMessageDeduplicationEnabled(true);
+    auto *manager = test.addNewExtension<QXmppMamManager>();
+    manager->setMaxParallelQueries(2);
+
+    QStringList bodies;
+    auto handleMessage = [&](QXmppMessage &&message, const QXmppMamManager::SyncCheckpoint &) {
+        bodies << message.body();
+    };
+
+    QXmppMamManager::SyncCheckpoint checkpoint { u"0"_s, QDateTime::currentDateTimeUtc().addSecs(-36 * 60 * 60) };
+    auto task = manager->synchronizeMessages(checkpoint, handleMessage);
+    auto queryId1 = xmlToDom(test.takePacket()).attribute(u"id"_s);
+    auto queryId2 = xmlToDom(test.takePacket()).attribute(u"id"_s);
+
+    // the message of the later slice is only buffered when the synchronization fails
+    manager->handleStanza(xmlToDom(mamMessage(queryId2, u"c"_s, u"3"_s)));
+    test.inject(u"<iq id='%1' type='error'><error type='cancel'><item-not-found xmlns='urn:ietf:params:xml:ns:xmpp-stanzas'/></error></iq>"_s.arg(queryId1));
+    expectFutureVariant<QXmppError>(task);
+    QVERIFY(bodies.isEmpty());
+
+    // it is reported after resuming
+    task = manager->synchronizeMessages(checkpoint, handleMessage);
+    queryId1 = xmlToDom(test.takePacket()).attribute(u"id"_s);
+    queryId2 = xmlToDom(test.takePacket()).attribute(u"id"_s);
+    manager->handleStanza(xmlToDom(mamMessage(queryId1, u"a"_s, u"1"_s)));
+    test.inject(u"<iq id='%1' type='result'><fin xmlns='urn:xmpp:mam:2' complete='true'/></iq>"_s.arg(queryId1));
+    manager->handleStanza(xmlToDom(mamMessage(queryId2, u"c"_s, u"3"_s)));
+    test.inject(u"<iq id='%1' type='result'><fin xmlns='urn:xmpp:mam:2' complete='true'/></iq>"_s.arg(queryId2));
+    QCOMPARE(expectFutureVariant<QXmppMamManager::SyncCheckpoint>(task).stanzaId, u"c"_s);
+    QCOMPARE(bodies, (QStringList { u"1"_s, u"3"_s }));
+
+    // committed messages are skipped by later synchronizations
+    bodies.clear();
+    task = manager->synchronizeMessages(checkpoint, handleMessage);
+    queryId1 = xmlToDom(test.takePacket()).attribute(u"id"_s);
+    queryId2 = xmlToDom(test.takePacket()).attribute(u"id"_s);
+    manager->handleStanza(xmlToDom(mamMessage(queryId1, u"a"_s, u"1"_s)));
+    test.inject(u"<iq id='%1' type='result'><fin xmlns='urn:xmpp:mam:2' complete='true'/></iq>"_s.arg(queryId1));
+    test.inject(u"<iq id='%1' type='result'><fin xmlns='urn:xmpp:mam:2' complete='true'/></iq>"_s.arg(queryId2));
+    expectFutureVariant<QXmppMamManager::SyncCheckpoint>(task);
+    QVERIFY(bodies.isEmpty());
+    test.expectNoPacket();
+}
+
+void tst_QXmppMamManager::testSynchronizeMessagesBuffer()
+{
+    TestClient test;
+    auto *manager = test.addNewExtension<QXmppMamManager>();
+    manager->setMaxParallelQueries(2);
+
+    qsizetype count = 0;
+    auto handleMessage = [&](QXmppMessage &&, const QXmppMamManager::SyncCheckpoint &) {
+        count++;
+    };
+
+    QXmppMamManager::SyncCheckpoint checkpoint { u"0"_s, QDateTime::currentDateTimeUtc().addSecs(-36 * 60 * 60) };
+    auto task = manager->synchronizeMessages(checkpoint, handleMessage);
+    auto queryId1 = xmlToDom(test.takePacket()).attribute(u"id"_s);
+    auto queryId2 = xmlToDom(test.takePacket()).attribute(u"id"_s);
+
+    // the later slice is paused once it holds back too many messages
+    for (int i = 0; i < 500; i++) {
+        manager->handleStanza(xmlToDom(mamMessage(queryId2, u"b%1"_s.arg(i), u"2"_s)));
+    }
+    test.inject(u"<iq id='%1' type='result'>"
+                "<fin xmlns='urn:xmpp:mam:2'><set xmlns='http://jabber.org/protocol/rsm'><first>b0</first><last>b499</last></set></fin>"
+                "</iq>"_s.arg(queryId2));
+    test.expectNoPacket();
+
+    // and continued when the earlier slice has been reported
+    manager->handleStanza(xmlToDom(mamMessage(queryId1, u"a"_s, u"1"_s)));
+    test.inject(u"<iq id='%1' type='result'><fin xmlns='urn:xmpp:mam:2' complete='true'/></iq>"_s.arg(queryId1));
+    QCOMPARE(count, 501);
+    auto query = xmlToDom(test.takePacket());
+    QCOMPARE(query.firstChildElement(u"query"_s).firstChildElement(u"set"_s).firstChildElement(u"after"_s).text(), u"b499"_s);
+    test.inject(u"<iq id='%1' type='result'><fin xmlns='urn:xmpp:mam:2' complete='true'/></iq>"_s.arg(query.attribute(u"id"_s)));
+    QCOMPARE(expectFutureVariant<QXmppMamManager::SyncCheckpoint>(task).stanzaId, u"b499"_s);
+    test.expectNoPacket();
+}
+
 void QXmppMamTestHelper::archivedMessageReceived(const QString &queryId, const QXmppMessage &message)
 {
     m_signalTriggered = true;
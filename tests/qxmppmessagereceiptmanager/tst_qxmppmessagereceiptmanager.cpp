@@ -5,6 +5,7 @@
 #include "QXmppClient.h"
 #include "QXmppMessageReceiptManager.h"
 
+#include "TestClient.h"
 #include "util.h"
 
 #include <QObject>
@@ -18,6 +19,8 @@ private:
 
     Q_SLOT void testReceipt_data();
     Q_SLOT void testReceipt();
+    Q_SLOT void testBatchedReceipts();
+    Q_SLOT void testGroupChatMarkers();
 
     void handleMessageDelivered(const QString &, const QString &)
     {
@@ -173,5 +176,134 @@ void tst_QXmppMessageReceiptManager::testReceipt()
     QCOMPARE(m_receiptSent, sent);
 }
 
+void tst_QXmppMessageReceiptManager::testBatchedReceipts()
+{
+    using namespace std::chrono_literals;
+
+    TestClient test;
+    auto *manager = test.addNewExtension<QXmppMessageReceiptManager>();
+    // receipts are sent manually
+    manager->setBatchInterval(1h);
+
+    auto message = [](const QString &from, const QString &id, bool markable) {
+        QXmppMessage message(from, u"northumberland@shakespeare.lit/westminster"_s, u"Hi"_s);
+        message.setId(id);
+        message.setReceiptRequested(true);
+        message.setMarkable(markable);
+        return message;
+    };
+    auto takeMessage = [&]() {
+        QXmppMessage message;
+        parsePacket(message, test.takePacket().toUtf8());
+        return message;
+    };
+
+    const auto richard = u"kingrichard@royalty.england.lit/throne"_s;
+    const auto henry = u"henry@royalty.england.lit/palace"_s;
+    QVERIFY(!manager->handleMessage(message(richard, u"r1"_s, true)));
+    QVERIFY(!manager->handleMessage(message(henry, u"h1"_s, false)));
+    QVERIFY(!manager->handleMessage(message(richard, u"r2"_s, true)));
+    QVERIFY(!manager->handleMessage(message(henry, u"h2"_s, true)));
+    test.expectNoPacket();
+
+    manager->sendPendingReceipts();
+
+    // single marker for the latest message of a peer supporting chat markers
+    auto marker = takeMessage();
+    QCOMPARE(marker.to(), richard);
+    QCOMPARE(marker.marker(), QXmppMessage::Received);
+    QCOMPARE(marker.markedId(), u"r2"_s);
+    QCOMPARE(marker.receiptId(), u"r2"_s);
+
+    // one receipt per message otherwise
+    auto receipt = takeMessage();
+    QCOMPARE(receipt.to(), henry);
+    QCOMPARE(receipt.receiptId(), u"h1"_s);
+    QCOMPARE(receipt.marker(), QXmppMessage::NoMarker);
+    receipt = takeMessage();
+    QCOMPARE(receipt.receiptId(), u"h2"_s);
+    test.expectNoPacket();
+
+    // displayed marker for the latest message replaces the received marker
+    auto latest = message(richard, u"r3"_s, true);
+    manager->handleMessage(latest);
+    manager->sendDisplayedMarker(latest);
+    manager->sendPendingReceipts();
+    marker = takeMessage();
+    QCOMPARE(marker.marker(), QXmppMessage::Displayed);
+    QCOMPARE(marker.markedId(), u"r3"_s);
+    QCOMPARE(marker.receiptId(), u"r3"_s);
+    test.expectNoPacket();
+
+    // without batching receipts are sent immediately
+    manager->handleMessage(message(richard, u"r4"_s, true));
+    manager->setBatchInterval(0ms);
+    QCOMPARE(takeMessage().markedId(), u"r4"_s);
+    manager->handleMessage(message(richard, u"r5"_s, true));
+    receipt = takeMessage();
+    QCOMPARE(receipt.receiptId(), u"r5"_s);
+    QCOMPARE(receipt.marker(), QXmppMessage::NoMarker);
+    test.expectNoPacket();
+}
+
+void tst_QXmppMessageReceiptManager::testGroupChatMarkers()
+{
+    using namespace std::chrono_literals;
+
+    TestClient test;
+    auto *manager = test.addNewExtension<QXmppMessageReceiptManager>();
+    manager->setBatchInterval(1h);
+
+    const auto room = u"coven@chat.shakespeare.lit"_s;
+    const auto occupant = u"coven@chat.shakespeare.lit/thirdwitch"_s;
+    auto message = [&](const QString &id, const QString &stanzaId) {
+        QXmppMessage message(occupant, u"hag66@shakespeare.lit/pda"_s, u"Hi"_s);
+        message.setType(QXmppMessage::GroupChat);
+        message.setId(id);
+        message.setReceiptRequested(true);
+        message.setMarkable(true);
+        if (!stanzaId.isEmpty()) {
+            message.setStanzaIds({ QXmppStanzaId { stanzaId, room } });
+        }
+        return message;
+    };
+    auto takeMessage = [&]() {
+        QXmppMessage message;
+        parsePacket(message, test.takePacket().toUtf8());
+        return message;
+    };
+
+    auto first = message(u"m1"_s, u"s1"_s);
+    auto second = message(u"m2"_s, u"s2"_s);
+    manager->handleMessage(first);
+    manager->handleMessage(second);
+    manager->sendDisplayedMarker(first);
+    manager->sendDisplayedMarker(second);
+    manager->sendPendingReceipts();
+
+    // no received markers in groupchats
+    auto receipt = takeMessage();
+    QCOMPARE(receipt.to(), occupant);
+    QCOMPARE(receipt.receiptId(), u"m1"_s);
+    QCOMPARE(receipt.marker(), QXmppMessage::NoMarker);
+    receipt = takeMessage();
+    QCOMPARE(receipt.receiptId(), u"m2"_s);
+    QCOMPARE(receipt.marker(), QXmppMessage::NoMarker);
+
+    // displayed marker goes to the room and references the room's stanza ID
+    auto marker = takeMessage();
+    QCOMPARE(marker.to(), room);
+    QCOMPARE(marker.type(), QXmppMessage::GroupChat);
+    QCOMPARE(marker.marker(), QXmppMessage::Displayed);
+    QCOMPARE(marker.markedId(), u"s2"_s);
+    QVERIFY(marker.receiptId().isEmpty());
+    test.expectNoPacket();
+
+    // messages without a stanza ID from the room can't be marked
+    manager->setBatchInterval(0ms);
+    manager->sendDisplayedMarker(message(u"m3"_s, {}));
+    test.expectNoPacket();
+}
+
 QTEST_MAIN(tst_QXmppMessageReceiptManager)
 #include "tst_qxmppmessagereceiptmanager.moc"
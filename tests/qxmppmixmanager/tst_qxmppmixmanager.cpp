@@ -78,6 +78,7 @@ private:
     Q_SLOT void testRequestParticipants();
     Q_SLOT void testLeaveChannel();
     Q_SLOT void testDeleteChannel();
+    Q_SLOT void testChannelCache();
 
     template<typename T>
     void testErrorFromChannel(QXmppTask<T> &task, TestClient &client);
@@ -1554,5 +1555,122 @@ void tst_QXmppMixManager::testError(QXmppTask<T> &task, TestClient &client, cons
     expectFutureVariant<QXmppError>(task);
 }
 
+void tst_QXmppMixManager::testChannelCache()
+{
+    auto tester = Tester(u"hag66@shakespeare.example"_s);
+    auto &client = tester.client;
+    auto manager = tester.manager;
+    const auto channelJid = u"coven@mix.shakespeare.example"_s;
+    const auto participantsNode = u"urn:xmpp:mix:nodes:participants"_s;
+
+    QVERIFY(!manager->isChannelCacheEnabled(channelJid));
+    manager->setChannelCacheEnabled(channelJid, true);
+    QVERIFY(manager->isChannelCacheEnabled(channelJid));
+    QVERIFY(!manager->cachedParticipants(channelJid));
+
+    // the first request fills the cache
+    auto task = manager->requestParticipants(channelJid);
+    client.expect(QStringLiteral("<iq id='qxmpp1' to='coven@mix.shakespeare.example' type='get'>"
+                                 "<pubsub xmlns='http://jabber.org/protocol/pubsub'>"
+                                 "<items node='urn:xmpp:mix:nodes:participants'/>"
+                                 "</pubsub>"
+                                 "</iq>"));
+    client.inject(QStringLiteral("<iq id='qxmpp1' from='coven@mix.shakespeare.example' type='result'>"
+                                 "<pubsub xmlns='http://jabber.org/protocol/pubsub'>"
+                                 "<items node='urn:xmpp:mix:nodes:participants'>"
+                                 "<item id='123456'>"
+                                 "<participant xmlns='urn:xmpp:mix:core:1'>"
+                                 "<nick>thirdwitch</nick>"
+                                 "<jid>hag66@shakespeare.example</jid>"
+                                 "</participant>"
+                                 "</item>"
+                                 "</items>"
+                                 "</pubsub>"
+                                 "</iq>"));
+    QCOMPARE(expectFutureVariant<QVector<QXmppMixParticipantItem>>(task).size(), 1);
+    QCOMPARE(manager->cachedParticipant(channelJid, u"123456"_s)->nick(), u"thirdwitch"_s);
+
+    // events keep the cache up to date
+    manager->handlePubSubEvent(xmlToDom(QStringLiteral("<message from='coven@mix.shakespeare.example' to='hag66@shakespeare.example'>"
+                                                       "<event xmlns='http://jabber.org/protocol/pubsub#event'>"
+                                                       "<items node='urn:xmpp:mix:nodes:participants'>"
+                                                       "<item id='123457'>"
+                                                       "<participant xmlns='urn:xmpp:mix:core:1'>"
+                                                       "<nick>fourthwitch</nick>"
+                                                       "<jid>hag67@shakespeare.example</jid>"
+                                                       "</participant>"
+                                                       "</item>"
+                                                       "</items>"
+                                                       "</event>"
+                                                       "</message>")),
+                               channelJid,
+                               participantsNode);
+    // the cached participants are sorted by their IDs
+    const auto cachedParticipants = *manager->cachedParticipants(channelJid);
+    QCOMPARE(cachedParticipants.size(), 2);
+    QCOMPARE(cachedParticipants.at(0).id(), u"123456"_s);
+    QCOMPARE(cachedParticipants.at(1).id(), u"123457"_s);
+
+    manager->handlePubSubEvent(xmlToDom(QStringLiteral("<message from='coven@mix.shakespeare.example' to='hag66@shakespeare.example'>"
+                                                       "<event xmlns='http://jabber.org/protocol/pubsub#event'>"
+                                                       "<items node='urn:xmpp:mix:nodes:participants'>"
+                                                       "<retract id='123456'/>"
+                                                       "</items>"
+                                                       "</event>"
+                                                       "</message>")),
+                               channelJid,
+                               participantsNode);
+    QVERIFY(!manager->cachedParticipant(channelJid, u"123456"_s));
+    QCOMPARE(manager->cachedParticipant(channelJid, u"123457"_s)->nick(), u"fourthwitch"_s);
+
+    // cached data is returned without network traffic
+    task = manager->requestParticipants(channelJid);
+    client.expectNoPacket();
+    const auto participants = expectFutureVariant<QVector<QXmppMixParticipantItem>>(task);
+    QCOMPARE(participants.size(), 1);
+    QCOMPARE(participants.constFirst().jid(), u"hag67@shakespeare.example"_s);
+
+    // nodes which have not been requested are not cached
+    QVERIFY(!manager->cachedChannelInformation(channelJid));
+    auto informationTask = manager->requestChannelInformation(channelJid);
+    client.expect(QStringLiteral("<iq id='qxmpp1' to='coven@mix.shakespeare.example' type='get'>"
+                                 "<pubsub xmlns='http://jabber.org/protocol/pubsub'>"
+                                 "<items node='urn:xmpp:mix:nodes:info'/>"
+                                 "</pubsub>"
+                                 "</iq>"));
+    client.inject(QStringLiteral("<iq id='qxmpp1' from='coven@mix.shakespeare.example' type='result'>"
+                                 "<pubsub xmlns='http://jabber.org/protocol/pubsub'>"
+                                 "<items node='urn:xmpp:mix:nodes:info'>"
+                                 "<item id='2016-05-30T09:00:00'>"
+                                 "<x xmlns='jabber:x:data' type='result'>"
+                                 "<field type='hidden' var='FORM_TYPE'>"
+                                 "<value>urn:xmpp:mix:core:1</value>"
+                                 "</field>"
+                                 "<field type='text-single' var='Name'>"
+                                 "<value>Witches Coven</value>"
+                                 "</field>"
+                                 "</x>"
+                                 "</item>"
+                                 "</items>"
+                                 "</pubsub>"
+                                 "</iq>"));
+    QCOMPARE(expectFutureVariant<QXmppMixInfoItem>(informationTask).name(), u"Witches Coven"_s);
+    QCOMPARE(manager->cachedChannelInformation(channelJid)->name(), u"Witches Coven"_s);
+
+    // leaving the channel removes its cache
+    manager->leaveChannel(channelJid);
+    client.expect(QStringLiteral("<iq id='qxmpp1' to='hag66@shakespeare.example' type='set'>"
+                                 "<client-leave xmlns='urn:xmpp:mix:pam:2' channel='coven@mix.shakespeare.example'>"
+                                 "<leave xmlns='urn:xmpp:mix:core:1'/>"
+                                 "</client-leave>"
+                                 "</iq>"));
+    client.inject(QStringLiteral("<iq id='qxmpp1' type='result'>"
+                                 "<client-leave xmlns='urn:xmpp:mix:pam:2' channel='coven@mix.shakespeare.example'>"
+                                 "<leave xmlns='urn:xmpp:mix:core:1'/>"
+                                 "</client-leave>"
+                                 "</iq>"));
+    QVERIFY(!manager->isChannelCacheEnabled(channelJid));
+}
+
 QTEST_MAIN(tst_QXmppMixManager)
 #include "tst_qxmppmixmanager.moc"
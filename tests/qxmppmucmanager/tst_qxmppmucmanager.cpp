@@ -0,0 +1,197 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppMessage.h"
+#include "QXmppMucManager.h"
+
+#include "TestClient.h"
+#include "util.h"
+
+#include <QSignalSpy>
+
+#include <algorithm>
+
+class tst_QXmppMucManager : public QObject
+{
+    Q_OBJECT
+
+private:
+    Q_SLOT void testRouting();
+    Q_SLOT void testParticipants();
+    Q_SLOT void testBatchedJoin();
+    Q_SLOT void testLurkerJoin();
+};
+
+static QXmppPresence occupantPresence(const QString &jid, QXmppPresence::Type type = QXmppPresence::Available)
+{
+    QXmppPresence presence(type);
+    presence.setFrom(jid);
+    presence.setMucSupported(true);
+    return presence;
+}
+
+void tst_QXmppMucManager::testRouting()
+{
+    TestClient test;
+    auto *manager = test.addNewExtension<QXmppMucManager>();
+
+    auto *coven = manager->addRoom(u"coven@chat.shakespeare.lit"_s);
+    auto *chapel = manager->addRoom(u"chapel@chat.shakespeare.lit"_s);
+    QCOMPARE(manager->addRoom(u"coven@chat.shakespeare.lit"_s), coven);
+    QCOMPARE(manager->rooms().size(), 2);
+
+    QSignalSpy covenMessages(coven, &QXmppMucRoom::messageReceived);
+    QSignalSpy chapelMessages(chapel, &QXmppMucRoom::messageReceived);
+    QSignalSpy covenAdded(coven, &QXmppMucRoom::participantAdded);
+    QSignalSpy chapelAdded(chapel, &QXmppMucRoom::participantAdded);
+
+    QXmppMessage message;
+    message.setFrom(u"coven@chat.shakespeare.lit/thirdwitch"_s);
+    message.setType(QXmppMessage::GroupChat);
+    message.setSubject(u"Fire Burn and Cauldron Bubble!"_s);
+    Q_EMIT test.messageReceived(message);
+    QCOMPARE(covenMessages.size(), 1);
+    QCOMPARE(chapelMessages.size(), 0);
+    QCOMPARE(coven->subject(), u"Fire Burn and Cauldron Bubble!"_s);
+
+    Q_EMIT test.presenceReceived(occupantPresence(u"chapel@chat.shakespeare.lit/hag66"_s));
+    QCOMPARE(covenAdded.size(), 0);
+    QCOMPARE(chapelAdded.size(), 1);
+    QCOMPARE(chapel->participants(), QStringList { u"chapel@chat.shakespeare.lit/hag66"_s });
+
+    // stanzas of unknown rooms are ignored
+    message.setFrom(u"darkcave@chat.shakespeare.lit/thirdwitch"_s);
+    Q_EMIT test.messageReceived(message);
+    QCOMPARE(covenMessages.size(), 1);
+    QCOMPARE(chapelMessages.size(), 0);
+
+    // destroyed rooms are not routed to anymore
+    delete chapel;
+    QCOMPARE(manager->rooms(), QList<QXmppMucRoom *> { coven });
+    Q_EMIT test.presenceReceived(occupantPresence(u"chapel@chat.shakespeare.lit/hag77"_s));
+    QCOMPARE(covenAdded.size(), 0);
+}
+
+void tst_QXmppMucManager::testParticipants()
+{
+    TestClient test;
+    auto *manager = test.addNewExtension<QXmppMucManager>();
+    auto *room = manager->addRoom(u"coven@chat.shakespeare.lit"_s);
+    room->setNickName(u"thirdwitch"_s);
+
+    QSignalSpy added(room, &QXmppMucRoom::participantAdded);
+    QSignalSpy changed(room, &QXmppMucRoom::participantChanged);
+    QSignalSpy removed(room, &QXmppMucRoom::participantRemoved);
+    QSignalSpy listChanged(room, &QXmppMucRoom::participantsChanged);
+    QSignalSpy joined(room, &QXmppMucRoom::joined);
+
+    // every occupant is reported while joining
+    for (int i = 0; i < 100; i++) {
+        Q_EMIT test.presenceReceived(occupantPresence(u"coven@chat.shakespeare.lit/occupant%1"_s.arg(i)));
+    }
+    QCOMPARE(added.size(), 100);
+    QCOMPARE(listChanged.size(), 100);
+    QVERIFY(!room->isJoined());
+
+    Q_EMIT test.presenceReceived(occupantPresence(u"coven@chat.shakespeare.lit/thirdwitch"_s));
+    QVERIFY(room->isJoined());
+    QCOMPARE(joined.size(), 1);
+    QCOMPARE(added.size(), 101);
+    QCOMPARE(listChanged.size(), 101);
+    QCOMPARE(room->participants().size(), 101);
+    const auto participants = room->participants();
+    QVERIFY(std::is_sorted(participants.cbegin(), participants.cend()));
+
+    // changes after joining are reported individually
+    auto presence = occupantPresence(u"coven@chat.shakespeare.lit/occupant1"_s);
+    presence.setAvailableStatusType(QXmppPresence::Away);
+    Q_EMIT test.presenceReceived(presence);
+    QCOMPARE(changed.size(), 1);
+    QCOMPARE(room->participantPresence(u"coven@chat.shakespeare.lit/occupant1"_s).availableStatusType(), QXmppPresence::Away);
+
+    Q_EMIT test.presenceReceived(occupantPresence(u"coven@chat.shakespeare.lit/occupant2"_s, QXmppPresence::Unavailable));
+    QCOMPARE(removed.size(), 1);
+    QCOMPARE(listChanged.size(), 102);
+    QCOMPARE(room->participants().size(), 100);
+    QCOMPARE(room->participantPresence(u"coven@chat.shakespeare.lit/occupant2"_s).type(), QXmppPresence::Unavailable);
+
+    Q_EMIT test.presenceReceived(occupantPresence(u"coven@chat.shakespeare.lit/newcomer"_s));
+    QCOMPARE(added.size(), 102);
+    QCOMPARE(listChanged.size(), 103);
+}
+
+void tst_QXmppMucManager::testBatchedJoin()
+{
+    TestClient test;
+    auto *manager = test.addNewExtension<QXmppMucManager>();
+    auto *room = manager->addRoom(u"coven@chat.shakespeare.lit"_s);
+    room->setNickName(u"thirdwitch"_s);
+    room->setJoinMode(QXmppMucRoom::BatchedJoin);
+    room->setHistoryMaxStanzas(0);
+
+    QVERIFY(room->join());
+    const auto packet = test.takePacket();
+    QVERIFY(packet.contains(u"<x xmlns=\"http://jabber.org/protocol/muc\"><history maxstanzas=\"0\"/></x>"_s));
+
+    QSignalSpy added(room, &QXmppMucRoom::participantAdded);
+    QSignalSpy removed(room, &QXmppMucRoom::participantRemoved);
+    QSignalSpy reset(room, &QXmppMucRoom::participantsReset);
+    QSignalSpy nickChanged(room, &QXmppMucRoom::nickNameChanged);
+    QSignalSpy joined(room, &QXmppMucRoom::joined);
+
+    for (int i = 0; i < 100; i++) {
+        Q_EMIT test.presenceReceived(occupantPresence(u"coven@chat.shakespeare.lit/occupant%1"_s.arg(i)));
+    }
+    Q_EMIT test.presenceReceived(occupantPresence(u"coven@chat.shakespeare.lit/occupant0"_s, QXmppPresence::Unavailable));
+    QCOMPARE(added.size(), 0);
+    QCOMPARE(removed.size(), 0);
+    QCOMPARE(reset.size(), 0);
+
+    // the self-presence with a nickname assigned by the service completes the list
+    auto ownPresence = occupantPresence(u"coven@chat.shakespeare.lit/thirdwitch2"_s);
+    ownPresence.setMucStatusCodes({ 110, 210 });
+    Q_EMIT test.presenceReceived(ownPresence);
+    QCOMPARE(nickChanged.size(), 1);
+    QCOMPARE(room->nickName(), u"thirdwitch2"_s);
+    QCOMPARE(joined.size(), 1);
+    QCOMPARE(reset.size(), 1);
+    QCOMPARE(added.size(), 0);
+    QCOMPARE(room->participants().size(), 100);
+
+    // later changes are reported individually
+    Q_EMIT test.presenceReceived(occupantPresence(u"coven@chat.shakespeare.lit/newcomer"_s));
+    QCOMPARE(added.size(), 1);
+    QCOMPARE(reset.size(), 1);
+}
+
+void tst_QXmppMucManager::testLurkerJoin()
+{
+    TestClient test;
+    auto *manager = test.addNewExtension<QXmppMucManager>();
+    auto *room = manager->addRoom(u"coven@chat.shakespeare.lit"_s);
+    room->setNickName(u"thirdwitch"_s);
+    room->setJoinMode(QXmppMucRoom::LurkerJoin);
+
+    QSignalSpy added(room, &QXmppMucRoom::participantAdded);
+    QSignalSpy messages(room, &QXmppMucRoom::messageReceived);
+
+    Q_EMIT test.presenceReceived(occupantPresence(u"coven@chat.shakespeare.lit/hag66"_s));
+    Q_EMIT test.presenceReceived(occupantPresence(u"coven@chat.shakespeare.lit/thirdwitch"_s));
+    QVERIFY(room->isJoined());
+    QCOMPARE(room->participants(), QStringList { u"coven@chat.shakespeare.lit/thirdwitch"_s });
+    QCOMPARE(added.size(), 1);
+
+    Q_EMIT test.presenceReceived(occupantPresence(u"coven@chat.shakespeare.lit/hag77"_s));
+    QCOMPARE(added.size(), 1);
+
+    QXmppMessage message;
+    message.setFrom(u"coven@chat.shakespeare.lit/hag66"_s);
+    message.setType(QXmppMessage::GroupChat);
+    message.setBody(u"Thrice the brinded cat hath mew'd."_s);
+    Q_EMIT test.messageReceived(message);
+    QCOMPARE(messages.size(), 1);
+}
+
+QTEST_MAIN(tst_QXmppMucManager)
+#include "tst_qxmppmucmanager.moc"
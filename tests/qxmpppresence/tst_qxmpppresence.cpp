@@ -22,6 +22,7 @@ private:
     Q_SLOT void testPresenceWithExtendedAddresses();
     Q_SLOT void testPresenceWithMucItem();
     Q_SLOT void testPresenceWithMucPassword();
+    Q_SLOT void testPresenceWithMucHistory();
     Q_SLOT void testPresenceWithMucSupport();
     Q_SLOT void testPresenceWithMuji();
     Q_SLOT void testPresenceWithLastUserInteraction();
@@ -235,6 +236,30 @@ void tst_QXmppPresence::testPresenceWithMucPassword()
     serializePacket(presence, xml);
 }
 
+void tst_QXmppPresence::testPresenceWithMucHistory()
+{
+    const QByteArray xml(
+        "<presence to=\"coven@chat.shakespeare.lit/thirdwitch\" "
+        "from=\"hag66@shakespeare.lit/pda\">"
+        "<x xmlns=\"http://jabber.org/protocol/muc\">"
+        "<history maxstanzas=\"20\" since=\"1970-01-01T00:00:00Z\"/>"
+        "</x>"
+        "</presence>");
+
+    QXmppPresence presence;
+    parsePacket(presence, xml);
+    QCOMPARE(presence.isMucSupported(), true);
+    QVERIFY(presence.mucHistoryMaxStanzas());
+    QCOMPARE(*presence.mucHistoryMaxStanzas(), 20);
+    QCOMPARE(presence.mucHistorySince(), QDateTime(QDate(1970, 1, 1), QTime(0, 0, 0), Qt::UTC));
+    serializePacket(presence, xml);
+
+    QXmppPresence noHistory;
+    noHistory.setMucSupported(true);
+    noHistory.setMucHistoryMaxStanzas(0);
+    serializePacket(noHistory, "<presence><x xmlns=\"http://jabber.org/protocol/muc\"><history maxstanzas=\"0\"/></x></presence>");
+}
+
 void tst_QXmppPresence::testPresenceWithMucSupport()
 {
     const QByteArray xml(
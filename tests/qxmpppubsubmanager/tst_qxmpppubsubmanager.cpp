@@ -110,6 +110,11 @@ private:
     Q_SLOT void testUnsubscribeFromNode();
     Q_SLOT void testEventNotifications_data();
     Q_SLOT void testEventNotifications();
+    Q_SLOT void testItemCache();
+    Q_SLOT void testStreamItems();
+    Q_SLOT void testStreamItemsShortPage();
+    Q_SLOT void testChunkedPublishing();
+    Q_SLOT void testChunkedPublishingError();
     Q_SLOT void testStandardItemToString();
 };
 
@@ -1353,6 +1358,259 @@ void tst_QXmppPubSubManager::testEventNotifications()
     QCOMPARE(eventManager->pubSub(), psManager);
 }
 
+static QString tuneItemXml(const QString &id, const QString &title)
+{
+    return u"<item id='%1'><tune xmlns='http://jabber.org/protocol/tune'><title>%2</title></tune></item>"_s.arg(id, title);
+}
+
+void tst_QXmppPubSubManager::testItemCache()
+{
+    auto [test, psManager] = Client();
+    const auto service = u"pubsub.shakespeare.lit"_s;
+    const auto node = u"princely_musings"_s;
+
+    auto titles = [](const QVector<QXmppTuneItem> &items) {
+        QStringList titles;
+        for (const auto &item : items) {
+            titles << item.title();
+        }
+        return titles;
+    };
+
+    QVERIFY(!psManager->isItemCacheEnabled(service, node));
+    QVERIFY(!psManager->cachedItems<QXmppTuneItem>(service, node));
+
+    // initial synchronization requests all items
+    auto task = psManager->synchronizeItems<QXmppTuneItem>(service, node);
+    QVERIFY(psManager->isItemCacheEnabled(service, node));
+    test.expect(u"<iq id='qxmpp1' to='pubsub.shakespeare.lit' type='get'>"
+                "<query xmlns='http://jabber.org/protocol/disco#items' node='princely_musings'/>"
+                "</iq>"_s);
+    test.inject(u"<iq id='qxmpp1' from='pubsub.shakespeare.lit' type='result'>"
+                "<query xmlns='http://jabber.org/protocol/disco#items' node='princely_musings'>"
+                "<item jid='pubsub.shakespeare.lit' name='a'/>"
+                "<item jid='pubsub.shakespeare.lit' name='b'/>"
+                "</query></iq>"_s);
+    test.expect(u"<iq id='qxmpp1' to='pubsub.shakespeare.lit' type='get'>"
+                "<pubsub xmlns='http://jabber.org/protocol/pubsub'>"
+                "<items node='princely_musings'><item id='a'/><item id='b'/></items>"
+                "</pubsub></iq>"_s);
+    test.inject(u"<iq id='qxmpp1' from='pubsub.shakespeare.lit' type='result'>"
+                "<pubsub xmlns='http://jabber.org/protocol/pubsub'><items node='princely_musings'>%1%2</items></pubsub>"
+                "</iq>"_s.arg(tuneItemXml(u"a"_s, u"A"_s), tuneItemXml(u"b"_s, u"B"_s)));
+    QCOMPARE(titles(expectFutureVariant<PSManager::Items<QXmppTuneItem>>(task).items), (QStringList { u"A"_s, u"B"_s }));
+
+    // events update the cache
+    psManager->handleStanza(xmlToDom(u"<message from='pubsub.shakespeare.lit' to='francisco@denmark.lit'>"
+                                     "<event xmlns='http://jabber.org/protocol/pubsub#event'>"
+                                     "<items node='princely_musings'><retract id='a'/>%1</items>"
+                                     "</event></message>"_s.arg(tuneItemXml(u"c"_s, u"C"_s))));
+    QCOMPARE(titles(*psManager->cachedItems<QXmppTuneItem>(service, node)), (QStringList { u"B"_s, u"C"_s }));
+
+    // only new items are requested
+    task = psManager->synchronizeItems<QXmppTuneItem>(service, node);
+    test.expect(u"<iq id='qxmpp1' to='pubsub.shakespeare.lit' type='get'>"
+                "<query xmlns='http://jabber.org/protocol/disco#items' node='princely_musings'/>"
+                "</iq>"_s);
+    test.inject(u"<iq id='qxmpp1' from='pubsub.shakespeare.lit' type='result'>"
+                "<query xmlns='http://jabber.org/protocol/disco#items' node='princely_musings'>"
+                "<item jid='pubsub.shakespeare.lit' name='b'/>"
+                "<item jid='pubsub.shakespeare.lit' name='d'/>"
+                "</query></iq>"_s);
+    test.expect(u"<iq id='qxmpp1' to='pubsub.shakespeare.lit' type='get'>"
+                "<pubsub xmlns='http://jabber.org/protocol/pubsub'>"
+                "<items node='princely_musings'><item id='d'/></items>"
+                "</pubsub></iq>"_s);
+    test.inject(u"<iq id='qxmpp1' from='pubsub.shakespeare.lit' type='result'>"
+                "<pubsub xmlns='http://jabber.org/protocol/pubsub'><items node='princely_musings'>%1</items></pubsub>"
+                "</iq>"_s.arg(tuneItemXml(u"d"_s, u"D"_s)));
+    QCOMPARE(titles(expectFutureVariant<PSManager::Items<QXmppTuneItem>>(task).items), (QStringList { u"B"_s, u"D"_s }));
+
+    // a resumed stream keeps the cached items
+    test.setStreamManagementState(QXmppClient::ResumedStream);
+    Q_EMIT test.connected();
+    QCOMPARE(titles(*psManager->cachedItems<QXmppTuneItem>(service, node)), (QStringList { u"B"_s, u"D"_s }));
+
+    // a new stream clears them
+    test.setStreamManagementState(QXmppClient::NewStream);
+    Q_EMIT test.connected();
+    QVERIFY(psManager->isItemCacheEnabled(service, node));
+    QVERIFY(psManager->cachedItems<QXmppTuneItem>(service, node)->isEmpty());
+
+    psManager->setItemCacheEnabled(service, node, false);
+    QVERIFY(!psManager->cachedItems<QXmppTuneItem>(service, node));
+}
+
+void tst_QXmppPubSubManager::testStreamItems()
+{
+    auto [test, psManager] = Client();
+
+    QStringList titles;
+    auto task = psManager->streamItems<QXmppTuneItem>(u"pubsub.shakespeare.lit"_s, u"princely_musings"_s, [&](QXmppTuneItem &&item) {
+        titles << item.title();
+    },
+                                                      2);
+
+    test.expect(u"<iq id='qxmpp1' to='pubsub.shakespeare.lit' type='get'>"
+                "<pubsub xmlns='http://jabber.org/protocol/pubsub'>"
+                "<items node='princely_musings'/>"
+                "<set xmlns='http://jabber.org/protocol/rsm'><max>2</max></set>"
+                "</pubsub></iq>"_s);
+    test.inject(u"<iq id='qxmpp1' from='pubsub.shakespeare.lit' type='result'>"
+                "<pubsub xmlns='http://jabber.org/protocol/pubsub'><items node='princely_musings'>%1%2</items>"
+                "<set xmlns='http://jabber.org/protocol/rsm'><first>a</first><last>b</last><count>3</count></set>"
+                "</pubsub></iq>"_s.arg(tuneItemXml(u"a"_s, u"A"_s), tuneItemXml(u"b"_s, u"B"_s)));
+    QCOMPARE(titles, (QStringList { u"A"_s, u"B"_s }));
+    QVERIFY(!task.isFinished());
+
+    test.expect(u"<iq id='qxmpp1' to='pubsub.shakespeare.lit' type='get'>"
+                "<pubsub xmlns='http://jabber.org/protocol/pubsub'>"
+                "<items node='princely_musings'/>"
+                "<set xmlns='http://jabber.org/protocol/rsm'><max>2</max><after>b</after></set>"
+                "</pubsub></iq>"_s);
+    test.inject(u"<iq id='qxmpp1' from='pubsub.shakespeare.lit' type='result'>"
+                "<pubsub xmlns='http://jabber.org/protocol/pubsub'><items node='princely_musings'>%1</items>"
+                "<set xmlns='http://jabber.org/protocol/rsm'><first>c</first><last>c</last><count>3</count></set>"
+                "</pubsub></iq>"_s.arg(tuneItemXml(u"c"_s, u"C"_s)));
+    expectFutureVariant<QXmpp::Success>(task);
+    QCOMPARE(titles, (QStringList { u"A"_s, u"B"_s, u"C"_s }));
+    test.expectNoPacket();
+}
+
+void tst_QXmppPubSubManager::testStreamItemsShortPage()
+{
+    auto [test, psManager] = Client();
+
+    QStringList titles;
+    auto task = psManager->streamItems<QXmppTuneItem>(u"pubsub.shakespeare.lit"_s, u"princely_musings"_s, [&](QXmppTuneItem &&item) {
+        titles << item.title();
+    },
+                                                      2);
+
+    test.expect(u"<iq id='qxmpp1' to='pubsub.shakespeare.lit' type='get'>"
+                "<pubsub xmlns='http://jabber.org/protocol/pubsub'>"
+                "<items node='princely_musings'/>"
+                "<set xmlns='http://jabber.org/protocol/rsm'><max>2</max></set>"
+                "</pubsub></iq>"_s);
+    test.inject(u"<iq id='qxmpp1' from='pubsub.shakespeare.lit' type='result'>"
+                "<pubsub xmlns='http://jabber.org/protocol/pubsub'><items node='princely_musings'>%1</items>"
+                "<set xmlns='http://jabber.org/protocol/rsm'><first>a</first><last>a</last><count>3</count></set>"
+                "</pubsub></iq>"_s.arg(tuneItemXml(u"a"_s, u"A"_s)));
+
+    // a page with fewer items than requested doesn't end the result set
+    QVERIFY(!task.isFinished());
+    test.expect(u"<iq id='qxmpp1' to='pubsub.shakespeare.lit' type='get'>"
+                "<pubsub xmlns='http://jabber.org/protocol/pubsub'>"
+                "<items node='princely_musings'/>"
+                "<set xmlns='http://jabber.org/protocol/rsm'><max>2</max><after>a</after></set>"
+                "</pubsub></iq>"_s);
+    test.inject(u"<iq id='qxmpp1' from='pubsub.shakespeare.lit' type='result'>"
+                "<pubsub xmlns='http://jabber.org/protocol/pubsub'><items node='princely_musings'>%1%2</items>"
+                "<set xmlns='http://jabber.org/protocol/rsm'><first>b</first><last>c</last><count>3</count></set>"
+                "</pubsub></iq>"_s.arg(tuneItemXml(u"b"_s, u"B"_s), tuneItemXml(u"c"_s, u"C"_s)));
+    expectFutureVariant<QXmpp::Success>(task);
+    QCOMPARE(titles, (QStringList { u"A"_s, u"B"_s, u"C"_s }));
+    test.expectNoPacket();
+
+    // without a count, an empty page ends the result set
+    titles.clear();
+    task = psManager->streamItems<QXmppTuneItem>(u"pubsub.shakespeare.lit"_s, u"princely_musings"_s, [&](QXmppTuneItem &&item) {
+        titles << item.title();
+    },
+                                                 2);
+    test.expect(u"<iq id='qxmpp1' to='pubsub.shakespeare.lit' type='get'>"
+                "<pubsub xmlns='http://jabber.org/protocol/pubsub'>"
+                "<items node='princely_musings'/>"
+                "<set xmlns='http://jabber.org/protocol/rsm'><max>2</max></set>"
+                "</pubsub></iq>"_s);
+    test.inject(u"<iq id='qxmpp1' from='pubsub.shakespeare.lit' type='result'>"
+                "<pubsub xmlns='http://jabber.org/protocol/pubsub'><items node='princely_musings'>%1</items>"
+                "<set xmlns='http://jabber.org/protocol/rsm'><first>a</first><last>a</last></set>"
+                "</pubsub></iq>"_s.arg(tuneItemXml(u"a"_s, u"A"_s)));
+    test.expect(u"<iq id='qxmpp1' to='pubsub.shakespeare.lit' type='get'>"
+                "<pubsub xmlns='http://jabber.org/protocol/pubsub'>"
+                "<items node='princely_musings'/>"
+                "<set xmlns='http://jabber.org/protocol/rsm'><max>2</max><after>a</after></set>"
+                "</pubsub></iq>"_s);
+    test.inject(u"<iq id='qxmpp1' from='pubsub.shakespeare.lit' type='result'>"
+                "<pubsub xmlns='http://jabber.org/protocol/pubsub'><items node='princely_musings'/>"
+                "<set xmlns='http://jabber.org/protocol/rsm'><count>1</count></set>"
+                "</pubsub></iq>"_s);
+    expectFutureVariant<QXmpp::Success>(task);
+    QCOMPARE(titles, (QStringList { u"A"_s }));
+    test.expectNoPacket();
+}
+
+void tst_QXmppPubSubManager::testChunkedPublishing()
+{
+    auto [test, psManager] = Client();
+    QCOMPARE(psManager->maxPublishSize(), 0);
+
+    // every item exceeds the limit on its own
+    psManager->setMaxPublishSize(1);
+    auto task = psManager->publishItems(u"pubsub.shakespeare.lit"_s,
+                                        u"princely_musings"_s,
+                                        QVector<QXmppPubSubBaseItem> { QXmppPubSubBaseItem(u"a"_s), QXmppPubSubBaseItem(u"b"_s) });
+
+    // all requests are sent at once
+    test.expect(u"<iq id='qxmpp1' to='pubsub.shakespeare.lit' type='set'>"
+                "<pubsub xmlns='http://jabber.org/protocol/pubsub'>"
+                "<publish node='princely_musings'><item id='a'/></publish>"
+                "</pubsub></iq>"_s);
+    test.expect(u"<iq id='qxmpp2' to='pubsub.shakespeare.lit' type='set'>"
+                "<pubsub xmlns='http://jabber.org/protocol/pubsub'>"
+                "<publish node='princely_musings'><item id='b'/></publish>"
+                "</pubsub></iq>"_s);
+
+    // IDs are reported in the order of the items
+    test.inject(u"<iq id='qxmpp2' from='pubsub.shakespeare.lit' type='result'>"
+                "<pubsub xmlns='http://jabber.org/protocol/pubsub'>"
+                "<publish node='princely_musings'><item id='b'/></publish>"
+                "</pubsub></iq>"_s);
+    QVERIFY(!task.isFinished());
+    test.inject(u"<iq id='qxmpp1' from='pubsub.shakespeare.lit' type='result'>"
+                "<pubsub xmlns='http://jabber.org/protocol/pubsub'>"
+                "<publish node='princely_musings'><item id='a'/></publish>"
+                "</pubsub></iq>"_s);
+    QCOMPARE(expectFutureVariant<QVector<QString>>(task), (QVector<QString> { u"a"_s, u"b"_s }));
+}
+
+void tst_QXmppPubSubManager::testChunkedPublishingError()
+{
+    auto [test, psManager] = Client();
+    psManager->setMaxPublishSize(1);
+
+    auto task = psManager->publishItems(u"pubsub.shakespeare.lit"_s,
+                                        u"princely_musings"_s,
+                                        QVector<QXmppPubSubBaseItem> { QXmppPubSubBaseItem(u"a"_s), QXmppPubSubBaseItem(u"b"_s) });
+    test.expect(u"<iq id='qxmpp1' to='pubsub.shakespeare.lit' type='set'>"
+                "<pubsub xmlns='http://jabber.org/protocol/pubsub'>"
+                "<publish node='princely_musings'><item id='a'/></publish>"
+                "</pubsub></iq>"_s);
+    test.expect(u"<iq id='qxmpp2' to='pubsub.shakespeare.lit' type='set'>"
+                "<pubsub xmlns='http://jabber.org/protocol/pubsub'>"
+                "<publish node='princely_musings'><item id='b'/></publish>"
+                "</pubsub></iq>"_s);
+
+    test.inject(u"<iq id='qxmpp1' from='pubsub.shakespeare.lit' type='result'>"
+                "<pubsub xmlns='http://jabber.org/protocol/pubsub'>"
+                "<publish node='princely_musings'><item id='a'/></publish>"
+                "</pubsub></iq>"_s);
+    test.inject(u"<iq id='qxmpp2' from='pubsub.shakespeare.lit' type='error'>"
+                "<error type='wait'><resource-constraint xmlns='urn:ietf:params:xml:ns:xmpp-stanzas'/></error>"
+                "</iq>"_s);
+
+    // the error tells which requests have been published
+    auto error = expectFutureVariant<QXmppError>(task);
+    auto chunkedError = error.value<PSManager::ChunkedPublishError>();
+    QVERIFY(chunkedError);
+    QCOMPARE(chunkedError->chunkSizes, (QVector<qsizetype> { 1, 1 }));
+    QCOMPARE(chunkedError->chunkResults.size(), 2);
+    QCOMPARE(std::get<QVector<QString>>(chunkedError->chunkResults.at(0)), QVector<QString> { u"a"_s });
+    auto chunkError = std::get<QXmppError>(chunkedError->chunkResults.at(1));
+    QCOMPARE(chunkError.value<QXmppStanza::Error>()->condition(), QXmppStanza::Error::ResourceConstraint);
+}
+
 void tst_QXmppPubSubManager::testStandardItemToString()
 {
     auto standardItemString = PSManager::standardItemIdToString(PSManager::Current);
@@ -5,7 +5,10 @@
 
 #include "QXmppClient.h"
 #include "QXmppDiscoveryManager.h"
+#include "QXmppOutgoingClient_p.h"
 #include "QXmppRosterManager.h"
+#include "QXmppRosterFileStorage.h"
+#include "QXmppRosterMemoryStorage.h"
 
 #include "TestClient.h"
 
@@ -21,6 +24,14 @@ private:
     Q_SLOT void subscriptionRequestReceived();
     Q_SLOT void testAddItem();
     Q_SLOT void testRemoveItem();
+    Q_SLOT void testVersionedRosterUnchanged();
+    Q_SLOT void testVersionedRosterReplaced();
+    Q_SLOT void testFileStorage();
+    Q_SLOT void testFileStorageCorrupt();
+    Q_SLOT void testPresences();
+#ifdef BUILD_BENCHMARKS
+    Q_SLOT void benchmarkInitialPresences();
+#endif
 
 private:
     QXmppClient client;
@@ -162,5 +173,249 @@ void tst_QXmppRosterManager::testRemoveItem()
     QCOMPARE(error.text(), u"Not found"_s);
 }
 
+void tst_QXmppRosterManager::testVersionedRosterUnchanged()
+{
+    TestClient test;
+    test.configuration().setJid(u"juliet@capulet.lit"_s);
+    test.streamPrivate()->isAuthenticated = true;
+    test.streamPrivate()->rosterVersioningSupported = true;
+    auto *rosterManager = test.addNewExtension<QXmppRosterManager>(&test);
+
+    QXmppRosterIq::Item romeo;
+    romeo.setBareJid(u"romeo@example.net"_s);
+    romeo.setName(u"Romeo"_s);
+    romeo.setSubscriptionType(QXmppRosterIq::Item::Both);
+
+    QXmppRosterMemoryStorage storage;
+    storage.replaceRoster({ u"ver14"_s, { romeo } });
+    rosterManager->setStorage(&storage);
+
+    QSignalSpy rosterReceivedSpy(rosterManager, &QXmppRosterManager::rosterReceived);
+    QSignalSpy itemChangedSpy(rosterManager, &QXmppRosterManager::itemChanged);
+
+    test.setStreamManagementState(QXmppClient::NewStream);
+    Q_EMIT test.connected();
+    test.expect("<iq id='qxmpp1' from='juliet@capulet.lit' type='get'><query xmlns='jabber:iq:roster' ver='ver14'><annotate xmlns='urn:xmpp:mix:roster:0'/></query></iq>");
+
+    // empty result: the stored roster is up to date
+    test.inject<QString>("<iq id='qxmpp1' type='result'/>");
+    QCOMPARE(rosterReceivedSpy.size(), 1);
+    QVERIFY(rosterManager->isRosterReceived());
+    QCOMPARE(rosterManager->getRosterBareJids(), QStringList { u"romeo@example.net"_s });
+    QCOMPARE(rosterManager->getRosterEntry(u"romeo@example.net"_s).name(), u"Romeo"_s);
+
+    // push that does not change anything
+    QVERIFY(rosterManager->handleStanza(xmlToDom(
+        u"<iq id='push1' type='set'><query xmlns='jabber:iq:roster' ver='ver15'>"
+        "<item jid='romeo@example.net' name='Romeo' subscription='both'/>"
+        "</query></iq>"_s)));
+    test.expect("<iq id='push1' type='result'/>");
+    QCOMPARE(itemChangedSpy.size(), 0);
+
+    // push with a real change
+    QVERIFY(rosterManager->handleStanza(xmlToDom(
+        u"<iq id='push2' type='set'><query xmlns='jabber:iq:roster' ver='ver16'>"
+        "<item jid='romeo@example.net' name='Romeo Montague' subscription='both'/>"
+        "</query></iq>"_s)));
+    test.expect("<iq id='push2' type='result'/>");
+    QCOMPARE(itemChangedSpy.size(), 1);
+    QCOMPARE(rosterManager->getRosterEntry(u"romeo@example.net"_s).name(), u"Romeo Montague"_s);
+
+    auto stored = storage.roster().takeResult();
+    QCOMPARE(stored.version, u"ver16"_s);
+    QCOMPARE(stored.items.size(), 1);
+    QCOMPARE(stored.items.first().name(), u"Romeo Montague"_s);
+}
+
+void tst_QXmppRosterManager::testVersionedRosterReplaced()
+{
+    TestClient test;
+    test.configuration().setJid(u"juliet@capulet.lit"_s);
+    test.streamPrivate()->isAuthenticated = true;
+    test.streamPrivate()->rosterVersioningSupported = true;
+    auto *rosterManager = test.addNewExtension<QXmppRosterManager>(&test);
+
+    QXmppRosterIq::Item romeo;
+    romeo.setBareJid(u"romeo@example.net"_s);
+
+    QXmppRosterMemoryStorage storage;
+    storage.replaceRoster({ u"ver14"_s, { romeo } });
+    rosterManager->setStorage(&storage);
+
+    test.setStreamManagementState(QXmppClient::NewStream);
+    Q_EMIT test.connected();
+    test.expect("<iq id='qxmpp1' from='juliet@capulet.lit' type='get'><query xmlns='jabber:iq:roster' ver='ver14'><annotate xmlns='urn:xmpp:mix:roster:0'/></query></iq>");
+
+    // the server sends the complete roster
+    test.inject<QString>(
+        u"<iq id='qxmpp1' type='result'><query xmlns='jabber:iq:roster' ver='ver20'>"
+        "<item jid='nurse@example.com' subscription='both'/>"
+        "</query></iq>"_s);
+    QVERIFY(rosterManager->isRosterReceived());
+    QCOMPARE(rosterManager->getRosterBareJids(), QStringList { u"nurse@example.com"_s });
+
+    auto stored = storage.roster().takeResult();
+    QCOMPARE(stored.version, u"ver20"_s);
+    QCOMPARE(stored.items.size(), 1);
+    QCOMPARE(stored.items.first().bareJid(), u"nurse@example.com"_s);
+}
+
+void tst_QXmppRosterManager::testFileStorage()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const auto fileName = dir.filePath(u"roster.xml"_s);
+
+    QXmppRosterIq::Item romeo;
+    romeo.setBareJid(u"romeo@example.net"_s);
+    romeo.setName(u"Romeo"_s);
+    romeo.setSubscriptionType(QXmppRosterIq::Item::Both);
+    romeo.setGroups({ u"Friends"_s });
+
+    QXmppRosterIq::Item nurse;
+    nurse.setBareJid(u"nurse@example.com"_s);
+    nurse.setSubscriptionType(QXmppRosterIq::Item::To);
+
+    {
+        QXmppRosterFileStorage storage(fileName);
+        QCOMPARE(storage.fileName(), fileName);
+
+        // no file yet
+        auto roster = storage.roster().takeResult();
+        QVERIFY(roster.version.isEmpty());
+        QVERIFY(roster.items.isEmpty());
+
+        storage.replaceRoster({ u"ver14"_s, { romeo, nurse } });
+        // written once control returns to the event loop
+        QVERIFY(!QFile::exists(fileName));
+        QTRY_VERIFY(QFile::exists(fileName));
+    }
+
+    // the file is replaced atomically, no temporary files are left
+    QCOMPARE(QDir(dir.path()).entryList(QDir::Files), QStringList { u"roster.xml"_s });
+
+    {
+        QXmppRosterFileStorage storage(fileName);
+        auto roster = storage.roster().takeResult();
+        QCOMPARE(roster.version, u"ver14"_s);
+        QCOMPARE(roster.items.size(), 2);
+        QCOMPARE(roster.items.at(0).bareJid(), u"romeo@example.net"_s);
+        QCOMPARE(roster.items.at(0).name(), u"Romeo"_s);
+        QCOMPARE(roster.items.at(0).subscriptionType(), QXmppRosterIq::Item::Both);
+        QCOMPARE(roster.items.at(0).groups(), QSet<QString> { u"Friends"_s });
+        QCOMPARE(roster.items.at(1).bareJid(), u"nurse@example.com"_s);
+
+        // pending changes are written on destruction
+        nurse.setSubscriptionType(QXmppRosterIq::Item::Remove);
+        storage.updateItems(u"ver15"_s, { nurse });
+    }
+
+    QXmppRosterFileStorage storage(fileName);
+    auto roster = storage.roster().takeResult();
+    QCOMPARE(roster.version, u"ver15"_s);
+    QCOMPARE(roster.items.size(), 1);
+    QCOMPARE(roster.items.first().bareJid(), u"romeo@example.net"_s);
+
+    storage.resetAll();
+    QVERIFY(!QFile::exists(fileName));
+}
+
+void tst_QXmppRosterManager::testFileStorageCorrupt()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const auto fileName = dir.filePath(u"roster.xml"_s);
+
+    {
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write("<roster xmlns='jabber:iq:roster' ver='ver14'><item jid='romeo@exa");
+    }
+
+    // a corrupt file is treated like no stored roster, so the roster is requested without version
+    QXmppRosterFileStorage storage(fileName);
+    auto roster = storage.roster().takeResult();
+    QVERIFY(roster.version.isEmpty());
+    QVERIFY(roster.items.isEmpty());
+
+    QXmppRosterIq::Item romeo;
+    romeo.setBareJid(u"romeo@example.net"_s);
+    storage.updateItems(u"ver15"_s, { romeo });
+    QTRY_VERIFY(QXmppRosterFileStorage(fileName).roster().takeResult().version == u"ver15"_s);
+}
+
+void tst_QXmppRosterManager::testPresences()
+{
+    TestClient test;
+    auto *rosterManager = test.addNewExtension<QXmppRosterManager>(&test);
+
+    QXmppPresence presence;
+    presence.setFrom(u"romeo@example.net/orchard"_s);
+    presence.setStatusText(u"In the orchard"_s);
+    Q_EMIT test.presenceReceived(presence);
+
+    presence.setFrom(u"romeo@example.net/balcony"_s);
+    presence.setStatusText(u"On the balcony"_s);
+    Q_EMIT test.presenceReceived(presence);
+
+    // sorted, independent of the arrival order
+    QCOMPARE(rosterManager->getResources(u"romeo@example.net"_s), (QStringList { u"balcony"_s, u"orchard"_s }));
+    QCOMPARE(rosterManager->getPresence(u"romeo@example.net"_s, u"orchard"_s).statusText(), u"In the orchard"_s);
+    QCOMPARE(rosterManager->getAllPresencesForBareJid(u"romeo@example.net"_s).size(), 2);
+
+    QStringList visited;
+    rosterManager->visitPresences(u"romeo@example.net"_s, [&](const QString &resource, const QXmppPresence &) {
+        visited << resource;
+        return false;
+    });
+    QCOMPARE(visited, (QStringList { u"orchard"_s, u"balcony"_s }));
+
+    // update of an existing resource
+    presence.setStatusText(u"Still on the balcony"_s);
+    Q_EMIT test.presenceReceived(presence);
+    QCOMPARE(rosterManager->getResources(u"romeo@example.net"_s).size(), 2);
+    QCOMPARE(rosterManager->getPresence(u"romeo@example.net"_s, u"balcony"_s).statusText(), u"Still on the balcony"_s);
+
+    presence.setType(QXmppPresence::Unavailable);
+    Q_EMIT test.presenceReceived(presence);
+    QCOMPARE(rosterManager->getResources(u"romeo@example.net"_s), QStringList { u"orchard"_s });
+    QCOMPARE(rosterManager->getPresence(u"romeo@example.net"_s, u"balcony"_s).type(), QXmppPresence::Unavailable);
+
+    presence.setFrom(u"romeo@example.net/orchard"_s);
+    Q_EMIT test.presenceReceived(presence);
+    QVERIFY(rosterManager->getResources(u"romeo@example.net"_s).isEmpty());
+    QVERIFY(rosterManager->getAllPresencesForBareJid(u"romeo@example.net"_s).isEmpty());
+}
+
+#ifdef BUILD_BENCHMARKS
+void tst_QXmppRosterManager::benchmarkInitialPresences()
+{
+    constexpr int contactCount = 20000;
+
+    TestClient test;
+    auto *rosterManager = test.addNewExtension<QXmppRosterManager>(&test);
+
+    QList<QXmppPresence> presences;
+    presences.reserve(contactCount);
+    for (int i = 0; i < contactCount; i++) {
+        QXmppPresence presence;
+        presence.setFrom(u"contact%1@example.org/resource"_s.arg(i));
+        presences << presence;
+    }
+
+    // without stream management the presences are dropped on disconnect, so every iteration
+    // measures the initial presences and not updates of known ones
+    test.setStreamManagementState(QXmppClient::NoStreamManagement);
+    QBENCHMARK {
+        Q_EMIT test.disconnected();
+        for (const auto &presence : std::as_const(presences)) {
+            Q_EMIT test.presenceReceived(presence);
+        }
+    }
+
+    QCOMPARE(rosterManager->getResources(u"contact42@example.org"_s), QStringList { u"resource"_s });
+}
+#endif
+
 QTEST_MAIN(tst_QXmppRosterManager)
 #include "tst_qxmpprostermanager.moc"
@@ -10,6 +10,7 @@
 
 #include <QBuffer>
 #include <QObject>
+#include <QTemporaryFile>
 
 class tst_QXmppTransferManager : public QObject
 {
@@ -45,18 +46,24 @@ void tst_QXmppTransferManager::testSendFile_data()
     QTest::addColumn<QXmppTransferJob::Method>("senderMethods");
     QTest::addColumn<QXmppTransferJob::Method>("receiverMethods");
     QTest::addColumn<bool>("works");
+    QTest::addColumn<bool>("diskFile");
+    QTest::addColumn<bool>("hashing");
 
-    QTest::newRow("any - any") << QXmppTransferJob::AnyMethod << QXmppTransferJob::AnyMethod << true;
-    QTest::newRow("any - inband") << QXmppTransferJob::AnyMethod << QXmppTransferJob::InBandMethod << true;
-    QTest::newRow("any - socks") << QXmppTransferJob::AnyMethod << QXmppTransferJob::SocksMethod << true;
+    QTest::newRow("any - any") << QXmppTransferJob::AnyMethod << QXmppTransferJob::AnyMethod << true << false << true;
+    QTest::newRow("any - inband") << QXmppTransferJob::AnyMethod << QXmppTransferJob::InBandMethod << true << false << true;
+    QTest::newRow("any - socks") << QXmppTransferJob::AnyMethod << QXmppTransferJob::SocksMethod << true << false << true;
 
-    QTest::newRow("inband - any") << QXmppTransferJob::InBandMethod << QXmppTransferJob::AnyMethod << true;
-    QTest::newRow("inband - inband") << QXmppTransferJob::InBandMethod << QXmppTransferJob::InBandMethod << true;
-    QTest::newRow("inband - socks") << QXmppTransferJob::InBandMethod << QXmppTransferJob::SocksMethod << false;
+    QTest::newRow("inband - any") << QXmppTransferJob::InBandMethod << QXmppTransferJob::AnyMethod << true << false << true;
+    QTest::newRow("inband - inband") << QXmppTransferJob::InBandMethod << QXmppTransferJob::InBandMethod << true << false << true;
+    QTest::newRow("inband - socks") << QXmppTransferJob::InBandMethod << QXmppTransferJob::SocksMethod << false << false << true;
 
-    QTest::newRow("socks - any") << QXmppTransferJob::SocksMethod << QXmppTransferJob::AnyMethod << true;
-    QTest::newRow("socks - inband") << QXmppTransferJob::SocksMethod << QXmppTransferJob::InBandMethod << false;
-    QTest::newRow("socks - socks") << QXmppTransferJob::SocksMethod << QXmppTransferJob::SocksMethod << true;
+    QTest::newRow("socks - any") << QXmppTransferJob::SocksMethod << QXmppTransferJob::AnyMethod << true << false << true;
+    QTest::newRow("socks - inband") << QXmppTransferJob::SocksMethod << QXmppTransferJob::InBandMethod << false << false << true;
+    QTest::newRow("socks - socks") << QXmppTransferJob::SocksMethod << QXmppTransferJob::SocksMethod << true << false << true;
+
+    // files on disk can be sent with sendfile()
+    QTest::newRow("socks - socks, disk file") << QXmppTransferJob::SocksMethod << QXmppTransferJob::SocksMethod << true << true << true;
+    QTest::newRow("socks - socks, disk file, no hashing") << QXmppTransferJob::SocksMethod << QXmppTransferJob::SocksMethod << true << true << false;
 }
 
 void tst_QXmppTransferManager::testSendFile()
@@ -64,6 +71,8 @@ void tst_QXmppTransferManager::testSendFile()
     QFETCH(QXmppTransferJob::Method, senderMethods);
     QFETCH(QXmppTransferJob::Method, receiverMethods);
     QFETCH(bool, works);
+    QFETCH(bool, diskFile);
+    QFETCH(bool, hashing);
 
     const QString testDomain("localhost");
     const QHostAddress testHost(QHostAddress::LocalHost);
@@ -87,6 +96,7 @@ void tst_QXmppTransferManager::testSendFile()
     QXmppClient sender;
     auto *senderManager = new QXmppTransferManager;
     senderManager->setSupportedMethods(senderMethods);
+    senderManager->setHashingEnabled(hashing);
     sender.addExtension(senderManager);
     sender.setLogger(&logger);
 
@@ -108,6 +118,7 @@ void tst_QXmppTransferManager::testSendFile()
     QXmppClient receiver;
     auto *receiverManager = new QXmppTransferManager;
     receiverManager->setSupportedMethods(receiverMethods);
+    receiverManager->setHashingEnabled(hashing);
     connect(receiverManager, &QXmppTransferManager::fileReceived,
             this, &tst_QXmppTransferManager::acceptFile);
     receiver.addExtension(receiverManager);
@@ -123,11 +134,28 @@ void tst_QXmppTransferManager::testSendFile()
     receiverLoop.exec();
     QCOMPARE(receiver.isConnected(), true);
 
+    // prepare file
+    QFile resourceFile(":/test.svg");
+    QVERIFY(resourceFile.open(QIODevice::ReadOnly));
+    QByteArray expectedData = resourceFile.readAll();
+    QString filePath = resourceFile.fileName();
+
+    QTemporaryFile temporaryFile;
+    if (diskFile) {
+        // large enough to fill the socket buffers
+        expectedData = expectedData.repeated(500);
+        QVERIFY(temporaryFile.open());
+        QCOMPARE(temporaryFile.write(expectedData), qint64(expectedData.size()));
+        temporaryFile.close();
+        filePath = temporaryFile.fileName();
+    }
+
     // send file
     QEventLoop loop;
-    QXmppTransferJob *senderJob = senderManager->sendFile(receiver.configuration().jid(), ":/test.svg");
+    QXmppTransferJob *senderJob = senderManager->sendFile(receiver.configuration().jid(), filePath);
     QVERIFY(senderJob);
-    QCOMPARE(senderJob->localFileUrl(), QUrl::fromLocalFile(":/test.svg"));
+    QCOMPARE(senderJob->localFileUrl(), QUrl::fromLocalFile(filePath));
+    QCOMPARE(senderJob->fileHash().isEmpty(), !hashing);
     connect(senderJob, &QXmppTransferJob::finished, &loop, &QEventLoop::quit);
     loop.exec();
 
@@ -144,9 +172,6 @@ void tst_QXmppTransferManager::testSendFile()
         QCOMPARE(receiverJob->error(), QXmppTransferJob::NoError);
 
         // check received file
-        QFile expectedFile(":/test.svg");
-        QVERIFY(expectedFile.open(QIODevice::ReadOnly));
-        const QByteArray expectedData = expectedFile.readAll();
         QCOMPARE(receiverBuffer.data(), expectedData);
     } else {
         QCOMPARE(senderJob->state(), QXmppTransferJob::FinishedState);
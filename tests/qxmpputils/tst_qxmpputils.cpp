@@ -12,6 +12,8 @@
 
 #include "util.h"
 
+#include <QBuffer>
+#include <QElapsedTimer>
 #include <QObject>
 
 using namespace QXmpp;
@@ -32,6 +34,11 @@ private:
     Q_SLOT void testStanzaHash();
     Q_SLOT void testCalculateHashes_data();
     Q_SLOT void testCalculateHashes();
+    Q_SLOT void testHashingDevice();
+#ifdef BUILD_BENCHMARKS
+    Q_SLOT void benchmarkCalculateHashes_data();
+    Q_SLOT void benchmarkCalculateHashes();
+#endif
     Q_SLOT void testParseHostAddress_data();
     Q_SLOT void testParseHostAddress();
 };
@@ -183,6 +190,12 @@ void tst_QXmppUtils::testCalculateHashes_data()
         << u":/test.svg"_s
         << QByteArray::fromHex("a5e86044842e4c8306e9e2ee041fc26d57d172d5cb32346d5ee467c97c5a0b0b2350bc5a4a3dc76b92c48585c2ebbb01cf47fa59a88420fe7bba8f2a18af6f07")
         << HashAlgorithm::Blake2b_512;
+#endif
+#ifdef WITH_BLAKE3
+    QTest::newRow("svg/blake3-256")
+        << u":/test.svg"_s
+        << QByteArray::fromHex("0762a759dda2e20910ed6fa473f872c30098185c4adcb0d0874339566d9336c8")
+        << HashAlgorithm::Blake3_256;
 #endif
     QTest::newRow("bmp/sha3-256")
         << u":/test.bmp"_s
@@ -206,6 +219,101 @@ void tst_QXmppUtils::testCalculateHashes()
     QCOMPARE(hashes.front().hash(), hash);
 }
 
+void tst_QXmppUtils::testHashingDevice()
+{
+    auto openFile = []() {
+        auto file = std::make_unique<QFile>(u":/test.svg"_s);
+        [&]() { QVERIFY(file->open(QFile::ReadOnly)); }();
+        return file;
+    };
+    const std::vector<HashAlgorithm> algorithms = { HashAlgorithm::Sha256, HashAlgorithm::Sha3_256 };
+
+    auto expectedResult = wait(calculateHashes(openFile(), algorithms));
+    auto expected = expectVariant<std::vector<QXmppHash>>(std::move(expectedResult->result));
+
+    auto device = std::make_unique<HashingDevice>(openFile(), algorithms);
+    auto future = device->hashesFuture();
+    QCOMPARE(device->size(), QFile(u":/test.svg"_s).size());
+
+    // data read again after seeking back is only hashed once
+    auto data = device->read(1000);
+    QVERIFY(device->seek(500));
+    data = data.left(500) + device->read(300);
+    data += device->readAll();
+    QCOMPARE(qint64(data.size()), device->size());
+
+    auto hashes = expectVariant<std::vector<QXmppHash>>(std::move(wait(future)->result));
+    QCOMPARE(hashes.size(), expected.size());
+    for (size_t i = 0; i < hashes.size(); i++) {
+        QCOMPARE(hashes[i].algorithm(), expected[i].algorithm());
+        QCOMPARE(hashes[i].hash(), expected[i].hash());
+    }
+
+    // skipped data can't be hashed
+    device = std::make_unique<HashingDevice>(openFile(), algorithms);
+    future = device->hashesFuture();
+    QVERIFY(device->seek(100));
+    device->readAll();
+    device.reset();
+    expectVariant<QXmppError>(std::move(wait(future)->result));
+
+    // written data is hashed, too
+    auto buffer = std::make_unique<QBuffer>();
+    buffer->open(QIODevice::WriteOnly);
+    auto *bufferPtr = buffer.get();
+    device = std::make_unique<HashingDevice>(std::move(buffer), algorithms);
+    future = device->hashesFuture();
+    for (qsizetype i = 0; i < data.size(); i += 1000) {
+        QCOMPARE(device->write(data.mid(i, 1000)), qint64(data.mid(i, 1000).size()));
+    }
+    QCOMPARE(bufferPtr->data(), data);
+    device->finish();
+
+    hashes = expectVariant<std::vector<QXmppHash>>(std::move(wait(future)->result));
+    QCOMPARE(hashes.size(), expected.size());
+    QCOMPARE(hashes.front().hash(), expected.front().hash());
+    QCOMPARE(verificationHash({ expected.front() })->hash(), expected.front().hash());
+    QVERIFY(std::holds_alternative<HashVerificationResult::Verified>(
+        verifyHashingResult(std::vector { hashes.front() }, expected.front())));
+}
+
+#ifdef BUILD_BENCHMARKS
+void tst_QXmppUtils::benchmarkCalculateHashes_data()
+{
+    QTest::addColumn<QVector<HashAlgorithm>>("algorithms");
+
+    QTest::newRow("sha-256") << QVector<HashAlgorithm> { HashAlgorithm::Sha256 };
+    QTest::newRow("sha-512") << QVector<HashAlgorithm> { HashAlgorithm::Sha512 };
+    QTest::newRow("sha3-256") << QVector<HashAlgorithm> { HashAlgorithm::Sha3_256 };
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    QTest::newRow("blake2b-256") << QVector<HashAlgorithm> { HashAlgorithm::Blake2b_256 };
+#endif
+#ifdef WITH_BLAKE3
+    QTest::newRow("blake3-256") << QVector<HashAlgorithm> { HashAlgorithm::Blake3_256 };
+#endif
+    // as for file sharing with several hashes, all are calculated in one pass
+    QTest::newRow("sha-256, sha3-256, sha-512") << QVector<HashAlgorithm> { HashAlgorithm::Sha256, HashAlgorithm::Sha3_256, HashAlgorithm::Sha512 };
+}
+
+void tst_QXmppUtils::benchmarkCalculateHashes()
+{
+    QFETCH(QVector<HashAlgorithm>, algorithms);
+    constexpr qint64 fileSize = 64 * 1024 * 1024;
+
+    auto file = createBenchmarkFile(fileSize);
+    auto input = std::make_unique<QFile>(file->fileName());
+    QVERIFY(input->open(QIODevice::ReadOnly));
+
+    QElapsedTimer timer;
+    timer.start();
+    auto result = wait(calculateHashes(std::move(input), std::vector(algorithms.begin(), algorithms.end())));
+    setThroughputResult(fileSize, timer.nsecsElapsed());
+
+    auto hashes = expectVariant<std::vector<QXmppHash>>(std::move(result->result));
+    QCOMPARE(hashes.size(), size_t(algorithms.size()));
+}
+#endif
+
 void tst_QXmppUtils::testParseHostAddress_data()
 {
     QTest::addColumn<QString>("input");
@@ -4,6 +4,7 @@
 // SPDX-License-Identifier: LGPL-2.1-or-later
 
 #include "QXmppClient.h"
+#include "QXmppPresence.h"
 #include "QXmppVCardIq.h"
 #include "QXmppVCardManager.h"
 
@@ -13,11 +14,13 @@
 
 #include <memory>
 
+#include <QCryptographicHash>
 #include <QObject>
 
 Q_DECLARE_METATYPE(QXmppVCardIq);
 
 using namespace QXmpp;
+using namespace std::chrono_literals;
 
 class tst_QXmppVCardManager : public QObject
 {
@@ -28,6 +31,8 @@ private:
     Q_SLOT void testHandleStanza();
     Q_SLOT void fetchVCard();
     Q_SLOT void setVCard();
+    Q_SLOT void cacheVCard();
+    Q_SLOT void cacheVCardExpiry();
 
     // integration tests
     Q_SLOT void testSetClientVCard();
@@ -184,6 +189,85 @@ void tst_QXmppVCardManager::setVCard()
     expectFutureVariant<Success>(task);
 }
 
+void tst_QXmppVCardManager::cacheVCard()
+{
+    TestClient test;
+    auto *manager = test.addNewExtension<QXmppVCardManager>();
+    QCOMPARE(manager->cacheSize(), qsizetype(0));
+    manager->setCacheSize(1024 * 1024);
+
+    // concurrent fetches are merged
+    auto task1 = manager->fetchVCard("juliet@capulet.lit");
+    auto task2 = manager->fetchVCard("juliet@capulet.lit");
+    test.expect("<iq id='qxmpp2' to='juliet@capulet.lit' type='get'><vCard xmlns='vcard-temp'><TITLE/><ROLE/></vCard></iq>");
+    test.expectNoPacket();
+    test.inject("<iq id='qxmpp2' from='juliet@capulet.lit' type='result'>"
+                "<vCard xmlns='vcard-temp'><NICKNAME>Juliet</NICKNAME><PHOTO><TYPE>image/png</TYPE><BINVAL>cGhvdG8=</BINVAL></PHOTO></vCard>"
+                "</iq>");
+    QCOMPARE(expectFutureVariant<QXmppVCardIq>(task1).nickName(), u"Juliet"_s);
+    QCOMPARE(expectFutureVariant<QXmppVCardIq>(task2).nickName(), u"Juliet"_s);
+
+    // cached vCards are returned without network traffic
+    auto cachedTask = manager->fetchVCard("juliet@capulet.lit");
+    test.expectNoPacket();
+    QCOMPARE(expectFutureVariant<QXmppVCardIq>(cachedTask).photo(), QByteArray("photo"));
+    QVERIFY(manager->cachedVCard("juliet@capulet.lit").has_value());
+
+    // announcing the same photo keeps the cached vCard
+    QXmppPresence presence;
+    presence.setFrom("juliet@capulet.lit/balcony");
+    presence.setVCardUpdateType(QXmppPresence::VCardUpdateValidPhoto);
+    presence.setPhotoHash(QCryptographicHash::hash("photo", QCryptographicHash::Sha1));
+    Q_EMIT test.presenceReceived(presence);
+    QVERIFY(manager->cachedVCard("juliet@capulet.lit").has_value());
+
+    // a new photo invalidates it
+    presence.setPhotoHash(QCryptographicHash::hash("new photo", QCryptographicHash::Sha1));
+    Q_EMIT test.presenceReceived(presence);
+    QVERIFY(!manager->cachedVCard("juliet@capulet.lit").has_value());
+
+    manager->fetchVCard("juliet@capulet.lit");
+    test.expect("<iq id='qxmpp2' to='juliet@capulet.lit' type='get'><vCard xmlns='vcard-temp'><TITLE/><ROLE/></vCard></iq>");
+}
+
+void tst_QXmppVCardManager::cacheVCardExpiry()
+{
+    TestClient test;
+    auto *manager = test.addNewExtension<QXmppVCardManager>();
+    manager->setCacheSize(1024 * 1024);
+
+    auto fetch = [&](QXmppTask<QXmppVCardManager::VCardIqResult> task) {
+        test.expect("<iq id='qxmpp2' to='juliet@capulet.lit' type='get'><vCard xmlns='vcard-temp'><TITLE/><ROLE/></vCard></iq>");
+        test.inject("<iq id='qxmpp2' from='juliet@capulet.lit' type='result'>"
+                    "<vCard xmlns='vcard-temp'><NICKNAME>Juliet</NICKNAME></vCard>"
+                    "</iq>");
+        expectFutureVariant<QXmppVCardIq>(task);
+    };
+
+    // without an announced photo hash, vCards are only used for the cache duration
+    manager->setCacheDuration(0s);
+    fetch(manager->fetchVCard("juliet@capulet.lit"));
+    QVERIFY(!manager->cachedVCard("juliet@capulet.lit").has_value());
+    manager->setCacheDuration(1h);
+    fetch(manager->fetchVCard("juliet@capulet.lit"));
+    QVERIFY(manager->cachedVCard("juliet@capulet.lit").has_value());
+
+    // the cache can be bypassed
+    fetch(manager->refreshVCard("juliet@capulet.lit"));
+    QVERIFY(manager->cachedVCard("juliet@capulet.lit").has_value());
+
+    // a resumed stream keeps the cache
+    test.setStreamManagementState(QXmppClient::ResumedStream);
+    Q_EMIT test.connected();
+    QVERIFY(manager->cachedVCard("juliet@capulet.lit").has_value());
+
+    // a new stream clears it
+    test.setStreamManagementState(QXmppClient::NewStream);
+    Q_EMIT test.connected();
+    QVERIFY(!manager->cachedVCard("juliet@capulet.lit").has_value());
+    test.expectNoPacket();
+}
+
 void tst_QXmppVCardManager::testSetClientVCard()
 {
     SKIP_IF_INTEGRATION_TESTS_DISABLED();
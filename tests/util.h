@@ -47,6 +47,27 @@ inline QDomElement xmlToDom(const String &xml)
     return doc.documentElement();
 }
 
+#ifdef BUILD_BENCHMARKS
+// Creates a temporary file of at least the given size for benchmarks
+inline std::unique_ptr<QTemporaryFile> createBenchmarkFile(qint64 size)
+{
+    auto file = std::make_unique<QTemporaryFile>();
+    VERIFY2(file->open(), "Could not create temporary file.");
+    const QByteArray block(1024 * 1024, 'x');
+    for (qint64 written = 0; written < size; written += block.size()) {
+        VERIFY2(file->write(block) == block.size(), "Could not write temporary file.");
+    }
+    VERIFY2(file->flush(), "Could not write temporary file.");
+    return file;
+}
+
+// Reports the throughput of processing the given number of bytes as benchmark result
+inline void setThroughputResult(qint64 bytes, qint64 nsecsElapsed)
+{
+    QTest::setBenchmarkResult(qreal(bytes) * 1e9 / qreal(std::max<qint64>(nsecsElapsed, 1)), QTest::BytesPerSecond);
+}
+#endif
+
 template<typename T>
 static QByteArray packetToXml(const T &packet)
 {